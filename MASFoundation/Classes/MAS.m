@@ -1221,7 +1221,7 @@ withParameters:(nullable NSDictionary *)parameterInfo
         
     
         
-        [[MASNetworkingService sharedService] postMultiPartForm:request.endPoint withParameters:request.body andHeaders:request.header requestType:request.requestType responseType:request.responseType isPublic:request.isPublic timeoutInterval:timeoutInterval constructingBodyBlock:formDataBlock progress:progressBlock taskBlock:nil completion:completion];
+        [[MASNetworkingService sharedService] postMultiPartForm:request.endPoint withParameters:request.body andHeaders:request.header requestType:request.requestType responseType:request.responseType isPublic:request.isPublic timeoutInterval:timeoutInterval compressRequestBody:request.compressRequestBody constructingBodyBlock:formDataBlock progress:progressBlock taskBlock:nil completion:completion];
         
     }];
 }
@@ -1247,7 +1247,7 @@ withParameters:(nullable NSDictionary *)parameterInfo
             (request.timeoutInterval == MASDefaultNetworkTimeoutConfiguration) ?
             [self timeoutIntervalForEndpoint:request.endPoint] : request.timeoutInterval;
         
-        [[MASNetworkingService sharedService] postMultiPartForm:request.endPoint withParameters:request.body andHeaders:request.header requestType:request.requestType responseType:request.responseType isPublic:request.isPublic timeoutInterval:timeoutInterval  constructingBodyBlock:formDataBlock progress:progressBlock taskBlock:taskBlock completion:completion];
+        [[MASNetworkingService sharedService] postMultiPartForm:request.endPoint withParameters:request.body andHeaders:request.header requestType:request.requestType responseType:request.responseType isPublic:request.isPublic timeoutInterval:timeoutInterval compressRequestBody:request.compressRequestBody constructingBodyBlock:formDataBlock progress:progressBlock taskBlock:taskBlock completion:completion];
         
     }];
 }
@@ -1694,12 +1694,35 @@ withParameters:(nullable NSDictionary *)parameterInfo
     }
     
     //
-    //  Retrieve private key from registered device's client certificate
+    //  Check if the client registration status
+    //
+    if (![MASApplication currentApplication].isRegistered)
+    {
+        if (error)
+        {
+            *error = [NSError errorApplicationNotRegistered];
+        }
+        
+        return nil;
+    }
+    
+    //
+    //  Validate MASClaims object
+    //
+    if (claims == nil)
+    {
+        if (error)
+        {
+            *error = [NSError errorForFoundationCode:MASFoundationErrorCodeJWTInvalidClaims errorDomain:MASFoundationErrorDomainLocal];
+        }
+        
+        return nil;
+    }
+    
+    //
+    //  Sign with the registered device's private key kept by the security service
     //
-    SecKeyRef pemPrivateRef = [[MASAccessService sharedService] getAccessValueCryptoKeyWithStorageKey:MASKeychainStorageKeyPrivateKey];
-    NSData *privateKeyData = [NSData converKeyRefToNSData:pemPrivateRef];
- 
-    return [self signWithClaims:claims privateKey:privateKeyData error:error];
+    return [claims buildWithError:error];
 }
 
 
@@ -17,6 +17,8 @@
 }
 @property(nonatomic,readwrite,weak)MASSessionDataTaskOperation* operation;
 @property(readwrite)NSString* taskID;
+@property(nonatomic,assign)BOOL cancelRequested;
+@property(nonatomic,assign)BOOL completionDelivered;
 @end
 
 
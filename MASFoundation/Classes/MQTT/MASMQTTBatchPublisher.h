@@ -0,0 +1,141 @@
+//
+//  MASMQTTBatchPublisher.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <MASFoundation/MASMQTTClient.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+//Maximum length in bytes a received compressed batch body may decompress to, unless specified otherwise. 1 MB
+extern NSUInteger const MASMQTTBatchDefaultMaxBatchLength;
+
+/**
+ *  MASMQTTBatchPublisher coalesces small messages published to the same topic into a single MQTT PUBLISH.
+ *
+ *  Messages are buffered per topic and sent as one batch once maxDelay has elapsed since the first buffered message,
+ *  or as soon as the batch reaches maxBatchSize bytes or maxMessageCount messages, whichever comes first.
+ *  When compressionEnabled is YES, the batch is gzip compressed if that makes it smaller.
+ *
+ *  Subscribers of a topic receiving batches must split them with payloadsFromBatchData:.
+ */
+@interface MASMQTTBatchPublisher : NSObject
+
+
+
+///--------------------------------------
+/// @name Properties
+///--------------------------------------
+
+# pragma mark - Properties
+
+//MQTT client the batches are published with
+@property (nonatomic, weak, readonly, nullable) MASMQTTClient *client;
+
+//QoS the batches are published with
+@property (nonatomic, assign, readonly) MQTTQualityOfService qos;
+
+//Maximum time in seconds a message is buffered before its batch is published. Defaults to 0.1 seconds
+@property (nonatomic, assign) NSTimeInterval maxDelay;
+
+//Size in bytes of buffered payloads at which a batch is published right away. Defaults to 16384 bytes
+@property (nonatomic, assign) NSUInteger maxBatchSize;
+
+//Number of buffered messages at which a batch is published right away. Defaults to 100 messages
+@property (nonatomic, assign) NSUInteger maxMessageCount;
+
+//Whether batches are gzip compressed when that makes them smaller. Defaults to NO
+@property (nonatomic, assign) BOOL compressionEnabled;
+
+
+
+///--------------------------------------
+/// @name Lifecycle
+///--------------------------------------
+
+# pragma mark - Lifecycle
+
+/**
+ *  Initializer to create a batch publisher publishing with the given MQTT client.
+ *
+ *  @param client MASMQTTClient object used to publish the batches
+ *  @param qos MQTTQualityOfService the batches are published with
+ *
+ *  @return MASMQTTBatchPublisher object
+ */
+- (instancetype)initWithClient:(MASMQTTClient *)client qos:(MQTTQualityOfService)qos;
+
+
+
+- (instancetype)init NS_UNAVAILABLE;
+
+
+
+///--------------------------------------
+/// @name Publish
+///--------------------------------------
+
+# pragma mark - Publish
+
+/**
+ *  Buffers a message to be published to a topic with the next batch for that topic.
+ *
+ *  @param payload NSData the message payload
+ *  @param topic NSString the topic to publish to
+ *  @param completion MQTTPublishingCompletionBlock invoked once the batch containing the message has been published
+ */
+- (void)publishData:(NSData *)payload
+            toTopic:(NSString *)topic
+         completion:(MQTTPublishingCompletionBlock _Nullable)completion;
+
+
+
+/**
+ *  Publishes the buffered messages of all topics right away.
+ *  Buffered messages are also published when the batch publisher is deallocated.
+ */
+- (void)flush;
+
+
+
+///--------------------------------------
+/// @name Batch
+///--------------------------------------
+
+# pragma mark - Batch
+
+/**
+ *  Splits the payload of a received batch into the payloads of the messages it contains.
+ *  A compressed batch is rejected if it decompresses to more than MASMQTTBatchDefaultMaxBatchLength bytes.
+ *
+ *  @param data NSData the payload of a received MASMQTTMessage
+ *
+ *  @return NSArray of NSData payloads in the order they were published, or nil if data is not a valid batch
+ */
++ (NSArray<NSData *> * _Nullable)payloadsFromBatchData:(NSData *)data;
+
+
+
+/**
+ *  Splits the payload of a received batch into the payloads of the messages it contains.
+ *  A compressed batch is only decompressed up to maxBatchLength bytes, so that a small payload cannot
+ *  inflate into an arbitrarily large one.
+ *
+ *  @param data NSData the payload of a received MASMQTTMessage
+ *  @param maxBatchLength NSUInteger maximum length in bytes of the decompressed batch body
+ *
+ *  @return NSArray of NSData payloads in the order they were published, or nil if data is not a valid batch
+ *          or decompresses to more than maxBatchLength bytes
+ */
++ (NSArray<NSData *> * _Nullable)payloadsFromBatchData:(NSData *)data maxBatchLength:(NSUInteger)maxBatchLength;
+
+@end
+
+NS_ASSUME_NONNULL_END
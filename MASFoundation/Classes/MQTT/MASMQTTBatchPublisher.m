@@ -0,0 +1,330 @@
+//
+//  MASMQTTBatchPublisher.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASMQTTBatchPublisher.h"
+
+#import "NSData+MASPrivate.h"
+
+//
+//  A batch is a 4 bytes magic, a version byte and a flags byte followed by the body.
+//  The body is a sequence of messages, each a 4 bytes big-endian length followed by the payload.
+//
+static const UInt8 MASMQTTBatchMagic[4] = { 'M', 'A', 'S', 'B' };
+static const UInt8 MASMQTTBatchVersion = 1;
+static const UInt8 MASMQTTBatchFlagCompressed = 0x01;
+static const NSUInteger MASMQTTBatchHeaderLength = 6;
+static const NSUInteger MASMQTTBatchLengthPrefix = sizeof(UInt32);
+
+NSUInteger const MASMQTTBatchDefaultMaxBatchLength = 1024 * 1024;
+
+
+static void MASMQTTBatchInvokeCompletions(NSArray *completions, BOOL completed, NSError *error, int mid)
+{
+    for (id completion in completions)
+    {
+        if (completion != [NSNull null])
+        {
+            ((MQTTPublishingCompletionBlock)completion)(completed, error, mid);
+        }
+    }
+}
+
+
+# pragma mark - MASMQTTBatch
+
+@interface MASMQTTBatch : NSObject
+
+@property (nonatomic, strong) NSMutableData *body;
+@property (nonatomic, strong) NSMutableArray *completions;
+@property (nonatomic, assign) NSUInteger count;
+
+@end
+
+
+@implementation MASMQTTBatch
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _body = [NSMutableData data];
+        _completions = [NSMutableArray array];
+        _count = 0;
+    }
+    
+    return self;
+}
+
+@end
+
+
+# pragma mark - MASMQTTBatchPublisher
+
+@interface MASMQTTBatchPublisher ()
+
+@property (nonatomic, weak, readwrite) MASMQTTClient *client;
+@property (nonatomic, assign, readwrite) MQTTQualityOfService qos;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, MASMQTTBatch *> *batches;
+@property (nonatomic, strong) dispatch_queue_t batchQueue;
+
+@end
+
+
+@implementation MASMQTTBatchPublisher
+
+# pragma mark - Lifecycle
+
+- (instancetype)initWithClient:(MASMQTTClient *)client qos:(MQTTQualityOfService)qos
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _client = client;
+        _qos = qos;
+        _maxDelay = 0.1;
+        _maxBatchSize = 16384;
+        _maxMessageCount = 100;
+        _compressionEnabled = NO;
+        _batches = [NSMutableDictionary dictionary];
+        _batchQueue = dispatch_queue_create("com.ca.MASFoundation.mqtt.batchQueue", DISPATCH_QUEUE_SERIAL);
+    }
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    //
+    //  Blocks queued by publishData:toTopic:completion: and flush retain the publisher, so the batches are no longer used on the batch queue.
+    //  Buffered messages are published rather than dropped, so that their completions are invoked.
+    //
+    for (NSString *topic in [self.batches allKeys])
+    {
+        [self publishBatchForTopic:topic];
+    }
+}
+
+
+# pragma mark - Publish
+
+- (void)publishData:(NSData *)payload toTopic:(NSString *)topic completion:(MQTTPublishingCompletionBlock)completion
+{
+    //
+    //  Validate parameters
+    //
+    if (payload == nil || topic.length == 0)
+    {
+        NSError *error = [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
+                                             code:911001
+                                         userInfo:@{ NSLocalizedDescriptionKey:@"MQTT error. Invalid parameter(s)." }];
+        
+        if (completion)
+        {
+            completion(NO, error, 0);
+        }
+        
+        return;
+    }
+    
+    NSString *batchTopic = [topic copy];
+    NSData *message = [payload copy];
+    id messageCompletion = completion ? [completion copy] : [NSNull null];
+    
+    dispatch_async(self.batchQueue, ^{
+        
+        MASMQTTBatch *batch = self.batches[batchTopic];
+        NSUInteger messageLength = MASMQTTBatchLengthPrefix + message.length;
+        
+        //
+        //  A message which would overflow the buffered batch is sent with the next one
+        //
+        if (batch && batch.body.length + messageLength > self.maxBatchSize)
+        {
+            [self publishBatchForTopic:batchTopic];
+            batch = nil;
+        }
+        
+        if (!batch)
+        {
+            batch = [[MASMQTTBatch alloc] init];
+            self.batches[batchTopic] = batch;
+            
+            [self scheduleFlushOfBatch:batch forTopic:batchTopic];
+        }
+        
+        UInt32 length = CFSwapInt32HostToBig((UInt32)message.length);
+        [batch.body appendBytes:&length length:sizeof(length)];
+        [batch.body appendData:message];
+        [batch.completions addObject:messageCompletion];
+        batch.count++;
+        
+        if (batch.body.length >= self.maxBatchSize || batch.count >= self.maxMessageCount)
+        {
+            [self publishBatchForTopic:batchTopic];
+        }
+    });
+}
+
+
+- (void)flush
+{
+    dispatch_async(self.batchQueue, ^{
+        
+        for (NSString *topic in [self.batches allKeys])
+        {
+            [self publishBatchForTopic:topic];
+        }
+    });
+}
+
+
+# pragma mark - Batch
+
++ (NSArray<NSData *> *)payloadsFromBatchData:(NSData *)data
+{
+    return [self payloadsFromBatchData:data maxBatchLength:MASMQTTBatchDefaultMaxBatchLength];
+}
+
+
++ (NSArray<NSData *> *)payloadsFromBatchData:(NSData *)data maxBatchLength:(NSUInteger)maxBatchLength
+{
+    if (data.length < MASMQTTBatchHeaderLength || memcmp(data.bytes, MASMQTTBatchMagic, sizeof(MASMQTTBatchMagic)) != 0)
+    {
+        return nil;
+    }
+    
+    const UInt8 *header = data.bytes;
+    
+    if (header[4] != MASMQTTBatchVersion)
+    {
+        return nil;
+    }
+    
+    NSData *body = [data subdataWithRange:NSMakeRange(MASMQTTBatchHeaderLength, data.length - MASMQTTBatchHeaderLength)];
+    
+    if (header[5] & MASMQTTBatchFlagCompressed)
+    {
+        body = [body gzipDecompressedDataWithMaximumLength:maxBatchLength];
+        
+        if (!body)
+        {
+            return nil;
+        }
+    }
+    
+    NSMutableArray<NSData *> *payloads = [NSMutableArray array];
+    const UInt8 *bytes = body.bytes;
+    NSUInteger offset = 0;
+    
+    while (offset < body.length)
+    {
+        if (body.length - offset < MASMQTTBatchLengthPrefix)
+        {
+            return nil;
+        }
+        
+        UInt32 length;
+        memcpy(&length, bytes + offset, sizeof(length));
+        length = CFSwapInt32BigToHost(length);
+        offset += MASMQTTBatchLengthPrefix;
+        
+        if (body.length - offset < length)
+        {
+            return nil;
+        }
+        
+        [payloads addObject:[body subdataWithRange:NSMakeRange(offset, length)]];
+        offset += length;
+    }
+    
+    return payloads;
+}
+
+
+# pragma mark - Private
+
+- (void)scheduleFlushOfBatch:(MASMQTTBatch *)batch forTopic:(NSString *)topic
+{
+    __weak typeof(self) weakSelf = self;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.maxDelay * NSEC_PER_SEC)), self.batchQueue, ^{
+        
+        //
+        //  The batch may already have been published because of its size or an explicit flush
+        //
+        __strong typeof(weakSelf) strongSelf = weakSelf;
+        
+        if (strongSelf && strongSelf.batches[topic] == batch)
+        {
+            [strongSelf publishBatchForTopic:topic];
+        }
+    });
+}
+
+
+- (void)publishBatchForTopic:(NSString *)topic
+{
+    MASMQTTBatch *batch = self.batches[topic];
+    
+    if (!batch)
+    {
+        return;
+    }
+    
+    [self.batches removeObjectForKey:topic];
+    
+    NSArray *completions = [batch.completions copy];
+    MASMQTTClient *client = self.client;
+    
+    if (!client)
+    {
+        NSError *error = [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
+                                             code:911000
+                                         userInfo:@{ NSLocalizedDescriptionKey:@"MQTT error. No client available." }];
+        
+        MASMQTTBatchInvokeCompletions(completions, NO, error, 0);
+        
+        return;
+    }
+    
+    //
+    //  Only send the compressed body when compression actually saves bytes
+    //
+    NSData *body = batch.body;
+    UInt8 flags = 0;
+    
+    if (self.compressionEnabled)
+    {
+        NSData *compressedBody = [body gzipCompressedData];
+        
+        if (compressedBody && compressedBody.length < body.length)
+        {
+            body = compressedBody;
+            flags |= MASMQTTBatchFlagCompressed;
+        }
+    }
+    
+    NSMutableData *data = [NSMutableData dataWithCapacity:MASMQTTBatchHeaderLength + body.length];
+    [data appendBytes:MASMQTTBatchMagic length:sizeof(MASMQTTBatchMagic)];
+    [data appendBytes:&MASMQTTBatchVersion length:sizeof(MASMQTTBatchVersion)];
+    [data appendBytes:&flags length:sizeof(flags)];
+    [data appendData:body];
+    
+    [client publishData:data toTopic:topic withQos:self.qos retain:NO completion:^(BOOL completed, NSError * _Nullable error, int mid) {
+        
+        MASMQTTBatchInvokeCompletions(completions, completed, error, mid);
+    }];
+}
+
+@end
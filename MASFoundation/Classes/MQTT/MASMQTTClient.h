@@ -115,6 +115,26 @@ typedef void (^MQTTMessageHandler)(MASMQTTMessage *message);
 
 
 
+/**
+ *  MQTTMessagesHandler
+ *
+ *  @param messages The MASMQTTMessage objects received together, in the order of arrival
+ */
+typedef void (^MQTTMessagesHandler)(NSArray<MASMQTTMessage *> *messages);
+
+
+
+/**
+ *  MQTTSpoolOutcomeHandler
+ *
+ *  @param message The MASMQTTMessage object taken from the offline spool
+ *  @param delivered Whether the broker acknowledged the message; NO if it was dropped from the offline spool
+ *  @param error The reason the message was dropped, if not delivered
+ */
+typedef void (^MQTTSpoolOutcomeHandler)(MASMQTTMessage *message, BOOL delivered, NSError *_Nullable error);
+
+
+
 /**
  *  MQTTDisconnectionHandler
  *
@@ -156,6 +176,97 @@ static NSString * const MASConnectaOperationDidReceiveMessageNotification = @"co
 //MessageHandler - block used for message callback from the broker
 @property (nonatomic, copy) MQTTMessageHandler messageHandler;
 
+//MessagesHandler - block used for batched message callback from the broker; messages received together are delivered in one call
+@property (nonatomic, copy) MQTTMessagesHandler messagesHandler;
+
+//PostsMessageNotification - post MASConnectaOperationDidReceiveMessageNotification for every message received (default is YES)
+@property (nonatomic, assign) BOOL postsMessageNotification;
+
+//ReconnectDelay - delay before the first reconnect attempt after the connection was lost, in seconds (default is 1)
+@property (nonatomic, assign) unsigned int reconnectDelay;
+
+//ReconnectDelayMax - cap of the reconnect delay, in seconds (default is 60)
+@property (nonatomic, assign) unsigned int reconnectDelayMax;
+
+//ReconnectExponentialBackoff - whether to double the reconnect delay after every attempt up to reconnectDelayMax (default is YES)
+//Each attempt waits a random time up to the current delay, so that clients do not reconnect in lockstep after a broker restart
+@property (nonatomic, assign) BOOL reconnectExponentialBackoff;
+
+//ReconnectStableInterval - time a connection has to stay up before the reconnect delay is reset, in seconds (default is 30)
+@property (nonatomic, assign) NSTimeInterval reconnectStableInterval;
+
+//AdaptiveKeepAliveEnabled - ping at an interval learned per network type instead of keepAlive, to wake the radio as rarely as possible (default is NO)
+//Longer intervals are only probed while the application is active; the broker is given keepAliveMaximum, so it notices a vanished client later
+@property (nonatomic, assign) BOOL adaptiveKeepAliveEnabled;
+
+//KeepAliveWiFi - initial adaptive keep alive interval on Wi-Fi networks, in seconds (default is 120)
+@property (nonatomic, assign) NSTimeInterval keepAliveWiFi;
+
+//KeepAliveCellular - initial adaptive keep alive interval on cellular networks, in seconds (default is 60)
+@property (nonatomic, assign) NSTimeInterval keepAliveCellular;
+
+//KeepAliveMaximum - longest adaptive keep alive interval, sent to the broker as the keep alive of the connection, in seconds (default is 1200)
+@property (nonatomic, assign) NSTimeInterval keepAliveMaximum;
+
+//CurrentKeepAliveInterval - interval the client currently pings the broker at, in seconds
+@property (nonatomic, readonly, assign) NSTimeInterval currentKeepAliveInterval;
+
+//CleanSession - whether the broker discards the session, its subscriptions and undelivered messages when the connection is closed
+@property (nonatomic, readonly, assign) BOOL cleanSession;
+
+//SessionPresent - whether the broker resumed a previous session on the current connection, so subscriptions do not have to be made again
+@property (nonatomic, readonly, assign) BOOL sessionPresent;
+
+//RoundTripTime - time between the last keep alive ping and its response, in seconds; 0 until measured on the current connection
+@property (nonatomic, readonly, assign) NSTimeInterval roundTripTime;
+
+//RecentDisconnectCount - number of times the connection was lost in the last 10 minutes
+@property (nonatomic, readonly, assign) NSUInteger recentDisconnectCount;
+
+//ConnectionHealth - score between 0 (not connected) and 1, 1 / (1 + roundTripTime) / (1 + recentDisconnectCount), e.g. to throttle publishing
+@property (nonatomic, readonly, assign) double connectionHealth;
+
+//ProtocolVersion5Enabled - connect using MQTT 5, which negotiates the broker's receive maximum and topic alias maximum (default is NO)
+@property (nonatomic, assign) BOOL protocolVersion5Enabled;
+
+//TopicAliasesEnabled - send topic aliases instead of repeated topics, up to the broker's topic alias maximum; MQTT 5 only (default is YES)
+@property (nonatomic, assign) BOOL topicAliasesEnabled;
+
+//WebSocketEnabled - connect over a WebSocket instead of a plain TCP connection, e.g. through proxies that only pass HTTP(S); default ports become 80 and 443 (default is NO)
+@property (nonatomic, assign) BOOL webSocketEnabled;
+
+//WebSocketPath - path of the broker's WebSocket endpoint (default is /mqtt)
+@property (nonatomic, copy) NSString *webSocketPath;
+
+//WebSocketCompressionEnabled - offer permessage-deflate compression to the broker when connecting over a WebSocket (default is YES)
+@property (nonatomic, assign) BOOL webSocketCompressionEnabled;
+
+//PublishCompletionTimeout - time after which the completion of a QoS 1 or 2 message not acknowledged by the broker is invoked with an error, in seconds (default is 120)
+@property (nonatomic, assign) NSTimeInterval publishCompletionTimeout;
+
+//OfflineSpoolEnabled - store QoS 1 and 2 messages published while disconnected on disk and publish them in order once connected again (default is NO)
+//Spooled messages are kept across application launches and published no faster than inflightWindowSize allows
+//Disabling the spool does not drop messages: those already published still report their outcome, the others are published once it is enabled again
+@property (nonatomic, assign) BOOL offlineSpoolEnabled;
+
+//OfflineSpoolMaxBytes - size of the spooled payloads and topics above which the oldest spooled messages are dropped, in bytes (default is 1048576)
+@property (nonatomic, assign) NSUInteger offlineSpoolMaxBytes;
+
+//OfflineSpoolMaxAge - time after which a spooled message expires without being published, in seconds (default is 86400)
+@property (nonatomic, assign) NSTimeInterval offlineSpoolMaxAge;
+
+//SpoolOutcomeHandler - block invoked once for every spooled message when it is delivered or dropped, including messages spooled before the application was relaunched
+@property (nonatomic, copy, nullable) MQTTSpoolOutcomeHandler spoolOutcomeHandler;
+
+//MaxInflightMessages - number of QoS 1 and 2 messages published before waiting for acknowledgement (default is 16)
+@property (nonatomic, assign) NSUInteger maxInflightMessages;
+
+//InflightWindowSize - number of in-flight messages, maxInflightMessages limited by the broker's receive maximum once connected
+@property (nonatomic, readonly, assign) NSUInteger inflightWindowSize;
+
+//BrokerTopicAliasMaximum - highest topic alias accepted by the broker once connected; 0 if the broker does not accept topic aliases
+@property (nonatomic, readonly, assign) NSUInteger brokerTopicAliasMaximum;
+
 //DisconnectionHandler - block used for disconnect callback from the broker
 @property (nonatomic, copy) MQTTDisconnectionHandler disconnectionHandler;
 
@@ -348,6 +459,26 @@ static NSString * const MASConnectaOperationDidReceiveMessageNotification = @"co
 
 
 
+/**
+ *  Used to Publish binary data on a given topic
+ *
+ *  A QoS 0 message completes once it was handed to the connection; if it could not be, the completion receives
+ *  the MQTTSession error (MQTTSessionErrorEncoderNotReady)
+ *
+ *  @param payload           The Payload to be sent
+ *  @param topic             The Topic to be sent
+ *  @param qos               The Quality of Service to be used
+ *  @param retain            Set to true to make the message retained
+ *  @param completion        The completion code block
+ */
+- (void)publishData:(NSData *)payload
+            toTopic:(NSString *)topic
+            withQos:(MQTTQualityOfService)qos
+             retain:(BOOL)retain
+         completion:(MQTTPublishingCompletionBlock _Nullable)completion;
+
+
+
 #pragma mark - Subscribe/Unsubscribe methods
 
 /**
@@ -374,6 +505,23 @@ static NSString * const MASConnectaOperationDidReceiveMessageNotification = @"co
 
 
 
+/**
+ *  Used to Subscribe to a topic using a specific Quality of Service, with a message handler invoked only for messages matching the topic
+ *
+ *  @param topic             The Topic to be subscribed to; may contain the + and # wildcards
+ *  @param qos               The Quality of Service to be used
+ *  @param queue             The dispatch queue on which the messageHandler is invoked; the main queue if nil
+ *  @param messageHandler    The message handler code block, kept until the topic is unsubscribed from or the subscription fails
+ *  @param completion The completionHandler code block
+ */
+- (void)subscribeToTopic:(NSString *)topic
+                 withQos:(MQTTQualityOfService)qos
+                   queue:(dispatch_queue_t _Nullable)queue
+          messageHandler:(MQTTMessageHandler _Nullable)messageHandler
+              completion:(MQTTSubscriptionCompletionBlock _Nullable)completion;
+
+
+
 /**
  *  Used to Unsubscribe from a topic
  *
@@ -17,6 +17,11 @@
 #import "MASAccessService.h"
 #import "MASMQTTHelper.h"
 #import "MASMQTTConstants.h"
+#import "MASMQTTCompletionTable.h"
+#import "MASMQTTKeepAliveTuner.h"
+#import "MASMQTTPublishSpool.h"
+#import "MASMQTTTopicRouter.h"
+#import "MASNetworkReachability.h"
 
 #import "MQTTLog.h"
 #import "MQTTSession.h"
@@ -28,7 +33,9 @@
 #import "MQTTTransport.h"
 #import "MQTTCFSocketTransport.h"
 #import "MQTTCoreDataPersistence.h"
+#import "MQTTInMemoryPersistence.h"
 #import "MQTTSSLSecurityPolicyTransport.h"
+#import "MQTTWebsocketTransport.h"
 #import "ReconnectTimer.h"
 
 #if TARGET_OS_IPHONE == 1
@@ -37,7 +44,11 @@
 
 #define kMQTTDefaultPort    1883
 #define kMQTTDefaultTLSPort 8883
+#define kMQTTDefaultWebSocketPort    80
+#define kMQTTDefaultWebSocketTLSPort 443
 #define kKeepAliveTime      60
+#define kPingTimeout        15
+#define kHealthWindow       600
 
 @interface MASMQTTClient () <MQTTSessionDelegate>
 
@@ -48,13 +59,21 @@
 @property (nonatomic,strong) NSMutableDictionary *subscriptionBlocks;
 @property (nonatomic,strong) NSMutableDictionary *unsubscriptionHandlers;
 
-// Dictionary of mid -> completion handlers for messages published with a QoS of 1 or 2
-@property (nonatomic,strong) NSMutableDictionary *publishHandlers;
-@property (nonatomic,strong) NSMutableDictionary *publishBlocks;
+// Completions of messages published with a QoS of 1 or 2, keyed by mid until acknowledged
+@property (nonatomic,strong) MASMQTTCompletionTable *publishCompletions;
 
 // Dispatch queue to run the mosquitto_loop_forever.
 @property (nonatomic,strong) dispatch_queue_t queue;
 
+// Messages waiting to be delivered to the messagesHandler
+@property (nonatomic,strong) NSMutableArray<MASMQTTMessage *> *pendingMessages;
+
+// Message handlers registered per topic filter
+@property (nonatomic,strong) MASMQTTTopicRouter *topicRouter;
+
+// QoS 1 and 2 messages published while offline; nil until offlineSpoolEnabled is first set, kept once disabled
+@property (nonatomic,strong) MASMQTTPublishSpool *publishSpool;
+
 // Host name
 @property (readwrite,copy) NSString *host;
 
@@ -73,17 +92,8 @@
 // Connection status
 @property (nonatomic,assign) BOOL connected;
 
-// ReconnectDelay - in seconds (default is 1)
-@property (readwrite,assign) unsigned int reconnectDelay;
-
-// ReconnectDelayMax - in seconds (default is 1)
-@property (readwrite,assign) unsigned int reconnectDelayMax;
-
-// ReconnectExponentialBackoff - wheter to backoff exponentially the reconnect attempts (default is NO)
-@property (readwrite,assign) BOOL reconnectExponentialBackoff;
-
 // CleanSession
-@property (readwrite,assign) BOOL cleanSession;
+@property (nonatomic,readwrite,assign) BOOL cleanSession;
 
 //  MQTT Session
 @property (readwrite, strong) MQTTSession *currentSession;
@@ -97,6 +107,24 @@
 //  Reconnect timer
 @property (strong, nonatomic) ReconnectTimer *reconnectTimer;
 
+//  Reachability of the host, to reconnect as soon as the network is back
+@property (strong, nonatomic) MASNetworkReachability *reachability;
+
+//  Dates at which the connection was lost within the health window
+@property (strong, nonatomic) NSMutableArray<NSDate *> *disconnectDates;
+
+//  Keep alive intervals learned per network type while adaptiveKeepAliveEnabled
+@property (strong, nonatomic) MASMQTTKeepAliveTuner *keepAliveTuner;
+
+//  Whether the application is active, the only time longer keep alive intervals are probed
+@property (assign, nonatomic) BOOL applicationActive;
+
+//  Whether a packet other than PINGREQ or PINGRESP was sent or received since the last PINGREQ
+@property (assign, nonatomic) BOOL trafficSincePing;
+
+//  Whether the connection was idle for the whole interval before the outstanding PINGREQ
+@property (assign, nonatomic) BOOL pingAfterIdleInterval;
+
 #if TARGET_OS_IPHONE == 1
 //  Foreground reconnection manager
 @property (strong, nonatomic) MASMQTTForegroundReconnection *foregroundReconnection;
@@ -186,21 +214,38 @@ static MASMQTTClient *_sharedClient = nil;
         self.subscriptionHandlers = [[NSMutableDictionary alloc] init];
         self.subscriptionBlocks = [[NSMutableDictionary alloc] init];
         self.unsubscriptionHandlers = [[NSMutableDictionary alloc] init];
-        self.publishHandlers = [[NSMutableDictionary alloc] init];
-        self.publishBlocks = [[NSMutableDictionary alloc] init];
         
         self.clientID = clientId;
         self.keepAlive = kKeepAliveTime;
         self.cleanSession = cleanSession;
         
         self.reconnectDelay = 1;
-        self.reconnectDelayMax = 1;
-        self.reconnectExponentialBackoff = NO;
+        self.reconnectDelayMax = 60;
+        self.reconnectExponentialBackoff = YES;
+        self.reconnectStableInterval = 30;
+        self.disconnectDates = [NSMutableArray array];
+        
+        self.adaptiveKeepAliveEnabled = NO;
+        self.keepAliveWiFi = 120;
+        self.keepAliveCellular = 60;
+        self.keepAliveMaximum = 1200;
+        self.applicationActive = YES;
+        
+        self.webSocketEnabled = NO;
+        self.webSocketPath = @"/mqtt";
+        self.webSocketCompressionEnabled = YES;
+        
+        self.offlineSpoolMaxBytes = 1024 * 1024;
+        self.offlineSpoolMaxAge = 24 * 60 * 60;
 
         self.debugMode = NO;
+        self.postsMessageNotification = YES;
+        self.pendingMessages = [NSMutableArray array];
+        self.topicRouter = [[MASMQTTTopicRouter alloc] init];
         
         const char *cstrClientId = [self.clientID cStringUsingEncoding:NSUTF8StringEncoding];
         self.queue = dispatch_queue_create(cstrClientId, NULL);
+        self.publishCompletions = [[MASMQTTCompletionTable alloc] initWithCallbackQueue:self.queue];
         
         _currentSession = [[MQTTSession alloc] initWithClientId:clientId];
         _currentSession.keepAliveInterval = self.keepAlive;
@@ -208,6 +253,12 @@ static MASMQTTClient *_sharedClient = nil;
         _currentSession.delegate = self;
         _currentSession.queue = self.queue;
         
+        //
+        //  Flows are never persisted to a file; the in-memory persistence indexes them by message id and deadline
+        //  instead of fetching and sorting all flows for every publish
+        //
+        _currentSession.persistence = [[MQTTInMemoryPersistence alloc] init];
+        
         //
         //  SSL/TLS
         //
@@ -218,6 +269,12 @@ static MASMQTTClient *_sharedClient = nil;
         
 #if TARGET_OS_IPHONE == 1
         self.foregroundReconnection = [[MASMQTTForegroundReconnection alloc] initWithMQTTClient:self];
+        
+        //
+        //  Longer keep alive intervals are only probed while the application is active
+        //
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(applicationStateChanged:) name:UIApplicationDidBecomeActiveNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(applicationStateChanged:) name:UIApplicationWillResignActiveNotification object:nil];
 #endif
         
         //
@@ -242,6 +299,8 @@ static MASMQTTClient *_sharedClient = nil;
 
 - (void)dealloc
 {
+    [_reachability stopMonitoring];
+    
     if (_currentSession)
     {
         [[NSNotificationCenter defaultCenter] removeObserver:self];
@@ -264,6 +323,198 @@ static MASMQTTClient *_sharedClient = nil;
 }
 
 
+- (NSTimeInterval)currentKeepAliveInterval
+{
+    if (self.adaptiveKeepAliveEnabled && self.keepAliveTuner)
+    {
+        return self.keepAliveTuner.interval;
+    }
+    
+    return self.keepAlive;
+}
+
+
+- (BOOL)sessionPresent
+{
+    return _currentSession.sessionPresent;
+}
+
+
+- (NSTimeInterval)roundTripTime
+{
+    return _currentSession.roundTripTime;
+}
+
+
+- (NSUInteger)recentDisconnectCount
+{
+    @synchronized(self.disconnectDates)
+    {
+        NSDate *windowStart = [NSDate dateWithTimeIntervalSinceNow:-kHealthWindow];
+        
+        while (self.disconnectDates.count && [self.disconnectDates.firstObject compare:windowStart] == NSOrderedAscending)
+        {
+            [self.disconnectDates removeObjectAtIndex:0];
+        }
+        
+        return self.disconnectDates.count;
+    }
+}
+
+
+- (double)connectionHealth
+{
+    if (!self.connected)
+    {
+        return 0.0;
+    }
+    
+    //
+    //  The score is divided by (1 + round trip time in seconds) and by (1 + connection losses within the health window),
+    //  i.e. a 1 second round trip or a single loss halves it, and 3 seconds or 3 losses quarter it
+    //
+    return 1.0 / (1.0 + self.roundTripTime) / (1.0 + self.recentDisconnectCount);
+}
+
+
+- (BOOL)protocolVersion5Enabled
+{
+    return _currentSession.protocolLevel == MQTTProtocolVersion50;
+}
+
+
+- (void)setProtocolVersion5Enabled:(BOOL)protocolVersion5Enabled
+{
+    _currentSession.protocolLevel = protocolVersion5Enabled ? MQTTProtocolVersion50 : MQTTProtocolVersion311;
+}
+
+
+- (BOOL)topicAliasesEnabled
+{
+    return _currentSession.topicAliasesEnabled;
+}
+
+
+- (void)setTopicAliasesEnabled:(BOOL)topicAliasesEnabled
+{
+    _currentSession.topicAliasesEnabled = topicAliasesEnabled;
+}
+
+
+- (NSUInteger)maxInflightMessages
+{
+    return _currentSession.persistence.maxWindowSize;
+}
+
+
+- (void)setMaxInflightMessages:(NSUInteger)maxInflightMessages
+{
+    _currentSession.persistence.maxWindowSize = maxInflightMessages;
+}
+
+
+- (NSUInteger)inflightWindowSize
+{
+    return _currentSession.effectiveWindowSize;
+}
+
+
+- (NSUInteger)brokerTopicAliasMaximum
+{
+    return _currentSession.serverTopicAliasMaximum.unsignedIntegerValue;
+}
+
+
+- (NSTimeInterval)publishCompletionTimeout
+{
+    return self.publishCompletions.timeout;
+}
+
+
+- (void)setPublishCompletionTimeout:(NSTimeInterval)publishCompletionTimeout
+{
+    self.publishCompletions.timeout = publishCompletionTimeout;
+}
+
+
+- (void)setOfflineSpoolEnabled:(BOOL)offlineSpoolEnabled
+{
+    _offlineSpoolEnabled = offlineSpoolEnabled;
+    
+    __weak typeof(self) weakSelf = self;
+    
+    //
+    //  A disabled spool is kept rather than released: messages already published from it still complete through it
+    //  when acknowledged, and pending ones stay on disk until it is enabled again.  Loading them from disk again
+    //  would publish the in-flight ones twice and lose their completions.
+    //
+    if (!offlineSpoolEnabled)
+    {
+        return;
+    }
+    
+    if (self.publishSpool)
+    {
+        dispatch_async(self.queue, ^{
+            
+            [weakSelf drainPublishSpool];
+        });
+        
+        return;
+    }
+    
+    //
+    //  Messages are spooled per client id, so that clients connected to different brokers do not publish each other's messages
+    //
+    NSString *applicationSupportPath = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) lastObject];
+    NSString *clientDirectory = [self.clientID stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet alphanumericCharacterSet]];
+    NSString *directory = [[applicationSupportPath stringByAppendingPathComponent:@"MASMQTTSpool"] stringByAppendingPathComponent:clientDirectory];
+    
+    MASMQTTPublishSpool *publishSpool = [[MASMQTTPublishSpool alloc] initWithDirectory:directory];
+    publishSpool.maxBytes = self.offlineSpoolMaxBytes;
+    publishSpool.maxAge = self.offlineSpoolMaxAge;
+    
+    publishSpool.outcomeHandler = ^(MASMQTTSpooledMessage *spooledMessage, BOOL delivered, NSError *error) {
+        
+        MQTTSpoolOutcomeHandler spoolOutcomeHandler = weakSelf.spoolOutcomeHandler;
+        
+        if (spoolOutcomeHandler)
+        {
+            MASMQTTMessage *message = [[MASMQTTMessage alloc] initWithTopic:spooledMessage.topic
+                                                                    payload:spooledMessage.payload
+                                                                        qos:spooledMessage.qos
+                                                                     retain:spooledMessage.retained
+                                                                        mid:0];
+            spoolOutcomeHandler(message, delivered, error);
+        }
+    };
+    
+    self.publishSpool = publishSpool;
+    
+    //
+    //  Publish messages spooled before the application was relaunched
+    //
+    dispatch_async(self.queue, ^{
+        
+        [weakSelf drainPublishSpool];
+    });
+}
+
+
+- (void)setOfflineSpoolMaxBytes:(NSUInteger)offlineSpoolMaxBytes
+{
+    _offlineSpoolMaxBytes = offlineSpoolMaxBytes;
+    self.publishSpool.maxBytes = offlineSpoolMaxBytes;
+}
+
+
+- (void)setOfflineSpoolMaxAge:(NSTimeInterval)offlineSpoolMaxAge
+{
+    _offlineSpoolMaxAge = offlineSpoolMaxAge;
+    self.publishSpool.maxAge = offlineSpoolMaxAge;
+}
+
+
 # pragma mark - Setup methods
 
 + (void)setClientPassword:(NSString *)password
@@ -346,10 +597,10 @@ static MASMQTTClient *_sharedClient = nil;
     
     if (!tls)
     {
-        self.port = kMQTTDefaultPort;
+        self.port = self.webSocketEnabled ? kMQTTDefaultWebSocketPort : kMQTTDefaultPort;
     }
     else {
-        self.port = kMQTTDefaultTLSPort;
+        self.port = self.webSocketEnabled ? kMQTTDefaultWebSocketTLSPort : kMQTTDefaultTLSPort;
     }
     
     [self connectWithCompletionHandler:completionHandler];
@@ -367,6 +618,61 @@ static MASMQTTClient *_sharedClient = nil;
 
 
 - (void)connectWithCompletionHandler:(void(^)(MQTTConnectionReturnCode code))completionHandler
+{
+    //
+    //  Configure retry mechanism
+    //
+    if (_reconnectTimer != nil)
+    {
+        [_reconnectTimer stop];
+        _reconnectTimer = nil;
+    }
+    
+    __weak typeof(self) weakSelf = self;
+    NSTimeInterval maxRetryInterval = _reconnectExponentialBackoff ? MAX(_reconnectDelayMax, _reconnectDelay) : _reconnectDelay;
+    _reconnectTimer = [[ReconnectTimer alloc] initWithRetryInterval:_reconnectDelay maxRetryInterval:maxRetryInterval queue:_queue reconnectBlock:^{
+        
+        //
+        //  Reconnect without resetting the retry interval of the timer
+        //
+        if (!weakSelf.connected)
+        {
+            [weakSelf connectSessionWithCompletionHandler:nil];
+        }
+    }];
+    _reconnectTimer.jitter = YES;
+    _reconnectTimer.stableInterval = _reconnectStableInterval;
+    
+    //
+    //  Retry right away when the network to the host becomes reachable again
+    //
+    if (self.host && ![self.reachability.domain isEqualToString:self.host])
+    {
+        [self.reachability stopMonitoring];
+        self.reachability = [[MASNetworkReachability alloc] initWithDomain:self.host];
+        [self.reachability setReachabilityMonitoringBlock:^(MASNetworkReachabilityStatus status) {
+            
+            if (status == MASNetworkReachabilityStatusReachableViaWiFi || status == MASNetworkReachabilityStatusReachableViaWWAN)
+            {
+                __strong typeof(weakSelf) strongSelf = weakSelf;
+                
+                if (strongSelf)
+                {
+                    dispatch_async(strongSelf.queue, ^{
+                        [strongSelf updateKeepAliveNetwork:status];
+                        [strongSelf.reconnectTimer retryNow];
+                    });
+                }
+            }
+        }];
+        [self.reachability startMonitoring];
+    }
+    
+    [self connectSessionWithCompletionHandler:completionHandler];
+}
+
+
+- (void)connectSessionWithCompletionHandler:(void(^)(MQTTConnectionReturnCode code))completionHandler
 {
     //
     //  Logging level based on the debug mode
@@ -374,9 +680,21 @@ static MASMQTTClient *_sharedClient = nil;
     [MQTTLog setLogLevel:self.debugMode ? DDLogLevelAll : DDLogLevelOff];
 
     //
-    //  Construct SSL security transport
+    //  Construct SSL security transport, framing MQTT packets in WebSocket messages if enabled
     //
-    MQTTSSLSecurityPolicyTransport *transport = [[MQTTSSLSecurityPolicyTransport alloc] init];
+    MQTTSSLSecurityPolicyTransport *transport;
+    
+    if (self.webSocketEnabled)
+    {
+        MQTTWebsocketTransport *webSocketTransport = [[MQTTWebsocketTransport alloc] init];
+        webSocketTransport.path = self.webSocketPath;
+        webSocketTransport.compression = self.webSocketCompressionEnabled;
+        transport = webSocketTransport;
+    }
+    else {
+        transport = [[MQTTSSLSecurityPolicyTransport alloc] init];
+    }
+    
     transport.host = self.host;
     transport.port = self.port;
     transport.tls = self.enableTLS;
@@ -414,6 +732,34 @@ static MASMQTTClient *_sharedClient = nil;
     
     _currentSession.transport = transport;
     
+    //
+    //  Keep alive
+    //
+    if (self.adaptiveKeepAliveEnabled)
+    {
+        if (!self.keepAliveTuner)
+        {
+            self.keepAliveTuner = [[MASMQTTKeepAliveTuner alloc] initWithWiFiInterval:self.keepAliveWiFi cellularInterval:self.keepAliveCellular];
+        }
+        
+        self.keepAliveTuner.maximumInterval = self.keepAliveMaximum;
+        self.keepAliveTuner.network = self.reachability.reachabilityStatus == MASNetworkReachabilityStatusReachableViaWWAN ? MASMQTTKeepAliveNetworkCellular : MASMQTTKeepAliveNetworkWiFi;
+        self.keepAliveTuner.probingEnabled = self.applicationActive;
+        
+        //
+        //  The broker is given the longest interval, while the client pings at the learned one;
+        //  a ping not answered in time means the connection is gone, e.g. a NAT mapping expired
+        //
+        _currentSession.keepAliveInterval = MIN(self.keepAliveMaximum, UINT16_MAX);
+        _currentSession.pingInterval = self.keepAliveTuner.interval;
+        _currentSession.pingTimeout = kPingTimeout;
+    }
+    else {
+        _currentSession.keepAliveInterval = self.keepAlive;
+        _currentSession.pingInterval = 0;
+        _currentSession.pingTimeout = 0;
+    }
+    
     //
     // If provided, pass username and password to mosquitto
     //
@@ -455,23 +801,6 @@ static MASMQTTClient *_sharedClient = nil;
             blockSelf.connectionCompletionHandler(blockSelf.connectionStatus);
         }
     }];
-    
-    //
-    //  Configure retry mechanism
-    //
-    if (_reconnectTimer != nil)
-    {
-        [_reconnectTimer stop];
-        _reconnectTimer = nil;
-    }
-    
-    _reconnectTimer = [[ReconnectTimer alloc] initWithRetryInterval:_reconnectDelay maxRetryInterval:_reconnectDelayMax queue:_queue reconnectBlock:^{
-        
-        //
-        //  Reconnect
-        //
-        [blockSelf reconnect];
-    }];
 }
 
 
@@ -498,8 +827,20 @@ static MASMQTTClient *_sharedClient = nil;
 
 - (void)reconnect
 {
-    if (!_connected)
+    if (_connected)
     {
+        return;
+    }
+    
+    //
+    //  A persistent session is resumed by the broker, so only the connection is made again
+    //  without resetting the retry mechanism and reachability monitoring
+    //
+    if (!self.cleanSession && _reconnectTimer)
+    {
+        [self connectSessionWithCompletionHandler:nil];
+    }
+    else {
         [self connectWithCompletionHandler:nil];
     }
 }
@@ -524,7 +865,7 @@ static MASMQTTClient *_sharedClient = nil;
     //
     //  Validate parameters
     //
-    if (payload == nil || [topic isEmpty] || qos < 0)
+    if (payload == nil || [topic isEmpty] || qos < AtMostOnce || qos > ExactlyOnce)
     {
         NSError *error = [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
                                              code:911001
@@ -534,26 +875,102 @@ static MASMQTTClient *_sharedClient = nil;
         {
             completion(NO, error, 0);
         }
+        
+        return;
     }
     
-    if (qos == 0 && completion)
+    //
+    //  QoS 1 and 2 messages published while offline are spooled, as are messages published while earlier ones are
+    //  still spooled, so that they are published in order
+    //
+    MASMQTTPublishSpool *publishSpool = self.offlineSpoolEnabled ? self.publishSpool : nil;
+    
+    if (publishSpool && qos != AtMostOnce && (!self.connected || publishSpool.hasPendingMessages))
     {
-        [self.publishBlocks setObject:completion forKey:[NSNumber numberWithInt:0]];
+        if ([publishSpool spoolData:payload toTopic:topic withQos:qos retain:retain completion:completion] && self.connected)
+        {
+            __weak typeof(self) weakSelf = self;
+            dispatch_async(self.queue, ^{
+                
+                [weakSelf drainPublishSpool];
+            });
+        }
+        
+        return;
+    }
+    
+    //
+    //  QoS 0 messages are done once the session handed them to the transport; the session reports whether it could,
+    //  i.e. MQTTSessionErrorEncoderNotReady while disconnected or when the transport refused the message
+    //
+    if (qos == AtMostOnce)
+    {
+        dispatch_queue_t queue = self.queue;
+        
+        [_currentSession publishData:payload onTopic:topic retain:retain qos:MQTTQosLevelAtMostOnce publishHandler:^(NSError *error) {
+            
+            if (completion)
+            {
+                dispatch_async(queue, ^{
+                    
+                    completion(error == nil, error, 0);
+                });
+            }
+        }];
+        
+        return;
     }
     
+    //
+    //  The acknowledgement of a QoS 1 or 2 message may be processed before publishData: returns its message id
+    //
+    [self.publishCompletions beginPublish];
+    
     UInt16 messageId = [_currentSession publishData:payload onTopic:topic retain:retain qos:[self converToMQTTQoS:qos]];
-    NSNumber *msgId = [NSNumber numberWithInt:messageId];
     
-    if (completion)
+    //
+    //  A QoS 1 or 2 message without a message id was dropped by the session
+    //
+    if (messageId == 0)
     {
-        if (qos == 0)
+        [self.publishCompletions endPublish];
+        
+        if (completion)
         {
-            completion(YES, nil, [msgId intValue]);
-        }
-        else {
-            [self.publishBlocks setObject:completion forKey:msgId];
+            NSError *error = [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
+                                                 code:911007
+                                             userInfo:@{ NSLocalizedDescriptionKey:@"MQTT error. Message could not be published." }];
+            
+            completion(NO, error, messageId);
         }
+        
+        return;
     }
+    
+    //
+    //  The completion is added even if nil, to consume an acknowledgement processed before publishData: returned
+    //
+    [self.publishCompletions addCompletion:completion forMid:messageId];
+}
+
+
+- (void)drainPublishSpool
+{
+    MASMQTTPublishSpool *publishSpool = self.publishSpool;
+    MQTTSession *session = _currentSession;
+    
+    if (!publishSpool || !self.offlineSpoolEnabled || !self.connected)
+    {
+        return;
+    }
+    
+    //
+    //  Spooled messages are handed to the session no faster than the broker accepts in-flight messages
+    //
+    [publishSpool drainWithWindow:session.effectiveWindowSize publisher:^UInt16(MASMQTTSpooledMessage *message) {
+        
+        return [session publishData:message.payload onTopic:message.topic retain:message.retained qos:[self converToMQTTQoS:message.qos]];
+    }];
 }
 
     
@@ -612,11 +1029,60 @@ static MASMQTTClient *_sharedClient = nil;
 }
 
 
+- (void)subscribeToTopic:(NSString *)topic
+                 withQos:(MQTTQualityOfService)qos
+                   queue:(dispatch_queue_t)queue
+          messageHandler:(MQTTMessageHandler)messageHandler
+              completion:(MQTTSubscriptionCompletionBlock)completion
+{
+    //
+    //  The handler is registered before the SUBACK, so that messages delivered right after it are routed
+    //
+    MQTTMessageHandler handler = [messageHandler copy];
+    
+    if (handler && ![self.topicRouter addHandler:handler queue:queue forTopicFilter:topic])
+    {
+        //
+        //  Reject the topic filter locally instead of having the broker close the connection
+        //
+        if (completion)
+        {
+            NSError *error = [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
+                                                 code:911002
+                                             userInfo:@{ NSLocalizedDescriptionKey:@"MQTT error. Invalid topic filter" }];
+            
+            completion(NO, error, nil);
+        }
+        
+        return;
+    }
+    
+    __weak typeof(self) weakSelf = self;
+    [self subscribeToTopic:topic withQos:qos completion:^(BOOL completed, NSError *error, NSArray *grantedQos) {
+        
+        //
+        //  Remove the handler if the subscription failed, or was rejected by the broker
+        //
+        if (handler && (!completed || [weakSelf isSubscriptionRejected:grantedQos]))
+        {
+            [weakSelf.topicRouter removeHandler:handler forTopicFilter:topic];
+        }
+        
+        if (completion)
+        {
+            completion(completed, error, grantedQos);
+        }
+    }];
+}
+
+
 - (void)unsubscribeFromTopic:(NSString *)topic
        withCompletionHandler:(MQTTCompletionErrorBlock)completionHandler
 {
     if (_connected)
     {
+        [self.topicRouter removeHandlersForTopicFilter:topic];
+        
         UInt16 msgId = [_currentSession unsubscribeTopic:topic];
         
         if (completionHandler)
@@ -654,6 +1120,12 @@ static MASMQTTClient *_sharedClient = nil;
     // Source: https://developer.apple.com/library/ios/DOCUMENTATION/General/Conceptual/ConcurrencyProgrammingGuide/OperationQueues/OperationQueues.html#//apple_ref/doc/uid/TP40008091-CH102-SW1
     @autoreleasepool {
         
+        if (!self.postsMessageNotification && !self.messageHandler && !self.messagesHandler && !self.topicRouter.hasHandlers &&
+            !(self.delegate && [self.delegate respondsToSelector:@selector(onMessageReceived:)]))
+        {
+            return;
+        }
+        
         MASMQTTMessage *message = [[MASMQTTMessage alloc] initWithTopic:topic
                                                                 payload:data
                                                                     qos:[self converToMASQoS:qos]
@@ -663,14 +1135,38 @@ static MASMQTTClient *_sharedClient = nil;
         DLog(@"MASMQTT: New message (%@): \n\t\tdata: %@\n\t\ttopic: %@\n\t\tmessage: %@", session, data, topic, message);
         
         //Notification callback
-        NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
-        [notificationCenter postNotificationName:MASConnectaOperationDidReceiveMessageNotification object:message];
+        if (self.postsMessageNotification)
+        {
+            NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
+            [notificationCenter postNotificationName:MASConnectaOperationDidReceiveMessageNotification object:message];
+        }
         
         if (self.messageHandler)
         {
             self.messageHandler(message);
         }
         
+        //
+        //  Handlers subscribed for a topic filter only receive the messages matching it
+        //
+        [self.topicRouter routeMessage:message];
+        
+        //
+        //  Messages received in the same turn of the queue are delivered to the messagesHandler at once
+        //
+        if (self.messagesHandler)
+        {
+            [self.pendingMessages addObject:message];
+            
+            if (self.pendingMessages.count == 1)
+            {
+                __weak typeof(self) weakSelf = self;
+                dispatch_async(self.queue, ^{
+                    [weakSelf deliverPendingMessages];
+                });
+            }
+        }
+        
         //Delegation callback
         if (self.delegate && [self.delegate respondsToSelector:@selector(onMessageReceived:)])
         {
@@ -682,13 +1178,25 @@ static MASMQTTClient *_sharedClient = nil;
 }
 
 
+- (void)deliverPendingMessages
+{
+    NSArray<MASMQTTMessage *> *messages = [self.pendingMessages copy];
+    [self.pendingMessages removeAllObjects];
+    
+    if (self.messagesHandler && messages.count)
+    {
+        self.messagesHandler(messages);
+    }
+}
+
+
 - (void)handleEvent:(MQTTSession *)session event:(MQTTSessionEvent)eventCode error:(NSError *)error
 {
     switch (eventCode)
     {
         case MQTTSessionEventConnected:
             //
-            //  Reset reconnect interval if the connection is established
+            //  Reset reconnect interval once the connection has been stable for reconnectStableInterval
             //
             [self.reconnectTimer resetRetryInterval];
             break;
@@ -697,6 +1205,19 @@ static MASMQTTClient *_sharedClient = nil;
         case MQTTSessionEventProtocolError:
         case MQTTSessionEventConnectionRefused:
         case MQTTSessionEventConnectionError:
+            //
+            //  A connection lost without being closed by either side may have been idle for too long
+            //
+            if (eventCode == MQTTSessionEventConnectionError && self.adaptiveKeepAliveEnabled && [self.keepAliveTuner connectionLost])
+            {
+                DLog(@"MASMQTT: Keep alive interval lowered to %.0f seconds", self.keepAliveTuner.interval);
+            }
+            
+            @synchronized(self.disconnectDates)
+            {
+                [self.disconnectDates addObject:[NSDate date]];
+            }
+            
             //
             //  Trigger reconnection if it was closed by broker, or closed/refused with an error
             //
@@ -721,6 +1242,8 @@ static MASMQTTClient *_sharedClient = nil;
     _connected = YES;
     _connectionStatus = ConnectionAccepted;
     DLog(@"MASMQTT: Connection connected: %@", session);
+    
+    [self drainPublishSpool];
 }
 
 
@@ -729,11 +1252,6 @@ static MASMQTTClient *_sharedClient = nil;
     _connected = NO;
     _connectionStatus = ConnectionRefusedNotAuthorized;
     
-    if ([self.publishHandlers count] > 0)
-    {
-        [self.publishHandlers removeAllObjects];
-    }
-    
     if ([self.subscriptionHandlers count] > 0)
     {
         [self.subscriptionHandlers removeAllObjects];
@@ -744,6 +1262,20 @@ static MASMQTTClient *_sharedClient = nil;
         [self.unsubscriptionHandlers removeAllObjects];
     }
     
+    //
+    //  A clean session forgets unacknowledged messages on reconnect, so spooled ones have to be published again
+    //
+    if (self.cleanSession)
+    {
+        [self.publishSpool requeueInflightMessages];
+        
+        NSError *error = [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
+                                             code:911006
+                                         userInfo:@{ NSLocalizedDescriptionKey:@"MQTT error. Connection closed before the message was acknowledged." }];
+        
+        [self.publishCompletions failAllWithError:error];
+    }
+    
     //Delegation callback
     if (self.delegate && [self.delegate respondsToSelector:@selector(onDisconnect:)]) {
         
@@ -788,27 +1320,14 @@ static MASMQTTClient *_sharedClient = nil;
     NSNumber *msgId = [NSNumber numberWithInt:msgID];
     
     //
-    //  Deprecated subscription handler
+    //  Spooled messages report their outcome through the spool; publish the next ones now that the window moved on
     //
-    if ([self.publishHandlers objectForKey:msgId])
+    if ([self.publishSpool completeMessageWithMid:msgID])
     {
-        void (^handler)(int) = [self.publishHandlers objectForKey:msgId];
-        
-        if (handler)
-        {
-            handler(msgID);
-            [self.publishHandlers removeObjectForKey:msgId];
-        }
+        [self drainPublishSpool];
     }
-    else if ([self.publishBlocks objectForKey:msgId])
-    {
-        void (^MQTTPublishingCompletionBlock)(BOOL completed, NSError *_Nullable error, int mid) = [self.publishBlocks objectForKey:msgId];
-        
-        if (MQTTPublishingCompletionBlock)
-        {
-            MQTTPublishingCompletionBlock(YES, nil, msgID);
-            [self.publishBlocks removeObjectForKey:msgId];
-        }
+    else {
+        [self.publishCompletions completeMid:msgID];
     }
     
     //
@@ -896,17 +1415,97 @@ static MASMQTTClient *_sharedClient = nil;
 - (void)sending:(MQTTSession *)session type:(MQTTCommandType)type qos:(MQTTQosLevel)qos retained:(BOOL)retained duped:(BOOL)duped mid:(UInt16)mid data:(NSData *)data
 {
     DLog(@"Sent %@ %@", self.clientID, [self mqttCommandToString:type]);
+    
+    if (type == MQTTPingreq)
+    {
+        self.pingAfterIdleInterval = !self.trafficSincePing;
+        self.trafficSincePing = NO;
+    }
+    else {
+        self.trafficSincePing = YES;
+    }
 }
 
 
 - (void)received:(MQTTSession *)session type:(MQTTCommandType)type qos:(MQTTQosLevel)qos retained:(BOOL)retained duped:(BOOL)duped mid:(UInt16)mid data:(NSData *)data
 {
     DLog(@"Received %@ %@", self.clientID, [self mqttCommandToString:type]);
+    
+    if (type != MQTTPingresp)
+    {
+        self.trafficSincePing = YES;
+        
+        return;
+    }
+    
+    //
+    //  Only a ping after a whole interval without traffic shows that the interval keeps an idle connection alive;
+    //  any packet in between would have refreshed the NAT mapping on its own
+    //
+    if (self.pingAfterIdleInterval && self.adaptiveKeepAliveEnabled && [self.keepAliveTuner pingSucceeded])
+    {
+        DLog(@"MASMQTT: Probing keep alive interval of %.0f seconds", self.keepAliveTuner.interval);
+        
+        _currentSession.pingInterval = self.keepAliveTuner.interval;
+    }
 }
 
 
+# pragma mark - Keep alive
+
+- (void)updateKeepAliveNetwork:(MASNetworkReachabilityStatus)status
+{
+    if (!self.keepAliveTuner)
+    {
+        return;
+    }
+    
+    self.keepAliveTuner.network = status == MASNetworkReachabilityStatusReachableViaWWAN ? MASMQTTKeepAliveNetworkCellular : MASMQTTKeepAliveNetworkWiFi;
+    
+    if (self.adaptiveKeepAliveEnabled)
+    {
+        _currentSession.pingInterval = self.keepAliveTuner.interval;
+    }
+}
+
+
+#if TARGET_OS_IPHONE == 1
+- (void)applicationStateChanged:(NSNotification *)notification
+{
+    BOOL active = [notification.name isEqualToString:UIApplicationDidBecomeActiveNotification];
+    
+    dispatch_async(self.queue, ^{
+        
+        self.applicationActive = active;
+        self.keepAliveTuner.probingEnabled = active;
+        
+        if (self.adaptiveKeepAliveEnabled && self.keepAliveTuner)
+        {
+            self.currentSession.pingInterval = self.keepAliveTuner.interval;
+        }
+    });
+}
+#endif
+
+
 # pragma mark - Helper methods
 
+- (BOOL)isSubscriptionRejected:(NSArray *)grantedQos
+{
+    //
+    //  The SUBACK reports 0x80 for a failed subscription, or a reason code of 0x80 and above with MQTT 5
+    //
+    for (NSNumber *qos in grantedQos)
+    {
+        if ([qos unsignedIntValue] >= 0x80)
+        {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
 
 - (MQTTQosLevel)converToMQTTQoS:(MQTTQualityOfService)qos
 {
@@ -1091,31 +1690,19 @@ static MASMQTTClient *_sharedClient = nil;
   completionHandler:(void(^)(int mid))completionHandler
 {
     //
-    //  Validate parameters
+    //  The deprecated handler receives 0 instead of the message id if the message was not published
     //
-    if (payload == nil || [topic isEmpty] || qos < 0)
-    {
-        completionHandler(0);
-    }
-    
-    if (qos == 0 && completionHandler)
-    {
-        [self.publishHandlers setObject:completionHandler forKey:[NSNumber numberWithInt:0]];
-    }
-    
-    UInt16 messageId = [_currentSession publishData:payload onTopic:topic retain:retain qos:[self converToMQTTQoS:qos]];
-    NSNumber *msgId = [NSNumber numberWithInt:messageId];
+    MQTTPublishingCompletionBlock completion = nil;
     
     if (completionHandler)
     {
-        if (qos == 0)
-        {
-            completionHandler([msgId intValue]);
-        }
-        else {
-            [self.publishHandlers setObject:[completionHandler copy] forKey:msgId];
-        }
+        completion = ^(BOOL completed, NSError *_Nullable error, int mid) {
+            
+            completionHandler(completed ? mid : 0);
+        };
     }
+    
+    [self publishData:payload toTopic:topic withQos:qos retain:retain completion:completion];
 }
 
 
@@ -117,6 +117,7 @@ static NSString *_Nonnull const MASInfoTypeThumbnail = @"thumbnail"; // string
 # pragma mark - Request/Response/Configuration Constants
 
 static NSString *_Nonnull const MASAcceptRequestResponseKey = @"accept"; // string
+static NSString *_Nonnull const MASAcceptEncodingRequestResponseKey = @"accept-encoding"; // string
 static NSString *_Nonnull const MASAccessTokenRequestResponseKey = @"access_token"; // string
 
 static NSString *_Nonnull const MASApplicationAuthUrlRequestResponseKey = @"auth_url"; // string
@@ -139,6 +140,8 @@ static NSString *_Nonnull const MASClientKeyRequestResponseKey = @"client_id"; /
 static NSString *_Nonnull const MASClientExpirationRequestResponseKey = @"client_expiration"; // array
 static NSString *_Nonnull const MASClientSecretRequestResponseKey = @"client_secret"; // string
 static NSString *_Nonnull const MASCodeRequestResponseKey = @"code"; // string
+static NSString *_Nonnull const MASContentEncodingRequestResponseKey = @"content-encoding"; // string
+static NSString *_Nonnull const MASContentLengthRequestResponseKey = @"content-length"; // string
 static NSString *_Nonnull const MASContentTypeRequestResponseKey = @"content-type"; // string
 static NSString *_Nonnull const MASCreateSessionRequestResponseKey = @"create-session"; // string
 static NSString *_Nonnull const MASDeviceIdRequestResponseKey = @"device-id"; // string
@@ -207,6 +210,24 @@ static NSString *_Nonnull const MASUserRefreshTokenRequestResponseKey = @"refres
 // Default network timeout configuration.
 static int const MASDefaultNetworkTimeoutConfiguration = 60;
 
+// Default minimum size of a request body, in bytes, before the body is compressed.
+static NSUInteger const MASDefaultRequestCompressionThreshold = 1024;
+
+// Content codings supported for request and response bodies.
+static NSString *_Nonnull const MASContentEncodingGzipValue = @"gzip";
+static NSString *_Nonnull const MASAcceptEncodingValue = @"gzip, deflate";
+
+// Maximum time, in seconds, and number of requests held while the gateway is not reachable.
+static NSTimeInterval const MASDefaultGatewayReachabilityWaitInterval = 60;
+static NSUInteger const MASDefaultMaximumPendingRequestCount = 50;
+
+// Gateway endpoint health probing and failover with alternate gateway hosts.
+static NSTimeInterval const MASGatewayEndpointProbeInterval = 60;
+static NSTimeInterval const MASGatewayEndpointProbeTimeout = 5;
+static NSUInteger const MASGatewayEndpointFailureThreshold = 3;
+static double const MASGatewayEndpointLatencySmoothingFactor = 0.3;
+static double const MASGatewayEndpointSwitchLatencyRatio = 0.5;
+
 
 # pragma mark - GrantType Constants
 
@@ -453,3 +474,9 @@ static NSString *_Nonnull const MASSessionTaskDidCompleteNotification = @"com.ca
  *  The NSString constant for network monitor's response object key string in NSDictionary.
  */
 static NSString *_Nonnull const MASSessionTaskDidCompleteSerializedResponseKey = @"com.ca.mas.networking.sessiontask.didcomplete.responsekey";
+
+
+/**
+ *  The NSString constant for network monitor's NSURLSessionTaskMetrics key string in NSDictionary.
+ */
+static NSString *_Nonnull const MASSessionTaskDidCompleteMetricsKey = @"com.ca.mas.networking.sessiontask.didcomplete.metricskey";
@@ -0,0 +1,94 @@
+//
+//  MASMQTTCompletionTable.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MASMQTTClient.h"
+
+
+/**
+ MASMQTTCompletionTable class is responsible to keep the completions of QoS 1 and 2 messages until the broker acknowledged them.
+
+ Completions are keyed by message id and only accessed on a private serial queue, so that messages can be published from
+ any thread while acknowledgements are processed on the MQTT session's queue. An acknowledgement processed while a publish
+ is in progress, before the completion of its message was added, is remembered for a few seconds, and the completion is
+ invoked as soon as it is added. Acknowledgements of other messages are ignored, so that a duplicate acknowledgement can
+ never complete a later message reusing its message id.
+ Every added completion is invoked exactly once: acknowledged, failed, or timed out.
+ */
+@interface MASMQTTCompletionTable : NSObject
+
+
+/**
+ Time in seconds after which a completion not acknowledged is invoked with an error.
+ */
+@property (nonatomic, assign) NSTimeInterval timeout;
+
+
+
+/**
+ Time in seconds an acknowledgement processed before the completion of its message was added is remembered.
+ */
+@property (nonatomic, assign) NSTimeInterval earlyAcknowledgementTimeout;
+
+
+
+/**
+ Initializes the table.
+
+ @param queue The dispatch queue on which completions acknowledged early, or timed out, are invoked.
+ @return MASMQTTCompletionTable object
+ */
+- (instancetype _Nonnull)initWithCallbackQueue:(dispatch_queue_t _Nonnull)queue;
+
+
+
+/**
+ Begins the publish of a message, before it is handed to the MQTT session, so that its acknowledgement is remembered
+ if it is processed before the completion is added. Every call is balanced by addCompletion:forMid: or endPublish.
+ */
+- (void)beginPublish;
+
+
+
+/**
+ Ends the publish of a message the MQTT session did not assign a message id to.
+ */
+- (void)endPublish;
+
+
+
+/**
+ Adds the completion of a message published with the message id, and ends its publish.
+
+ @param completion The block invoked with the outcome of the message; nil still consumes an early acknowledgement.
+ @param mid The message id.
+ */
+- (void)addCompletion:(MQTTPublishingCompletionBlock _Nullable)completion forMid:(UInt16)mid;
+
+
+
+/**
+ Invokes the completion of the message acknowledged with the message id on the calling queue.
+
+ @param mid The message id.
+ */
+- (void)completeMid:(UInt16)mid;
+
+
+
+/**
+ Invokes all completions not yet acknowledged with the error on the calling queue.
+
+ @param error The NSError the completions are invoked with.
+ */
+- (void)failAllWithError:(NSError * _Nonnull)error;
+
+@end
@@ -0,0 +1,345 @@
+//
+//  MASMQTTCompletionTable.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASMQTTCompletionTable.h"
+
+
+# pragma mark - MASMQTTCompletionEntry
+
+@interface MASMQTTCompletionEntry : NSObject
+
+@property (nonatomic, assign) UInt16 mid;
+@property (nonatomic, copy) MQTTPublishingCompletionBlock completion;
+@property (nonatomic, assign) CFAbsoluteTime deadline;
+
+//  NO for an acknowledgement which arrived before the completion of its message was added
+@property (nonatomic, assign) BOOL added;
+
+//  YES once the entry left the table; it is then skipped when it reaches the front of the deadlines
+@property (nonatomic, assign) BOOL done;
+
+@end
+
+
+@implementation MASMQTTCompletionEntry
+
+@end
+
+
+# pragma mark - MASMQTTCompletionTable
+
+@interface MASMQTTCompletionTable ()
+
+@property (nonatomic, strong) dispatch_queue_t tableQueue;
+@property (nonatomic, strong) dispatch_queue_t callbackQueue;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, MASMQTTCompletionEntry *> *entries;
+
+//  Entries in the order they were created; as the timeout is the same for all entries, this is also the order of their deadlines
+@property (nonatomic, strong) NSMutableArray<MASMQTTCompletionEntry *> *deadlines;
+
+//  Early acknowledgements in the order they were processed, with the shorter earlyAcknowledgementTimeout
+@property (nonatomic, strong) NSMutableArray<MASMQTTCompletionEntry *> *earlyAcknowledgements;
+
+//  Number of publishes begun whose completion was not added yet; acknowledgements are only remembered while it is not 0
+@property (nonatomic, assign) NSUInteger publishesInProgress;
+
+//  The time the next sweep is scheduled at, 0 when none is
+@property (nonatomic, assign) CFAbsoluteTime sweepDeadline;
+
+@end
+
+
+@implementation MASMQTTCompletionTable
+
+# pragma mark - Lifecycle
+
+- (instancetype)initWithCallbackQueue:(dispatch_queue_t)queue
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _timeout = 120;
+        _earlyAcknowledgementTimeout = 5;
+        _tableQueue = dispatch_queue_create("com.ca.MASFoundation.mqtt.completionTableQueue", DISPATCH_QUEUE_SERIAL);
+        _callbackQueue = queue;
+        _entries = [NSMutableDictionary dictionary];
+        _deadlines = [NSMutableArray array];
+        _earlyAcknowledgements = [NSMutableArray array];
+        _publishesInProgress = 0;
+        _sweepDeadline = 0;
+    }
+    
+    return self;
+}
+
+
+# pragma mark - Public
+
+- (void)beginPublish
+{
+    dispatch_sync(self.tableQueue, ^{
+        
+        self.publishesInProgress++;
+    });
+}
+
+
+- (void)endPublish
+{
+    dispatch_sync(self.tableQueue, ^{
+        
+        [self endPublishInternal];
+    });
+}
+
+
+- (void)addCompletion:(MQTTPublishingCompletionBlock)completion forMid:(UInt16)mid
+{
+    __block MASMQTTCompletionEntry *acknowledgedEntry = nil;
+    __block MASMQTTCompletionEntry *supersededEntry = nil;
+    
+    dispatch_sync(self.tableQueue, ^{
+        
+        [self endPublishInternal];
+        
+        MASMQTTCompletionEntry *entry = self.entries[@(mid)];
+        
+        if (entry && !entry.added)
+        {
+            [self.entries removeObjectForKey:@(mid)];
+            entry.done = YES;
+            entry.completion = completion;
+            acknowledgedEntry = entry;
+            
+            return;
+        }
+        
+        //
+        //  The message id is only reused once the message was acknowledged, so an entry still in the table is stale
+        //
+        if (entry)
+        {
+            entry.done = YES;
+            supersededEntry = entry;
+        }
+        
+        [self insertEntryForMid:mid completion:completion added:YES];
+    });
+    
+    if (acknowledgedEntry.completion)
+    {
+        MQTTPublishingCompletionBlock acknowledgedCompletion = acknowledgedEntry.completion;
+        
+        dispatch_async(self.callbackQueue, ^{
+            
+            acknowledgedCompletion(YES, nil, mid);
+        });
+    }
+    
+    if (supersededEntry.completion)
+    {
+        MQTTPublishingCompletionBlock supersededCompletion = supersededEntry.completion;
+        NSError *error = [self errorWithCode:911005 description:@"MQTT error. No acknowledgement received for the message."];
+        
+        dispatch_async(self.callbackQueue, ^{
+            
+            supersededCompletion(NO, error, mid);
+        });
+    }
+}
+
+
+- (void)completeMid:(UInt16)mid
+{
+    __block MQTTPublishingCompletionBlock completion = nil;
+    
+    dispatch_sync(self.tableQueue, ^{
+        
+        MASMQTTCompletionEntry *entry = self.entries[@(mid)];
+        
+        if (!entry)
+        {
+            //
+            //  The publishing thread may not have added the completion yet; without a publish in progress,
+            //  the acknowledgement is a duplicate or belongs to a message published before the table existed
+            //
+            if (self.publishesInProgress)
+            {
+                [self insertEntryForMid:mid completion:nil added:NO];
+            }
+            
+            return;
+        }
+        
+        if (entry.added)
+        {
+            [self.entries removeObjectForKey:@(mid)];
+            entry.done = YES;
+            completion = entry.completion;
+        }
+    });
+    
+    if (completion)
+    {
+        completion(YES, nil, mid);
+    }
+}
+
+
+- (void)failAllWithError:(NSError *)error
+{
+    __block NSArray<MASMQTTCompletionEntry *> *entries = nil;
+    
+    dispatch_sync(self.tableQueue, ^{
+        
+        entries = self.entries.allValues;
+        
+        for (MASMQTTCompletionEntry *entry in entries)
+        {
+            entry.done = YES;
+        }
+        
+        [self.entries removeAllObjects];
+        [self.deadlines removeAllObjects];
+        [self.earlyAcknowledgements removeAllObjects];
+    });
+    
+    for (MASMQTTCompletionEntry *entry in entries)
+    {
+        if (entry.added && entry.completion)
+        {
+            entry.completion(NO, error, entry.mid);
+        }
+    }
+}
+
+
+# pragma mark - Private
+
+- (void)endPublishInternal
+{
+    if (self.publishesInProgress)
+    {
+        self.publishesInProgress--;
+    }
+}
+
+
+- (void)insertEntryForMid:(UInt16)mid completion:(MQTTPublishingCompletionBlock)completion added:(BOOL)added
+{
+    MASMQTTCompletionEntry *entry = [[MASMQTTCompletionEntry alloc] init];
+    entry.mid = mid;
+    entry.completion = completion;
+    entry.deadline = CFAbsoluteTimeGetCurrent() + (added ? self.timeout : self.earlyAcknowledgementTimeout);
+    entry.added = added;
+    
+    self.entries[@(mid)] = entry;
+    [added ? self.deadlines : self.earlyAcknowledgements addObject:entry];
+    
+    [self scheduleSweepAt:entry.deadline];
+}
+
+
+- (void)scheduleSweepAt:(CFAbsoluteTime)deadline
+{
+    //
+    //  A sweep scheduled later is kept; it finds nothing expired and reschedules itself
+    //
+    if (self.sweepDeadline && self.sweepDeadline <= deadline)
+    {
+        return;
+    }
+    
+    self.sweepDeadline = deadline;
+    
+    __weak typeof(self) weakSelf = self;
+    int64_t delay = (int64_t)(MAX(deadline - CFAbsoluteTimeGetCurrent(), 0) * NSEC_PER_SEC);
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, delay), self.tableQueue, ^{
+        
+        [weakSelf sweep];
+    });
+}
+
+
+- (void)sweep
+{
+    self.sweepDeadline = 0;
+    
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSMutableArray<MASMQTTCompletionEntry *> *expiredEntries = [NSMutableArray array];
+    
+    [self removeExpiredEntriesFrom:self.earlyAcknowledgements before:now into:nil];
+    [self removeExpiredEntriesFrom:self.deadlines before:now into:expiredEntries];
+    
+    if (self.earlyAcknowledgements.count)
+    {
+        [self scheduleSweepAt:self.earlyAcknowledgements.firstObject.deadline];
+    }
+    
+    if (self.deadlines.count)
+    {
+        [self scheduleSweepAt:self.deadlines.firstObject.deadline];
+    }
+    
+    if (expiredEntries.count)
+    {
+        NSError *error = [self errorWithCode:911005 description:@"MQTT error. No acknowledgement received for the message."];
+        
+        dispatch_async(self.callbackQueue, ^{
+            
+            for (MASMQTTCompletionEntry *entry in expiredEntries)
+            {
+                entry.completion(NO, error, entry.mid);
+            }
+        });
+    }
+}
+
+
+- (void)removeExpiredEntriesFrom:(NSMutableArray<MASMQTTCompletionEntry *> *)entries
+                         before:(CFAbsoluteTime)now
+                           into:(NSMutableArray<MASMQTTCompletionEntry *> *)expiredEntries
+{
+    //
+    //  Entries which left the table are dropped on the way to the first one not yet expired
+    //
+    NSUInteger count = 0;
+    
+    while (count < entries.count && (entries[count].done || entries[count].deadline <= now))
+    {
+        MASMQTTCompletionEntry *entry = entries[count];
+        count++;
+        
+        if (!entry.done)
+        {
+            [self.entries removeObjectForKey:@(entry.mid)];
+            entry.done = YES;
+            
+            if (entry.added && entry.completion)
+            {
+                [expiredEntries addObject:entry];
+            }
+        }
+    }
+    
+    [entries removeObjectsInRange:NSMakeRange(0, count)];
+}
+
+
+- (NSError *)errorWithCode:(NSInteger)code description:(NSString *)description
+{
+    return [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
+                               code:code
+                           userInfo:@{ NSLocalizedDescriptionKey:description }];
+}
+
+@end
@@ -70,6 +70,15 @@
 
 - (void)appWillResignActive
 {
+    //
+    //  A persistent session stays connected while the application is in the background task,
+    //  so that it is resumed without a new handshake if the application becomes active again
+    //
+    if (!self.mqttClient.cleanSession)
+    {
+        return;
+    }
+    
     [self.mqttClient disconnectWithCompletionHandler:^(NSUInteger code) {
         
     }];
@@ -84,8 +93,19 @@
     }
     
     __weak typeof(self) weakSelf = self;
-    self.backgroundTask = [[UIApplication sharedApplication] beginBackgroundTaskWithExpirationHandler:^{
+    self.backgroundTask = [self beginBackgroundTaskWithExpirationHandler:^{
         __strong typeof(weakSelf) strongSelf = weakSelf;
+        
+        //
+        //  The broker keeps the persistent session, and queues its messages, until the application is active again
+        //
+        if (!strongSelf.mqttClient.cleanSession)
+        {
+            [strongSelf.mqttClient disconnectWithCompletionHandler:^(NSUInteger code) {
+                
+            }];
+        }
+        
         [strongSelf endBackgroundTask];
     }];
 }
@@ -93,6 +113,7 @@
 
 - (void)appDidBecomeActive
 {
+    [self endBackgroundTask];
     [self.mqttClient reconnect];
 }
 
@@ -101,11 +122,28 @@
 {
     if (self.backgroundTask)
     {
-        [[UIApplication sharedApplication] endBackgroundTask:self.backgroundTask];
+        [self endBackgroundTaskWithIdentifier:self.backgroundTask];
         self.backgroundTask = UIBackgroundTaskInvalid;
     }
 }
 
+
+# pragma mark - Background task
+
+//
+//  UIApplication is only reached through these two methods, which tests override to expire the background task
+//
+- (UIBackgroundTaskIdentifier)beginBackgroundTaskWithExpirationHandler:(void (^)(void))handler
+{
+    return [[UIApplication sharedApplication] beginBackgroundTaskWithExpirationHandler:handler];
+}
+
+
+- (void)endBackgroundTaskWithIdentifier:(UIBackgroundTaskIdentifier)identifier
+{
+    [[UIApplication sharedApplication] endBackgroundTask:identifier];
+}
+
 @end
 
 #endif
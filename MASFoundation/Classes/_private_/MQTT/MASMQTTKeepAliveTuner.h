@@ -0,0 +1,94 @@
+//
+//  MASMQTTKeepAliveTuner.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ The enumerated MASMQTTKeepAliveNetwork, the kinds of networks a keep alive interval is learned for.
+
+ - MASMQTTKeepAliveNetworkWiFi: Wi-Fi network
+ - MASMQTTKeepAliveNetworkCellular: Cellular network, typically behind carrier NATs with short idle timeouts
+ */
+typedef NS_ENUM(NSUInteger, MASMQTTKeepAliveNetwork)
+{
+    MASMQTTKeepAliveNetworkWiFi,
+    MASMQTTKeepAliveNetworkCellular
+};
+
+
+
+/**
+ MASMQTTKeepAliveTuner class is responsible to find the longest interval between keep alive pings which keeps an MQTT connection alive
+ on the current network, so that the radio is woken up as rarely as possible.
+
+ Each network starts from its initial interval, which is known to be safe. While probing is allowed, the interval is raised after
+ a number of consecutive pings answered at the current interval. A connection lost while probing marks the interval as too long,
+ and the interval falls back to the last safe one. Probing then bisects between the two until they are close enough.
+ */
+@interface MASMQTTKeepAliveTuner : NSObject
+
+
+/**
+ The network the connection currently uses.
+ */
+@property (nonatomic, assign) MASMQTTKeepAliveNetwork network;
+
+
+
+/**
+ BOOL value indicating whether intervals longer than the safe one may be tried, e.g. only while the application is in the foreground.
+ */
+@property (nonatomic, assign) BOOL probingEnabled;
+
+
+
+/**
+ The longest interval in seconds ever used.
+ */
+@property (nonatomic, assign) NSTimeInterval maximumInterval;
+
+
+
+/**
+ The interval in seconds to ping at on the current network.
+ */
+@property (readonly, nonatomic, assign) NSTimeInterval interval;
+
+
+
+/**
+ Initializes the tuner.
+
+ @param wifiInterval The initial interval in seconds on Wi-Fi networks.
+ @param cellularInterval The initial interval in seconds on cellular networks.
+ @return MASMQTTKeepAliveTuner object
+ */
+- (instancetype _Nonnull)initWithWiFiInterval:(NSTimeInterval)wifiInterval cellularInterval:(NSTimeInterval)cellularInterval;
+
+
+
+/**
+ Records a ping answered at the current interval, sent after the connection was idle for the whole interval.
+
+ @return BOOL value indicating whether the interval changed.
+ */
+- (BOOL)pingSucceeded;
+
+
+
+/**
+ Records the connection lost without being closed by either side.
+
+ @return BOOL value indicating whether the interval changed.
+ */
+- (BOOL)connectionLost;
+
+@end
@@ -0,0 +1,189 @@
+//
+//  MASMQTTKeepAliveTuner.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASMQTTKeepAliveTuner.h"
+
+//
+//  Number of consecutive pings an interval has to be answered at to be considered safe
+//
+static const NSUInteger MASMQTTKeepAliveConfirmations = 3;
+
+//
+//  Probing stops once the longest safe and the shortest failed interval are this close
+//
+static const NSTimeInterval MASMQTTKeepAliveResolution = 30;
+
+static const NSTimeInterval MASMQTTKeepAliveMinimumInterval = 30;
+
+
+# pragma mark - MASMQTTKeepAliveState
+
+@interface MASMQTTKeepAliveState : NSObject
+
+//  Longest interval confirmed to keep the connection alive
+@property (nonatomic, assign) NSTimeInterval safeInterval;
+
+//  Shortest interval the connection was lost at; 0 until a probe failed
+@property (nonatomic, assign) NSTimeInterval failedInterval;
+
+@property (nonatomic, assign) NSTimeInterval interval;
+@property (nonatomic, assign) NSUInteger confirmations;
+@property (nonatomic, assign) NSUInteger losses;
+
+@end
+
+
+@implementation MASMQTTKeepAliveState
+
+@end
+
+
+# pragma mark - MASMQTTKeepAliveTuner
+
+@interface MASMQTTKeepAliveTuner ()
+
+@property (nonatomic, strong) NSArray<MASMQTTKeepAliveState *> *states;
+
+@end
+
+
+@implementation MASMQTTKeepAliveTuner
+
+# pragma mark - Lifecycle
+
+- (instancetype)initWithWiFiInterval:(NSTimeInterval)wifiInterval cellularInterval:(NSTimeInterval)cellularInterval
+{
+    self = [super init];
+    
+    if (self)
+    {
+        MASMQTTKeepAliveState *wifiState = [[MASMQTTKeepAliveState alloc] init];
+        wifiState.safeInterval = wifiState.interval = wifiInterval;
+        
+        MASMQTTKeepAliveState *cellularState = [[MASMQTTKeepAliveState alloc] init];
+        cellularState.safeInterval = cellularState.interval = cellularInterval;
+        
+        _states = @[wifiState, cellularState];
+        _network = MASMQTTKeepAliveNetworkWiFi;
+        _probingEnabled = NO;
+        _maximumInterval = MAX(wifiInterval, cellularInterval);
+    }
+    
+    return self;
+}
+
+
+# pragma mark - Properties
+
+- (NSTimeInterval)interval
+{
+    return MIN(self.state.interval, self.maximumInterval);
+}
+
+
+- (void)setProbingEnabled:(BOOL)probingEnabled
+{
+    _probingEnabled = probingEnabled;
+    
+    //
+    //  An interval being probed is abandoned, rather than risking the connection while probing is not allowed
+    //
+    if (!probingEnabled)
+    {
+        for (MASMQTTKeepAliveState *state in self.states)
+        {
+            if (state.interval > state.safeInterval)
+            {
+                state.interval = state.safeInterval;
+                state.confirmations = 0;
+            }
+        }
+    }
+}
+
+
+# pragma mark - Public
+
+- (BOOL)pingSucceeded
+{
+    MASMQTTKeepAliveState *state = self.state;
+    state.losses = 0;
+    state.confirmations++;
+    
+    if (state.confirmations < MASMQTTKeepAliveConfirmations)
+    {
+        return NO;
+    }
+    
+    state.safeInterval = MAX(state.safeInterval, state.interval);
+    
+    if (!self.probingEnabled)
+    {
+        return NO;
+    }
+    
+    //
+    //  Double the interval until a probe fails, then bisect between the safe and the failed interval
+    //
+    NSTimeInterval ceiling = state.failedInterval > 0 ? MIN(state.failedInterval, self.maximumInterval) : self.maximumInterval;
+    NSTimeInterval probeInterval = state.failedInterval > 0 ? (state.safeInterval + ceiling) / 2 : MIN(state.safeInterval * 2, ceiling);
+    
+    if (probeInterval - state.safeInterval < MASMQTTKeepAliveResolution)
+    {
+        return NO;
+    }
+    
+    state.interval = probeInterval;
+    state.confirmations = 0;
+    
+    return YES;
+}
+
+
+- (BOOL)connectionLost
+{
+    MASMQTTKeepAliveState *state = self.state;
+    state.confirmations = 0;
+    
+    if (state.interval > state.safeInterval)
+    {
+        state.failedInterval = state.interval;
+        state.interval = state.safeInterval;
+        
+        return YES;
+    }
+    
+    //
+    //  Losing the connection repeatedly at the safe interval means the network changed, e.g. a different Wi-Fi behind a shorter NAT timeout
+    //
+    state.losses++;
+    
+    if (state.losses >= 2 && state.safeInterval > MASMQTTKeepAliveMinimumInterval)
+    {
+        state.failedInterval = state.safeInterval;
+        state.safeInterval = MAX(state.safeInterval / 2, MASMQTTKeepAliveMinimumInterval);
+        state.interval = state.safeInterval;
+        state.losses = 0;
+        
+        return YES;
+    }
+    
+    return NO;
+}
+
+
+# pragma mark - Private
+
+- (MASMQTTKeepAliveState *)state
+{
+    return self.states[self.network];
+}
+
+@end
@@ -0,0 +1,127 @@
+//
+//  MASMQTTPublishSpool.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MASMQTTClient.h"
+
+
+/**
+ MASMQTTSpooledMessage represents a message held by the MASMQTTPublishSpool until the broker acknowledged it.
+ */
+@interface MASMQTTSpooledMessage : NSObject
+
+@property (nonatomic, copy, readonly, nonnull) NSString *topic;
+@property (nonatomic, copy, readonly, nonnull) NSData *payload;
+@property (nonatomic, assign, readonly) MQTTQualityOfService qos;
+@property (nonatomic, assign, readonly) BOOL retained;
+@property (nonatomic, strong, readonly, nonnull) NSDate *date;
+
+//  Completion of the publish call which spooled the message; nil for messages spooled before the application was relaunched
+@property (nonatomic, copy, readonly, nullable) MQTTPublishingCompletionBlock completion;
+
+@end
+
+
+
+/**
+ MASMQTTPublishSpool class is responsible to durably keep QoS 1 and 2 messages published while the MQTT client is offline.
+ Each message is written to its own file, so that spooling and removing a message does not rewrite the others,
+ and messages survive a relaunch of the application until they are delivered, dropped or expired.
+
+ Messages are handed to the publisher in the order they were spooled, never more than the given window at a time,
+ so that draining the spool after a reconnect does not exceed the number of in-flight messages accepted by the broker.
+ */
+@interface MASMQTTPublishSpool : NSObject
+
+
+/**
+ Maximum number of payload and topic bytes held by the spool. The oldest messages are dropped to make room for new ones.
+ */
+@property (nonatomic, assign) NSUInteger maxBytes;
+
+
+
+/**
+ Maximum time in seconds a message is held by the spool before it expires without being published.
+ */
+@property (nonatomic, assign) NSTimeInterval maxAge;
+
+
+
+/**
+ Block invoked once with the outcome of every spooled message: delivered, or dropped with an error.
+ */
+@property (nonatomic, copy, nullable) void (^outcomeHandler)(MASMQTTSpooledMessage * _Nonnull message, BOOL delivered, NSError * _Nullable error);
+
+
+
+/**
+ BOOL value indicating whether messages are waiting to be handed to the publisher.
+ */
+@property (readonly, assign) BOOL hasPendingMessages;
+
+
+
+/**
+ Initializes the spool with the messages previously spooled in the directory.
+
+ @param directory The directory the messages are stored in; created if it does not exist.
+ @return MASMQTTPublishSpool object
+ */
+- (instancetype _Nonnull)initWithDirectory:(NSString * _Nonnull)directory;
+
+
+
+/**
+ Spools a message to be published once the client is connected.
+
+ @param payload The message payload.
+ @param topic The topic to publish to.
+ @param qos The MQTTQualityOfService of the message; AtLeastOnce or ExactlyOnce.
+ @param retain BOOL value indicating whether the message is retained by the broker.
+ @param completion The block invoked with the outcome of the message.
+ @return BOOL value indicating whether the message was spooled; if not, the completion has been invoked with the error.
+ */
+- (BOOL)spoolData:(NSData * _Nonnull)payload
+          toTopic:(NSString * _Nonnull)topic
+          withQos:(MQTTQualityOfService)qos
+           retain:(BOOL)retain
+       completion:(MQTTPublishingCompletionBlock _Nullable)completion;
+
+
+
+/**
+ Hands pending messages to the publisher, in the order they were spooled, until the window of in-flight messages is full.
+ Expired messages are dropped first.
+
+ @param window The maximum number of spooled messages published and not yet acknowledged.
+ @param publisher The block publishing a message; returns the message id, or 0 if the message could not be published.
+ */
+- (void)drainWithWindow:(NSUInteger)window publisher:(UInt16 (^ _Nonnull)(MASMQTTSpooledMessage * _Nonnull message))publisher;
+
+
+
+/**
+ Removes the message published with the message id from the spool once the broker acknowledged it.
+
+ @param mid The message id.
+ @return BOOL value indicating whether the message id belonged to a spooled message.
+ */
+- (BOOL)completeMessageWithMid:(UInt16)mid;
+
+
+
+/**
+ Returns the published messages which were not acknowledged to the pending messages, to be published again.
+ */
+- (void)requeueInflightMessages;
+
+@end
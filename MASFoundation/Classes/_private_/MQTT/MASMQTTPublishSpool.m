@@ -0,0 +1,367 @@
+//
+//  MASMQTTPublishSpool.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASMQTTPublishSpool.h"
+
+static NSString * const MASMQTTSpoolFileExtension = @"plist";
+static NSString * const MASMQTTSpoolTopicKey = @"topic";
+static NSString * const MASMQTTSpoolPayloadKey = @"payload";
+static NSString * const MASMQTTSpoolQosKey = @"qos";
+static NSString * const MASMQTTSpoolRetainKey = @"retain";
+static NSString * const MASMQTTSpoolDateKey = @"date";
+
+
+# pragma mark - MASMQTTSpooledMessage
+
+@interface MASMQTTSpooledMessage ()
+
+@property (nonatomic, copy, readwrite) NSString *topic;
+@property (nonatomic, copy, readwrite) NSData *payload;
+@property (nonatomic, assign, readwrite) MQTTQualityOfService qos;
+@property (nonatomic, assign, readwrite) BOOL retained;
+@property (nonatomic, strong, readwrite) NSDate *date;
+@property (nonatomic, copy, readwrite) MQTTPublishingCompletionBlock completion;
+
+//  Sequence number giving the order the message was spooled in, and the name of its file
+@property (nonatomic, assign) unsigned long long sequence;
+@property (nonatomic, assign) UInt16 mid;
+
+//  Number of payload and topic bytes accounted against the size of the spool
+@property (nonatomic, assign, readonly) NSUInteger length;
+
+@end
+
+
+@implementation MASMQTTSpooledMessage
+
+- (NSUInteger)length
+{
+    return self.payload.length + [self.topic lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+}
+
+@end
+
+
+# pragma mark - MASMQTTPublishSpool
+
+@interface MASMQTTPublishSpool ()
+
+@property (nonatomic, copy) NSString *directory;
+@property (nonatomic, strong) NSMutableArray<MASMQTTSpooledMessage *> *pendingMessages;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, MASMQTTSpooledMessage *> *inflightMessages;
+@property (nonatomic, assign) NSUInteger byteCount;
+@property (nonatomic, assign) unsigned long long nextSequence;
+
+@end
+
+
+@implementation MASMQTTPublishSpool
+
+# pragma mark - Lifecycle
+
+- (instancetype)initWithDirectory:(NSString *)directory
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _directory = [directory copy];
+        _maxBytes = 1024 * 1024;
+        _maxAge = 24 * 60 * 60;
+        _pendingMessages = [NSMutableArray array];
+        _inflightMessages = [NSMutableDictionary dictionary];
+        _byteCount = 0;
+        _nextSequence = 1;
+        
+        [[NSFileManager defaultManager] createDirectoryAtPath:_directory withIntermediateDirectories:YES attributes:nil error:nil];
+        [self loadMessages];
+    }
+    
+    return self;
+}
+
+
+# pragma mark - Properties
+
+- (BOOL)hasPendingMessages
+{
+    @synchronized(self)
+    {
+        return self.pendingMessages.count > 0;
+    }
+}
+
+
+# pragma mark - Public
+
+- (BOOL)spoolData:(NSData *)payload
+          toTopic:(NSString *)topic
+          withQos:(MQTTQualityOfService)qos
+           retain:(BOOL)retain
+       completion:(MQTTPublishingCompletionBlock)completion
+{
+    MASMQTTSpooledMessage *message = [[MASMQTTSpooledMessage alloc] init];
+    message.topic = topic;
+    message.payload = payload;
+    message.qos = qos;
+    message.retained = retain;
+    message.date = [NSDate date];
+    message.completion = completion;
+    
+    NSArray *expiredMessages;
+    NSMutableArray *droppedMessages = [NSMutableArray array];
+    BOOL spooled = NO;
+    
+    @synchronized(self)
+    {
+        expiredMessages = [self removeExpiredMessages];
+        
+        //
+        //  Make room by dropping the oldest messages not yet published; published ones are kept until acknowledged
+        //
+        if (message.length <= self.maxBytes)
+        {
+            while (self.byteCount + message.length > self.maxBytes && self.pendingMessages.count)
+            {
+                MASMQTTSpooledMessage *oldestMessage = self.pendingMessages.firstObject;
+                [self.pendingMessages removeObjectAtIndex:0];
+                [self removeMessage:oldestMessage];
+                [droppedMessages addObject:oldestMessage];
+            }
+            
+            if (self.byteCount + message.length <= self.maxBytes)
+            {
+                message.sequence = self.nextSequence++;
+                spooled = [self writeMessage:message];
+            }
+        }
+        
+        if (spooled)
+        {
+            [self.pendingMessages addObject:message];
+            self.byteCount += message.length;
+        }
+    }
+    
+    [self reportMessages:expiredMessages delivered:NO error:[self errorWithCode:911004 description:@"MQTT error. Message expired in the offline spool."]];
+    [self reportMessages:droppedMessages delivered:NO error:[self errorWithCode:911003 description:@"MQTT error. Message dropped from the full offline spool."]];
+    
+    if (!spooled)
+    {
+        [self reportMessages:@[message] delivered:NO error:[self errorWithCode:911003 description:@"MQTT error. Message could not be spooled."]];
+    }
+    
+    return spooled;
+}
+
+
+- (void)drainWithWindow:(NSUInteger)window publisher:(UInt16 (^)(MASMQTTSpooledMessage *message))publisher
+{
+    NSArray *expiredMessages;
+    
+    @synchronized(self)
+    {
+        expiredMessages = [self removeExpiredMessages];
+        
+        while (self.pendingMessages.count && self.inflightMessages.count < MAX(window, 1))
+        {
+            MASMQTTSpooledMessage *message = self.pendingMessages.firstObject;
+            UInt16 mid = publisher(message);
+            
+            //
+            //  Stop draining if the session did not accept the message; it is retried with the next drain
+            //
+            if (mid == 0)
+            {
+                break;
+            }
+            
+            [self.pendingMessages removeObjectAtIndex:0];
+            message.mid = mid;
+            self.inflightMessages[@(mid)] = message;
+        }
+    }
+    
+    [self reportMessages:expiredMessages delivered:NO error:[self errorWithCode:911004 description:@"MQTT error. Message expired in the offline spool."]];
+}
+
+
+- (BOOL)completeMessageWithMid:(UInt16)mid
+{
+    MASMQTTSpooledMessage *message;
+    
+    @synchronized(self)
+    {
+        message = self.inflightMessages[@(mid)];
+        
+        if (!message)
+        {
+            return NO;
+        }
+        
+        [self.inflightMessages removeObjectForKey:@(mid)];
+        [self removeMessage:message];
+    }
+    
+    [self reportMessages:@[message] delivered:YES error:nil];
+    
+    return YES;
+}
+
+
+- (void)requeueInflightMessages
+{
+    @synchronized(self)
+    {
+        if (!self.inflightMessages.count)
+        {
+            return;
+        }
+        
+        NSMutableArray *messages = [NSMutableArray arrayWithArray:self.inflightMessages.allValues];
+        [messages addObjectsFromArray:self.pendingMessages];
+        [messages sortUsingComparator:^NSComparisonResult(MASMQTTSpooledMessage *message1, MASMQTTSpooledMessage *message2) {
+            
+            return message1.sequence < message2.sequence ? NSOrderedAscending : (message1.sequence > message2.sequence ? NSOrderedDescending : NSOrderedSame);
+        }];
+        
+        [self.inflightMessages removeAllObjects];
+        self.pendingMessages = messages;
+    }
+}
+
+
+# pragma mark - Private
+
+- (void)loadMessages
+{
+    NSArray *fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory error:nil];
+    
+    //
+    //  File names are zero padded sequence numbers, so sorting them restores the order messages were spooled in
+    //
+    for (NSString *fileName in [fileNames sortedArrayUsingSelector:@selector(compare:)])
+    {
+        if (![fileName.pathExtension isEqualToString:MASMQTTSpoolFileExtension])
+        {
+            continue;
+        }
+        
+        NSString *path = [self.directory stringByAppendingPathComponent:fileName];
+        NSData *data = [NSData dataWithContentsOfFile:path];
+        NSDictionary *entry = data ? [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil] : nil;
+        
+        MASMQTTSpooledMessage *message = [[MASMQTTSpooledMessage alloc] init];
+        message.sequence = strtoull(fileName.stringByDeletingPathExtension.UTF8String, NULL, 10);
+        
+        if (![entry isKindOfClass:[NSDictionary class]] || message.sequence == 0 ||
+            ![entry[MASMQTTSpoolTopicKey] isKindOfClass:[NSString class]] ||
+            ![entry[MASMQTTSpoolPayloadKey] isKindOfClass:[NSData class]] ||
+            ![entry[MASMQTTSpoolDateKey] isKindOfClass:[NSDate class]])
+        {
+            //
+            //  A file left incomplete by a crash cannot be published
+            //
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+            continue;
+        }
+        
+        message.topic = entry[MASMQTTSpoolTopicKey];
+        message.payload = entry[MASMQTTSpoolPayloadKey];
+        message.qos = [entry[MASMQTTSpoolQosKey] integerValue];
+        message.retained = [entry[MASMQTTSpoolRetainKey] boolValue];
+        message.date = entry[MASMQTTSpoolDateKey];
+        
+        [self.pendingMessages addObject:message];
+        self.byteCount += message.length;
+        self.nextSequence = MAX(self.nextSequence, message.sequence + 1);
+    }
+}
+
+
+- (NSString *)pathForMessage:(MASMQTTSpooledMessage *)message
+{
+    NSString *fileName = [NSString stringWithFormat:@"%020llu.%@", message.sequence, MASMQTTSpoolFileExtension];
+    
+    return [self.directory stringByAppendingPathComponent:fileName];
+}
+
+
+- (BOOL)writeMessage:(MASMQTTSpooledMessage *)message
+{
+    NSDictionary *entry = @{ MASMQTTSpoolTopicKey : message.topic,
+                             MASMQTTSpoolPayloadKey : message.payload,
+                             MASMQTTSpoolQosKey : @(message.qos),
+                             MASMQTTSpoolRetainKey : @(message.retained),
+                             MASMQTTSpoolDateKey : message.date };
+    
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:entry format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+    
+    //
+    //  Messages are published from the background, so they must stay readable while the device is locked
+    //
+    return [data writeToFile:[self pathForMessage:message]
+                     options:NSDataWritingAtomic | NSDataWritingFileProtectionCompleteUntilFirstUserAuthentication
+                       error:nil];
+}
+
+
+- (void)removeMessage:(MASMQTTSpooledMessage *)message
+{
+    [[NSFileManager defaultManager] removeItemAtPath:[self pathForMessage:message] error:nil];
+    self.byteCount -= MIN(self.byteCount, message.length);
+}
+
+
+- (NSArray<MASMQTTSpooledMessage *> *)removeExpiredMessages
+{
+    NSDate *expiryDate = [NSDate dateWithTimeIntervalSinceNow:-self.maxAge];
+    NSMutableArray *expiredMessages = [NSMutableArray array];
+    
+    //
+    //  Pending messages are ordered by date, so the expired ones are at the front
+    //
+    while (self.pendingMessages.count && [self.pendingMessages.firstObject.date compare:expiryDate] == NSOrderedAscending)
+    {
+        MASMQTTSpooledMessage *message = self.pendingMessages.firstObject;
+        [self.pendingMessages removeObjectAtIndex:0];
+        [self removeMessage:message];
+        [expiredMessages addObject:message];
+    }
+    
+    return expiredMessages;
+}
+
+
+- (void)reportMessages:(NSArray<MASMQTTSpooledMessage *> *)messages delivered:(BOOL)delivered error:(NSError *)error
+{
+    for (MASMQTTSpooledMessage *message in messages)
+    {
+        if (message.completion)
+        {
+            message.completion(delivered, error, message.mid);
+        }
+        
+        if (self.outcomeHandler)
+        {
+            self.outcomeHandler(message, delivered, error);
+        }
+    }
+}
+
+
+- (NSError *)errorWithCode:(NSInteger)code description:(NSString *)description
+{
+    return [NSError errorWithDomain:@"com.ca.MASFoundation.localError:ErrorDomain"
+                               code:code
+                           userInfo:@{ NSLocalizedDescriptionKey:description }];
+}
+
+@end
@@ -0,0 +1,80 @@
+//
+//  MASMQTTTopicRouter.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MASMQTTMessage;
+
+
+/**
+ MASMQTTTopicRouter class is responsible to route incoming MQTT messages to the handlers registered for matching topic filters.
+ Topic filters are kept in a trie of topic levels supporting the single-level (+) and multi-level (#) wildcards,
+ so that a message is routed in time proportional to the number of levels of its topic rather than the number of filters.
+ */
+@interface MASMQTTTopicRouter : NSObject
+
+
+/**
+ Registers a handler for messages whose topic matches the topic filter.
+
+ @param handler The block to be invoked with each matching MASMQTTMessage.
+ @param queue The dispatch queue on which the handler is invoked; the main queue if nil.
+ @param topicFilter The topic filter, which may contain the + and # wildcards.
+ @return BOOL value indicating whether the topic filter is valid and the handler was registered.
+ */
+- (BOOL)addHandler:(void (^ _Nonnull)(MASMQTTMessage * _Nonnull message))handler
+             queue:(dispatch_queue_t _Nullable)queue
+    forTopicFilter:(NSString * _Nonnull)topicFilter;
+
+
+
+/**
+ Removes all handlers registered for the topic filter.
+
+ @param topicFilter The topic filter the handlers were registered with.
+ */
+- (void)removeHandlersForTopicFilter:(NSString * _Nonnull)topicFilter;
+
+
+
+/**
+ Removes a handler registered for the topic filter, leaving other handlers registered for it.
+
+ @param handler The block registered with addHandler:queue:forTopicFilter:.
+ @param topicFilter The topic filter the handler was registered with.
+ */
+- (void)removeHandler:(void (^ _Nonnull)(MASMQTTMessage * _Nonnull message))handler
+       forTopicFilter:(NSString * _Nonnull)topicFilter;
+
+
+
+/**
+ Removes all handlers.
+ */
+- (void)removeAllHandlers;
+
+
+
+/**
+ BOOL value indicating whether any handler is registered.
+ */
+@property (readonly, assign) BOOL hasHandlers;
+
+
+
+/**
+ Dispatches the message to all handlers registered for topic filters matching its topic.
+
+ @param message The MASMQTTMessage to be routed.
+ @return NSUInteger number of handlers the message was dispatched to.
+ */
+- (NSUInteger)routeMessage:(MASMQTTMessage * _Nonnull)message;
+
+@end
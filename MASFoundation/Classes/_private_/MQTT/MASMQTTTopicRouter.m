@@ -0,0 +1,292 @@
+//
+//  MASMQTTTopicRouter.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASMQTTTopicRouter.h"
+
+#import "MASMQTTMessage.h"
+
+static NSString * const MASMQTTTopicLevelSeparator = @"/";
+static NSString * const MASMQTTTopicSingleLevelWildcard = @"+";
+static NSString * const MASMQTTTopicMultiLevelWildcard = @"#";
+
+
+# pragma mark - MASMQTTTopicSubscription
+
+@interface MASMQTTTopicSubscription : NSObject
+
+@property (nonatomic, copy) void (^handler)(MASMQTTMessage *message);
+@property (nonatomic, strong) dispatch_queue_t queue;
+
+@end
+
+
+@implementation MASMQTTTopicSubscription
+
+@end
+
+
+# pragma mark - MASMQTTTopicNode
+
+@interface MASMQTTTopicNode : NSObject
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, MASMQTTTopicNode *> *children;
+@property (nonatomic, strong) NSMutableArray<MASMQTTTopicSubscription *> *subscriptions;
+
+@end
+
+
+@implementation MASMQTTTopicNode
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _children = [NSMutableDictionary dictionary];
+        _subscriptions = [NSMutableArray array];
+    }
+    
+    return self;
+}
+
+
+- (BOOL)isEmpty
+{
+    return self.children.count == 0 && self.subscriptions.count == 0;
+}
+
+@end
+
+
+# pragma mark - MASMQTTTopicRouter
+
+@interface MASMQTTTopicRouter ()
+
+@property (nonatomic, strong) MASMQTTTopicNode *root;
+@property (readwrite, assign) BOOL hasHandlers;
+
+@end
+
+
+@implementation MASMQTTTopicRouter
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _root = [[MASMQTTTopicNode alloc] init];
+        _hasHandlers = NO;
+    }
+    
+    return self;
+}
+
+
+# pragma mark - Public
+
+- (BOOL)addHandler:(void (^)(MASMQTTMessage *message))handler queue:(dispatch_queue_t)queue forTopicFilter:(NSString *)topicFilter
+{
+    NSArray<NSString *> *levels = [topicFilter componentsSeparatedByString:MASMQTTTopicLevelSeparator];
+    
+    if (!handler || ![self isValidTopicFilter:levels])
+    {
+        return NO;
+    }
+    
+    MASMQTTTopicSubscription *subscription = [[MASMQTTTopicSubscription alloc] init];
+    subscription.handler = handler;
+    subscription.queue = queue ? queue : dispatch_get_main_queue();
+    
+    @synchronized(self)
+    {
+        MASMQTTTopicNode *node = self.root;
+        
+        for (NSString *level in levels)
+        {
+            MASMQTTTopicNode *child = node.children[level];
+            
+            if (!child)
+            {
+                child = [[MASMQTTTopicNode alloc] init];
+                node.children[level] = child;
+            }
+            
+            node = child;
+        }
+        
+        [node.subscriptions addObject:subscription];
+        self.hasHandlers = YES;
+    }
+    
+    return YES;
+}
+
+
+- (void)removeHandlersForTopicFilter:(NSString *)topicFilter
+{
+    [self removeHandler:nil forTopicFilter:topicFilter];
+}
+
+
+- (void)removeHandler:(void (^)(MASMQTTMessage *message))handler forTopicFilter:(NSString *)topicFilter
+{
+    NSArray<NSString *> *levels = [topicFilter componentsSeparatedByString:MASMQTTTopicLevelSeparator];
+    
+    @synchronized(self)
+    {
+        //
+        //  Walk down to the filter's node, then prune the nodes left without subscriptions or children
+        //
+        NSMutableArray<MASMQTTTopicNode *> *path = [NSMutableArray arrayWithObject:self.root];
+        MASMQTTTopicNode *node = self.root;
+        
+        for (NSString *level in levels)
+        {
+            node = node.children[level];
+            
+            if (!node)
+            {
+                return;
+            }
+            
+            [path addObject:node];
+        }
+        
+        //
+        //  Without a handler, all subscriptions of the filter are removed
+        //
+        if (handler)
+        {
+            NSIndexSet *indexes = [node.subscriptions indexesOfObjectsPassingTest:^BOOL(MASMQTTTopicSubscription *subscription, NSUInteger index, BOOL *stop) {
+                return subscription.handler == handler;
+            }];
+            [node.subscriptions removeObjectsAtIndexes:indexes];
+        }
+        else {
+            [node.subscriptions removeAllObjects];
+        }
+        
+        for (NSInteger index = levels.count; index > 0 && [path[index] isEmpty]; index--)
+        {
+            [path[index - 1].children removeObjectForKey:levels[index - 1]];
+        }
+        
+        self.hasHandlers = ![self.root isEmpty];
+    }
+}
+
+
+- (void)removeAllHandlers
+{
+    @synchronized(self)
+    {
+        self.root = [[MASMQTTTopicNode alloc] init];
+        self.hasHandlers = NO;
+    }
+}
+
+
+- (NSUInteger)routeMessage:(MASMQTTMessage *)message
+{
+    if (!self.hasHandlers || !message.topic)
+    {
+        return 0;
+    }
+    
+    NSArray<NSString *> *levels = [message.topic componentsSeparatedByString:MASMQTTTopicLevelSeparator];
+    NSMutableArray<MASMQTTTopicSubscription *> *subscriptions = [NSMutableArray array];
+    
+    @synchronized(self)
+    {
+        [self collectSubscriptions:subscriptions fromNode:self.root levels:levels index:0];
+    }
+    
+    for (MASMQTTTopicSubscription *subscription in subscriptions)
+    {
+        void (^handler)(MASMQTTMessage *message) = subscription.handler;
+        
+        dispatch_async(subscription.queue, ^{
+            handler(message);
+        });
+    }
+    
+    return subscriptions.count;
+}
+
+
+# pragma mark - Private
+
+- (void)collectSubscriptions:(NSMutableArray<MASMQTTTopicSubscription *> *)subscriptions fromNode:(MASMQTTTopicNode *)node levels:(NSArray<NSString *> *)levels index:(NSUInteger)index
+{
+    //
+    //  # matches the parent level and any number of levels below it
+    //
+    MASMQTTTopicNode *multiLevelNode = node.children[MASMQTTTopicMultiLevelWildcard];
+    
+    //
+    //  Topics starting with $ are not matched by wildcards at the first level
+    //
+    BOOL matchesWildcards = index > 0 || ![levels[0] hasPrefix:@"$"];
+    
+    if (multiLevelNode && matchesWildcards)
+    {
+        [subscriptions addObjectsFromArray:multiLevelNode.subscriptions];
+    }
+    
+    if (index == levels.count)
+    {
+        [subscriptions addObjectsFromArray:node.subscriptions];
+        return;
+    }
+    
+    MASMQTTTopicNode *child = node.children[levels[index]];
+    
+    if (child)
+    {
+        [self collectSubscriptions:subscriptions fromNode:child levels:levels index:index + 1];
+    }
+    
+    MASMQTTTopicNode *singleLevelNode = node.children[MASMQTTTopicSingleLevelWildcard];
+    
+    if (singleLevelNode && matchesWildcards)
+    {
+        [self collectSubscriptions:subscriptions fromNode:singleLevelNode levels:levels index:index + 1];
+    }
+}
+
+
+- (BOOL)isValidTopicFilter:(NSArray<NSString *> *)levels
+{
+    for (NSUInteger index = 0; index < levels.count; index++)
+    {
+        NSString *level = levels[index];
+        
+        //
+        //  Wildcards must occupy an entire level, and # must be the last level
+        //
+        if (![level isEqualToString:MASMQTTTopicSingleLevelWildcard] && [level rangeOfString:MASMQTTTopicSingleLevelWildcard].location != NSNotFound)
+        {
+            return NO;
+        }
+        
+        if ([level rangeOfString:MASMQTTTopicMultiLevelWildcard].location != NSNotFound &&
+            (![level isEqualToString:MASMQTTTopicMultiLevelWildcard] || index != levels.count - 1))
+        {
+            return NO;
+        }
+    }
+    
+    return levels.count > 0;
+}
+
+@end
@@ -74,6 +74,39 @@
 
 
 
+# pragma mark - Compression Methods
+
+/**
+ *  Compresses the data into gzip format.  The data is deflated in fixed size chunks so that
+ *  large bodies (multipart/file uploads) do not require a second full size working buffer.
+ *
+ *  @returns Returns the gzip compressed NSData, or nil if compression failed.
+ */
+- (NSData *)gzipCompressedData;
+
+
+
+
+/**
+ *  Decompresses gzip compressed data, giving up as soon as the output grows beyond maximumLength.
+ *  The output buffer never grows beyond maximumLength, so a small input inflating to a huge output is rejected cheaply.
+ *
+ *  @param maximumLength NSUInteger maximum length in bytes of the decompressed data.
+ *  @returns Returns the decompressed NSData, or nil if the data is not valid gzip compressed data or decompresses to more than maximumLength bytes.
+ */
+- (NSData *)gzipDecompressedDataWithMaximumLength:(NSUInteger)maximumLength;
+
+
+
+/**
+ *  Determines whether the data starts with the gzip magic header.
+ *
+ *  @returns Returns YES if the data is gzip compressed.
+ */
+- (BOOL)isGzipCompressed;
+
+
+
 # pragma mark - Encryption Methods
 
 /**
@@ -14,6 +14,7 @@
 
 #import <CommonCrypto/CommonHMAC.h>
 #import <objc/runtime.h>
+#import <zlib.h>
 
 static const char encodingTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
@@ -308,6 +309,153 @@ bool _encrypted = NO;
     return nil;
 }
 
+# pragma mark - Compression Methods
+
+//
+// Size of the output chunk used while deflating
+//
+static NSUInteger const MASDataCompressionChunkSize = 16384;
+
+
+- (NSData *)gzipCompressedData
+{
+    if ([self length] == 0)
+    {
+        return nil;
+    }
+    
+    z_stream stream;
+    bzero(&stream, sizeof(stream));
+    
+    //
+    // windowBits 15 + 16 produces a gzip header and trailer instead of a zlib wrapper
+    //
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return nil;
+    }
+    
+    NSMutableData *compressed = [NSMutableData dataWithLength:MASDataCompressionChunkSize];
+    NSUInteger remaining = [self length];
+    const Bytef *input = (const Bytef *)[self bytes];
+    int status = Z_OK;
+    
+    //
+    // Feed the input in chunks that fit into uInt, and grow the output one chunk at a time
+    //
+    do {
+        if (stream.avail_in == 0 && remaining > 0)
+        {
+            uInt chunk = (uInt)MIN(remaining, (NSUInteger)UINT_MAX);
+            stream.next_in = (Bytef *)input;
+            stream.avail_in = chunk;
+            input += chunk;
+            remaining -= chunk;
+        }
+        
+        if (stream.total_out >= [compressed length])
+        {
+            [compressed increaseLengthBy:MASDataCompressionChunkSize];
+        }
+        
+        stream.next_out = (Bytef *)[compressed mutableBytes] + stream.total_out;
+        stream.avail_out = (uInt)([compressed length] - stream.total_out);
+        
+        status = deflate(&stream, remaining == 0 ? Z_FINISH : Z_NO_FLUSH);
+    } while (status == Z_OK || status == Z_BUF_ERROR);
+    
+    deflateEnd(&stream);
+    
+    if (status != Z_STREAM_END)
+    {
+        return nil;
+    }
+    
+    [compressed setLength:stream.total_out];
+    
+    return [NSData dataWithData:compressed];
+}
+
+
+- (BOOL)isGzipCompressed
+{
+    if ([self length] < 2)
+    {
+        return NO;
+    }
+    
+    const uint8_t *bytes = (const uint8_t *)[self bytes];
+    
+    return bytes[0] == 0x1f && bytes[1] == 0x8b;
+}
+
+
+- (NSData *)gzipDecompressedDataWithMaximumLength:(NSUInteger)maximumLength
+{
+    if ([self length] == 0)
+    {
+        return nil;
+    }
+    
+    z_stream stream;
+    bzero(&stream, sizeof(stream));
+    
+    //
+    // windowBits 15 + 16 only accepts the gzip wrapper produced by gzipCompressedData
+    //
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+    {
+        return nil;
+    }
+    
+    //
+    // The buffer is capped one byte beyond maximumLength, so that filling it means the output is too long
+    //
+    NSUInteger capacity = maximumLength < NSUIntegerMax ? maximumLength + 1 : maximumLength;
+    NSMutableData *decompressed = [NSMutableData dataWithLength:MIN(MAX([self length] * 2, MASDataCompressionChunkSize), capacity)];
+    NSUInteger remaining = [self length];
+    const Bytef *input = (const Bytef *)[self bytes];
+    int status = Z_OK;
+    
+    do {
+        if (stream.avail_in == 0 && remaining > 0)
+        {
+            uInt chunk = (uInt)MIN(remaining, (NSUInteger)UINT_MAX);
+            stream.next_in = (Bytef *)input;
+            stream.avail_in = chunk;
+            input += chunk;
+            remaining -= chunk;
+        }
+        
+        if (stream.total_out >= [decompressed length])
+        {
+            if ([decompressed length] >= capacity)
+            {
+                break;
+            }
+            
+            [decompressed setLength:MIN([decompressed length] + MAX([decompressed length] / 2, MASDataCompressionChunkSize), capacity)];
+        }
+        
+        stream.next_out = (Bytef *)[decompressed mutableBytes] + stream.total_out;
+        stream.avail_out = (uInt)MIN([decompressed length] - stream.total_out, (NSUInteger)UINT_MAX);
+        
+        status = inflate(&stream, Z_NO_FLUSH);
+    } while (status == Z_OK || (status == Z_BUF_ERROR && (stream.avail_in > 0 || remaining > 0 || stream.avail_out == 0)));
+    
+    inflateEnd(&stream);
+    
+    if (status != Z_STREAM_END || stream.total_out > maximumLength)
+    {
+        return nil;
+    }
+    
+    [decompressed setLength:stream.total_out];
+    
+    return [NSData dataWithData:decompressed];
+}
+
+
 #pragma mark - Encryption Methods
 
 - (void)encrypted:(BOOL)value
@@ -32,6 +32,11 @@
     //
     [self setValue:[self requestResponseTypeAsMimeTypeString:responseType] forHTTPHeaderField:MASAcceptRequestResponseKey];
     
+    //
+    // Advertise compressed response bodies; NSURLSession decodes them transparently
+    //
+    [self setValue:MASAcceptEncodingValue forHTTPHeaderField:MASAcceptEncodingRequestResponseKey];
+    
     NSString *lowerKey;
     NSString *value;
     for(NSString *key in [headerInfo allKeys])
@@ -99,53 +99,64 @@
                                           [[MASAccessService sharedService].currentAccessObj deleteCodeVerifier];
                                           [[MASAccessService sharedService].currentAccessObj deletePKCEState];
                                           
+                                          NSDictionary *headerInfo = responseInfo[MASResponseInfoHeaderInfoKey];
+                                          
                                           //
-                                          // Validate id_token when received from server.
+                                          // Continues once the id_token, if any, was validated
                                           //
-                                          NSDictionary *headerInfo = responseInfo[MASResponseInfoHeaderInfoKey];
+                                          void (^finishRegistration)(void) = ^{
+                                              
+                                              //
+                                              // Updated with latest info
+                                              //
+                                              [[MASDevice currentDevice] saveWithUpdatedInfo:responseInfo];
+                                              
+                                              //
+                                              // re-establish URLSession to trigger URL authentication
+                                              //
+                                              [[MASNetworkingService sharedService] establishURLSession];
+                                              
+                                              //
+                                              // Post the notification
+                                              //
+                                              [[NSNotificationCenter defaultCenter] postNotificationName:MASDeviceDidRegisterNotification object:blockSelf];
+                                              
+                                              //
+                                              // Notify
+                                              //
+                                              if (blockCompletion)
+                                              {
+                                                  blockCompletion(YES, nil);
+                                              }
+                                          };
                                           
+                                          //
+                                          // Validate id_token when received from server.
+                                          //
                                           if ([headerInfo objectForKey:MASIdTokenHeaderRequestResponseKey] &&
                                               [headerInfo objectForKey:MASIdTokenTypeHeaderRequestResponseKey] &&
                                               [[headerInfo objectForKey:MASIdTokenTypeHeaderRequestResponseKey] isEqualToString:MASIdTokenTypeToValidateConstant] &&
                                               [MASConfigurationService isIdTokenValidationEnabled])
                                           {
-                                              NSError *idTokenValidationError = nil;
-                                              BOOL isIdTokenValid = [MASAccessService validateIdToken:[headerInfo objectForKey:MASIdTokenHeaderRequestResponseKey]
-                                                                                        magIdentifier:[headerInfo objectForKey:MASMagIdentifierRequestResponseKey]
-                                                                                                error:&idTokenValidationError];
-                                              
-                                              if (!isIdTokenValid && idTokenValidationError)
-                                              {
-                                                  if (blockCompletion)
+                                              [MASAccessService validateIdToken:[headerInfo objectForKey:MASIdTokenHeaderRequestResponseKey]
+                                                                  magIdentifier:[headerInfo objectForKey:MASMagIdentifierRequestResponseKey]
+                                                                     completion:^(BOOL isIdTokenValid, NSError * _Nullable idTokenValidationError) {
+                                                  
+                                                  if (!isIdTokenValid && idTokenValidationError)
                                                   {
-                                                      blockCompletion(NO, idTokenValidationError);
-                                                      
-                                                      return;
+                                                      if (blockCompletion)
+                                                      {
+                                                          blockCompletion(NO, idTokenValidationError);
+                                                          
+                                                          return;
+                                                      }
                                                   }
-                                              }
+                                                  
+                                                  finishRegistration();
+                                              }];
                                           }
-                                          
-                                          //
-                                          // Updated with latest info
-                                          //
-                                          [[MASDevice currentDevice] saveWithUpdatedInfo:responseInfo];
-                                          
-                                          //
-                                          // re-establish URLSession to trigger URL authentication
-                                          //
-                                          [[MASNetworkingService sharedService] establishURLSession];
-                                          
-                                          //
-                                          // Post the notification
-                                          //
-                                          [[NSNotificationCenter defaultCenter] postNotificationName:MASDeviceDidRegisterNotification object:blockSelf];
-                                          
-                                          //
-                                          // Notify
-                                          //
-                                          if (blockCompletion)
-                                          {
-                                              blockCompletion(YES, nil);
+                                          else {
+                                              finishRegistration();
                                           }
                                       }];
 }
@@ -226,120 +237,131 @@
                                           [[MASAccessService sharedService].currentAccessObj deleteCodeVerifier];
                                           [[MASAccessService sharedService].currentAccessObj deletePKCEState];
                                           
-                                          //
-                                          // Validate id_token when received from server.
-                                          //
                                           NSDictionary *bodyInfo = responseInfo[MASResponseInfoBodyInfoKey];
                                           
-                                          if ([bodyInfo objectForKey:MASIdTokenBodyRequestResponseKey] &&
-                                              [bodyInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] &&
-                                              [[bodyInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] isEqualToString:MASIdTokenTypeToValidateConstant] &&
-                                              [MASConfigurationService isIdTokenValidationEnabled])
-                                          {
-                                              NSError *idTokenValidationError = nil;
-                                              BOOL isIdTokenValid = [MASAccessService validateIdToken:[bodyInfo objectForKey:MASIdTokenBodyRequestResponseKey]
-                                                                                        magIdentifier:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyMAGIdentifier]
-                                                                                                error:&idTokenValidationError];
-                                              
-                                              if (!isIdTokenValid && idTokenValidationError)
-                                              {
-                                                  //
-                                                  // Post the notification
-                                                  //
-                                                  [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidFailToAuthenticateNotification object:blockSelf];
-                                                  
-                                                  if (blockCompletion)
-                                                  {
-                                                      blockCompletion(NO, idTokenValidationError);
-                                                      
-                                                      return;
-                                                  }
-                                              }
-                                          }
-                                          
-                                          //
-                                          // Persist current authCredentials type
-                                          //
-                                          [[MASAccessService sharedService] setAccessValueString:self.credentialsType storageKey:MASKeychainStorageKeyCurrentAuthCredentialsGrantType];
-                                          
                                           //
-                                          // Create a new instance of MASUser if not client credentials
+                                          // Continues once the id_token, if any, was validated
                                           //
-                                          if ([self.credentialsType isEqualToString:MASGrantTypeClientCredentials])
-                                          {
-                                              //
-                                              // Make sure to clean up current user after client credentials authentication
-                                              //
-                                              [[MASModelService sharedService] clearCurrentUserForLogout];
+                                          void (^finishAuthentication)(void) = ^{
                                               
                                               //
-                                              // set authenticated timestamp
+                                              // Persist current authCredentials type
                                               //
-                                              NSNumber *authenticatedTimestamp = [NSNumber numberWithDouble:[[NSDate date] timeIntervalSince1970]];
-                                              [[MASAccessService sharedService] setAccessValueNumber:authenticatedTimestamp storageKey:MASKeychainStorageKeyAuthenticatedTimestamp];
+                                              [[MASAccessService sharedService] setAccessValueString:self.credentialsType storageKey:MASKeychainStorageKeyCurrentAuthCredentialsGrantType];
                                               
                                               //
-                                              //  Store credential information into keychain
+                                              // Create a new instance of MASUser if not client credentials
                                               //
-                                              [[MASAccessService sharedService] saveAccessValuesWithDictionary:bodyInfo forceToOverwrite:NO];
-                                          }
-                                          else {
-                                              if(![MASUser currentUser])
+                                              if ([self.credentialsType isEqualToString:MASGrantTypeClientCredentials])
                                               {
-                                                  [[MASModelService sharedService] setUserObject:[[MASUser alloc] initWithInfo:responseInfo]];
+                                                  //
+                                                  // Make sure to clean up current user after client credentials authentication
+                                                  //
+                                                  [[MASModelService sharedService] clearCurrentUserForLogout];
+                                                  
+                                                  //
+                                                  // set authenticated timestamp
+                                                  //
+                                                  NSNumber *authenticatedTimestamp = [NSNumber numberWithDouble:[[NSDate date] timeIntervalSince1970]];
+                                                  [[MASAccessService sharedService] setAccessValueNumber:authenticatedTimestamp storageKey:MASKeychainStorageKeyAuthenticatedTimestamp];
                                                   
+                                                  //
+                                                  //  Store credential information into keychain
+                                                  //
+                                                  [[MASAccessService sharedService] saveAccessValuesWithDictionary:bodyInfo forceToOverwrite:NO];
                                               }
+                                              else {
+                                                  if(![MASUser currentUser])
+                                                  {
+                                                      [[MASModelService sharedService] setUserObject:[[MASUser alloc] initWithInfo:responseInfo]];
+                                                      
+                                                  }
+                                                  
+                                                  //
+                                                  // Update the existing user with new information
+                                                  //
+                                                  else
+                                                  {
+                                                      [[MASUser currentUser] saveWithUpdatedInfo:responseInfo];
+                                                  }
+                                              }
+                                              
+                                              [[MASAccessService sharedService].currentAccessObj refresh];
                                               
                                               //
-                                              // Update the existing user with new information
+                                              // Retrieve userinfo unless otherwise authCredentialsType is client credentials
                                               //
-                                              else
+                                              if (![self.credentialsType isEqualToString:MASGrantTypeClientCredentials])
                                               {
-                                                  [[MASUser currentUser] saveWithUpdatedInfo:responseInfo];
+                                                  [[MASModelService sharedService] requestUserInfoWithCompletion:^(MASUser *user, NSError *error) {
+                                                      
+                                                      //
+                                                      // Post the notification
+                                                      //
+                                                      [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidAuthenticateNotification object:blockSelf];
+                                                      
+                                                      //
+                                                      // Requesting additional userInfo upon successful authentication
+                                                      // and do not depend on the result of userInfo call.
+                                                      // This a workaround to fix other frameworks' dependency issue on userInfo.
+                                                      // James Go @ April 4, 2016
+                                                      //
+                                                      
+                                                      //
+                                                      // Notify
+                                                      //
+                                                      if (blockCompletion)
+                                                      {
+                                                          blockCompletion(YES, nil);
+                                                      }
+                                                  }];
                                               }
-                                          }
-                                          
-                                          [[MASAccessService sharedService].currentAccessObj refresh];
-                                          
-                                          //
-                                          // Retrieve userinfo unless otherwise authCredentialsType is client credentials
-                                          //
-                                          if (![self.credentialsType isEqualToString:MASGrantTypeClientCredentials])
-                                          {
-                                              [[MASModelService sharedService] requestUserInfoWithCompletion:^(MASUser *user, NSError *error) {
+                                              else {
                                                   
                                                   //
                                                   // Post the notification
                                                   //
                                                   [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidAuthenticateNotification object:blockSelf];
                                                   
-                                                  //
-                                                  // Requesting additional userInfo upon successful authentication
-                                                  // and do not depend on the result of userInfo call.
-                                                  // This a workaround to fix other frameworks' dependency issue on userInfo.
-                                                  // James Go @ April 4, 2016
-                                                  //
-                                                  
-                                                  //
-                                                  // Notify
-                                                  //
                                                   if (blockCompletion)
                                                   {
                                                       blockCompletion(YES, nil);
                                                   }
+                                              }
+                                          };
+                                          
+                                          //
+                                          // Validate id_token when received from server.
+                                          //
+                                          if ([bodyInfo objectForKey:MASIdTokenBodyRequestResponseKey] &&
+                                              [bodyInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] &&
+                                              [[bodyInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] isEqualToString:MASIdTokenTypeToValidateConstant] &&
+                                              [MASConfigurationService isIdTokenValidationEnabled])
+                                          {
+                                              [MASAccessService validateIdToken:[bodyInfo objectForKey:MASIdTokenBodyRequestResponseKey]
+                                                                  magIdentifier:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyMAGIdentifier]
+                                                                     completion:^(BOOL isIdTokenValid, NSError * _Nullable idTokenValidationError) {
+                                                  
+                                                  if (!isIdTokenValid && idTokenValidationError)
+                                                  {
+                                                      //
+                                                      // Post the notification
+                                                      //
+                                                      [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidFailToAuthenticateNotification object:blockSelf];
+                                                      
+                                                      if (blockCompletion)
+                                                      {
+                                                          blockCompletion(NO, idTokenValidationError);
+                                                          
+                                                          return;
+                                                      }
+                                                  }
+                                                  
+                                                  finishAuthentication();
                                               }];
                                           }
                                           else {
-                                              
-                                              //
-                                              // Post the notification
-                                              //
-                                              [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidAuthenticateNotification object:blockSelf];
-                                              
-                                              if (blockCompletion)
-                                              {
-                                                  blockCompletion(YES, nil);
-                                              }
+                                              finishAuthentication();
                                           }
                                       }];
 }
@@ -21,4 +21,14 @@
  */
 - (NSString * __nullable)buildWithPrivateKey:(NSData * __nonnull)privateKey error:(NSError * __nullable __autoreleasing * __nullable)error;
 
+
+
+/**
+ Builds JWT based on the claims, signed with the private key of the registered device
+ 
+ @param error NSError object that may be returned during the build process
+ @return NSString of JWT if build process was successful
+ */
+- (NSString * __nullable)buildWithError:(NSError * __nullable __autoreleasing * __nullable)error;
+
 @end
@@ -11,6 +11,7 @@
 #import "MASClaims+MASPrivate.h"
 
 #import "MASAccessService.h"
+#import "MASSecurityService.h"
 
 //  JWT
 #import "JWT.h"
@@ -27,7 +28,85 @@
 
 - (NSString * __nullable)buildWithPrivateKey:(NSData * __nonnull)privateKey error:(NSError * __nullable __autoreleasing * __nullable)error
 {
+    NSDictionary *payload = [self buildPayload];
     
+    //
+    //  MASClaims will only sign with RS256 which is mutually agreed with
+    //
+    NSString *algorithmName = @"RS256";
+    id<JWTRSAlgorithm> algorithm = (id<JWTRSAlgorithm>)[JWTAlgorithmFactory algorithmByName:algorithmName];
+    
+    //
+    //  Prepare data holder with private key as PEM Base64 in NSData
+    //
+    id <JWTAlgorithmDataHolderProtocol> dataHolder = [JWTAlgorithmRSFamilyDataHolder new].keyExtractorType([JWTCryptoKeyExtractor privateKeyWithPEMBase64].type).algorithm(algorithm).secretData(privateKey);
+    
+    //
+    //  Construct JWT builder with payload and data holder
+    //
+    JWTCodingBuilder *builder = [JWTEncodingBuilder encodePayload:payload].addHolder(dataHolder);
+    
+    //
+    //  Build
+    //
+    JWTCodingResultType *signResult = builder.result;
+    
+    if (signResult.successResult.encoded)
+    {
+        return signResult.successResult.encoded;
+    }
+    else {
+        if (signResult.errorResult.error && error)
+        {
+            *error = signResult.errorResult.error;
+        }
+        return nil;
+    }
+}
+
+
+- (NSString * __nullable)buildWithError:(NSError * __nullable __autoreleasing * __nullable)error
+{
+    NSDictionary *payload = [self buildPayload];
+    
+    //
+    //  Encode header and payload the same way as JWTEncodingBuilder does, with RS256 which is mutually agreed with
+    //
+    NSDictionary *header = @{ @"alg" : @"RS256", @"typ" : @"JWT" };
+    
+    NSData *headerData = [NSJSONSerialization dataWithJSONObject:header options:0 error:nil];
+    NSData *payloadData = [NSJSONSerialization dataWithJSONObject:payload options:0 error:error];
+    
+    if (!payloadData)
+    {
+        return nil;
+    }
+    
+    NSMutableString *jwt = [NSMutableString stringWithString:[JWTBase64Coder base64UrlEncodedStringWithData:headerData]];
+    [jwt appendString:@"."];
+    [jwt appendString:[JWTBase64Coder base64UrlEncodedStringWithData:payloadData]];
+    
+    //
+    //  Sign the signing input with the private key kept by the security service, instead of exporting and importing it through the keychain
+    //
+    NSData *signature = [[MASSecurityService sharedService] signData:[jwt dataUsingEncoding:NSUTF8StringEncoding] error:error];
+    
+    if (!signature)
+    {
+        return nil;
+    }
+    
+    [jwt appendString:@"."];
+    [jwt appendString:[JWTBase64Coder base64UrlEncodedStringWithData:signature]];
+    
+    return jwt;
+}
+
+
+# pragma mark - Private
+
+- (NSDictionary *)buildPayload
+{
     //
     //  Prepare iat at current timestamp
     //
@@ -106,38 +185,7 @@
         [payload setObject:obj forKey:key];
     }];
     
-    //
-    //  MASClaims will only sign with RS256 which is mutually agreed with
-    //
-    NSString *algorithmName = @"RS256";
-    id<JWTRSAlgorithm> algorithm = (id<JWTRSAlgorithm>)[JWTAlgorithmFactory algorithmByName:algorithmName];
-    
-    //
-    //  Prepare data holder with private key as PEM Base64 in NSData
-    //
-    id <JWTAlgorithmDataHolderProtocol> dataHolder = [JWTAlgorithmRSFamilyDataHolder new].keyExtractorType([JWTCryptoKeyExtractor privateKeyWithPEMBase64].type).algorithm(algorithm).secretData(privateKey);
-    
-    //
-    //  Construct JWT builder with payload and data holder
-    //
-    JWTCodingBuilder *builder = [JWTEncodingBuilder encodePayload:payload].addHolder(dataHolder);
-    
-    //
-    //  Build
-    //
-    JWTCodingResultType *signResult = builder.result;
-    
-    if (signResult.successResult.encoded)
-    {
-        return signResult.successResult.encoded;
-    }
-    else {
-        if (signResult.errorResult.error && error)
-        {
-            *error = signResult.errorResult.error;
-        }
-        return nil;
-    }
+    return payload;
 }
 
 @end
@@ -10,6 +10,8 @@
 
 #import <Foundation/Foundation.h>
 
+@protocol JWTCryptoKeyProtocol;
+
 
 
 NS_ASSUME_NONNULL_BEGIN
@@ -42,6 +44,14 @@ NS_ASSUME_NONNULL_BEGIN
 
 
 
+/**
+ * The date after which the JWKSet should be loaded again, as indicated by the cache headers of the JWKS response.
+ * nil if unknown, i.e. for a JWKSet retrieved from local storage.
+ */
+@property (nonatomic, strong, nullable) NSDate *expirationDate;
+
+
+
 ///--------------------------------------
 /// @name Lifecycle
 ///--------------------------------------
@@ -58,6 +68,17 @@ NS_ASSUME_NONNULL_BEGIN
 
 
 
+/**
+ * Retrieves the public key of the JSON Web Key with the key identifier.
+ * Public keys are extracted from the first certificate of each key's x5c chain once, when the JWKSet is initialized.
+ *
+ * @param keyId NSString of unique identifier of the json web key value
+ * @return Returns the public key, or nil if the JWKSet contains no usable key with the identifier.
+ */
+- (id<JWTCryptoKeyProtocol> _Nullable)publicKeyForKeyId:(NSString *_Nonnull)keyId;
+
+
+
 /**
  * Retrieves the instance of MASJWKSet from local storage, if it exists.
  *
@@ -17,12 +17,23 @@
 
 #import "NSData+MASPrivate.h"
 
+//  JWT
+#import "JWTCryptoKey.h"
+
 
 # pragma mark - JSONWebKeySet Constants
 
 static NSString *const MASJWKSetKeysKey = @"keys"; // value is Dictionary
 
 
+@interface MASJWKSet ()
+
+//  Public keys of the JSON Web Keys, indexed by key identifier
+@property (nonatomic, copy) NSDictionary<NSString *, id<JWTCryptoKeyProtocol>> *publicKeys;
+
+@end
+
+
 @implementation MASJWKSet
 
 static NSDictionary *_jsonWebKeySetInfo_;
@@ -65,6 +76,7 @@ static NSDictionary *_jsonWebKeySetInfo_;
         _jsonWebKeySetInfo_ = info;
         
         [self setValue:[NSNumber numberWithBool:(_jsonWebKeySetInfo_ && ([_jsonWebKeySetInfo_ count] > 0))] forKey:@"isLoaded"];
+        [self indexPublicKeys];
     }
     
     [self saveToStorage];
@@ -141,6 +153,7 @@ static NSDictionary *_jsonWebKeySetInfo_;
         
         
         [self setValue:[NSNumber numberWithBool:(_jsonWebKeySetInfo_ && ([_jsonWebKeySetInfo_ count] > 0))] forKey:@"isLoaded"];
+        [self indexPublicKeys];
     }
     
     return self;
@@ -156,4 +169,47 @@ static NSDictionary *_jsonWebKeySetInfo_;
     return jsonWebKeys;
 }
 
+
+# pragma mark - Public Keys
+
+- (id<JWTCryptoKeyProtocol>)publicKeyForKeyId:(NSString *)keyId
+{
+    return keyId ? self.publicKeys[keyId] : nil;
+}
+
+
+- (void)indexPublicKeys
+{
+    NSMutableDictionary *publicKeys = [NSMutableDictionary dictionary];
+    
+    for (NSDictionary *jsonWebKey in self.jsonWebKeys)
+    {
+        NSString *keyId = jsonWebKey[@"kid"];
+        NSArray *x5c = jsonWebKey[@"x5c"];
+        
+        if (![keyId isKindOfClass:[NSString class]] || ![x5c isKindOfClass:[NSArray class]] || [x5c count] == 0)
+        {
+            continue;
+        }
+        
+        //
+        //  Use x5c[0] of chain.
+        //
+        NSData *certData = [[NSData alloc] initWithBase64EncodedString:x5c[0] options:NSDataBase64DecodingIgnoreUnknownCharacters];
+        
+        NSError *keyError = nil;
+        JWTCryptoKeyPublic *publicKey = certData ? [[JWTCryptoKeyPublic alloc] initWithCertificateData:certData parameters:nil error:&keyError] : nil;
+        
+        if (publicKey && !keyError)
+        {
+            publicKeys[keyId] = publicKey;
+        }
+        else {
+            DLog(@"Error extracting public key of JWK (%@): %@", keyId, keyError);
+        }
+    }
+    
+    self.publicKeys = publicKeys;
+}
+
 @end
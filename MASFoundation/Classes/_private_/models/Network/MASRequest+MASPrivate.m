@@ -24,6 +24,8 @@
 @property (assign, readwrite) MASRequestResponseType requestType;
 @property (assign, readwrite) MASRequestResponseType responseType;
 @property (assign, readwrite) NSTimeInterval timeoutInterval;
+@property (assign, readwrite) BOOL compressRequestBody;
+@property (assign, readwrite) BOOL waitsForConnectivity;
 
 @end
 
@@ -50,6 +52,8 @@
         self.body = builder.body;
         self.query = builder.query;
         self.timeoutInterval = builder.timeoutInterval;
+        self.compressRequestBody = builder.compressRequestBody;
+        self.waitsForConnectivity = builder.waitsForConnectivity;
         
         
         //
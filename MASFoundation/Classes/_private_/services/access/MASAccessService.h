@@ -423,12 +423,13 @@ extern NSString * const MASKeychainStorageKeyPKCEState;
 /**
  *  Validate id_token
  *
+ *  An id_token signed with RS256 is verified once the JWKS with its key is loaded, which may require a request.
+ *
  *  @param idToken NSString of id_token value
  *  @param magIdentifier NSString of mag-identifier value
- *
- *  @return BOOL if the id_token is still valid or not
+ *  @param completion The MASCompletionErrorBlock receiving whether the id_token is still valid or not, and the reason if it is not
  */
-+ (BOOL)validateIdToken:(NSString *)idToken magIdentifier:(NSString *)magIdentifier error:(NSError *__autoreleasing *)error;
++ (void)validateIdToken:(NSString *)idToken magIdentifier:(NSString *)magIdentifier completion:(MASCompletionErrorBlock)completion;
 
 
 
@@ -13,6 +13,7 @@
 #import "NSData+MASPrivate.h"
 #import "MASIKeyChainStore.h"
 #import "MASIKeyChainStore+MASPrivate.h"
+#import "MASCompactJWT.h"
 #import "MASJWTService.h"
 #import "MASSecurityService.h"
 
@@ -773,80 +774,6 @@ static BOOL _isDonotLogoutRefreshtokenServerMaintainance_ = NO;
 
 #pragma mark - Private
 
-+ (NSString *)padding:(NSString *)encodedString{
-    
-    unsigned long lengthtRequired = (int)(4 * ceil((float)[encodedString length] / 4.0));
-    long numPaddings = lengthtRequired - [encodedString length];
-    
-    if (numPaddings > 0) {
-        NSString *padding =
-        [[NSString string] stringByPaddingToLength:numPaddings
-                                        withString:@"=" startingAtIndex:0];
-        encodedString = [encodedString stringByAppendingString:padding];
-    }
-    
-    encodedString = [encodedString stringByReplacingOccurrencesOfString:@"-" withString:@"+"];
-    encodedString = [encodedString stringByReplacingOccurrencesOfString:@"_" withString:@"/"];
-    
-    return encodedString;
-}
-
-
-+ (NSDictionary *)getIdTokenSegments:(NSString *)idToken error:(NSError *__autoreleasing *)error
-{
-    NSDictionary *segmentsDict = nil;
-    
-    NSArray *segments = [idToken componentsSeparatedByString:@"."];
-    
-    //
-    // check if idToken is in valid format
-    //
-    if (segments == nil || [segments count] != 3) {
-        
-        if (error)
-        {
-            *error = [NSError errorInvalidIdToken];
-        }
-    }
-    
-    NSString *headerString = [segments objectAtIndex:0];
-    NSString *payload = [segments objectAtIndex:1];
-    NSString *signature = [segments objectAtIndex:2];
-    
-    if (!headerString || !payload || !signature){
-        
-        if (error)
-        {
-            *error = [NSError errorInvalidIdToken];
-        }
-        
-    }
-    else {
-        segmentsDict = [[NSDictionary alloc] initWithObjectsAndKeys:headerString, @"headerString", payload, @"payload", signature, @"signature", nil];
-    }
-    
-    return segmentsDict;
-}
-
-
-+ (NSDictionary *)unwrap:(NSString *)data
-{
-    NSDictionary *dictionary = nil;
-    
-    //
-    // process to unwrap
-    //
-    NSData *decodedData = [NSData dataWithBase64EncodedString:data];
-    NSString *decodedString = [[NSString alloc] initWithData:decodedData encoding:NSUTF8StringEncoding];
-    
-    dictionary = [NSJSONSerialization JSONObjectWithData:[decodedString dataUsingEncoding:NSUTF8StringEncoding]
-                                                 options:0
-                                                   error:nil];
-    
-    return dictionary;
-}
-
-
 - (NSString *)convertKeyString:(NSString *)key
 {
     NSString *accessTypeToString = nil;
@@ -1192,11 +1119,10 @@ static BOOL _isDonotLogoutRefreshtokenServerMaintainance_ = NO;
     if (idToken)
     {
         //
-        // Validate id_token whether it is valid or not
+        // Only an expired id_token fails the unlock, other validation errors are ignored; the expiration is checked locally,
+        // so that unlocking never waits for the JWKS to be loaded
         //
-        BOOL isIdTokenValid = [MASAccessService validateIdToken:idToken
-                                                  magIdentifier:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyMAGIdentifier]
-                                                          error:&localError];
+        BOOL isIdTokenValid = ![MASAccessService isIdTokenExpired:idToken error:&localError];
         
         if (localError && localError.code != MASFoundationErrorCodeTokenIdTokenExpired)
         {
@@ -1250,42 +1176,40 @@ static BOOL _isDonotLogoutRefreshtokenServerMaintainance_ = NO;
     [[MASAccessService sharedService].currentAccessObj refresh];
 }
 
-+ (BOOL)validateIdToken:(NSString *)idToken magIdentifier:(NSString *)magIdentifier error:(NSError *__autoreleasing *)error
++ (void)validateIdToken:(NSString *)idToken magIdentifier:(NSString *)magIdentifier completion:(MASCompletionErrorBlock)completion
 {
     //
     // Credits to Anthony Yu
     //
-
+    
+    if (!completion)
+    {
+        return;
+    }
+    
     //
-    // extract idToken segments
+    // parse idToken in a single pass; the parsed token is shared with isIdTokenExpired:
     //
-    NSDictionary *idTokenSegments = [MASAccessService getIdTokenSegments:idToken error:error];
+    MASCompactJWT *jwt = [MASCompactJWT jwtWithString:idToken];
     
     //
-    // if could not extract segments, there is an issue with the idToken
+    // if could not parse the idToken, there is an issue with the idToken
     //
-    if (!idTokenSegments)
+    if (!jwt)
     {
-        return NO;
+        completion(NO, [NSError errorInvalidIdToken]);
+        return;
     }
     
-    NSString *headerString = [idTokenSegments valueForKey:@"headerString"];
-    NSString *payload = [idTokenSegments valueForKey:@"payload"];
-    NSString *signature = [idTokenSegments valueForKey:@"signature"];;
-    
     //
     // verifying signature
-    // processes to unwrap the header
     //
-    NSDictionary *headerDictionary = [MASAccessService unwrap:headerString];
+    NSDictionary *headerDictionary = jwt.header;
     
     if (![[headerDictionary allKeys] containsObject:@"alg"])
     {
-        if (error)
-        {
-            *error = [NSError errorIdTokenInvalidSignature];
-        }
-        return NO;
+        completion(NO, [NSError errorIdTokenInvalidSignature]);
+        return;
     }
     else if ([[headerDictionary objectForKey:@"alg"] isEqualToString:@"HS256"])
     {
@@ -1293,25 +1217,15 @@ static BOOL _isDonotLogoutRefreshtokenServerMaintainance_ = NO;
         //
         // check signature
         //
-        NSMutableArray *signatureSegments = [NSMutableArray array];
-        [signatureSegments addObject:headerString];
-        [signatureSegments addObject:payload];
-        
-        NSString *signingInput = [signatureSegments componentsJoinedByString:@"."];
         NSString *clientSecret = [[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyClientSecret];
-        NSData *signedInput = [NSData sign:signingInput key:clientSecret];
-        NSString *encodedSignedInput = [signedInput base64Encoding];
         
         //
         // case 1: signature doesn't match
         //
-        if (![encodedSignedInput isEqualToString:[MASAccessService padding:signature]])
+        if (![jwt verifyHS256SignatureWithKey:clientSecret])
         {
-            if (error)
-            {
-                *error = [NSError errorIdTokenInvalidSignature];
-            }
-            return NO;
+            completion(NO, [NSError errorIdTokenInvalidSignature]);
+            return;
         }
     }
     else if ([[headerDictionary objectForKey:@"alg"] isEqualToString:@"RS256"])
@@ -1322,50 +1236,57 @@ static BOOL _isDonotLogoutRefreshtokenServerMaintainance_ = NO;
         //
         if (![[headerDictionary allKeys] containsObject:@"kid"])
         {
-            if (error)
-            {
-                *error = [NSError errorIdTokenInvalidSignature];
-            }
-            return NO;
+            completion(NO, [NSError errorIdTokenInvalidSignature]);
+            return;
         }
         
         //
-        // Check signature.
+        // Check signature; if the JWKS is not loaded yet, or does not have the keyId, this waits for it to be loaded.
         //
-        NSDictionary *headerAndPayloadDictionary =
-            [[MASJWTService sharedService] decodeToken:idToken
-                                      keyId:headerDictionary[@"kid"]
-                             skipSignatureVerification:NO error:error];
-        
-        //
-        // signature Doesn't match.
-        //
-        BOOL signatureVerified = (headerAndPayloadDictionary != nil);
-        if (!signatureVerified) {
-         
-            if (error)
+        [[MASJWTService sharedService] decodeToken:idToken
+                                             keyId:headerDictionary[@"kid"]
+                         skipSignatureVerification:NO
+                                        completion:^(id _Nullable headerAndPayloadDictionary, NSError * _Nullable error) {
+            
+            //
+            // signature Doesn't match.
+            //
+            if (!headerAndPayloadDictionary)
             {
-                *error = [NSError errorIdTokenInvalidSignature];
+                completion(NO, [NSError errorIdTokenInvalidSignature]);
+                return;
             }
-            return NO;
-        }
+            
+            NSError *payloadError = nil;
+            BOOL isIdTokenValid = [MASAccessService validatePayloadOfIdToken:jwt magIdentifier:magIdentifier error:&payloadError];
+            
+            completion(isIdTokenValid, payloadError);
+        }];
+        
+        return;
     }
     else {
-        if (error)
-        {
-            *error = [NSError errorIdTokenNotSupportedAlgorithm];
-        }
-        return NO;
+        completion(NO, [NSError errorIdTokenNotSupportedAlgorithm]);
+        return;
     }
     
+    NSError *payloadError = nil;
+    BOOL isIdTokenValid = [MASAccessService validatePayloadOfIdToken:jwt magIdentifier:magIdentifier error:&payloadError];
+    
+    completion(isIdTokenValid, payloadError);
+}
+
+
++ (BOOL)validatePayloadOfIdToken:(MASCompactJWT *)jwt magIdentifier:(NSString *)magIdentifier error:(NSError *__autoreleasing *)error
+{
     //
     // validating payload
     //
-    NSDictionary *payloadDictionary = [MASAccessService unwrap:payload];
+    NSDictionary *payloadDictionary = jwt.payload;
     
     NSString *aud = [payloadDictionary valueForKey:@"aud"];
     NSString *azp = [payloadDictionary valueForKey:@"azp"];
-    NSDate *exp = [NSDate dateWithTimeIntervalSince1970:[[payloadDictionary valueForKey:@"exp"] floatValue]];
+    NSDate *exp = jwt.expirationDate ?: [NSDate dateWithTimeIntervalSince1970:0];
     
     if (!aud || !azp || !exp)
     {
@@ -1419,29 +1340,26 @@ static BOOL _isDonotLogoutRefreshtokenServerMaintainance_ = NO;
 + (BOOL)isIdTokenExpired:(NSString *)idToken error:(NSError *__autoreleasing *)error
 {
     //
-    // extract idToken segments
+    // parse idToken, or reuse the token parsed while validating it
     //
-    NSDictionary *idTokenSegments = [MASAccessService getIdTokenSegments:idToken error:error];
+    MASCompactJWT *jwt = [MASCompactJWT jwtWithString:idToken];
     
     //
-    // if could not extract segments, there is an issue with the idToken so return as expired
+    // if could not parse the idToken, there is an issue with the idToken so return as expired
     //
-    if (!idTokenSegments)
+    if (!jwt)
     {
+        if (error)
+        {
+            *error = [NSError errorInvalidIdToken];
+        }
         return YES;
     }
     
     //
     // validate expire date
     //
-    NSString *payload = [idTokenSegments valueForKey:@"payload"];
-    
-    //
-    // unwrap payload
-    //
-    NSDictionary *payloadDictionary = [MASAccessService unwrap:payload];
-
-    NSDate *exp = [NSDate dateWithTimeIntervalSince1970:[[payloadDictionary valueForKey:@"exp"] floatValue]];
+    NSDate *exp = jwt.expirationDate ?: [NSDate dateWithTimeIntervalSince1970:0];
 
     //
     // check if JWT expired
@@ -62,6 +62,17 @@ Sets network timeout for specified host in MASNetworkConfiguration object
 
 
 
+/**
+ Registers alternate domains which are equivalent to the given domain.  An alternate domain without a network, or security configuration
+ of its own resolves to the configuration of the given domain, so that changes made to the primary gateway's configuration also apply to its alternate gateways.
+ 
+ @param alternateDomains NSArray of NSURL of the alternate domains, or nil to remove previously registered alternate domains.
+ @param domain NSURL of the domain whose configuration is inherited.
+ */
++ (void)setAlternateDomains:(NSArray *)alternateDomains forDomain:(NSURL *)domain;
+
+
+
 ///--------------------------------------
 /// @name Security Configuration
 ///--------------------------------------
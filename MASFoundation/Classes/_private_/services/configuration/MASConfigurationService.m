@@ -20,6 +20,7 @@ static NSDictionary *_newConfigurationObject_ = nil;
 static BOOL _newConfigurationDetected_ = NO;
 static NSMutableDictionary *_networkConfigurations_;
 static NSMutableDictionary *_securityConfigurations_;
+static NSMutableDictionary *_alternateDomains_;
 static BOOL _enableIdTokenValidation_ = YES;
 
 # pragma mark - Properties
@@ -111,9 +112,60 @@ static BOOL _enableIdTokenValidation_ = YES;
 
 
 + (MASNetworkConfiguration *)networkConfigurationForDomain:(NSURL *)domain
+{
+    return [self configurationForDomain:domain inConfigurations:_networkConfigurations_];
+}
+
+
++ (void)setAlternateDomains:(NSArray *)alternateDomains forDomain:(NSURL *)domain
 {
     NSURL *thisDomain = [NSURL URLWithString:[NSString stringWithFormat:@"%@://%@:%@", domain.scheme, domain.host, domain.port]];
-    return thisDomain ? [_networkConfigurations_ objectForKey:[thisDomain absoluteString]] : nil;
+    if (!thisDomain)
+    {
+        return;
+    }
+    
+    if (!_alternateDomains_)
+    {
+        _alternateDomains_ = [NSMutableDictionary dictionary];
+    }
+    
+    //
+    //  Remove alternate domains previously registered for the domain
+    //
+    [_alternateDomains_ removeObjectsForKeys:[_alternateDomains_ allKeysForObject:[thisDomain absoluteString]]];
+    
+    for (NSURL *alternateDomain in alternateDomains)
+    {
+        NSURL *thisAlternateDomain = [NSURL URLWithString:[NSString stringWithFormat:@"%@://%@:%@", alternateDomain.scheme, alternateDomain.host, alternateDomain.port]];
+        if (thisAlternateDomain && ![thisAlternateDomain isEqual:thisDomain])
+        {
+            [_alternateDomains_ setObject:[thisDomain absoluteString] forKey:[thisAlternateDomain absoluteString]];
+        }
+    }
+}
+
+
++ (id)configurationForDomain:(NSURL *)domain inConfigurations:(NSDictionary *)configurations
+{
+    NSURL *thisDomain = [NSURL URLWithString:[NSString stringWithFormat:@"%@://%@:%@", domain.scheme, domain.host, domain.port]];
+    if (!thisDomain)
+    {
+        return nil;
+    }
+    
+    id configuration = [configurations objectForKey:[thisDomain absoluteString]];
+    
+    //
+    //  Alternate gateways inherit the configuration of the primary gateway unless configured on their own
+    //
+    NSString *inheritedDomain = [_alternateDomains_ objectForKey:[thisDomain absoluteString]];
+    if (!configuration && inheritedDomain)
+    {
+        configuration = [configurations objectForKey:inheritedDomain];
+    }
+    
+    return configuration;
 }
 
 
@@ -148,8 +200,7 @@ static BOOL _enableIdTokenValidation_ = YES;
 
 + (MASSecurityConfiguration *)securityConfigurationForDomain:(NSURL *)domain
 {
-    NSURL *thisDomain = [NSURL URLWithString:[NSString stringWithFormat:@"%@://%@:%@", domain.scheme, domain.host, domain.port]];
-    return thisDomain ? [_securityConfigurations_ objectForKey:[thisDomain absoluteString]] : nil;
+    return [self configurationForDomain:domain inConfigurations:_securityConfigurations_];
 }
 
 
@@ -338,6 +389,12 @@ static BOOL _enableIdTokenValidation_ = YES;
     
     [MASConfiguration setSecurityConfiguration:defaultSecurityConfiguration error:nil];
     
+    //
+    //  Alternate gateways are equivalent to the primary gateway; they resolve to its network and security configuration,
+    //  including any change made to it after SDK initialization
+    //
+    [MASConfigurationService setAlternateDomains:_currentConfiguration.gatewayAlternateUrls forDomain:currentURL];
+    
     //DLog(@"\n\ndone and current configuration is:\n\n%@\n\n", [_currentConfiguration debugDescription]);
     
     [super serviceWillStart];
@@ -370,6 +427,8 @@ static BOOL _enableIdTokenValidation_ = YES;
         [_securityConfigurations_ removeObjectForKey:[thisDomain absoluteString]];
     }
     
+    [_alternateDomains_ removeAllObjects];
+    
     if (_newConfigurationObject_)
     {
         _newConfigurationObject_ = nil;
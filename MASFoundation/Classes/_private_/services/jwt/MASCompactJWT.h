@@ -0,0 +1,104 @@
+//
+//  MASCompactJWT.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+
+/**
+ * MASCompactJWT represents a JWT in compact serialization, parsed in a single pass over the token.
+ *
+ * The header and payload segments are decoded from base64url straight into buffers which are parsed as JSON,
+ * and the signing input is a view into the token's bytes rather than a copy.
+ * Parsed tokens are cached by their string, so that validating a token and checking its expiration decode it only once.
+ */
+@interface MASCompactJWT : NSObject
+
+///--------------------------------------
+/// @name Properties
+///--------------------------------------
+
+# pragma mark - Properties
+
+/**
+ * The JOSE header.
+ */
+@property (nonatomic, copy, readonly) NSDictionary *header;
+
+
+
+/**
+ * The claims of the payload.
+ */
+@property (nonatomic, copy, readonly) NSDictionary *payload;
+
+
+
+/**
+ * The decoded signature.
+ */
+@property (nonatomic, copy, readonly) NSData *signature;
+
+
+
+/**
+ * The signing input, the encoded header and payload separated by a period, as ASCII bytes.
+ * The data shares the bytes of the parsed token.
+ */
+@property (nonatomic, strong, readonly) NSData *signingInput;
+
+
+
+/**
+ * The expiration date of the exp claim, or nil if the payload has no exp claim.
+ */
+@property (nonatomic, strong, readonly, nullable) NSDate *expirationDate;
+
+
+
+///--------------------------------------
+/// @name Lifecycle
+///--------------------------------------
+
+# pragma mark - Lifecycle
+
+/**
+ * Retrieves the parsed JWT of the token, parsing it if it was not parsed recently.
+ *
+ * @param token NSString of the JWT in compact serialization.
+ * @return Returns the parsed JWT, or nil if the token is not a well-formed JWT with JSON object header and payload.
+ */
++ (MASCompactJWT *_Nullable)jwtWithString:(NSString *_Nullable)token;
+
+
+
+///--------------------------------------
+/// @name Signature
+///--------------------------------------
+
+# pragma mark - Signature
+
+/**
+ * Verifies the HMAC SHA-256 signature of the JWT with the key, in constant time.
+ *
+ * @param key NSString of the shared secret.
+ * @return Returns YES if the signature matches.
+ */
+- (BOOL)verifyHS256SignatureWithKey:(NSString *_Nullable)key;
+
+@end
+
+
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,239 @@
+//
+//  MASCompactJWT.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASCompactJWT.h"
+
+#include <CommonCrypto/CommonHMAC.h>
+
+
+//
+//  Number of parsed tokens kept; a handful covers the id_token being validated and checked for expiration
+//
+static NSUInteger const MASCompactJWTCacheCountLimit = 8;
+
+
+@interface MASCompactJWT ()
+
+@property (nonatomic, copy, readwrite) NSDictionary *header;
+@property (nonatomic, copy, readwrite) NSDictionary *payload;
+@property (nonatomic, copy, readwrite) NSData *signature;
+@property (nonatomic, strong, readwrite) NSData *signingInput;
+@property (nonatomic, strong, readwrite) NSDate *expirationDate;
+
+@end
+
+
+@implementation MASCompactJWT
+
+# pragma mark - Lifecycle
+
++ (MASCompactJWT *)jwtWithString:(NSString *)token
+{
+    if (![token isKindOfClass:[NSString class]] || [token length] == 0)
+    {
+        return nil;
+    }
+    
+    static NSCache *cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        
+        cache = [[NSCache alloc] init];
+        cache.countLimit = MASCompactJWTCacheCountLimit;
+    });
+    
+    MASCompactJWT *jwt = [cache objectForKey:token];
+    
+    if (!jwt)
+    {
+        jwt = [[MASCompactJWT alloc] initWithString:token];
+        
+        if (jwt)
+        {
+            [cache setObject:jwt forKey:token];
+        }
+    }
+    
+    return jwt;
+}
+
+
+- (instancetype)initWithString:(NSString *)token
+{
+    //
+    //  The compact serialization is ASCII; a token with other characters is malformed
+    //
+    NSData *tokenData = [token dataUsingEncoding:NSASCIIStringEncoding];
+    
+    if (!tokenData)
+    {
+        return nil;
+    }
+    
+    const uint8_t *bytes = tokenData.bytes;
+    NSUInteger length = tokenData.length;
+    
+    //
+    //  Locate the two periods separating header, payload and signature
+    //
+    const uint8_t *firstPeriod = memchr(bytes, '.', length);
+    const uint8_t *secondPeriod = firstPeriod ? memchr(firstPeriod + 1, '.', length - (firstPeriod + 1 - bytes)) : NULL;
+    
+    if (!secondPeriod || memchr(secondPeriod + 1, '.', length - (secondPeriod + 1 - bytes)))
+    {
+        return nil;
+    }
+    
+    NSUInteger headerLength = firstPeriod - bytes;
+    NSUInteger payloadLength = secondPeriod - (firstPeriod + 1);
+    NSUInteger signatureLength = length - (secondPeriod + 1 - bytes);
+    
+    NSData *headerData = [MASCompactJWT dataWithBase64URLBytes:bytes length:headerLength];
+    NSData *payloadData = [MASCompactJWT dataWithBase64URLBytes:firstPeriod + 1 length:payloadLength];
+    NSData *signatureData = [MASCompactJWT dataWithBase64URLBytes:secondPeriod + 1 length:signatureLength];
+    
+    if (!headerData || !payloadData || !signatureData)
+    {
+        return nil;
+    }
+    
+    NSDictionary *header = [NSJSONSerialization JSONObjectWithData:headerData options:0 error:nil];
+    NSDictionary *payload = [NSJSONSerialization JSONObjectWithData:payloadData options:0 error:nil];
+    
+    if (![header isKindOfClass:[NSDictionary class]] || ![payload isKindOfClass:[NSDictionary class]])
+    {
+        return nil;
+    }
+    
+    self = [super init];
+    
+    if (self)
+    {
+        _header = header;
+        _payload = payload;
+        _signature = signatureData;
+        
+        //
+        //  The signing input keeps the token's bytes alive instead of copying them
+        //
+        _signingInput = [[NSData alloc] initWithBytesNoCopy:(void *)bytes length:secondPeriod - bytes deallocator:^(void *buffer, NSUInteger bufferLength) {
+            
+            (void)tokenData;
+        }];
+        
+        id exp = payload[@"exp"];
+        
+        if ([exp isKindOfClass:[NSNumber class]] || [exp isKindOfClass:[NSString class]])
+        {
+            _expirationDate = [NSDate dateWithTimeIntervalSince1970:[exp doubleValue]];
+        }
+    }
+    
+    return self;
+}
+
+
+# pragma mark - Signature
+
+- (BOOL)verifyHS256SignatureWithKey:(NSString *)key
+{
+    const char *cKey = [key cStringUsingEncoding:NSASCIIStringEncoding];
+    
+    if (!cKey || self.signature.length != CC_SHA256_DIGEST_LENGTH)
+    {
+        return NO;
+    }
+    
+    unsigned char cHMAC[CC_SHA256_DIGEST_LENGTH];
+    CCHmac(kCCHmacAlgSHA256, cKey, strlen(cKey), self.signingInput.bytes, self.signingInput.length, cHMAC);
+    
+    //
+    //  Compare all bytes, so that the time taken does not reveal how much of the signature matched
+    //
+    const uint8_t *signatureBytes = self.signature.bytes;
+    uint8_t difference = 0;
+    
+    for (NSUInteger i = 0; i < CC_SHA256_DIGEST_LENGTH; i++)
+    {
+        difference |= signatureBytes[i] ^ cHMAC[i];
+    }
+    
+    return difference == 0;
+}
+
+
+# pragma mark - Private
+
++ (NSData *)dataWithBase64URLBytes:(const uint8_t *)bytes length:(NSUInteger)length
+{
+    //
+    //  Decoding table of the base64url alphabet; the standard alphabet's '+' and '/' are accepted as well
+    //
+    static int8_t decodingTable[256];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        
+        memset(decodingTable, -1, sizeof(decodingTable));
+        
+        const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+        
+        for (int8_t i = 0; i < 64; i++)
+        {
+            decodingTable[(uint8_t)alphabet[i]] = i;
+        }
+        
+        decodingTable['+'] = 62;
+        decodingTable['/'] = 63;
+    });
+    
+    //
+    //  Padding is optional in base64url
+    //
+    while (length > 0 && bytes[length - 1] == '=')
+    {
+        length--;
+    }
+    
+    if (length % 4 == 1)
+    {
+        return nil;
+    }
+    
+    NSMutableData *data = [NSMutableData dataWithLength:length * 3 / 4];
+    uint8_t *output = data.mutableBytes;
+    NSUInteger outputLength = 0;
+    uint32_t accumulator = 0;
+    int bits = 0;
+    
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        int8_t value = decodingTable[bytes[i]];
+        
+        if (value < 0)
+        {
+            return nil;
+        }
+        
+        accumulator = (accumulator << 6) | (uint32_t)value;
+        bits += 6;
+        
+        if (bits >= 8)
+        {
+            bits -= 8;
+            output[outputLength++] = (uint8_t)(accumulator >> bits);
+        }
+    }
+    
+    data.length = outputLength;
+    
+    return data;
+}
+
+@end
@@ -70,15 +70,19 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  *  Decode id_token
  *
+ *  If there is no JWKSet yet, or keyId is not part of it, the completion waits for the JWKSet being loaded.
+ *  An unknown keyId is loaded again only once, as long as the JWKSet was loaded successfully.
+ *
  *  @param token NSString of id_token value
  *  @param keyId NSString of unique identifier of the json web key value
  *  @param skipVerification BOOL value whether JWT signature verification be skipped.
- *
- *  @return NSDictionary of Header and Payload Dictionary.
+ *  @param completion The MASObjectResponseErrorBlock receiving the NSDictionary of Header and Payload Dictionary,
+ *         or nil if the token could not be decoded.
  */
-- (NSDictionary *)decodeToken:(NSString *)token
-                        keyId:(NSString *)keyId
-    skipSignatureVerification:(BOOL)skipVerification error:(NSError *__autoreleasing *)error;
+- (void)decodeToken:(NSString *)token
+              keyId:(NSString *)keyId
+    skipSignatureVerification:(BOOL)skipVerification
+         completion:(MASObjectResponseErrorBlock)completion;
 
 @end
 
@@ -17,7 +17,25 @@
 #import "MASAccessService.h"
 #import "MASConfigurationService.h"
 
-#import "NSURLSession+MASPrivate.h"
+
+//
+//  Time in seconds a JWKSet is used before being loaded again, if the JWKS response has no cache headers
+//
+static NSTimeInterval const MASJWKSetDefaultMaxAge = 24 * 60 * 60;
+
+
+@interface MASJWTService ()
+
+//  YES while the JWKS is being loaded; further loads wait for it instead of starting another request
+@property (nonatomic, assign) BOOL loadingJWKSet;
+
+//  Completion blocks of the loads waiting for the JWKS being loaded
+@property (nonatomic, strong) NSMutableArray<MASCompletionErrorBlock> *loadJWKSetCompletions;
+
+//  Key identifiers a reload was already attempted for, as they were not part of the JWKSet
+@property (nonatomic, strong) NSMutableSet<NSString *> *reloadedKeyIds;
+
+@end
 
 
 @implementation MASJWTService
@@ -116,7 +134,7 @@ static BOOL _enableJWKSetLoading_ = NO;
         if (_enableJWKSetLoading_ ||
             [[currentConfiguration idTokenSignedResponseAlgo] isEqualToString:@"RS256"]) {
 
-            [self loadJWKSAsynchronously:YES completion:nil];
+            [self loadJWKSWithCompletion:nil];
         }
     }
     
@@ -149,150 +167,176 @@ static BOOL _enableJWKSetLoading_ = NO;
 
 # pragma mark - Private
 
-- (void)loadJWKSAsynchronously:(BOOL)async completion:(MASCompletionErrorBlock)completion {
- 
-    //
-    // Endpoint
-    //
-    __block NSString *endPoint = MASJWTOpenIdConfigEndpointKey;
+- (void)loadJWKSWithCompletion:(MASCompletionErrorBlock)completion {
     
     //
-    // Load Asynchronously.
+    // Single-flight: only one JWKS request at a time, concurrent loads are notified when it completes
     //
-    if (async) {
+    @synchronized(self) {
         
-        [[MASNetworkingService sharedService] getFrom:endPoint
-                                       withParameters:nil
-                                           andHeaders:nil
-                                          requestType:MASRequestResponseTypeJson
-                                         responseType:MASRequestResponseTypeJson
-                                             isPublic:YES
-                                      timeoutInterval:MASDefaultNetworkTimeoutConfiguration
-                                           completion:
-         ^(NSDictionary<NSString *,id> * _Nullable responseInfo, NSError * _Nullable error) {
-             
-             if (!responseInfo && error) {
-                 
-                 if (completion) {
-                     
-                     completion(NO, error);
-                 }
-                 
-                 return;
-             }
-             
-             //
-             // JWKS Endpoint
-             //
-             endPoint = responseInfo[MASResponseInfoBodyInfoKey][MASJWTJWKSURIKey];
-             
-             [[MASNetworkingService sharedService] getFrom:endPoint
-                                            withParameters:nil
-                                                andHeaders:nil
-                                               requestType:MASRequestResponseTypeJson
-                                              responseType:MASRequestResponseTypeJson
-                                                  isPublic:YES
-                                           timeoutInterval:MASDefaultNetworkTimeoutConfiguration
-                                                completion:
-              ^(NSDictionary<NSString *,id> * _Nullable responseInfo, NSError * _Nullable error) {
-                  
-                  if (!responseInfo && error) {
-                      
-                      if (completion) {
-                          
-                          completion(NO, error);
-                      }
-                      
-                      return;
-                  }
-                  
-                  _currentJWKSet = [[MASJWKSet alloc] initWithJWKSetInfo:responseInfo[MASResponseInfoBodyInfoKey]];
-                  
-                  //
-                  // If created then store it to local storage
-                  //
-                  if(_currentJWKSet)
-                  {
-                      [_currentJWKSet saveToStorage];
-                  }
-                  
-                  if (completion) {
-                      
-                      completion(YES, nil);
-                  }
-                  
-                  return;
-              }];
-         }];
+        if (!self.loadJWKSetCompletions) {
+            
+            self.loadJWKSetCompletions = [NSMutableArray array];
+        }
+        
+        if (completion) {
+            
+            [self.loadJWKSetCompletions addObject:[completion copy]];
+        }
+        
+        if (self.loadingJWKSet) {
+            
+            return;
+        }
+        
+        self.loadingJWKSet = YES;
     }
-    //
-    // Load Synchronously.
-    //
-    else {
+    
+    __block MASJWTService *blockSelf = self;
+    [self requestJWKSetWithCompletion:^(NSDictionary<NSString *,id> * _Nullable responseInfo, NSError * _Nullable error) {
+        
+        if (!responseInfo && error) {
+            
+            [blockSelf finishLoadingJWKSWithSuccess:NO error:error];
+            
+            return;
+        }
         
         //
-        // Adding prefix to the endpoint path
+        // Public keys are extracted once here, on the networking queue, instead of on every token validation.
+        // The JWKSet saves itself to local storage when initialized.
         //
-        if ([MASConfiguration currentConfiguration].gatewayPrefix &&
-            ![endPoint hasPrefix:@"http://"] &&
-            ![endPoint hasPrefix:@"https://"])
+        MASJWKSet *jwkSet = [[MASJWKSet alloc] initWithJWKSetInfo:responseInfo[MASResponseInfoBodyInfoKey]];
+        jwkSet.expirationDate = [MASJWTService expirationDateWithHeaders:responseInfo[MASResponseInfoHeaderInfoKey]];
+        
+        if (jwkSet)
         {
-            endPoint = [NSString stringWithFormat:@"%@%@",[MASConfiguration currentConfiguration].gatewayPrefix, endPoint];
+            @synchronized(blockSelf) {
+                
+                _currentJWKSet = jwkSet;
+            }
         }
+        
+        [blockSelf finishLoadingJWKSWithSuccess:(jwkSet != nil) error:nil];
+    }];
+}
 
-        //
-        // Full URL path
-        //
-        NSURL *url = [NSURL URLWithString:endPoint relativeToURL:[MASConfiguration currentConfiguration].gatewayUrl];
+
+- (void)requestJWKSetWithCompletion:(MASResponseInfoErrorBlock)completion {
+    
+    //
+    // Endpoint
+    //
+    __block NSString *endPoint = MASJWTOpenIdConfigEndpointKey;
+    
+    [[MASNetworkingService sharedService] getFrom:endPoint
+                                   withParameters:nil
+                                       andHeaders:nil
+                                      requestType:MASRequestResponseTypeJson
+                                     responseType:MASRequestResponseTypeJson
+                                         isPublic:YES
+                                  timeoutInterval:MASDefaultNetworkTimeoutConfiguration
+                                       completion:
+     ^(NSDictionary<NSString *,id> * _Nullable responseInfo, NSError * _Nullable error) {
+         
+         if (!responseInfo && error) {
+             
+             completion(nil, error);
+             
+             return;
+         }
+         
+         //
+         // JWKS Endpoint
+         //
+         endPoint = responseInfo[MASResponseInfoBodyInfoKey][MASJWTJWKSURIKey];
+         
+         [[MASNetworkingService sharedService] getFrom:endPoint
+                                        withParameters:nil
+                                            andHeaders:nil
+                                           requestType:MASRequestResponseTypeJson
+                                          responseType:MASRequestResponseTypeJson
+                                              isPublic:YES
+                                       timeoutInterval:MASDefaultNetworkTimeoutConfiguration
+                                            completion:completion];
+     }];
+}
+
+
+- (void)finishLoadingJWKSWithSuccess:(BOOL)success error:(NSError *)error {
+    
+    NSArray<MASCompletionErrorBlock> *completions = nil;
+    
+    @synchronized(self) {
         
-        NSAssert(url, @"URL cannot be nil");
+        completions = [self.loadJWKSetCompletions copy];
+        [self.loadJWKSetCompletions removeAllObjects];
+        self.loadingJWKSet = NO;
+    }
+    
+    for (MASCompletionErrorBlock completion in completions) {
         
-        NSDictionary *responseInfo = [NSURLSession requestSynchronousJSONWithURLString:[url absoluteString]];
+        completion(success, error);
+    }
+}
+
+
++ (NSDate *)expirationDateWithHeaders:(NSDictionary *)headers {
+    
+    NSString *cacheControl = nil;
+    NSString *expires = nil;
+    
+    for (NSString *key in headers) {
         
-        if (!responseInfo) {
+        if ([key caseInsensitiveCompare:@"Cache-Control"] == NSOrderedSame) {
             
-            if (completion) {
-                
-                completion(NO, nil);
-            }
+            cacheControl = [headers[key] lowercaseString];
+        }
+        else if ([key caseInsensitiveCompare:@"Expires"] == NSOrderedSame) {
             
-            return;
+            expires = headers[key];
         }
+    }
+    
+    //
+    // Cache-Control takes precedence over Expires
+    //
+    if (cacheControl) {
         
-        //
-        // Endpoint
-        //
-        endPoint = responseInfo[MASJWTJWKSURIKey];
-        
-        responseInfo = [NSURLSession requestSynchronousJSONWithURLString:endPoint];
+        if ([cacheControl containsString:@"no-cache"] || [cacheControl containsString:@"no-store"]) {
+            
+            return [NSDate date];
+        }
         
-        if (!responseInfo) {
+        for (NSString *directive in [cacheControl componentsSeparatedByString:@","]) {
+            
+            NSString *trimmedDirective = [directive stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
             
-            if (completion) {
+            if ([trimmedDirective hasPrefix:@"max-age="]) {
                 
-                completion(NO, nil);
+                NSTimeInterval maxAge = [[trimmedDirective substringFromIndex:[@"max-age=" length]] doubleValue];
+                
+                return [NSDate dateWithTimeIntervalSinceNow:MAX(maxAge, 0)];
             }
-            
-            return;
         }
+    }
+    
+    if (expires) {
         
-        _currentJWKSet = [[MASJWKSet alloc] initWithJWKSetInfo:responseInfo];
+        NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
+        dateFormatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        dateFormatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        dateFormatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss zzz";
         
-        //
-        // If created then store it to local storage
-        //
-        if(_currentJWKSet)
-        {
-            [_currentJWKSet saveToStorage];
-        }
+        NSDate *expirationDate = [dateFormatter dateFromString:expires];
         
-        if (completion) {
+        if (expirationDate) {
             
-            completion(YES, nil);
+            return expirationDate;
         }
-        
-        return;
     }
+    
+    return [NSDate dateWithTimeIntervalSinceNow:MASJWKSetDefaultMaxAge];
 }
 
 
@@ -302,88 +346,133 @@ static BOOL _enableJWKSetLoading_ = NO;
 
 #pragma mark - Token Validation
 
-- (NSDictionary *)decodeToken:(NSString *)token
-                        keyId:(NSString *)keyId
+- (void)decodeToken:(NSString *)token
+              keyId:(NSString *)keyId
     skipSignatureVerification:(BOOL)skipVerification
-                        error:(NSError *__autoreleasing *)error {
+         completion:(MASObjectResponseErrorBlock)completion {
     
-    //
-    // If no locally stored JWKS is found.
-    // Start loading JWKS synchronously.
-    //
-    if (!self.currentJWKSet) {
+    MASJWKSet *jwkSet = nil;
+    
+    @synchronized(self) {
         
-        [self loadJWKSAsynchronously:NO completion:nil];
+        jwkSet = _currentJWKSet;
     }
     
+    BOOL expired = (!jwkSet || !jwkSet.expirationDate || [jwkSet.expirationDate timeIntervalSinceNow] <= 0);
+    
+    //
+    // Public key of the Json Web Key of keyId.
+    //
+    id<JWTCryptoKeyProtocol> key = [jwkSet publicKeyForKeyId:keyId];
+    
     //
-    // Extract the x509 cert chain for Json Web Key of keyId.
+    // A known key is used right away; if the JWKS cache lifetime is over, it is loaded again in the background.
     //
-    NSArray *x5c = nil;
-    NSArray *JWKeys = [self.currentJWKSet jsonWebKeys];
-    for (NSDictionary *JWKey in JWKeys) {
+    if (key) {
         
-        if ([keyId isEqualToString:JWKey[@"kid"]]) {
+        if (expired) {
             
-            x5c = JWKey[@"x5c"];
-            break;
+            [self loadJWKSWithCompletion:nil];
         }
+        
+        completion([self decodeToken:token key:key skipSignatureVerification:skipVerification], nil);
+        
+        return;
     }
     
     //
-    // If no x509 cert chain return nil.
+    // Without a current JWKS the token waits for it to be loaded. If the key is unknown, the keys may have been rotated;
+    // the JWKS is loaded again only once for the keyId, so that tokens of unknown keys cannot cause a request each.
     //
-    if (!x5c) return nil;
+    BOOL reload = NO;
+    BOOL reloadForKeyId = NO;
+    
+    @synchronized(self) {
+        
+        if (!self.reloadedKeyIds) {
+            
+            self.reloadedKeyIds = [NSMutableSet set];
+        }
+        
+        if (expired) {
+            
+            reload = YES;
+        }
+        else if (keyId && ![self.reloadedKeyIds containsObject:keyId]) {
+            
+            [self.reloadedKeyIds addObject:keyId];
+            reload = reloadForKeyId = YES;
+        }
+    }
     
+    if (!reload) {
+        
+        completion(nil, nil);
+        
+        return;
+    }
+    
+    __block MASJWTService *blockSelf = self;
+    [self loadJWKSWithCompletion:^(BOOL completed, NSError * _Nullable error) {
+        
+        //
+        // A failed load did not show whether keyId is part of the JWKS; the next token of the keyId tries again
+        //
+        if (!completed) {
+            
+            if (reloadForKeyId) {
+                
+                @synchronized(blockSelf) {
+                    
+                    [blockSelf.reloadedKeyIds removeObject:keyId];
+                }
+            }
+            
+            completion(nil, error);
+            
+            return;
+        }
+        
+        MASJWKSet *loadedJWKSet = nil;
+        
+        @synchronized(blockSelf) {
+            
+            loadedJWKSet = blockSelf.currentJWKSet;
+        }
+        
+        id<JWTCryptoKeyProtocol> loadedKey = [loadedJWKSet publicKeyForKeyId:keyId];
+        
+        completion(loadedKey ? [blockSelf decodeToken:token key:loadedKey skipSignatureVerification:skipVerification] : nil, nil);
+    }];
+}
+
+
+- (NSDictionary *)decodeToken:(NSString *)token
+                          key:(id<JWTCryptoKeyProtocol>)key
+    skipSignatureVerification:(BOOL)skipVerification {
     
     //
     // JWT Algorithm = RS256.
     //
     NSString *algorithmName = @"RS256";
     
-    NSError *theError = nil;
     id<JWTAlgorithm> algorithm = [JWTAlgorithmFactory algorithmByName:algorithmName];
     if (!algorithm) {
         return nil;
     }
     
     //
-    // Extract JWT Public Key.
+    // JWT Public Key.
     //
     id<JWTAlgorithmDataHolderProtocol> holder = nil;
     if ([algorithm isKindOfClass:[JWTAlgorithmRSBase class]] || [algorithm.name hasPrefix:@"RS"]) {
         
-        //
-        //  Use x5c[0] of chain.
-        //
-        NSData *certData =
-            [[NSData alloc] initWithBase64EncodedString:x5c[0] options:NSDataBase64DecodingIgnoreUnknownCharacters];
-        
-        NSError *keyError = nil;
-        id<JWTCryptoKeyProtocol>key = [[JWTCryptoKeyPublic alloc] initWithCertificateData:certData parameters:nil error:&keyError];
-        
-        theError = keyError;
-        if (!theError) {
-            holder = [JWTAlgorithmRSFamilyDataHolder new].verifyKey(key).algorithmName(algorithmName).secretData([NSData new]);
-        }
+        holder = [JWTAlgorithmRSFamilyDataHolder new].verifyKey(key).algorithmName(algorithmName).secretData([NSData new]);
     }
     else if ([algorithm isKindOfClass:[JWTAlgorithmNone class]]) {
         holder = [JWTAlgorithmNoneDataHolder new];
     }
     
-    //
-    // JWT error out.
-    //
-    if (theError) {
-        //DSLog(@"JWT internalError: %@", theError);
-        
-        if (error) {
-            *error = theError;
-        }
-        
-        return nil;
-    }
-    
     //
     // Decode id_token.
     //
@@ -66,6 +66,15 @@ typedef NS_ENUM(NSInteger, MASLocationServiceStatus)
 @property (assign, setter=setLocationUpdateInterval:, getter=getLocationUpdateInterval) NSTimeInterval locationUpdateInterval;
 
 
+/**
+ NSString of the most recent location formatted for the geo-location request header; nil if the location is not available,
+ the configuration does not require location, or the location was not updated for two location update intervals (at least 10 minutes).
+ The value is only reformatted when the location moves beyond a distance threshold, or the previous value becomes older than a time threshold,
+ so that it can be read on every request without querying the location service.
+ */
+@property (atomic, copy, readonly) NSString *geoLocationHeaderValue;
+
+
 
 ///--------------------------------------
 /// @name Public
@@ -80,4 +89,14 @@ typedef NS_ENUM(NSInteger, MASLocationServiceStatus)
  */
 - (MASLocationServiceStatus)locationServiceStatus;
 
+
+
+/**
+ Requests a fresh location fix, and notifies the completion block once the location is updated or failed to update.
+ All callers while a location fix is in-flight share the same location request.
+
+ @param completion The completion block that receives the geo-location header value; nil if the location is not available.
+ */
+- (void)refreshLocationWithCompletion:(void (^)(NSString *geoLocationHeaderValue))completion;
+
 @end
@@ -14,13 +14,19 @@
 #import "MASConfigurationService.h"
 
 static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
+static CLLocationDistance const kMASLocationServiceHeaderDistanceThreshold = 100;
+static NSTimeInterval const kMASLocationServiceHeaderTimeThreshold = 60;
+static NSTimeInterval const kMASLocationServiceHeaderMaximumAge = 600;
 
 @interface MASLocationService () <CLLocationManagerDelegate>
 
 @property (nonatomic, strong) CLLocationManager *locationManager;
-@property (nonatomic, strong) NSDate *lastKnownLocationTime;
+@property (atomic, strong) NSDate *lastKnownLocationTime;
 @property (nonatomic, strong) NSTimer *locationTimer;
 @property (assign) BOOL didFailToAuthorize;
+@property (atomic, copy) NSString *formattedGeoLocationHeaderValue;
+@property (atomic, strong) CLLocation *geoLocationHeaderLocation;
+@property (nonatomic, strong) NSMutableArray *locationRefreshBlocks;
 
 @end
 
@@ -132,7 +138,13 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
     [self stopSchedulingLocationUpdate];
     
     _lastKnownLocation = nil;
-    _lastKnownLocationTime = nil;
+    self.lastKnownLocationTime = nil;
+    [self updateGeoLocationHeaderWithLocation:nil];
+    
+    //
+    //  Release any request waiting for the location fix
+    //
+    [self completeLocationRefresh];
 }
 
 
@@ -153,6 +165,19 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
 {
     _lastKnownLocation = [locations firstObject];
     self.lastKnownLocationTime = [NSDate date];
+    
+    //
+    //  Only reformat the header value when the location has moved, or the header value is stale
+    //
+    CLLocation *headerLocation = self.geoLocationHeaderLocation;
+    if (_lastKnownLocation && (!headerLocation ||
+                               [_lastKnownLocation distanceFromLocation:headerLocation] >= kMASLocationServiceHeaderDistanceThreshold ||
+                               [_lastKnownLocation.timestamp timeIntervalSinceDate:headerLocation.timestamp] >= kMASLocationServiceHeaderTimeThreshold))
+    {
+        [self updateGeoLocationHeaderWithLocation:_lastKnownLocation];
+    }
+    
+    [self completeLocationRefresh];
 }
 
 
@@ -165,6 +190,7 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
     {
         _lastKnownLocation = nil;
         self.lastKnownLocationTime = nil;
+        [self updateGeoLocationHeaderWithLocation:nil];
     }
     
     if (error.domain == kCLErrorDomain && error.code == kCLErrorDenied)
@@ -173,7 +199,10 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
         //  If the permission denied during runtime, stop the scheduler
         //
         [self stopSchedulingLocationUpdate];
+        [self updateGeoLocationHeaderWithLocation:nil];
     }
+    
+    [self completeLocationRefresh];
 }
 
 
@@ -187,6 +216,11 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
             break;
         case kCLAuthorizationStatusDenied:
         case kCLAuthorizationStatusRestricted:
+            //
+            //  Location must not be sent once the authorization is revoked
+            //
+            [self updateGeoLocationHeaderWithLocation:nil];
+            break;
         case kCLAuthorizationStatusNotDetermined:
         default:
             break;
@@ -258,6 +292,30 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
 }
 
 
+- (void)updateGeoLocationHeaderWithLocation:(CLLocation *)location
+{
+    self.geoLocationHeaderLocation = location;
+    self.formattedGeoLocationHeaderValue = location ? [location locationAsGeoCoordinates] : nil;
+}
+
+
+- (void)completeLocationRefresh
+{
+    NSArray *locationRefreshBlocks = nil;
+    
+    @synchronized (self) {
+        locationRefreshBlocks = [self.locationRefreshBlocks copy];
+        [self.locationRefreshBlocks removeAllObjects];
+    }
+    
+    NSString *geoLocationHeaderValue = self.geoLocationHeaderValue;
+    for (void (^locationRefreshBlock)(NSString *) in locationRefreshBlocks)
+    {
+        locationRefreshBlock(geoLocationHeaderValue);
+    }
+}
+
+
 - (NSString *)locationServiceStatusAsString
 {
     NSString *statusAsString = @"";
@@ -348,6 +406,30 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
 }
 
 
+- (NSString *)geoLocationHeaderValue
+{
+    //
+    //  Location is only sent when the configuration requires it
+    //
+    if (![MASConfiguration currentConfiguration].locationIsRequired)
+    {
+        return nil;
+    }
+    
+    //
+    //  A location which was not updated for two update intervals is no longer the location of the device; location updates may have stopped
+    //
+    NSDate *lastKnownLocationTime = self.lastKnownLocationTime;
+    NSTimeInterval maximumAge = MAX(kMASLocationServiceHeaderMaximumAge, 2 * _locationUpdateInterval);
+    if (!lastKnownLocationTime || -[lastKnownLocationTime timeIntervalSinceNow] > maximumAge)
+    {
+        return nil;
+    }
+    
+    return self.formattedGeoLocationHeaderValue;
+}
+
+
 - (void)setLocationAccuracy:(CLLocationAccuracy)locationAccuracy
 {
     _locationAccuracy = locationAccuracy;
@@ -381,6 +463,47 @@ static NSTimeInterval const kMASLocationServiceTimerInterval = 300;
 }
 
 
+- (void)refreshLocationWithCompletion:(void (^)(NSString *geoLocationHeaderValue))completion
+{
+    if (!completion)
+    {
+        return;
+    }
+    
+    //
+    //  Location fix cannot be requested; return whatever is currently available
+    //
+    if (![MASConfiguration currentConfiguration].locationIsRequired || _locationManager == nil || self.didFailToAuthorize)
+    {
+        completion(self.geoLocationHeaderValue);
+        return;
+    }
+    
+    BOOL shouldRequestLocation = NO;
+    
+    @synchronized (self) {
+        
+        if (!self.locationRefreshBlocks)
+        {
+            self.locationRefreshBlocks = [NSMutableArray array];
+        }
+        
+        //
+        //  Only the first caller requests the location; others wait for the same location fix
+        //
+        shouldRequestLocation = ([self.locationRefreshBlocks count] == 0);
+        [self.locationRefreshBlocks addObject:[completion copy]];
+    }
+    
+    if (shouldRequestLocation)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self.locationManager requestLocation];
+        });
+    }
+}
+
+
 - (MASLocationServiceStatus)locationServiceStatus
 {
     MASLocationServiceStatus status = MASLocationServiceStatusAvailable;
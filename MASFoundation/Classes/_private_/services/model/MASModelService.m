@@ -2012,50 +2012,62 @@ static id<MASBrowserBasedAuthenticationConfigurationInterface> _browserBasedAuth
                                           {
                                               
                                               //
-                                              // DE509848 - During server maintenance timeframe,
-                                              // when token refresh calls returns 500, MAS library logout the user.
+                                              // Continues unless the refresh_token is kept on a server error
                                               //
-                                              if ([MAS isDonotLogoutTokenRenewalOnServerErrors] && httpResponse.statusCode == 500)  {
-                                                  
-                                                  NSError *idTokenValidationError = nil;
-                                                  BOOL isIdTokenValid = [MASAccessService validateIdToken:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyIdToken]
-                                                                                            magIdentifier:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyMAGIdentifier]
-                                                                                                    error:&idTokenValidationError];
+                                              void (^handleError)(void) = ^{
                                                   
-                                                  NSString *refreshToken =
-                                                    [MASAccessService sharedService].currentAccessObj.refreshToken;
-                                                  if (refreshToken && isIdTokenValid && !idTokenValidationError)
-                                                  {
-                                                      if (blockCompletion) {
+                                                  //
+                                                  // If authenticate user with refresh_token, we should invalidate local refresh_token, and re-validate the user's session with alternative method.
+                                                  //
+                                                  if (headerInfo[MASHeaderInfoErrorKey] && !bodayInfo[MASAccessTokenRequestResponseKey]) {
+                                                      
+                                                      [[MASAccessService sharedService] setAccessValueString:nil storageKey:MASKeychainStorageKeyRefreshToken];
+                                                      [[MASAccessService sharedService].currentAccessObj refresh];
+                                                      
+                                                      [blockSelf validateCurrentUserSession:completion];
                                                       
-                                                          blockCompletion(NO, error);
-                                                      }
-                                                  
                                                       return;
                                                   }
-                                              }
+                                                  
+                                                  //
+                                                  // If not server error
+                                                  // Do not invalidate refresh_token and re-validate.
+                                                  //
+                                                  if (blockCompletion)
+                                                  {
+                                                      blockCompletion(NO, error);
+                                                  }
+                                              };
                                               
                                               //
-                                              // If authenticate user with refresh_token, we should invalidate local refresh_token, and re-validate the user's session with alternative method.
+                                              // DE509848 - During server maintenance timeframe,
+                                              // when token refresh calls returns 500, MAS library logout the user.
                                               //
-                                              if (headerInfo[MASHeaderInfoErrorKey] && !bodayInfo[MASAccessTokenRequestResponseKey]) {
-                                                  
-                                                  [[MASAccessService sharedService] setAccessValueString:nil storageKey:MASKeychainStorageKeyRefreshToken];
-                                                  [[MASAccessService sharedService].currentAccessObj refresh];
+                                              NSString *refreshToken = [MASAccessService sharedService].currentAccessObj.refreshToken;
+                                              
+                                              if ([MAS isDonotLogoutTokenRenewalOnServerErrors] && httpResponse.statusCode == 500 && refreshToken)  {
                                                   
-                                                  [blockSelf validateCurrentUserSession:completion];
+                                                  [MASAccessService validateIdToken:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyIdToken]
+                                                                      magIdentifier:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyMAGIdentifier]
+                                                                         completion:^(BOOL isIdTokenValid, NSError * _Nullable idTokenValidationError) {
+                                                      
+                                                      if (isIdTokenValid && !idTokenValidationError)
+                                                      {
+                                                          if (blockCompletion) {
+                                                          
+                                                              blockCompletion(NO, error);
+                                                          }
+                                                      
+                                                          return;
+                                                      }
+                                                      
+                                                      handleError();
+                                                  }];
                                                   
                                                   return;
                                               }
                                               
-                                              //
-                                              // If not server error
-                                              // Do not invalidate refresh_token and re-validate.
-                                              //
-                                              if (blockCompletion)
-                                              {
-                                                  blockCompletion(NO, error);
-                                              }
+                                              handleError();
                                               
                                               return;
                                           }
@@ -2067,60 +2079,71 @@ static id<MASBrowserBasedAuthenticationConfigurationInterface> _browserBasedAuth
                                           [[MASAccessService sharedService].currentAccessObj deletePKCEState];
                                           
                                           //
-                                          // Validate id_token when received from server.
+                                          // Continues once the id_token, if any, was validated
                                           //
-                                          if ([bodayInfo objectForKey:MASIdTokenBodyRequestResponseKey] &&
-                                              [bodayInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] &&
-                                              [[bodayInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] isEqualToString:MASIdTokenTypeToValidateConstant] &&
-                                              [MASConfigurationService isIdTokenValidationEnabled])
-                                          {
-                                              NSError *idTokenValidationError = nil;
-                                              BOOL isIdTokenValid = [MASAccessService validateIdToken:[bodayInfo objectForKey:MASIdTokenBodyRequestResponseKey]
-                                                                                        magIdentifier:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyMAGIdentifier]
-                                                                                                error:&idTokenValidationError];
+                                          void (^finishAuthentication)(void) = ^{
                                               
-                                              if (!isIdTokenValid && idTokenValidationError)
-                                              {
+                                              //
+                                              // Update the current user
+                                              //
+                                              [_currentUser saveWithUpdatedInfo:responseInfo];
+                                              
+                                              //
+                                              // Post the notification
+                                              //
+                                              [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidAuthenticateNotification object:blockSelf];
+                                              
+                                              [self requestUserInfoWithCompletion:^(MASUser *user, NSError *error) {
+                                                  
                                                   //
-                                                  // Post the notification
+                                                  // Requesting additional userInfo upon successful authentication
+                                                  // and do not depend on the result of userInfo call.
+                                                  // This a workaround to fix other frameworks' dependency issue on userInfo.
+                                                  // James Go @ April 4, 2016
                                                   //
-                                                  [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidFailToAuthenticateNotification object:blockSelf];
                                                   
+                                                  //
+                                                  // Notify
+                                                  //
                                                   if (blockCompletion)
                                                   {
-                                                      blockCompletion(NO, idTokenValidationError);
-                                                      return;
+                                                      blockCompletion(YES, nil);
                                                   }
-                                              }
-                                          }
-                                          
-                                          //
-                                          // Update the current user
-                                          //
-                                          [_currentUser saveWithUpdatedInfo:responseInfo];
+                                              }];
+                                          };
                                           
                                           //
-                                          // Post the notification
+                                          // Validate id_token when received from server.
                                           //
-                                          [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidAuthenticateNotification object:blockSelf];
-                                          
-                                          [self requestUserInfoWithCompletion:^(MASUser *user, NSError *error) {
-                                              
-                                              //
-                                              // Requesting additional userInfo upon successful authentication
-                                              // and do not depend on the result of userInfo call.
-                                              // This a workaround to fix other frameworks' dependency issue on userInfo.
-                                              // James Go @ April 4, 2016
-                                              //
-                                              
-                                              //
-                                              // Notify
-                                              //
-                                              if (blockCompletion)
-                                              {
-                                                  blockCompletion(YES, nil);
-                                              }
-                                          }];
+                                          if ([bodayInfo objectForKey:MASIdTokenBodyRequestResponseKey] &&
+                                              [bodayInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] &&
+                                              [[bodayInfo objectForKey:MASIdTokenTypeBodyRequestResponseKey] isEqualToString:MASIdTokenTypeToValidateConstant] &&
+                                              [MASConfigurationService isIdTokenValidationEnabled])
+                                          {
+                                              [MASAccessService validateIdToken:[bodayInfo objectForKey:MASIdTokenBodyRequestResponseKey]
+                                                                  magIdentifier:[[MASAccessService sharedService] getAccessValueStringWithStorageKey:MASKeychainStorageKeyMAGIdentifier]
+                                                                     completion:^(BOOL isIdTokenValid, NSError * _Nullable idTokenValidationError) {
+                                                  
+                                                  if (!isIdTokenValid && idTokenValidationError)
+                                                  {
+                                                      //
+                                                      // Post the notification
+                                                      //
+                                                      [[NSNotificationCenter defaultCenter] postNotificationName:MASUserDidFailToAuthenticateNotification object:blockSelf];
+                                                      
+                                                      if (blockCompletion)
+                                                      {
+                                                          blockCompletion(NO, idTokenValidationError);
+                                                          return;
+                                                      }
+                                                  }
+                                                  
+                                                  finishAuthentication();
+                                              }];
+                                          }
+                                          else {
+                                              finishAuthentication();
+                                          }
                                       }];
 }
 
@@ -0,0 +1,33 @@
+//
+//  MASGatewayReachabilityOperation.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface MASGatewayReachabilityOperation : NSOperation
+
+@property (assign) BOOL result;
+@property (nonatomic, strong) NSError *error;
+@property (assign, readonly) NSUInteger pendingOperationCount;
+
+
+/**
+ Creates an operation which finishes once the gateway endpoint is reachable, or fails after the maximum wait interval.
+ Requests held until the gateway is reachable depend on one such operation; each call returns a new operation.
+
+ @param maximumWaitInterval NSTimeInterval to wait for the gateway to become reachable; 0 fails right away if the gateway is not reachable.
+ @return MASGatewayReachabilityOperation object created.
+ */
++ (instancetype)operationWithMaximumWaitInterval:(NSTimeInterval)maximumWaitInterval;
+
+- (void)addPendingOperation;
+
+- (void)removePendingOperation;
+
+@end
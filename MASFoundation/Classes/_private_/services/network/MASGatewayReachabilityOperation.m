@@ -0,0 +1,200 @@
+//
+//  MASGatewayReachabilityOperation.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASGatewayReachabilityOperation.h"
+
+#import "MASNetworkingService.h"
+#import "NSError+MASPrivate.h"
+
+@interface MASGatewayReachabilityOperation ()
+
+@property (nonatomic, readwrite, getter = isFinished)  BOOL finished;
+@property (nonatomic, readwrite, getter = isExecuting) BOOL executing;
+@property (assign) NSTimeInterval maximumWaitInterval;
+@property (assign, readwrite) NSUInteger pendingOperationCount;
+
+@end
+
+
+@implementation MASGatewayReachabilityOperation
+
+@synthesize executing = _executing;
+@synthesize finished  = _finished;
+
+
+# pragma mark - Lifecycle
+
++ (instancetype)operationWithMaximumWaitInterval:(NSTimeInterval)maximumWaitInterval
+{
+    MASGatewayReachabilityOperation *operation = [[self alloc] init];
+    operation.maximumWaitInterval = maximumWaitInterval;
+    return operation;
+}
+
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+
+# pragma mark - Pending operations
+
+- (void)addPendingOperation
+{
+    @synchronized (self) {
+        self.pendingOperationCount++;
+    }
+}
+
+
+- (void)removePendingOperation
+{
+    @synchronized (self) {
+        
+        if (self.pendingOperationCount > 0)
+        {
+            self.pendingOperationCount--;
+        }
+    }
+}
+
+
+# pragma mark - NSNotification
+
+- (void)didReceiveGatewayStatusUpdate:(NSNotification *)notification
+{
+    //
+    //  Any of the primary gateway, or the alternate gateway endpoints, may have changed; requests are sent to the selected endpoint
+    //
+    if (![self gatewayEndpointIsNotReachable])
+    {
+        //
+        //  Gateway became reachable; release all operations on hold
+        //
+        [self completeOperationWithResult:YES error:nil];
+    }
+}
+
+
+# pragma mark - NSOperation methods
+
+- (void)start
+{
+    if ([self isCancelled])
+    {
+        [self setFinished:YES];
+        return;
+    }
+    
+    [self setExecuting:YES];
+    
+    //
+    //  Gateway may have become reachable while the operation was enqueued
+    //
+    if (![self gatewayEndpointIsNotReachable])
+    {
+        [self completeOperationWithResult:YES error:nil];
+        return;
+    }
+    
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(didReceiveGatewayStatusUpdate:) name:MASGatewayMonitorStatusUpdateNotification object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(didReceiveGatewayStatusUpdate:) name:MASNetworkReachabilityStatusUpdateNotification object:nil];
+    
+    //
+    //  Fail all operations on hold, if the gateway does not become reachable within the maximum wait interval
+    //
+    __block MASGatewayReachabilityOperation *blockSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.maximumWaitInterval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [blockSelf completeOperationWithResult:NO error:[NSError errorNetworkNotReachable]];
+    });
+}
+
+
+- (void)cancel
+{
+    [super cancel];
+    
+    if (self.isExecuting)
+    {
+        [self completeOperationWithResult:NO error:nil];
+    }
+}
+
+
+- (void)completeOperation
+{
+    [self setExecuting:NO];
+    [self setFinished:YES];
+}
+
+
+- (BOOL)isConcurrent
+{
+    return YES;
+}
+
+
+- (void)setExecuting:(BOOL)executing
+{
+    if (executing != _executing) {
+        [self willChangeValueForKey:@"isExecuting"];
+        _executing = executing;
+        [self didChangeValueForKey:@"isExecuting"];
+    }
+}
+
+
+- (void)setFinished:(BOOL)finished
+{
+    if (finished != _finished) {
+        [self willChangeValueForKey:@"isFinished"];
+        _finished = finished;
+        [self didChangeValueForKey:@"isFinished"];
+    }
+}
+
+
+# pragma mark - NSObject
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p, executing: %@, cancelled: %@, finished: %@, pending: %lu>", NSStringFromClass([self class]), self, self.isExecuting ? @"YES":@"NO", [self isCancelled] ? @"YES":@"NO", self.isFinished ? @"YES":@"NO", (unsigned long)self.pendingOperationCount];
+}
+
+
+# pragma mark - Private
+
+- (BOOL)gatewayEndpointIsNotReachable
+{
+    return [[MASNetworkingService sharedService] gatewayEndpointIsNotReachable];
+}
+
+
+- (void)completeOperationWithResult:(BOOL)result error:(NSError *)error
+{
+    @synchronized (self) {
+        
+        //
+        //  Only if the operation is still being executed; reachability update and maximum wait interval may race each other
+        //
+        if (self.isExecuting && !self.isFinished)
+        {
+            [[NSNotificationCenter defaultCenter] removeObserver:self name:MASGatewayMonitorStatusUpdateNotification object:nil];
+            [[NSNotificationCenter defaultCenter] removeObserver:self name:MASNetworkReachabilityStatusUpdateNotification object:nil];
+            
+            self.result = result;
+            self.error = error;
+            [self completeOperation];
+        }
+    }
+}
+
+@end
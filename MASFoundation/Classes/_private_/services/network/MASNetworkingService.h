@@ -13,6 +13,7 @@
 #import "MASMultiFactorAuthenticator.h"
 #import "MASObject.h"
 #import "MASAuthValidationOperation.h"
+#import "MASGatewayReachabilityOperation.h"
 
 typedef NSURLRequest* (^MASSessionDataTaskHTTPRedirectBlock)(NSURLSession *session, NSURLSessionTask *task, NSURLResponse *response, NSURLRequest *request);
 
@@ -162,6 +163,24 @@ typedef NSURLRequest* (^MASSessionDataTaskHTTPRedirectBlock)(NSURLSession *sessi
 - (BOOL)networkIsReachable;
 
 
+/**
+ * Retrieves a simple boolean indicator if the network is known to be not reachable.
+ * Unlike networkIsReachable, this returns NO while the reachability status has not been determined yet.
+ *
+ * @return Returns YES if it is not reachable, NO if it is reachable or unknown.
+ */
+- (BOOL)networkIsNotReachable;
+
+
+/**
+ * Retrieves a simple boolean indicator if the gateway endpoint that requests are sent to is known to be not reachable.
+ * This is the selected endpoint if alternate gateways are configured, and the primary gateway otherwise.
+ *
+ * @return Returns YES if it is not reachable, NO if it is reachable or unknown.
+ */
+- (BOOL)gatewayEndpointIsNotReachable;
+
+
 /**
  * Retrieves the current monitoring status of the network connection.
  *
@@ -855,7 +874,7 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
 
 # pragma mark - HTTP File Requests
 
-- (void)postMultiPartForm:(NSString*)endPoint withParameters:(NSDictionary *)parameterInfo andHeaders:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic timeoutInterval:(NSTimeInterval)timeoutInterval constructingBodyBlock:(nonnull MASMultiPartFormDataBlock)formDataBlock progress:(MASFileRequestProgressBlock)progress taskBlock:(MASDataTaskBlock)taskBlock completion:(MASResponseObjectErrorBlock)completion;
+- (void)postMultiPartForm:(NSString*)endPoint withParameters:(NSDictionary *)parameterInfo andHeaders:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic timeoutInterval:(NSTimeInterval)timeoutInterval compressRequestBody:(BOOL)compressRequestBody constructingBodyBlock:(nonnull MASMultiPartFormDataBlock)formDataBlock progress:(MASFileRequestProgressBlock)progress taskBlock:(MASDataTaskBlock)taskBlock completion:(MASResponseObjectErrorBlock)completion;
 
 @end
 
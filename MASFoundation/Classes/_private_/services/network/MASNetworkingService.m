@@ -28,6 +28,7 @@
 #import "MASPutURLRequest.h"
 #import "MASSecurityPolicy.h"
 #import "MASNetworkReachability.h"
+#import "MASGatewayEndpointSelector.h"
 #import "MASMultiFactorHandler+MASPrivate.h"
 #import "MASMultiPartRequestSerializer.h"
 #import "MASDataTask+MASPrivate.h"
@@ -62,7 +63,9 @@ NSString *const MASGatewayMonitoringStatusReachableViaWiFiValue = @"Reachable Vi
 
 @property (nonatomic, strong, readwrite) MASURLSessionManager *sessionManager;
 @property (nonatomic, strong, readwrite) MASNetworkReachability *gatewayReachabilityManager;
+@property (nonatomic, strong, readwrite) MASGatewayEndpointSelector *gatewayEndpointSelector;
 @property (readwrite, nonatomic, strong) MASAuthValidationOperation *authValidationOperation;
+@property (readwrite, nonatomic, strong) MASGatewayReachabilityOperation *gatewayReachabilityOperation;
 @property (atomic, strong) NSMutableDictionary* tasks;
 
 @end
@@ -294,6 +297,7 @@ static NSMutableArray *_multiFactorAuthenticators_;
     {
         [_sessionManager.operationQueue cancelAllOperations];
         [_gatewayReachabilityManager stopMonitoring];
+        [_gatewayEndpointSelector stopMonitoring];
         [[_sessionManager operationQueue] removeObserver:self forKeyPath:@"operations" context:&kMASNetworkQueueOperationsChanged];
         _sessionManager = nil;
     }
@@ -313,6 +317,7 @@ static NSMutableArray *_multiFactorAuthenticators_;
     {
         [_sessionManager.operationQueue cancelAllOperations];
         [_gatewayReachabilityManager stopMonitoring];
+        [_gatewayEndpointSelector stopMonitoring];
         [[_sessionManager operationQueue] removeObserver:self forKeyPath:@"operations" context:&kMASNetworkQueueOperationsChanged];
         _sessionManager = nil;
     }
@@ -373,6 +378,60 @@ static NSMutableArray *_multiFactorAuthenticators_;
 }
 
 
+# pragma mark - MASGatewayReachabilityOperation
+
+- (MASGatewayReachabilityOperation *)sharedReachabilityOperation
+{
+    //
+    //  synchronized method to avoid duplicate sharedReachabilityOperation
+    //
+    @synchronized (self) {
+        
+        //
+        //  one shared operation holds all requests until the gateway becomes reachable; construct a new one once it is finished
+        //
+        if (!_gatewayReachabilityOperation || _gatewayReachabilityOperation.isFinished)
+        {
+            _gatewayReachabilityOperation = [MASGatewayReachabilityOperation operationWithMaximumWaitInterval:MASDefaultGatewayReachabilityWaitInterval];
+        }
+        
+        return _gatewayReachabilityOperation;
+    }
+}
+
+
+- (void)holdOperationUntilGatewayIsReachable:(MASSessionDataTaskOperation *)operation
+{
+    MASGatewayReachabilityOperation *reachabilityOperation = nil;
+    
+    @synchronized (self) {
+        
+        reachabilityOperation = self.sharedReachabilityOperation;
+        
+        //
+        //  if too many requests are already on hold, fail the request right away rather than growing the queue
+        //
+        if (reachabilityOperation.pendingOperationCount >= MASDefaultMaximumPendingRequestCount)
+        {
+            reachabilityOperation = [MASGatewayReachabilityOperation operationWithMaximumWaitInterval:0];
+        }
+        else {
+            [reachabilityOperation addPendingOperation];
+        }
+    }
+    
+    [operation addDependency:reachabilityOperation];
+    
+    //
+    //  to make sure SDK to not enqueue reachability operation that is already enqueued and being executed
+    //
+    if (!reachabilityOperation.isFinished && !reachabilityOperation.isExecuting && ![_sessionManager.operationQueue.operations containsObject:reachabilityOperation])
+    {
+        [_sessionManager.operationQueue addOperation:reachabilityOperation];
+    }
+}
+
+
 # pragma mark - Public
 
 - (void)releaseOperationQueue
@@ -419,6 +478,24 @@ static NSMutableArray *_multiFactorAuthenticators_;
         // Begin monitoring
         //
         [_gatewayReachabilityManager startMonitoring];
+        
+        //
+        // Gateway endpoint selection, if alternate gateways are configured
+        //
+        if (_gatewayEndpointSelector != nil)
+        {
+            [_gatewayEndpointSelector stopMonitoring];
+            _gatewayEndpointSelector = nil;
+        }
+        
+        if ([MASConfiguration currentConfiguration].gatewayAlternateUrls)
+        {
+            _gatewayEndpointSelector = [[MASGatewayEndpointSelector alloc] initWithPrimaryURL:[MASConfiguration currentConfiguration].gatewayUrl
+                                                                          primaryReachability:_gatewayReachabilityManager
+                                                                                alternateURLs:[MASConfiguration currentConfiguration].gatewayAlternateUrls];
+            _sessionManager.endpointSelector = _gatewayEndpointSelector;
+            [_gatewayEndpointSelector startMonitoring];
+        }
     }
     else {
         [_sessionManager updateSession];
@@ -441,7 +518,10 @@ static NSMutableArray *_multiFactorAuthenticators_;
                                                                      httpMethod:(NSString *)httpMethod
                                                                     requestType:(MASRequestResponseType)requestType
                                                                    responseType:(MASRequestResponseType)responseType
-                                                                       isPublic:(BOOL)isPublic completionBlock:(MASResponseInfoErrorBlock)completion
+                                                                       isPublic:(BOOL)isPublic
+                                                            compressRequestBody:(BOOL)compressRequestBody
+                                                                       dataTask:(MASDataTask *)dataTask
+                                                                completionBlock:(MASResponseInfoErrorBlock)completion
 {
     __block MASRequestResponseType blockResponseType = responseType;
     __block MASRequestResponseType blockRequestType = requestType;
@@ -450,10 +530,24 @@ static NSMutableArray *_multiFactorAuthenticators_;
     __block NSMutableDictionary *blockOriginalParameter = [originalParameterInfo mutableCopy];
     __block NSMutableDictionary *blockOriginalHeader = [originalHeaderInfo mutableCopy];
     __block MASResponseInfoErrorBlock blockCompletion = completion;
+    __block MASDataTask *blockDataTask = dataTask;
     __block MASNetworkingService *blockSelf = self;
     
     MASSessionDataTaskCompletionBlock taskCompletionBlock = ^(NSURLResponse * _Nonnull response, id  _Nonnull responseObject, NSError * _Nonnull error){
         
+        //
+        //  Cancelled request is delivered as it is; it must not trigger any retry, re-authentication, or multi-factor authentication flow
+        //
+        if (error && [error.domain isEqualToString:MASFoundationErrorDomainLocal] && error.code == MASFoundationErrorCodeTaskCancelled)
+        {
+            if (blockCompletion)
+            {
+                blockCompletion(nil, error);
+            }
+            
+            return;
+        }
+        
         NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
         
         if (blockResponseType == MASRequestResponseTypeTextPlain && [responseObject isKindOfClass:[NSData class]])
@@ -571,40 +665,45 @@ static NSMutableArray *_multiFactorAuthenticators_;
             else if ([[MASLocationService sharedService] locationServiceStatus] == MASLocationServiceStatusAvailable)
             {
                 //
-                // If an invalid geolocation result is detected
+                // Wait for a fresh location fix; all requests failing with 449 at the same time share a single location request
                 //
-                if([MASLocationService sharedService].lastKnownLocation == nil)
-                {
-                    //
-                    // Notify
-                    //
-                    if(blockCompletion)
-                    {
-                        blockCompletion(nil, [NSError errorGeolocationIsInvalid]);
-                    }
-                }
-                else {
+                [[MASLocationService sharedService] refreshLocationWithCompletion:^(NSString *geoLocationHeaderValue) {
                     
                     //
-                    // Inject geo-location information in the header
+                    // If an invalid geolocation result is detected
                     //
-                    if ([MASLocationService sharedService].lastKnownLocation != nil)
+                    if (geoLocationHeaderValue == nil)
                     {
-                        blockOriginalHeader[MASGeoLocationRequestResponseKey] = [[MASLocationService sharedService].lastKnownLocation locationAsGeoCoordinates];
+                        //
+                        // Notify
+                        //
+                        if(blockCompletion)
+                        {
+                            blockCompletion(nil, [NSError errorGeolocationIsInvalid]);
+                        }
                     }
-                    
-                    //
-                    //  Proceed with original request
-                    //
-                    [blockSelf proceedOriginalRequestWithEndPoint:blockEndPoint
-                                                   originalHeader:blockOriginalHeader
-                                                originalParameter:blockOriginalParameter
-                                                      requestType:blockRequestType
-                                                     responseType:blockResponseType
-                                                         isPublic:isPublic
-                                                       httpMethod:blockHTTPMethod
-                                                       completion:blockCompletion];
-                }
+                    else {
+                        
+                        //
+                        // Inject geo-location information in the header
+                        //
+                        blockOriginalHeader[MASGeoLocationRequestResponseKey] = geoLocationHeaderValue;
+                        
+                        //
+                        //  Proceed with original request
+                        //
+                        [blockSelf proceedOriginalRequestWithEndPoint:blockEndPoint
+                                                       originalHeader:blockOriginalHeader
+                                                    originalParameter:blockOriginalParameter
+                                                          requestType:blockRequestType
+                                                         responseType:blockResponseType
+                                                             isPublic:isPublic
+                                                  compressRequestBody:compressRequestBody
+                                                           httpMethod:blockHTTPMethod
+                                                             dataTask:blockDataTask
+                                                           completion:blockCompletion];
+                    }
+                }];
             }
             //
             // All other cases (which unlikely happen), return the original error from the server to the client
@@ -647,7 +746,9 @@ static NSMutableArray *_multiFactorAuthenticators_;
                                                   requestType:blockRequestType
                                                  responseType:blockResponseType
                                                      isPublic:isPublic
+                                          compressRequestBody:compressRequestBody
                                                    httpMethod:blockHTTPMethod
+                                                     dataTask:blockDataTask
                                                    completion:blockCompletion];
             }
         }
@@ -686,7 +787,9 @@ static NSMutableArray *_multiFactorAuthenticators_;
                                                       requestType:blockRequestType
                                                      responseType:blockResponseType
                                                          isPublic:isPublic
+                                              compressRequestBody:compressRequestBody
                                                        httpMethod:blockHTTPMethod
+                                                         dataTask:blockDataTask
                                                        completion:blockCompletion];
                 }
             }];
@@ -738,7 +841,9 @@ static NSMutableArray *_multiFactorAuthenticators_;
                                                       requestType:blockRequestType
                                                      responseType:blockResponseType
                                                          isPublic:isPublic
+                                              compressRequestBody:compressRequestBody
                                                        httpMethod:blockHTTPMethod
+                                                         dataTask:blockDataTask
                                                        completion:blockCompletion];
                 }
             }
@@ -866,32 +971,35 @@ static NSMutableArray *_multiFactorAuthenticators_;
                                requestType:(MASRequestResponseType)requestType
                               responseType:(MASRequestResponseType)responseType
                                   isPublic:(BOOL)isPublic
+                       compressRequestBody:(BOOL)compressRequestBody
                                 httpMethod:(NSString *)httpMethod
+                                  dataTask:(MASDataTask *)dataTask
                                 completion:(MASResponseInfoErrorBlock)completion
 {
-    
     //
-    // Retry request
+    //  The request was cancelled while the retry was being prepared
     //
-    if ([httpMethod isEqualToString:@"DELETE"])
-    {
-        [self deleteFrom:endPoint withParameters:originalParameter andHeaders:originalHeader requestType:requestType responseType:responseType isPublic:isPublic completion:completion];
-    }
-    else if ([httpMethod isEqualToString:@"GET"])
-    {
-        [self getFrom:endPoint withParameters:originalParameter andHeaders:originalHeader requestType:requestType responseType:responseType isPublic:isPublic completion:completion];
-    }
-    else if ([httpMethod isEqualToString:@"PATCH"])
-    {
-        [self patchTo:endPoint withParameters:originalParameter andHeaders:originalHeader requestType:requestType responseType:responseType isPublic:isPublic completion:completion];
-    }
-    else if ([httpMethod isEqualToString:@"POST"])
+    if ([dataTask isCancelled])
     {
-        [self postTo:endPoint withParameters:originalParameter andHeaders:originalHeader requestType:requestType responseType:responseType isPublic:isPublic completion:completion];
+        if (completion)
+        {
+            completion(nil, [NSError errorDataTaskCancelled]);
+        }
+        
+        return;
     }
-    else if ([httpMethod isEqualToString:@"PUT"])
+    
+    //
+    // Retry request
+    //
+    MASSessionDataTaskOperation *operation = [self httpRequest:httpMethod endPoint:endPoint parameters:originalParameter headers:originalHeader requestType:requestType responseType:responseType isPublic:isPublic timeoutInterval:MASDefaultNetworkTimeoutConfiguration compressRequestBody:compressRequestBody dataTask:dataTask completion:completion];
+    
+    //
+    //  Cancelling the original data task cancels the retry as well
+    //
+    if (dataTask && operation)
     {
-        [self putTo:endPoint withParameters:originalParameter andHeaders:originalHeader requestType:requestType responseType:responseType isPublic:isPublic completion:completion];
+        [dataTask chainOperation:operation];
     }
     
     return;
@@ -921,6 +1029,18 @@ static NSMutableArray *_multiFactorAuthenticators_;
 }
 
 
+- (void)configureCompressionForRequest:(MASURLRequest *)request compressRequestBody:(BOOL)compressRequestBody
+{
+    //
+    //  Request body compression is enabled either per request, or for all requests to the host through MASNetworkConfiguration
+    //
+    MASNetworkConfiguration *networkConfiguration = [MASConfigurationService networkConfigurationForDomain:[request.URL absoluteURL]];
+    
+    request.compressRequestBody = compressRequestBody || networkConfiguration.compressRequestBody;
+    request.compressionThreshold = networkConfiguration ? networkConfiguration.requestCompressionThreshold : MASDefaultRequestCompressionThreshold;
+}
+
+
 # pragma mark - Network Monitoring
 
 - (BOOL)networkIsReachable
@@ -929,6 +1049,26 @@ static NSMutableArray *_multiFactorAuthenticators_;
 }
 
 
+- (BOOL)networkIsNotReachable
+{
+    return _gatewayReachabilityManager ? _gatewayReachabilityManager.reachabilityStatus == MASNetworkReachabilityStatusNotReachable : NO;
+}
+
+
+- (BOOL)gatewayEndpointIsNotReachable
+{
+    //
+    //  With alternate gateways, requests are sent to the selected endpoint, which fails over when the primary gateway is not reachable
+    //
+    if (_gatewayEndpointSelector)
+    {
+        return [_gatewayEndpointSelector activeEndpointIsNotReachable];
+    }
+    
+    return [self networkIsNotReachable];
+}
+
+
 - (NSString *)networkStatusAsString
 {
     //
@@ -1548,7 +1688,7 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
 }
 
 
-- (void)postMultiPartForm:(NSString*)endPoint withParameters:(NSDictionary *)parameterInfo andHeaders:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic timeoutInterval:(NSTimeInterval)timeoutInterval constructingBodyBlock:(nonnull MASMultiPartFormDataBlock)formDataBlock progress:(MASFileRequestProgressBlock)progress taskBlock:(MASDataTaskBlock)taskBlock completion:(MASResponseObjectErrorBlock)completion
+- (void)postMultiPartForm:(NSString*)endPoint withParameters:(NSDictionary *)parameterInfo andHeaders:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic timeoutInterval:(NSTimeInterval)timeoutInterval compressRequestBody:(BOOL)compressRequestBody constructingBodyBlock:(nonnull MASMultiPartFormDataBlock)formDataBlock progress:(MASFileRequestProgressBlock)progress taskBlock:(MASDataTaskBlock)taskBlock completion:(MASResponseObjectErrorBlock)completion
 {
     //
     //  endPoint cannot be nil
@@ -1563,25 +1703,27 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
         return;
     }
     
-    [self httpFileUploadRequest:endPoint parameters:parameterInfo headers:headerInfo requestType:requestType responseType:responseType isPublic:isPublic timeoutInterval:timeoutInterval constructingBodyBlock:formDataBlock progress:progress taskBlock:taskBlock completion:completion];
+    [self httpFileUploadRequest:endPoint parameters:parameterInfo headers:headerInfo requestType:requestType responseType:responseType isPublic:isPublic timeoutInterval:timeoutInterval compressRequestBody:compressRequestBody constructingBodyBlock:formDataBlock progress:progress taskBlock:taskBlock completion:completion];
 }
 
 
-- (void)httpFileUploadRequest:(NSString *)endPoint parameters:(NSDictionary *)parameterInfo headers:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic timeoutInterval:(NSTimeInterval)timeoutInterval constructingBodyBlock:(nonnull MASMultiPartFormDataBlock)formDataBlock progress:(MASFileRequestProgressBlock)progress taskBlock:(MASDataTaskBlock)taskBlock completion:(MASResponseObjectErrorBlock)completion
+- (void)httpFileUploadRequest:(NSString *)endPoint parameters:(NSDictionary *)parameterInfo headers:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic timeoutInterval:(NSTimeInterval)timeoutInterval compressRequestBody:(BOOL)compressRequestBody constructingBodyBlock:(nonnull MASMultiPartFormDataBlock)formDataBlock progress:(MASFileRequestProgressBlock)progress taskBlock:(MASDataTaskBlock)taskBlock completion:(MASResponseObjectErrorBlock)completion
 {
     NSMutableDictionary *mutableHeaderInfo = [headerInfo mutableCopy];
     
     MASURLRequest *request = nil;
     
     //
-    //  if location was successfully retrieved
+    //  if location is required by the configuration, and a recent location was retrieved
     //
-    if ([MASLocationService sharedService].lastKnownLocation != nil)
+    NSString *geoLocationHeaderValue = [MASLocationService sharedService].geoLocationHeaderValue;
+    if (geoLocationHeaderValue != nil)
     {
-        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = [[MASLocationService sharedService].lastKnownLocation locationAsGeoCoordinates];
+        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = geoLocationHeaderValue;
     }
     
     request = [MASPostFormURLRequest requestForEndpoint:endPoint withParameters:parameterInfo andHeaders:headerInfo requestType:requestType responseType:responseType isPublic:isPublic timeoutInterval:timeoutInterval constructingBodyBlock:formDataBlock];
+    [self configureCompressionForRequest:request compressRequestBody:compressRequestBody];
     
     //
     //  Construct MASSessionDataTaskOperation with request, and completion block to handle any responsive re-authentication or re-registration.
@@ -1591,14 +1733,18 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
         [_sessionManager setSessionDidReceiveHTTPRedirectBlock:self.httpRedirectionBlock];
     }
     
-    MASSessionDataTaskOperation *operation = [self.sessionManager fileUploadOperation:request progress:progress completionHandler:[self sessionDataTaskCompletionBlockWithEndPoint:endPoint parameters:parameterInfo headers:headerInfo httpMethod:request.HTTPMethod requestType:requestType responseType:responseType isPublic:isPublic completionBlock:^(NSDictionary<NSString *,id> * _Nullable responseInfo, NSError * _Nullable error) {
+    MASDataTask* newDataTask = [[MASDataTask alloc] initForChainedOperations];
+    
+    MASSessionDataTaskOperation *operation = [self.sessionManager fileUploadOperation:request progress:progress completionHandler:[self sessionDataTaskCompletionBlockWithEndPoint:endPoint parameters:parameterInfo headers:headerInfo httpMethod:request.HTTPMethod requestType:requestType responseType:responseType isPublic:isPublic compressRequestBody:compressRequestBody dataTask:newDataTask completionBlock:^(NSDictionary<NSString *,id> * _Nullable responseInfo, NSError * _Nullable error) {
+            [newDataTask completeTask];
+            
             if (completion)
             {
                 completion([responseInfo objectForKey:MASNSHTTPURLResponseObjectKey], responseInfo[MASResponseInfoBodyInfoKey], error);
             }
     }]];
     
-    MASDataTask* newDataTask = [[MASDataTask alloc] initWithTask:operation];
+    [newDataTask chainOperation:operation];
     [self cacheDataTask:newDataTask];
     
     
@@ -1649,6 +1795,13 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
 
 - (void)httpRequest:(NSString *)httpMethod endPoint:(NSString *)endPoint parameters:(NSDictionary *)parameterInfo headers:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic
     timeoutInterval:(NSTimeInterval)timeoutInterval completion:(MASResponseInfoErrorBlock)completion
+{
+    [self httpRequest:httpMethod endPoint:endPoint parameters:parameterInfo headers:headerInfo requestType:requestType responseType:responseType isPublic:isPublic timeoutInterval:timeoutInterval compressRequestBody:NO dataTask:nil completion:completion];
+}
+
+
+- (MASSessionDataTaskOperation *)httpRequest:(NSString *)httpMethod endPoint:(NSString *)endPoint parameters:(NSDictionary *)parameterInfo headers:(NSDictionary *)headerInfo requestType:(MASRequestResponseType)requestType responseType:(MASRequestResponseType)responseType isPublic:(BOOL)isPublic
+                             timeoutInterval:(NSTimeInterval)timeoutInterval compressRequestBody:(BOOL)compressRequestBody dataTask:(MASDataTask *)dataTask completion:(MASResponseInfoErrorBlock)completion
 {
     //
     // Update the header
@@ -1658,11 +1811,12 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
     MASURLRequest *request = nil;
     
     //
-    //  if location was successfully retrieved
+    //  if location is required by the configuration, and a recent location was retrieved
     //
-    if ([MASLocationService sharedService].lastKnownLocation != nil)
+    NSString *geoLocationHeaderValue = [MASLocationService sharedService].geoLocationHeaderValue;
+    if (geoLocationHeaderValue != nil)
     {
-        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = [[MASLocationService sharedService].lastKnownLocation locationAsGeoCoordinates];
+        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = geoLocationHeaderValue;
     }
     
     //
@@ -1689,6 +1843,8 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
         request = [MASPutURLRequest requestForEndpoint:endPoint withParameters:parameterInfo andHeaders:mutableHeaderInfo requestType:requestType responseType:responseType isPublic:isPublic timeoutInterval:timeoutInterval];
     }
     
+    [self configureCompressionForRequest:request compressRequestBody:compressRequestBody];
+    
     //
     //  Construct MASSessionDataTaskOperation with request, and completion block to handle any responsive re-authentication or re-registration.
     //
@@ -1705,6 +1861,8 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
                                                                                                                             requestType:requestType
                                                                                                                            responseType:responseType
                                                                                                                                isPublic:isPublic
+                                                                                                                    compressRequestBody:compressRequestBody
+                                                                                                                               dataTask:dataTask
                                                                                                                         completionBlock:completion]];
     
     
@@ -1745,6 +1903,8 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
         //
         [_sessionManager.internalOperationQueue addOperation:operation];
     }
+    
+    return operation;
 }
 
 
@@ -1763,13 +1923,15 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
     
     
     MASURLRequest* urlRequest = [self getURLRequest:request.httpMethod endPoint:request.endPoint parameters:request.body headers:[NSDictionary dictionary] requestType:request.requestType responseType:request.responseType isPublic:request.isPublic timeoutInterval:request.timeoutInterval];
+    [self configureCompressionForRequest:urlRequest compressRequestBody:request.compressRequestBody];
     
     //
-    //  if location was successfully retrieved
+    //  if location is required by the configuration, and a recent location was retrieved
     //
-    if ([MASLocationService sharedService].lastKnownLocation != nil)
+    NSString *geoLocationHeaderValue = [MASLocationService sharedService].geoLocationHeaderValue;
+    if (geoLocationHeaderValue != nil)
     {
-        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = [[MASLocationService sharedService].lastKnownLocation locationAsGeoCoordinates];
+        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = geoLocationHeaderValue;
     }
     
     if(self.httpRedirectionBlock)
@@ -1777,6 +1939,20 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
         [_sessionManager setSessionDidReceiveHTTPRedirectBlock:self.httpRedirectionBlock];
     }
     
+    //
+    //  The data task follows the request through its retries, and is finished once the completion is delivered
+    //
+    MASDataTask* newDataTask = [[MASDataTask alloc] initForChainedOperations];
+    MASResponseInfoErrorBlock taskCompletion = ^(NSDictionary<NSString *,id> * _Nullable responseInfo, NSError * _Nullable error) {
+        
+        [newDataTask completeTask];
+        
+        if (completion)
+        {
+            completion(responseInfo, error);
+        }
+    };
+    
     MASSessionDataTaskOperation *operation = [_sessionManager dataOperationWithRequest:urlRequest
                                                                      completionHandler:[self sessionDataTaskCompletionBlockWithEndPoint:request.endPoint
                                                                                                                              parameters:request.body
@@ -1784,10 +1960,13 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
                                                                                                                              httpMethod:urlRequest.HTTPMethod
                                                                                                                             requestType:request.requestType
                                                                                                                            responseType:request.responseType
-                                                                                                                               isPublic:request.isPublic                                                                                                                        completionBlock:completion]];
+                                                                                                                               isPublic:request.isPublic
+                                                                                                                    compressRequestBody:request.compressRequestBody
+                                                                                                                               dataTask:newDataTask
+                                                                                                                        completionBlock:taskCompletion]];
     
 
-    MASDataTask* newDataTask = [[MASDataTask alloc] initWithTask:operation];
+    [newDataTask chainOperation:operation];
     DLog(@"MASNetworkingService : created Task with ID %@",newDataTask.taskID);
     [self cacheDataTask:newDataTask];
     
@@ -1819,6 +1998,14 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
             }
         }
         
+        //
+        //  if the request can wait for connectivity, and the gateway is not reachable, hold the request until the gateway becomes reachable
+        //
+        if (request.waitsForConnectivity && [self gatewayEndpointIsNotReachable])
+        {
+            [self holdOperationUntilGatewayIsReachable:operation];
+        }
+        
         //
         //  add current request into normal operation queue
         //
@@ -1843,7 +2030,9 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
     //[self cleanUpFinishedTasks];
     if(dataTask.taskID){
         DLog(@"MASNetworkingService : Added Task with ID %@ to the cache",dataTask.taskID);
-        [self.tasks setObject:dataTask forKey:dataTask.taskID];
+        @synchronized (self.tasks) {
+            [self.tasks setObject:dataTask forKey:dataTask.taskID];
+        }
     }
 }
 
@@ -1851,23 +2040,32 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
 {
     NSLog(@"cleanUpFinishedTasks : cleaning up tasks");
     NSMutableArray* keysToRemove = [[NSMutableArray alloc] init];
-    for (NSString* key in self.tasks){
-        if([[self.tasks objectForKey:key] isFinished] || [[self.tasks objectForKey:key] isCancelled]){
-            [keysToRemove addObject:key];
-            //[self.tasks removeObjectForKey:key];
+    @synchronized (self.tasks) {
+        for (NSString* key in self.tasks){
+            if([[self.tasks objectForKey:key] isFinished] || [[self.tasks objectForKey:key] isCancelled]){
+                [keysToRemove addObject:key];
+                //[self.tasks removeObjectForKey:key];
+            }
         }
+        [self.tasks removeObjectsForKeys:keysToRemove];
     }
-    [self.tasks removeObjectsForKeys:keysToRemove];
     NSLog(@"cleanUpFinishedTasks : finished cleaning up");
 }
 
 - (BOOL)cancelRequest:(MASDataTask*)task error:(NSError**)error;
 {
     NSString* taskID = task.taskID;
-    if(self.tasks && [self.tasks objectForKey:taskID]){
-        MASDataTask* taskToBeCancelled = [self.tasks objectForKey:taskID];
+    MASDataTask* taskToBeCancelled = nil;
+    
+    @synchronized (self.tasks) {
+        taskToBeCancelled = taskID ? [self.tasks objectForKey:taskID] : nil;
+        if (taskToBeCancelled) {
+            [self.tasks removeObjectForKey:taskID];
+        }
+    }
+    
+    if(taskToBeCancelled){
         BOOL isTaskCancelled = [taskToBeCancelled cancelTask];
-        [self.tasks removeObjectForKey:taskToBeCancelled.taskID];
         
         if (!isTaskCancelled){
             if (error != NULL){
@@ -1892,10 +2090,16 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
 - (void)cancelAllRequests
 {
     NSLog(@"Cancel All Requests");
+    
+    //
+    //  The queues remain in use after cancellation; keep observing the operation queue so that the shared validation operation is still released
+    //
     [[_sessionManager operationQueue] cancelAllOperations];
     [[_sessionManager internalOperationQueue] cancelAllOperations];
-    [[_sessionManager operationQueue] removeObserver:self forKeyPath:@"operations" context:&kMASNetworkQueueOperationsChanged];
-
+    
+    @synchronized (self.tasks) {
+        [self.tasks removeAllObjects];
+    }
 }
 
 
@@ -1911,11 +2115,12 @@ timeoutInterval:(NSTimeInterval)timeoutInterval
     MASURLRequest *request = nil;
     
     //
-    //  if location was successfully retrieved
+    //  if location is required by the configuration, and a recent location was retrieved
     //
-    if ([MASLocationService sharedService].lastKnownLocation != nil)
+    NSString *geoLocationHeaderValue = [MASLocationService sharedService].geoLocationHeaderValue;
+    if (geoLocationHeaderValue != nil)
     {
-        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = [[MASLocationService sharedService].lastKnownLocation locationAsGeoCoordinates];
+        mutableHeaderInfo[MASGeoLocationRequestResponseKey] = geoLocationHeaderValue;
     }
     
     //
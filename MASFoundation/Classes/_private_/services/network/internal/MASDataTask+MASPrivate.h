@@ -19,7 +19,14 @@ NS_ASSUME_NONNULL_BEGIN
     
 }
 
-- (instancetype)initWithTask:(MASSessionDataTaskOperation*)operation;
+//
+//  A request may be retried by the networking service (geo-location, token re-validation, client certificate renewal),
+//  each retry running as a new operation; the data task is created before its first operation,
+//  so that the completion block of each operation can chain the retry to the same data task
+//
+- (instancetype)initForChainedOperations;
+- (void)chainOperation:(MASSessionDataTaskOperation*)operation;
+- (void)completeTask;
 - (BOOL)isFinished;
 -(BOOL)isCancelled;
 - (BOOL)cancelTask;
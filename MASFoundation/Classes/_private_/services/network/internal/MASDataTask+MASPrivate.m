@@ -17,17 +17,18 @@
 
 @property(readwrite)NSString* taskID;
 @property(nonatomic,readwrite)MASSessionDataTaskOperation* operation;
+@property(nonatomic,assign)BOOL cancelRequested;
+@property(nonatomic,assign)BOOL completionDelivered;
 
 @end
 
 @implementation MASDataTask (MASPrivate)
 
 
-- (instancetype)initWithTask:(MASSessionDataTaskOperation*)operation
+- (instancetype)initForChainedOperations
 {
     if(self = [super init]){
-        self.operation = operation;
-        self.taskID = operation.taskID;
+        self.taskID = [[NSUUID UUID] UUIDString];
     }
     
     return self;
@@ -35,25 +36,76 @@
 
 - (BOOL)isFinished
 {
-    return [self.operation isFinished];
+    //
+    //  The operation finishes before its retry starts; the task is only finished once the completion was delivered
+    //
+    @synchronized (self) {
+        return self.completionDelivered;
+    }
 }
 
 
 -(BOOL)isCancelled
 {
+    @synchronized (self) {
+        if (self.cancelRequested)
+        {
+            return YES;
+        }
+    }
+    
     return [self.operation isCancelled];
 }
 
 - (BOOL)cancelTask
 {
-    if(self.operation && (![self.operation isFinished] && ![self.operation isCancelled])){
-        DLog(@"Cancelling task with ID %@",self.taskID);
-        [self.operation cancel];
-        return YES;
+    MASSessionDataTaskOperation *operation = nil;
+    
+    @synchronized (self) {
+        
+        //
+        //  The task can be cancelled until its completion is delivered, including while a retry is being prepared
+        //
+        if(!self.completionDelivered && !self.cancelRequested){
+            self.cancelRequested = YES;
+            operation = self.operation;
+        }
+        else {
+            DLog(@"Unable to cancel task. The operation is either finished or cancelled earlier");
+            return NO;
+        }
+    }
+    
+    DLog(@"Cancelling task with ID %@",self.taskID);
+    [operation cancel];
+    
+    return YES;
+}
+
+- (void)chainOperation:(MASSessionDataTaskOperation*)operation
+{
+    BOOL cancelRequested = NO;
+    
+    @synchronized (self) {
+        self.operation = operation;
+        cancelRequested = self.cancelRequested;
     }
     
-    DLog(@"Unable to cancel task. The operation is either finished or cancelled earlier");
-    return NO;
+    //
+    //  The data task was cancelled while the retry was being prepared; the retry reports the cancellation to the original completion
+    //
+    if (cancelRequested)
+    {
+        DLog(@"Cancelling retry of task with ID %@",self.taskID);
+        [operation cancel];
+    }
+}
+
+- (void)completeTask
+{
+    @synchronized (self) {
+        self.completionDelivered = YES;
+    }
 }
 
 
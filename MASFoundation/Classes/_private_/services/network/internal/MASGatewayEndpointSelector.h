@@ -0,0 +1,131 @@
+//
+//  MASGatewayEndpointSelector.h
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+@import Foundation;
+
+@class MASNetworkReachability;
+
+
+/**
+ MASGatewayEndpointSelector class is responsible to monitor health and latency of equivalent gateway endpoints,
+ and to route requests made to the primary gateway to the selected endpoint.
+
+ The selected endpoint is sticky; it only changes when the endpoint is marked down by network reachability or consecutive failures,
+ or when another healthy endpoint is significantly faster, so that an established mutual SSL session is not renegotiated on every request.
+ */
+@interface MASGatewayEndpointSelector : NSObject
+
+
+///--------------------------------------
+/// @name Properties
+///--------------------------------------
+
+# pragma mark - Properties
+
+
+/**
+ NSURL value of the currently selected endpoint in https://<hostname>:<port> format.
+ */
+@property (readonly, nonatomic, strong, nonnull) NSURL *activeEndpointURL;
+
+
+
+///--------------------------------------
+/// @name Lifecycle
+///--------------------------------------
+
+# pragma mark - Lifecycle
+
+
+/**
+ Initializer to perform default object initialization with the primary gateway and its alternate endpoints.
+ The network reachability of the primary gateway host is not monitored again; the given reachability, owned by the caller, is shared.
+
+ @param primaryURL NSURL of the primary gateway.
+ @param primaryReachability MASNetworkReachability already monitoring the primary gateway host.
+ @param alternateURLs NSArray of NSURL for the alternate gateway endpoints.
+ @return MASGatewayEndpointSelector object created.
+ */
+- (instancetype _Nullable)initWithPrimaryURL:(NSURL * _Nonnull)primaryURL primaryReachability:(MASNetworkReachability * _Nullable)primaryReachability alternateURLs:(NSArray<NSURL *> * _Nullable)alternateURLs;
+
+
+
+/**
+ This initializer is not available.  Please use [[MASGatewayEndpointSelector alloc] initWithPrimaryURL:primaryReachability:alternateURLs:].
+
+ @return nil will always be returned with this initialization method.
+ */
+- (instancetype _Nullable)init NS_UNAVAILABLE;
+
+
+
+/**
+ This initializer is not available.  Please use [[MASGatewayEndpointSelector alloc] initWithPrimaryURL:primaryReachability:alternateURLs:].
+
+ @return nil will always be returned with this initialization method.
+ */
++ (instancetype _Nullable)new NS_UNAVAILABLE;
+
+
+
+///--------------------------------------
+/// @name Public
+///--------------------------------------
+
+# pragma mark - Public
+
+/**
+ Starts monitoring network reachability of all endpoints, and periodically probes their connection latency.
+ */
+- (void)startMonitoring;
+
+
+
+/**
+ Stops monitoring all endpoints.
+ */
+- (void)stopMonitoring;
+
+
+
+/**
+ Returns the URL to be used for the request.  If the given URL targets one of the gateway endpoints, the host and port are replaced
+ with those of the currently selected endpoint; otherwise, the given URL is returned as it is.
+
+ @param URL NSURL of the request.
+ @return NSURL to be used for the request.
+ */
+- (NSURL * _Nonnull)endpointURLForURL:(NSURL * _Nonnull)URL;
+
+
+
+/**
+ Reevaluates the selected endpoint against the current network reachability, and returns whether it is known to be not reachable.
+ The primary gateway being not reachable does not hold requests while an alternate endpoint is reachable.
+
+ @return BOOL YES if the selected endpoint is not reachable, NO if it is reachable or unknown.
+ */
+- (BOOL)activeEndpointIsNotReachable;
+
+
+
+/**
+ Records the outcome of a request sent to one of the gateway endpoints.  Transport errors and gateway errors (502, 503, 504)
+ count toward marking the endpoint down; any other response marks the endpoint healthy.
+ The response time of requests includes the processing time of the gateway, and is not used to compare endpoints;
+ endpoints are only compared by the connection latency measured by probes.
+
+ @param URL NSURL that the request was sent to.
+ @param response NSURLResponse of the request, if any.
+ @param error NSError of the request, if any.
+ */
+- (void)recordCompletionForURL:(NSURL * _Nonnull)URL response:(NSURLResponse * _Nullable)response error:(NSError * _Nullable)error;
+
+@end
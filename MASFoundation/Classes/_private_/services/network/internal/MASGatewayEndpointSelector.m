@@ -0,0 +1,519 @@
+//
+//  MASGatewayEndpointSelector.m
+//  MASFoundation
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MASGatewayEndpointSelector.h"
+
+@import Network;
+
+#import "MASConstantsPrivate.h"
+#import "MASNetworkReachability.h"
+#import "MASNotifications.h"
+
+
+# pragma mark - MASGatewayEndpoint
+
+@interface MASGatewayEndpoint : NSObject
+
+@property (nonatomic, strong) NSURL *URL;
+@property (nonatomic, strong) MASNetworkReachability *reachability;
+@property (nonatomic, assign) BOOL sharesGatewayReachability;
+@property (nonatomic, assign) NSTimeInterval probeLatency;
+@property (nonatomic, assign) NSUInteger consecutiveFailures;
+@property (nonatomic, assign, readonly, getter=isHealthy) BOOL healthy;
+
+@end
+
+
+@implementation MASGatewayEndpoint
+
+- (BOOL)isHealthy
+{
+    //
+    //  Unknown, or initializing reachability status is not treated as down
+    //
+    return (self.reachability.reachabilityStatus != MASNetworkReachabilityStatusNotReachable && self.consecutiveFailures < MASGatewayEndpointFailureThreshold);
+}
+
+@end
+
+
+# pragma mark - MASGatewayEndpointSelector
+
+@interface MASGatewayEndpointSelector ()
+
+@property (nonatomic, strong) NSArray *endpoints;
+@property (nonatomic, strong) MASGatewayEndpoint *activeEndpoint;
+@property (nonatomic, strong) dispatch_queue_t probeQueue;
+@property (nonatomic, strong) dispatch_source_t probeTimer;
+
+@end
+
+
+@implementation MASGatewayEndpointSelector
+
+# pragma mark - Lifecycle
+
+- (instancetype)initWithPrimaryURL:(NSURL *)primaryURL primaryReachability:(MASNetworkReachability *)primaryReachability alternateURLs:(NSArray *)alternateURLs
+{
+    self = [super init];
+    
+    if (self)
+    {
+        NSMutableArray *endpoints = [NSMutableArray array];
+        NSMutableSet *endpointKeys = [NSMutableSet set];
+        
+        NSMutableArray *URLs = [NSMutableArray arrayWithObject:primaryURL];
+        if (alternateURLs)
+        {
+            [URLs addObjectsFromArray:alternateURLs];
+        }
+        
+        for (NSURL *URL in URLs)
+        {
+            NSString *endpointKey = [MASGatewayEndpointSelector endpointKeyForURL:URL];
+            if (!endpointKey || [endpointKeys containsObject:endpointKey])
+            {
+                continue;
+            }
+            
+            MASGatewayEndpoint *endpoint = [[MASGatewayEndpoint alloc] init];
+            endpoint.URL = [NSURL URLWithString:[NSString stringWithFormat:@"%@://%@:%@", URL.scheme, URL.host, URL.port ? URL.port : @443]];
+            
+            //
+            //  The primary gateway host is already monitored by the networking service, which also notifies the gateway status;
+            //  a second monitor on the same host would post duplicate MASGatewayMonitorStatusUpdateNotification
+            //
+            if (primaryReachability && [[URL.host lowercaseString] isEqualToString:[primaryURL.host lowercaseString]])
+            {
+                endpoint.reachability = primaryReachability;
+                endpoint.sharesGatewayReachability = YES;
+            }
+            else {
+                endpoint.reachability = [[MASNetworkReachability alloc] initWithDomain:URL.host];
+            }
+            
+            [endpoints addObject:endpoint];
+            [endpointKeys addObject:endpointKey];
+        }
+        
+        //
+        //  Primary gateway is always the first endpoint, and the initial selection
+        //
+        _endpoints = endpoints;
+        _activeEndpoint = [endpoints firstObject];
+        _probeQueue = dispatch_queue_create("com.ca.mas.networking.gateway.endpoint.probe", DISPATCH_QUEUE_SERIAL);
+    }
+    
+    return self;
+}
+
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:NSGenericException
+                                   reason:@"`-init` is not available. Use `-initWithPrimaryURL:primaryReachability:alternateURLs:` instead"
+                                 userInfo:nil];
+    return nil;
+}
+
+
++ (instancetype)new
+{
+    @throw [NSException exceptionWithName:NSGenericException
+                                   reason:@"`+new` is not available. Use `-initWithPrimaryURL:primaryReachability:alternateURLs:` instead"
+                                 userInfo:nil];
+    return nil;
+}
+
+
+- (void)dealloc
+{
+    [self stopMonitoring];
+}
+
+
+# pragma mark - Public getter methods
+
+- (NSURL *)activeEndpointURL
+{
+    @synchronized (self) {
+        return self.activeEndpoint.URL;
+    }
+}
+
+
+# pragma mark - Public
+
+- (void)startMonitoring
+{
+    [self stopMonitoring];
+    
+    __weak __typeof(self) weakSelf = self;
+    for (MASGatewayEndpoint *endpoint in self.endpoints)
+    {
+        if (endpoint.sharesGatewayReachability)
+        {
+            continue;
+        }
+        
+        __weak MASGatewayEndpoint *weakEndpoint = endpoint;
+        [endpoint.reachability setReachabilityMonitoringBlock:^(MASNetworkReachabilityStatus status) {
+            [weakSelf reachabilityStatusDidChange:status forEndpoint:weakEndpoint];
+        }];
+        [endpoint.reachability startMonitoring];
+    }
+    
+    //
+    //  Status changes of the primary gateway host are observed through the notification of the existing gateway monitor
+    //
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(gatewayStatusDidUpdate:) name:MASGatewayMonitorStatusUpdateNotification object:nil];
+    
+    //
+    //  Probe all endpoints right away, and then periodically
+    //
+    self.probeTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.probeQueue);
+    dispatch_source_set_timer(self.probeTimer, dispatch_time(DISPATCH_TIME_NOW, 0), (uint64_t)(MASGatewayEndpointProbeInterval * NSEC_PER_SEC), (uint64_t)(NSEC_PER_SEC));
+    dispatch_source_set_event_handler(self.probeTimer, ^{
+        [weakSelf probeEndpoints];
+    });
+    dispatch_resume(self.probeTimer);
+}
+
+
+- (void)stopMonitoring
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:MASGatewayMonitorStatusUpdateNotification object:nil];
+    
+    for (MASGatewayEndpoint *endpoint in self.endpoints)
+    {
+        if (endpoint.sharesGatewayReachability)
+        {
+            continue;
+        }
+        
+        [endpoint.reachability setReachabilityMonitoringBlock:nil];
+        [endpoint.reachability stopMonitoring];
+    }
+    
+    if (self.probeTimer)
+    {
+        dispatch_source_cancel(self.probeTimer);
+        self.probeTimer = nil;
+    }
+}
+
+
+- (NSURL *)endpointURLForURL:(NSURL *)URL
+{
+    NSString *endpointKey = [MASGatewayEndpointSelector endpointKeyForURL:URL];
+    NSURL *activeEndpointURL = self.activeEndpointURL;
+    
+    //
+    //  Only requests targeting one of the gateway endpoints are routed
+    //
+    if (!endpointKey || !activeEndpointURL || ![self endpointForKey:endpointKey] || [endpointKey isEqualToString:[MASGatewayEndpointSelector endpointKeyForURL:activeEndpointURL]])
+    {
+        return URL;
+    }
+    
+    NSURLComponents *components = [NSURLComponents componentsWithURL:URL resolvingAgainstBaseURL:YES];
+    components.host = activeEndpointURL.host;
+    components.port = activeEndpointURL.port;
+    
+    return components.URL ? components.URL : URL;
+}
+
+
+- (BOOL)activeEndpointIsNotReachable
+{
+    @synchronized (self) {
+        
+        //
+        //  Reachability notifications may be delivered before the selection is updated
+        //
+        [self selectActiveEndpoint];
+        
+        return self.activeEndpoint.reachability.reachabilityStatus == MASNetworkReachabilityStatusNotReachable;
+    }
+}
+
+
+- (void)recordCompletionForURL:(NSURL *)URL response:(NSURLResponse *)response error:(NSError *)error
+{
+    MASGatewayEndpoint *endpoint = [self endpointForKey:[MASGatewayEndpointSelector endpointKeyForURL:URL]];
+    
+    if (!endpoint)
+    {
+        return;
+    }
+    
+    if (error)
+    {
+        if ([MASGatewayEndpointSelector isEndpointFailureError:error])
+        {
+            [self recordFailureForEndpoint:endpoint];
+        }
+        
+        return;
+    }
+    
+    NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).statusCode : 0;
+    if (statusCode == 502 || statusCode == 503 || statusCode == 504)
+    {
+        [self recordFailureForEndpoint:endpoint];
+    }
+    else {
+        [self recordSuccessForEndpoint:endpoint];
+    }
+}
+
+
+# pragma mark - Private
+
++ (NSString *)endpointKeyForURL:(NSURL *)URL
+{
+    if (!URL.host)
+    {
+        return nil;
+    }
+    
+    return [NSString stringWithFormat:@"%@:%@", [URL.host lowercaseString], URL.port ? URL.port : @443];
+}
+
+
++ (BOOL)isEndpointFailureError:(NSError *)error
+{
+    if (![error.domain isEqualToString:NSURLErrorDomain])
+    {
+        return NO;
+    }
+    
+    switch (error.code) {
+        case NSURLErrorTimedOut:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorSecureConnectionFailed:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+
+- (MASGatewayEndpoint *)endpointForKey:(NSString *)endpointKey
+{
+    if (!endpointKey)
+    {
+        return nil;
+    }
+    
+    for (MASGatewayEndpoint *endpoint in self.endpoints)
+    {
+        if ([[MASGatewayEndpointSelector endpointKeyForURL:endpoint.URL] isEqualToString:endpointKey])
+        {
+            return endpoint;
+        }
+    }
+    
+    return nil;
+}
+
+
+- (void)recordSuccessForEndpoint:(MASGatewayEndpoint *)endpoint
+{
+    @synchronized (self) {
+        
+        BOOL wasHealthy = endpoint.isHealthy;
+        endpoint.consecutiveFailures = 0;
+        
+        if (!wasHealthy)
+        {
+            [self selectActiveEndpoint];
+        }
+    }
+}
+
+
+- (void)recordProbeLatency:(NSTimeInterval)latency forEndpoint:(MASGatewayEndpoint *)endpoint
+{
+    @synchronized (self) {
+        
+        endpoint.consecutiveFailures = 0;
+        
+        //
+        //  Exponentially weighted moving average to smooth out a single slow probe
+        //
+        endpoint.probeLatency = endpoint.probeLatency > 0 ? (MASGatewayEndpointLatencySmoothingFactor * latency) + ((1 - MASGatewayEndpointLatencySmoothingFactor) * endpoint.probeLatency) : latency;
+        
+        [self selectActiveEndpoint];
+    }
+}
+
+
+- (void)recordFailureForEndpoint:(MASGatewayEndpoint *)endpoint
+{
+    @synchronized (self) {
+        
+        endpoint.consecutiveFailures++;
+        
+        if (!endpoint.isHealthy)
+        {
+            [self selectActiveEndpoint];
+        }
+    }
+}
+
+
+- (void)gatewayStatusDidUpdate:(NSNotification *)notification
+{
+    MASGatewayEndpoint *primaryEndpoint = [self.endpoints firstObject];
+    
+    for (MASGatewayEndpoint *endpoint in self.endpoints)
+    {
+        if (endpoint.sharesGatewayReachability)
+        {
+            [self reachabilityStatusDidChange:primaryEndpoint.reachability.reachabilityStatus forEndpoint:endpoint];
+        }
+    }
+}
+
+
+- (void)reachabilityStatusDidChange:(MASNetworkReachabilityStatus)status forEndpoint:(MASGatewayEndpoint *)endpoint
+{
+    if (!endpoint)
+    {
+        return;
+    }
+    
+    @synchronized (self) {
+        [self selectActiveEndpoint];
+    }
+    
+    //
+    //  Probe the endpoint as soon as it becomes reachable to clear previous failures
+    //
+    if (status == MASNetworkReachabilityStatusReachableViaWiFi || status == MASNetworkReachabilityStatusReachableViaWWAN)
+    {
+        __weak __typeof(self) weakSelf = self;
+        dispatch_async(self.probeQueue, ^{
+            [weakSelf probeEndpoint:endpoint];
+        });
+    }
+}
+
+
+- (void)selectActiveEndpoint
+{
+    //
+    //  Must be called within @synchronized (self)
+    //
+    MASGatewayEndpoint *fastestEndpoint = nil;
+    for (MASGatewayEndpoint *endpoint in self.endpoints)
+    {
+        if (!endpoint.isHealthy)
+        {
+            continue;
+        }
+        
+        //
+        //  Endpoints with measured latency are preferred over unmeasured ones; otherwise, the order of configuration is preserved
+        //
+        if (!fastestEndpoint || (endpoint.probeLatency > 0 && (fastestEndpoint.probeLatency <= 0 || endpoint.probeLatency < fastestEndpoint.probeLatency)))
+        {
+            fastestEndpoint = endpoint;
+        }
+    }
+    
+    MASGatewayEndpoint *selectedEndpoint = self.activeEndpoint;
+    
+    if (!selectedEndpoint.isHealthy)
+    {
+        //
+        //  Fail over to the fastest healthy endpoint, or fall back to the primary gateway if none is healthy
+        //
+        selectedEndpoint = fastestEndpoint ? fastestEndpoint : [self.endpoints firstObject];
+    }
+    else if (fastestEndpoint && fastestEndpoint != selectedEndpoint && fastestEndpoint.probeLatency > 0 && selectedEndpoint.probeLatency > 0 && fastestEndpoint.probeLatency < selectedEndpoint.probeLatency * MASGatewayEndpointSwitchLatencyRatio)
+    {
+        //
+        //  Stay on the current endpoint unless the other one is significantly faster
+        //
+        selectedEndpoint = fastestEndpoint;
+    }
+    
+    if (selectedEndpoint != self.activeEndpoint)
+    {
+        DLog(@"Gateway endpoint switched from %@ to %@", self.activeEndpoint.URL, selectedEndpoint.URL);
+        self.activeEndpoint = selectedEndpoint;
+    }
+}
+
+
+- (void)probeEndpoints
+{
+    for (MASGatewayEndpoint *endpoint in self.endpoints)
+    {
+        [self probeEndpoint:endpoint];
+    }
+}
+
+
+- (void)probeEndpoint:(MASGatewayEndpoint *)endpoint
+{
+    //
+    //  TCP connection establishment time is measured as the latency of the endpoint;
+    //  TLS is not negotiated so that probes neither depend on, nor disturb, the mutual SSL session of the SDK
+    //
+    nw_endpoint_t host = nw_endpoint_create_host([endpoint.URL.host UTF8String], [[endpoint.URL.port stringValue] UTF8String]);
+    nw_parameters_t parameters = nw_parameters_create_secure_tcp(NW_PARAMETERS_DISABLE_PROTOCOL, NW_PARAMETERS_DEFAULT_CONFIGURATION);
+    nw_connection_t connection = nw_connection_create(host, parameters);
+    
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    __block BOOL didFinish = NO;
+    __weak __typeof(self) weakSelf = self;
+    
+    nw_connection_set_queue(connection, self.probeQueue);
+    nw_connection_set_state_changed_handler(connection, ^(nw_connection_state_t state, nw_error_t error) {
+        
+        if (didFinish)
+        {
+            return;
+        }
+        
+        if (state == nw_connection_state_ready)
+        {
+            didFinish = YES;
+            [weakSelf recordProbeLatency:CFAbsoluteTimeGetCurrent() - startTime forEndpoint:endpoint];
+            nw_connection_cancel(connection);
+        }
+        else if (state == nw_connection_state_waiting || state == nw_connection_state_failed)
+        {
+            didFinish = YES;
+            [weakSelf recordFailureForEndpoint:endpoint];
+            nw_connection_cancel(connection);
+        }
+    });
+    
+    nw_connection_start(connection);
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MASGatewayEndpointProbeTimeout * NSEC_PER_SEC)), self.probeQueue, ^{
+        
+        if (!didFinish)
+        {
+            didFinish = YES;
+            [weakSelf recordFailureForEndpoint:endpoint];
+            nw_connection_cancel(connection);
+        }
+    });
+}
+
+@end
@@ -105,7 +105,31 @@ static void * MASNetworkRequestStartTimestamp = &MASNetworkRequestStartTimestamp
         else {
             DLog(@"%ld '%@' [%.04f s]: %@ %@", (long)responseStatusCode, [[response URL] absoluteString], elapsedTime, responseHeader, responseObject);
         }
+        
+        [self logCompressionMetrics:notification.userInfo[MASSessionTaskDidCompleteMetricsKey]];
+    }
+}
+
+
+- (void)logCompressionMetrics:(NSURLSessionTaskMetrics *)metrics
+{
+    NSURLSessionTaskTransactionMetrics *transactionMetrics = [metrics.transactionMetrics lastObject];
+    
+    if (!transactionMetrics)
+    {
+        return;
     }
+    
+    //
+    //  Response body: bytes on the wire vs. bytes after Content-Encoding was decoded by NSURLSession.
+    //  Request body compression is applied by MASURLRequest itself, so the bytes sent are already encoded.
+    //
+    int64_t requestBodySent = transactionMetrics.countOfRequestBodyBytesSent;
+    int64_t responseBodyReceived = transactionMetrics.countOfResponseBodyBytesReceived;
+    int64_t responseBodyDecoded = transactionMetrics.countOfResponseBodyBytesAfterDecoding;
+    
+    DLog(@"request body sent %lld bytes, response body %lld -> %lld bytes (compression ratio %.02f)",
+         requestBodySent, responseBodyReceived, responseBodyDecoded, responseBodyReceived > 0 ? (double)responseBodyDecoded / responseBodyReceived : 1.0);
 }
 
 @end
@@ -10,6 +10,8 @@
 
 #import "MASSessionTaskOperation.h"
 
+@class MASGatewayEndpointSelector;
+
 @interface MASSessionDataTaskOperation : MASSessionTaskOperation <NSURLSessionDataDelegate>
 
 ///--------------------------------------
@@ -23,6 +25,7 @@
 @property (nonatomic, copy) MASNetworkDataTaskWillCacheResponseBlock willCacheResponseBlock;
 @property (nonatomic, copy) MASNetworkDataTaskDidReceiveResponseBlock didReceiveResponseBlock;
 @property (nonatomic,readonly) NSString* taskID;
+@property (nonatomic, strong) MASGatewayEndpointSelector *endpointSelector;
 
 - (instancetype)initWithSession:(NSURLSession *)session request:(NSURLRequest *)request progress:(MASFileRequestProgressBlock)progress;
 
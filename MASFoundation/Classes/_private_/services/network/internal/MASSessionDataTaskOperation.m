@@ -12,9 +12,12 @@
 
 #import "MASAccessService.h"
 #import "MASAuthValidationOperation.h"
+#import "MASGatewayReachabilityOperation.h"
 #import "MASDevice.h"
+#import "MASGatewayEndpointSelector.h"
 #import "MASURLRequest.h"
 #import "MASConstantsPrivate.h"
+#import "NSError+MASPrivate.h"
 
 @interface MASSessionDataTaskOperation ()
 
@@ -83,14 +86,17 @@
 
 - (void)start
 {
-    if ([self isCancelled])
-    {
-        self.finished = YES;
-        return;
+    @synchronized (self) {
+        
+        if ([self isCancelled])
+        {
+            self.finished = YES;
+            return;
+        }
+        
+        self.executing = YES;
     }
     
-    self.executing = YES;
-    
     if (!self.request.isPublic)
     {
         NSMutableDictionary *mutableHeader = [self.request.headerInfo mutableCopy];
@@ -109,17 +115,34 @@
         self.request = [self.request rebuildRequest];
     }
     
-    if ([self.dependencies.lastObject isKindOfClass:[MASAuthValidationOperation class]])
+    for (NSOperation *dependency in self.dependencies)
     {
-        MASAuthValidationOperation *validationOperation = (MASAuthValidationOperation *)self.dependencies.lastObject;
+        NSError *dependencyError = nil;
+        BOOL dependencyFailed = NO;
         
-        if (!validationOperation.result || validationOperation.error != nil)
+        if ([dependency isKindOfClass:[MASAuthValidationOperation class]])
+        {
+            MASAuthValidationOperation *validationOperation = (MASAuthValidationOperation *)dependency;
+            dependencyFailed = (!validationOperation.result || validationOperation.error != nil);
+            dependencyError = validationOperation.error;
+        }
+        else if ([dependency isKindOfClass:[MASGatewayReachabilityOperation class]])
+        {
+            //
+            //  the gateway did not become reachable within the maximum wait interval, or too many requests were on hold
+            //
+            MASGatewayReachabilityOperation *reachabilityOperation = (MASGatewayReachabilityOperation *)dependency;
+            dependencyFailed = !reachabilityOperation.result;
+            dependencyError = reachabilityOperation.error ? reachabilityOperation.error : [NSError errorNetworkNotReachable];
+        }
+        
+        if (dependencyFailed)
         {
             if (self.didCompleteWithDataErrorBlock)
             {
                 dispatch_group_async(self.completionGroup ? self.completionGroup : [self defaultDispatchGroupForCompletionBlock], self.completionQueue ? self.completionQueue : dispatch_get_main_queue(), ^{
                    
-                    self.didCompleteWithDataErrorBlock(nil, nil, nil, validationOperation.error);
+                    self.didCompleteWithDataErrorBlock(nil, nil, nil, dependencyError);
                 });
             }
             
@@ -128,7 +151,35 @@
             return;
         }
     }
-    self.task = [self.session dataTaskWithRequest:self.request];
+    
+    //
+    //  route the request to the selected gateway endpoint, if alternate gateways are configured
+    //
+    if (self.endpointSelector)
+    {
+        [self.request setURL:[self.endpointSelector endpointURLForURL:self.request.URL]];
+    }
+    
+    //
+    //  compress the request body, if configured, once all headers are final
+    //
+    [self.request compressBodyIfNeeded];
+    
+    @synchronized (self) {
+        
+        //
+        //  the operation may have been cancelled while it was being prepared
+        //
+        if ([self isCancelled])
+        {
+            [self notifyCancellation];
+            [self completeOperation];
+            
+            return;
+        }
+        
+        self.task = [self.session dataTaskWithRequest:self.request];
+    }
     
     //
     //  post notification for network monitoring
@@ -141,6 +192,32 @@
 }
 
 
+- (void)cancel
+{
+    [super cancel];
+    
+    //
+    //  release the partially received response right away
+    //
+    @synchronized (self) {
+        
+        self.responseData = nil;
+        
+        //
+        //  a request on hold no longer waits for the gateway; it should not count toward the maximum number of requests on hold
+        //
+        for (NSOperation *dependency in self.dependencies)
+        {
+            if ([dependency isKindOfClass:[MASGatewayReachabilityOperation class]] && !dependency.isFinished)
+            {
+                [(MASGatewayReachabilityOperation *)dependency removePendingOperation];
+                [self removeDependency:dependency];
+            }
+        }
+    }
+}
+
+
 - (void)setExecuting:(BOOL)executing
 {
     if (executing != _executing)
@@ -170,6 +247,29 @@
     __block id responseObj = nil;
     __block NSURLSessionTask *blockTask = task;
     
+    //
+    //  the response of a cancelled request is discarded without being parsed
+    //
+    if ([self isCancelled])
+    {
+        @synchronized (self) {
+            self.responseData = nil;
+        }
+        
+        [self notifyCancellation];
+        [self completeOperation];
+        
+        return;
+    }
+    
+    //
+    //  report the outcome to the gateway endpoint selector for health tracking
+    //
+    if (self.endpointSelector && task.originalRequest.URL)
+    {
+        [self.endpointSelector recordCompletionForURL:task.originalRequest.URL response:task.response error:error];
+    }
+    
     if (error)
     {
         if (self.didCompleteWithDataErrorBlock)
@@ -185,6 +285,10 @@
         NSError *serializationError = nil;
         responseObj = [self.responseSerializer responseObjectForResponse:task.response data:self.responseData error:&serializationError];
         
+        @synchronized (self) {
+            self.responseData = nil;
+        }
+        
         
         if (self.didCompleteWithDataErrorBlock)
         {
@@ -198,9 +302,16 @@
     //
     //  post notification for network monitoring
     //
+    __block NSURLSessionTaskMetrics *blockMetrics = self.metrics;
     dispatch_async(dispatch_get_main_queue(), ^{
+        NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+        if (responseObj)
+            [userInfo setObject:responseObj forKey:MASSessionTaskDidCompleteSerializedResponseKey];
+        if (blockMetrics)
+            [userInfo setObject:blockMetrics forKey:MASSessionTaskDidCompleteMetricsKey];
+        
         if (responseObj)
-            [[NSNotificationCenter defaultCenter] postNotificationName:MASSessionTaskDidCompleteNotification object:blockTask userInfo:@{MASSessionTaskDidCompleteSerializedResponseKey:responseObj}];
+            [[NSNotificationCenter defaultCenter] postNotificationName:MASSessionTaskDidCompleteNotification object:blockTask userInfo:userInfo];
         else
             [[NSNotificationCenter defaultCenter] postNotificationName:MASSessionTaskDidResumeNotification object:blockTask];
     });
@@ -239,12 +350,23 @@
         });
     }
     else {
-        if (!self.responseData)
-        {
-            self.responseData = [NSMutableData dataWithData:data];
-        }
-        else {
-            [self.responseData appendData:data];
+        @synchronized (self) {
+            
+            //
+            //  data arriving after cancellation is dropped
+            //
+            if ([self isCancelled])
+            {
+                return;
+            }
+            
+            if (!self.responseData)
+            {
+                self.responseData = [NSMutableData dataWithData:data];
+            }
+            else {
+                [self.responseData appendData:data];
+            }
         }
     }
     
@@ -48,6 +48,7 @@ typedef NSCachedURLResponse * (^MASNetworkDataTaskWillCacheResponseBlock)(NSURLS
 @property (nonatomic, copy) MASNetworkNeedNewBodyStreamBlock needNewBodyStreamBlock;
 @property (nonatomic, copy) MASNetworkWillPerformHTTPRedirectionBlock willPerformHTTPRedirectBlock;
 @property (nonatomic, strong) id <MASIURLResponseSerialization> responseSerializer;
+@property (nonatomic, strong) NSURLSessionTaskMetrics *metrics;
 
 
 ///--------------------------------------
@@ -91,6 +92,13 @@ typedef NSCachedURLResponse * (^MASNetworkDataTaskWillCacheResponseBlock)(NSURLS
 
 
 
+/**
+ Notify didCompleteWithDataErrorBlock that the operation was cancelled
+ */
+- (void)notifyCancellation;
+
+
+
 /**
  Default dispatch group for completion block
 
@@ -94,6 +94,18 @@
 }
 
 
+- (void)notifyCancellation
+{
+    if (self.didCompleteWithDataErrorBlock)
+    {
+        dispatch_group_async(self.completionGroup ? self.completionGroup : [self defaultDispatchGroupForCompletionBlock], self.completionQueue ? self.completionQueue : dispatch_get_main_queue(), ^{
+            
+            self.didCompleteWithDataErrorBlock(nil, nil, nil, [NSError errorDataTaskCancelled]);
+        });
+    }
+}
+
+
 - (void)setTaskDidReceiveAuthenticationChallengeBlock:(nullable NSURLSessionAuthChallengeDisposition (^)(NSURLSession * _Nonnull session, NSURLSessionTask * _Nonnull task, NSURLAuthenticationChallenge * _Nonnull challenge, NSURLCredential * __nullable __autoreleasing * __nullable credential))block
 {
     self.taskAuthenticationChallengeBlock = block;
@@ -121,32 +133,49 @@
 
 - (void)start
 {
-    if ([self isCancelled])
-    {
-        self.finished = YES;
-        return;
+    @synchronized (self) {
+        
+        if ([self isCancelled])
+        {
+            self.finished = YES;
+            return;
+        }
+        
+        self.executing = YES;
     }
     
-    self.executing = YES;
-    
     [self.task resume];
 }
 
 
 - (void)cancel
 {
-    if(!self.isExecuting){
-        [self.task cancel];
-        [super cancel];
-        if(self.didCompleteWithDataErrorBlock){
-            self.didCompleteWithDataErrorBlock(nil, nil, nil, [NSError errorDataTaskCancelled]);
+    BOOL wasExecuting = NO;
+    
+    //
+    //  synchronized with start of the operation, so that the cancellation is either seen by start, or cancels the task created by start
+    //
+    @synchronized (self) {
+        
+        if ([self isCancelled] || self.isFinished)
+        {
+            return;
         }
         
-        return;
+        [super cancel];
+        wasExecuting = self.isExecuting;
     }
     
+    //
+    //  Cancelling the running task stops the transfer, and the cancellation is reported once through the session delegate.
+    //  If the operation has not started yet, it finishes without executing; report the cancellation right away.
+    //
     [self.task cancel];
-    [super cancel];
+    
+    if (!wasExecuting)
+    {
+        [self notifyCancellation];
+    }
 }
 
 
@@ -234,6 +263,15 @@
 }
 
 
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didFinishCollectingMetrics:(NSURLSessionTaskMetrics *)metrics
+{
+    //
+    //  metrics are delivered before the task completes; keep them for the completion notification
+    //
+    self.metrics = metrics;
+}
+
+
 - (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(nullable NSError *)error
 {
     if (self.didCompleteWithDataErrorBlock)
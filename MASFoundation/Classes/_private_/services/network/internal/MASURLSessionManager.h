@@ -11,6 +11,7 @@
 #import <Foundation/Foundation.h>
 
 #import "MASAuthValidationOperation.h"
+#import "MASGatewayEndpointSelector.h"
 #import "MASSecurityPolicy.h"
 #import "MASSessionDataTaskOperation.h"
 #import "MASURLRequest.h"
@@ -47,6 +48,12 @@ typedef void (^MASNetworkSessionDidFinishEventsForBackgroundURLSessionBlock)(NSU
 @property (readwrite, nonatomic, strong) MASSecurityPolicy *securityPolicy;
 
 
+/**
+ MASGatewayEndpointSelector object; responsible for routing requests among equivalent gateway endpoints.  nil if no alternate gateway is configured.
+ */
+@property (readwrite, nonatomic, strong) MASGatewayEndpointSelector *endpointSelector;
+
+
 
 ///--------------------------------------
 /// @name Initialization
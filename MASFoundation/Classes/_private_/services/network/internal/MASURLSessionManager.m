@@ -157,9 +157,26 @@
 - (MASSessionDataTaskOperation *)dataOperationWithRequest:(MASURLRequest *)request completionHandler:(MASSessionDataTaskCompletionBlock)completionHandler
 {
     MASSessionDataTaskOperation *dataTask = [[MASSessionDataTaskOperation alloc] initWithSession:_session request:request];
-    [self.operations addObject:dataTask];
+    dataTask.endpointSelector = self.endpointSelector;
+    [self addSessionTaskOperation:dataTask];
     
+    __weak MASSessionDataTaskOperation *weakDataTask = dataTask;
+    __weak MASURLSessionManager *weakSelf = self;
     dataTask.didCompleteWithDataErrorBlock = ^(NSURLSession *session, NSURLSessionTask *task, NSData *data, NSError *error) {
+        
+        //
+        //  the operation may have been cancelled after the result was dispatched; deliver the cancellation instead of the result
+        //
+        if (weakDataTask.isCancelled && !(error.code == MASFoundationErrorCodeTaskCancelled && [error.domain isEqualToString:MASFoundationErrorDomainLocal]))
+        {
+            data = nil;
+            error = [NSError errorDataTaskCancelled];
+        }
+        
+        //
+        //  operations that finished without a session task (i.e. cancelled before start) are not removed by the session delegate
+        //
+        [weakSelf removeSessionTaskOperation:weakDataTask];
       
         if (completionHandler)
         {
@@ -173,11 +190,27 @@
 -(MASSessionDataTaskOperation *)fileUploadOperation:(MASURLRequest *)request progress:(MASFileRequestProgressBlock)progress completionHandler:(MASSessionDataTaskCompletionBlock)completionHandler
 {
     MASSessionDataTaskOperation *dataTask = [[MASSessionDataTaskOperation alloc] initWithSession:_session request:request progress:progress];
+    dataTask.endpointSelector = self.endpointSelector;
+    [self addSessionTaskOperation:dataTask];
     
-    [self.operations addObject:dataTask];
-    
+    __weak MASSessionDataTaskOperation *weakDataTask = dataTask;
+    __weak MASURLSessionManager *weakSelf = self;
     dataTask.didCompleteWithDataErrorBlock = ^(NSURLSession *session, NSURLSessionTask *task, NSData *data, NSError *error) {
         
+        //
+        //  the operation may have been cancelled after the result was dispatched; deliver the cancellation instead of the result
+        //
+        if (weakDataTask.isCancelled && !(error.code == MASFoundationErrorCodeTaskCancelled && [error.domain isEqualToString:MASFoundationErrorDomainLocal]))
+        {
+            data = nil;
+            error = [NSError errorDataTaskCancelled];
+        }
+        
+        //
+        //  operations that finished without a session task (i.e. cancelled before start) are not removed by the session delegate
+        //
+        [weakSelf removeSessionTaskOperation:weakDataTask];
+        
         if (completionHandler)
         {
             completionHandler(task.response, data, error);
@@ -275,11 +308,13 @@
 {
     MASSessionTaskOperation *taskOperation = nil;
     
-    for (MASSessionTaskOperation *operation in self.operations)
-    {
-        if ([operation.task isEqual:task])
+    @synchronized (self.operations) {
+        for (MASSessionTaskOperation *operation in self.operations)
         {
-            taskOperation = operation;
+            if ([operation.task isEqual:task])
+            {
+                taskOperation = operation;
+            }
         }
     }
     
@@ -291,11 +326,13 @@
 {
     MASSessionDataTaskOperation *dataTaskOperation = nil;
     
-    for (MASSessionDataTaskOperation *operation in self.operations)
-    {
-        if ([operation.task isEqual:dataTask])
+    @synchronized (self.operations) {
+        for (MASSessionDataTaskOperation *operation in self.operations)
         {
-            dataTaskOperation = operation;
+            if ([operation.task isEqual:dataTask])
+            {
+                dataTaskOperation = operation;
+            }
         }
     }
     
@@ -307,8 +344,26 @@
 {
     MASSessionTaskOperation *operation = [self taskOperationWithTask:task];
     
-    if (operation)
+    [self removeSessionTaskOperation:operation];
+}
+
+
+- (void)addSessionTaskOperation:(MASSessionTaskOperation *)operation
+{
+    @synchronized (self.operations) {
+        [self.operations addObject:operation];
+    }
+}
+
+
+- (void)removeSessionTaskOperation:(MASSessionTaskOperation *)operation
+{
+    if (!operation)
     {
+        return;
+    }
+    
+    @synchronized (self.operations) {
         [self.operations removeObject:operation];
     }
 }
@@ -349,6 +404,17 @@
 }
 
 
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didFinishCollectingMetrics:(NSURLSessionTaskMetrics *)metrics
+{
+    MASSessionTaskOperation *operation = [self taskOperationWithTask:task];
+    
+    if ([operation respondsToSelector:@selector(URLSession:task:didFinishCollectingMetrics:)])
+    {
+        [operation URLSession:session task:task didFinishCollectingMetrics:metrics];
+    }
+}
+
+
 - (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition disposition, NSURLCredential *credential))completionHandler {
     MASSessionTaskOperation *operation = [self taskOperationWithTask:task];
     
@@ -31,6 +31,8 @@
 @property (nonatomic, strong) NSString *endPoint;
 @property (nonatomic, strong) NSDictionary *parameterInfo;
 @property (nonatomic, strong) NSDictionary *headerInfo;
+@property (assign) BOOL compressRequestBody;
+@property (assign) NSUInteger compressionThreshold;
 
 
 ///--------------------------------------
@@ -41,6 +43,14 @@
 
 - (MASURLRequest *)rebuildRequest;
 
+
+/**
+ * Gzip compress the HTTP body of the request when compressRequestBody is enabled and the body is larger than
+ * compressionThreshold.  The compressed body is only used, and Content-Encoding set, when it is smaller than the original body.
+ * Calling this method on a request which is already encoded has no effect.
+ */
+- (void)compressBodyIfNeeded;
+
 /**
  * Format the incoming parameter info dictionary specified by the request type and turn it into
  * data.  This method is typically used for HTTP PATCH, POST, PUT requests.
@@ -10,6 +10,8 @@
 
 #import "MASURLRequest.h"
 
+#import "NSData+MASPrivate.h"
+
 NSString * const MASRequestResponseTypeJsonValue = @"application/json";
 NSString * const MASRequestResponseTypeScimJsonValue = @"application/scim+json";
 NSString * const MASRequestResponseTypeTextPlainValue = @"text/plain";
@@ -40,6 +42,43 @@ NSString * const MASRequestResponseTypeFormDataValue = @"multipart/form-data";
 }
 
 
+- (void)compressBodyIfNeeded
+{
+    NSData *body = [self HTTPBody];
+    
+    //
+    // Nothing to do if compression is disabled, the body is too small, or the body was already encoded
+    //
+    if (!self.compressRequestBody || !body || [body length] < self.compressionThreshold || [self valueForHTTPHeaderField:MASContentEncodingRequestResponseKey])
+    {
+        return;
+    }
+    
+    NSData *compressedBody = [body gzipCompressedData];
+    
+    //
+    // Incompressible payloads (i.e. images in multipart form) are sent as they are
+    //
+    if (!compressedBody || [compressedBody length] >= [body length])
+    {
+        return;
+    }
+    
+    DLog(@"Request body compressed from %lu to %lu bytes", (unsigned long)[body length], (unsigned long)[compressedBody length]);
+    
+    [self setHTTPBody:compressedBody];
+    [self setValue:MASContentEncodingGzipValue forHTTPHeaderField:MASContentEncodingRequestResponseKey];
+    
+    //
+    // Multipart requests carry an explicit Content-Length which has to match the compressed body
+    //
+    if ([self valueForHTTPHeaderField:MASContentLengthRequestResponseKey])
+    {
+        [self setValue:[NSString stringWithFormat:@"%lu", (unsigned long)[compressedBody length]] forHTTPHeaderField:MASContentLengthRequestResponseKey];
+    }
+}
+
+
 + (NSString *)endPoint:(NSString *)endPoint byAppendingParameterInfo:(NSDictionary *)parameterInfo
 {
     //
@@ -78,4 +78,40 @@
  */
 - (void)generateKeypair;
 
+
+
+///--------------------------------------
+/// @name Signing
+///--------------------------------------
+
+# pragma mark - Signing
+
+/**
+ * Sign the data with the private key of the registered device, using RSA PKCS#1 v1.5 with SHA-256 (RS256).
+ *
+ * The private key is retrieved from the keychain on the first signature only, and kept until the keypair is deleted or generated,
+ * the client certificate is renewed, the device is deregistered or reset, or the gateway is switched.
+ *
+ * @param data The data to sign.
+ * @param error NSError object that may be returned if the data could not be signed.
+ * @return Returns the signature, or nil if the data could not be signed.
+ */
+- (NSData *)signData:(NSData *)data error:(NSError **)error;
+
+
+
+/**
+ * Sign with the private key until it is invalidated, instead of the one of the registered device retrieved from the keychain.
+ *
+ * @param signingKey The RSA private key to sign with.
+ */
+- (void)setSigningKey:(SecKeyRef)signingKey;
+
+
+
+/**
+ * Release the private key kept for signing; it is retrieved from the keychain again on the next signature.
+ */
+- (void)invalidateSigningKey;
+
 @end
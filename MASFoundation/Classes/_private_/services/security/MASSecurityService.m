@@ -19,6 +19,12 @@
 #define kAsymmetricSecKeyPairModulusSize 2048
 
 @interface MASSecurityService ()
+{
+    //
+    //  Private key of the registered device, kept to sign without a keychain round trip; guarded by @synchronized(self)
+    //
+    SecKeyRef _signingKey;
+}
 
 @end
 
@@ -58,6 +64,15 @@ static MASSecurityService *_sharedService_ = nil;
 
 - (void)serviceWillStart
 {
+    //
+    //  The signing key is released whenever the keypair or the registration of the device changes
+    //
+    NSNotificationCenter *defaultCenter = [NSNotificationCenter defaultCenter];
+    [defaultCenter addObserver:self selector:@selector(invalidateSigningKey) name:MASDeviceDidRenewClientCertificateNotification object:nil];
+    [defaultCenter addObserver:self selector:@selector(invalidateSigningKey) name:MASDeviceDidDeregisterNotification object:nil];
+    [defaultCenter addObserver:self selector:@selector(invalidateSigningKey) name:MASDeviceDidResetLocallyNotification object:nil];
+    [defaultCenter addObserver:self selector:@selector(invalidateSigningKey) name:MASWillSwitchGatewayServerNotification object:nil];
+    
     [super serviceWillStart];
 }
 
@@ -84,8 +99,19 @@ static MASSecurityService *_sharedService_ = nil;
     [super serviceDidStart];
 }
 
+- (void)serviceDidStop
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self invalidateSigningKey];
+    
+    [super serviceDidStop];
+}
+
+
 - (void)serviceDidReset
 {
+    [self invalidateSigningKey];
+    
     [super serviceDidReset];
 }
 
@@ -211,6 +237,8 @@ static MASSecurityService *_sharedService_ = nil;
 
 - (void)deleteAsymmetricKeys
 {
+    [self invalidateSigningKey];
+    
     NSString *privateKeyIdentifierStr = [NSString stringWithFormat:@"%@.%@", [MASConfiguration currentConfiguration].gatewayUrl.absoluteString, @"privateKey"];
     NSString *publicKeyIdentifierStr = [NSString stringWithFormat:@"%@.%@", [MASConfiguration currentConfiguration].gatewayUrl.absoluteString, @"publicKey"];
     
@@ -271,6 +299,8 @@ static MASSecurityService *_sharedService_ = nil;
         return;
     }
     
+    [self invalidateSigningKey];
+    
     //
     // Generate asymetric keys and save the private key into the keychain and return the public key
     //
@@ -395,6 +425,89 @@ static MASSecurityService *_sharedService_ = nil;
 }
 
 
+# pragma mark - Signing
+
+- (NSData *)signData:(NSData *)data error:(NSError **)error
+{
+    SecKeyRef privateKey = NULL;
+    
+    @synchronized(self)
+    {
+        if (_signingKey == NULL)
+        {
+            _signingKey = [[MASAccessService sharedService] getAccessValueCryptoKeyWithStorageKey:MASKeychainStorageKeyPrivateKey];
+        }
+        
+        //
+        //  Retained for the signature, so that the key can be invalidated by another thread meanwhile
+        //
+        if (_signingKey != NULL)
+        {
+            privateKey = (SecKeyRef)CFRetain(_signingKey);
+        }
+    }
+    
+    if (privateKey == NULL)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSOSStatusErrorDomain code:errSecItemNotFound userInfo:nil];
+        }
+        
+        return nil;
+    }
+    
+    CFErrorRef signError = NULL;
+    NSData *signature = (__bridge_transfer NSData *)SecKeyCreateSignature(privateKey, kSecKeyAlgorithmRSASignatureMessagePKCS1v15SHA256, (__bridge CFDataRef)data, &signError);
+    CFRelease(privateKey);
+    
+    if (signature == nil)
+    {
+        NSError *signatureError = (__bridge_transfer NSError *)signError;
+        DLog(@"Error signing data with the private key: %@", signatureError);
+        
+        if (error)
+        {
+            *error = signatureError;
+        }
+    }
+    
+    return signature;
+}
+
+
+- (void)setSigningKey:(SecKeyRef)signingKey
+{
+    @synchronized(self)
+    {
+        if (signingKey != NULL)
+        {
+            CFRetain(signingKey);
+        }
+        
+        if (_signingKey != NULL)
+        {
+            CFRelease(_signingKey);
+        }
+        
+        _signingKey = signingKey;
+    }
+}
+
+
+- (void)invalidateSigningKey
+{
+    @synchronized(self)
+    {
+        if (_signingKey != NULL)
+        {
+            CFRelease(_signingKey);
+            _signingKey = NULL;
+        }
+    }
+}
+
+
 - (void)checkKeypair
 {
     SecKeyRef privateKeyRef = [[MASAccessService sharedService] getAccessValueCryptoKeyWithStorageKey:MASKeychainStorageKeyPrivateKey];
@@ -117,6 +117,16 @@
 @property (nonatomic, strong, readonly, nonnull) NSURL *gatewayUrl;
 
 
+/**
+ * The list of alternate Gateway URLs that serve the same configuration as the primary Gateway,
+ * in a https://<hostname>:<port>/<prefix (if exists)> format.
+ * Requests to the primary Gateway are routed to the healthy endpoint with the lowest latency among these,
+ * and fail over automatically when an endpoint becomes unavailable.  Alternate Gateways use the primary Gateway's
+ * MASNetworkConfiguration and MASSecurityConfiguration unless one is set for their own host.  nil if no alternate host is configured.
+ */
+@property (nonatomic, strong, readonly, nullable) NSArray<NSURL *> *gatewayAlternateUrls;
+
+
 /**
  * Determines if a user's location coordinates are required.  This read only value 
  * is within the JSON configuration file and is set as a requirement of the application
@@ -25,6 +25,7 @@ static NSString *const MASGatewayCertificatesKey = @"server_certs"; // array
 static NSString *const MASGatewayHostNameKey = @"hostname"; // ip address or hostname
 static NSString *const MASGatewayPortKey = @"port"; // number
 static NSString *const MASGatewayPrefixKey = @"prefix"; // string
+static NSString *const MASGatewayAlternateHostsKey = @"alternate_hosts"; // array of Dictionary with hostname and port
 
 static NSString *const MASDefaultHttpsPrefix = @"https";
 
@@ -718,6 +719,53 @@ static float _systemVersionNumber_;
 }
 
 
+- (NSArray *)gatewayAlternateUrls
+{
+    NSDictionary *gatewayInfo = _configurationInfo_[MASGatewayConfigurationKey];
+    NSArray *alternateHosts = gatewayInfo[MASGatewayAlternateHostsKey];
+    
+    if (![alternateHosts isKindOfClass:[NSArray class]] || [alternateHosts count] == 0)
+    {
+        return nil;
+    }
+    
+    NSMutableArray *alternateUrls = [NSMutableArray array];
+    for (NSDictionary *alternateHost in alternateHosts)
+    {
+        if (![alternateHost isKindOfClass:[NSDictionary class]] || ![alternateHost[MASGatewayHostNameKey] isKindOfClass:[NSString class]])
+        {
+            continue;
+        }
+        
+        //
+        //  Alternate hosts share the prefix of the primary gateway, and the port unless specified
+        //
+        NSNumber *port = alternateHost[MASGatewayPortKey] ? alternateHost[MASGatewayPortKey] : [self gatewayPort];
+        NSURL *alternateUrl = nil;
+        
+        if ([self gatewayPrefix] && [self gatewayPrefix].length > 0)
+        {
+            alternateUrl = [NSURL URLWithString:[NSString stringWithFormat:@"https://%@:%@/%@",
+                                                 alternateHost[MASGatewayHostNameKey],
+                                                 port,
+                                                 [self gatewayPrefix]]];
+        }
+        else {
+            alternateUrl = [NSURL URLWithString:[NSString stringWithFormat:@"https://%@:%@",
+                                                 alternateHost[MASGatewayHostNameKey],
+                                                 port]];
+        }
+        
+        if (alternateUrl)
+        {
+            [alternateUrls addObject:alternateUrl];
+        }
+    }
+    
+    return [alternateUrls count] > 0 ? alternateUrls : nil;
+}
+
+
 # pragma mark - Endpoints
 
 - (NSString *)endpointPathForKey:(NSString *)endpointKey
@@ -1031,10 +1079,10 @@ static float _systemVersionNumber_;
     return [NSString stringWithFormat:@"(%@) is loaded: %@\n\n        application name: %@\n        application type: %@\n"
             "        application description: %@\n        application organization: %@\n        application registered by: %@\n"
             "        gateway host: %@\n        gateway port: %@\n        gateway prefix: %@\n        gateway url: %@\n"
-            "        location is required: %@\n        endpoint keys to paths: %@",
+            "        gateway alternate urls: %@\n        location is required: %@\n        endpoint keys to paths: %@",
             [self class], ([self isLoaded] ? @"Yes" : @"No"), [self applicationName], [self applicationType],
             [self applicationDescription], [self applicationOrganization], [self applicationRegisteredBy],
-            [self gatewayHostName], [self gatewayPort], [self gatewayPrefix], [self gatewayUrl],
+            [self gatewayHostName], [self gatewayPort], [self gatewayPrefix], [self gatewayUrl], [self gatewayAlternateUrls],
             ([self locationIsRequired] ? @"Yes" : @"No"), endpoints];
 }
 
@@ -29,6 +29,22 @@ The NSTimeInterval value that specifies the global timeInterval of all the reque
 
 
 
+/**
+ BOOL value that determines whether or not request bodies sent to the host are gzip compressed.
+ Only bodies larger than requestCompressionThreshold are compressed, and the compressed body is only used when it is smaller than the original.
+ The target host must accept `Content-Encoding: gzip` request bodies.
+ */
+@property (assign) BOOL compressRequestBody;
+
+
+
+/**
+ NSUInteger value of the minimum request body size, in bytes, before the request body is compressed.
+ */
+@property (assign) NSUInteger requestCompressionThreshold;
+
+
+
 /**
  NSURL value of the target host.
  */
@@ -45,7 +61,7 @@ The NSTimeInterval value that specifies the global timeInterval of all the reque
 /**
  Designated initializer for MASNetworkConfiguration.
 
- @discussion default values for designated initializer are: timeoutInterval : 60.
+ @discussion default values for designated initializer are: timeoutInterval : 60, compressRequestBody : NO, requestCompressionThreshold : 1024.
  @param url NSURL of the target domain
  @return MASNetworkConfiguration object
  */
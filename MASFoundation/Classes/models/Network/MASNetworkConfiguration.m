@@ -32,6 +32,8 @@
     if (self) {
         self.host = [NSURL URLWithString:[NSString stringWithFormat:@"%@://%@:%@", url.scheme, url.host, url.port]];
         self.timeoutInterval = MASDefaultNetworkTimeoutConfiguration;
+        self.compressRequestBody = NO;
+        self.requestCompressionThreshold = MASDefaultRequestCompressionThreshold;
     }
     
     return self;
@@ -90,6 +90,18 @@ The NSTimeInterval value that specifies the timeInterval of the request.
 @property (assign, readonly) NSTimeInterval timeoutInterval;
 
 
+/**
+ BOOL value that determines whether or not to gzip compress the request body.
+ */
+@property (assign, readonly) BOOL compressRequestBody;
+
+
+/**
+ BOOL value that determines whether or not the request waits for the primary gateway to become reachable.
+ */
+@property (assign, readonly) BOOL waitsForConnectivity;
+
+
 # pragma mark - Public
 
 
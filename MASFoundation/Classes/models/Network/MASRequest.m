@@ -23,6 +23,8 @@
 @property (assign, readwrite) MASRequestResponseType requestType;
 @property (assign, readwrite) MASRequestResponseType responseType;
 @property (assign, readwrite) NSTimeInterval timeoutInterval;
+@property (assign, readwrite) BOOL compressRequestBody;
+@property (assign, readwrite) BOOL waitsForConnectivity;
 
 @end
 
@@ -20,6 +20,8 @@
  isPublic: NO,
  timeoutInterval: 60,
  sign: NO,
+ compressRequestBody: NO,
+ waitsForConnectivity: NO,
  requestType:MASRequestResponseTypeJson, 
  responseType:MASRequestResponseTypeJson.
  */
@@ -105,6 +107,23 @@ The NSTimeInterval value that specifies the timeInterval of the request.
 @property (assign) NSTimeInterval timeoutInterval;
 
 
+
+/**
+ BOOL value that determines whether or not to gzip compress the request body.
+ When NO, the MASNetworkConfiguration of the target host decides whether the body is compressed.
+ */
+@property (assign) BOOL compressRequestBody;
+
+
+
+/**
+ BOOL value that determines whether or not the request waits for the primary gateway to become reachable, instead of failing, while the gateway is not reachable.
+ The request is held for up to 60 seconds, and fails right away if too many requests are already on hold.
+ Intended for non-interactive requests, such as background synchronization.
+ */
+@property (assign) BOOL waitsForConnectivity;
+
+
 ///--------------------------------------
 /// @name Lifecycle
 ///--------------------------------------
@@ -39,6 +39,8 @@
         self.requestType = MASRequestResponseTypeJson;
         self.responseType = MASRequestResponseTypeJson;
         self.timeoutInterval = MASDefaultNetworkTimeoutConfiguration; // default to 60 seconds.
+        self.compressRequestBody = NO;
+        self.waitsForConnectivity = NO;
     }
     
     return self;
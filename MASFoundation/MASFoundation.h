@@ -34,6 +34,7 @@ FOUNDATION_EXPORT const unsigned char MASFoundationVersionString[];
 //
 #import <MASFoundation/MASMQTTClient.h>
 #import <MASFoundation/MASMQTTMessage.h>
+#import <MASFoundation/MASMQTTBatchPublisher.h>
 #import <MASFoundation/MASMQTTConstants.h>
 
 //
@@ -10,7 +10,13 @@
 #import "JWTAlgorithm.h"
 @interface JWTAlgorithmFactory : NSObject
 
+/* Registered algorithms; built once and shared, not copied per call. */
 + (NSArray *)algorithms;
+
+/* Case-insensitive lookup of a registered algorithm. The instance is shared; algorithms are copied before keys are set on them. */
 + (id<JWTAlgorithm>)algorithmByName:(NSString *)name;
 
+/* Registers an additional algorithm, replacing a registered one with the same name. */
++ (void)registerAlgorithm:(id<JWTAlgorithm>)algorithm;
+
 @end
@@ -16,36 +16,79 @@ NSString *const JWTAlgorithmNameES256 = @"ES256";
 NSString *const JWTAlgorithmNameES384 = @"ES384";
 NSString *const JWTAlgorithmNameES512 = @"ES512";
 
+/* Immutable snapshots, replaced as a whole when an algorithm is registered. */
+static NSArray *JWTAlgorithmFactoryAlgorithms = nil;
+static NSDictionary *JWTAlgorithmFactoryAlgorithmsByName = nil;
+
 @implementation JWTAlgorithmFactory
 
-+ (NSArray *)algorithms {
-    return @[
-            [JWTAlgorithmNone new],
-            [JWTAlgorithmHSBase algorithm256],
-            [JWTAlgorithmHSBase algorithm384],
-            [JWTAlgorithmHSBase algorithm512],
-            [JWTAlgorithmRSBase algorithm256],
-            [JWTAlgorithmRSBase algorithm384],
-            [JWTAlgorithmRSBase algorithm512]
-            ];
++ (void)initialize {
+    if (self != [JWTAlgorithmFactory class]) {
+        return;
+    }
+    [self setAlgorithms:@[
+                          [JWTAlgorithmNone new],
+                          [JWTAlgorithmHSBase algorithm256],
+                          [JWTAlgorithmHSBase algorithm384],
+                          [JWTAlgorithmHSBase algorithm512],
+                          [JWTAlgorithmRSBase algorithm256],
+                          [JWTAlgorithmRSBase algorithm384],
+                          [JWTAlgorithmRSBase algorithm512]
+                          ]];
+}
 
++ (void)setAlgorithms:(NSArray *)algorithms {
+    NSMutableDictionary *algorithmsByName = [NSMutableDictionary dictionaryWithCapacity:algorithms.count * 2];
+    for (id<JWTAlgorithm> algorithm in algorithms) {
+        /* keyed by the name as is for the common exact match, and lowercased for case-insensitive lookup */
+        algorithmsByName[algorithm.name] = algorithm;
+        algorithmsByName[algorithm.name.lowercaseString] = algorithm;
+    }
+    @synchronized (self) {
+        JWTAlgorithmFactoryAlgorithms = [algorithms copy];
+        JWTAlgorithmFactoryAlgorithmsByName = [algorithmsByName copy];
+    }
+}
+
++ (NSArray *)algorithms {
+    @synchronized (self) {
+        return JWTAlgorithmFactoryAlgorithms;
+    }
 }
 
 + (id<JWTAlgorithm>)algorithmByName:(NSString *)name {
-    id<JWTAlgorithm> algorithm = nil;
+    if (!name) {
+        return nil;
+    }
     
-    NSString *algName = [name copy];
+    NSDictionary *algorithmsByName = nil;
+    @synchronized (self) {
+        algorithmsByName = JWTAlgorithmFactoryAlgorithmsByName;
+    }
     
-    NSUInteger index = [[self algorithms] indexOfObjectPassingTest:^BOOL(id<JWTAlgorithm> obj, NSUInteger idx, BOOL *stop) {
+    id<JWTAlgorithm> algorithm = algorithmsByName[name];
+    if (!algorithm) {
         // lowercase comparison
-        return [obj.name.lowercaseString isEqualToString:algName.lowercaseString];
-    }];
-    
-    if (index != NSNotFound) {
-        algorithm = [self algorithms][index];
+        algorithm = algorithmsByName[name.lowercaseString];
     }
     
     return algorithm;
 }
 
-@end
\ No newline at end of file
++ (void)registerAlgorithm:(id<JWTAlgorithm>)algorithm {
+    if (!algorithm.name) {
+        return;
+    }
+    @synchronized (self) {
+        NSMutableArray *algorithms = [NSMutableArray arrayWithCapacity:JWTAlgorithmFactoryAlgorithms.count + 1];
+        for (id<JWTAlgorithm> registeredAlgorithm in JWTAlgorithmFactoryAlgorithms) {
+            if (![registeredAlgorithm.name.lowercaseString isEqualToString:algorithm.name.lowercaseString]) {
+                [algorithms addObject:registeredAlgorithm];
+            }
+        }
+        [algorithms addObject:algorithm];
+        [self setAlgorithms:algorithms];
+    }
+}
+
+@end
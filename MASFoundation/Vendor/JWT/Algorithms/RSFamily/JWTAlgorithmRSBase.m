@@ -41,8 +41,10 @@ NSString *const JWTAlgorithmNameRS512 = @"RS512";
 
 #pragma mark - NSCopying
 - (id)copyWithZone:(NSZone *)zone {
-    // create new.
-    id <JWTRSAlgorithm> algorithm = (id<JWTRSAlgorithm>)[JWTAlgorithmFactory algorithmByName:[self name]];
+    // create new; the factory shares its instances, so a new instance of the registered class is created.
+    id <JWTAlgorithm> registeredAlgorithm = [JWTAlgorithmFactory algorithmByName:[self name]];
+    Class algorithmClass = registeredAlgorithm ? [registeredAlgorithm class] : [self class];
+    id <JWTRSAlgorithm> algorithm = (id<JWTRSAlgorithm>)[algorithmClass new];
     algorithm.privateKeyCertificatePassphrase = self.privateKeyCertificatePassphrase;
     algorithm.keyExtractorType = self.keyExtractorType;
     algorithm.signKey = self.signKey;
@@ -281,7 +281,9 @@
     NSString *signedOutput;
     
     if ([self.jwtAlgorithm conformsToProtocol:@protocol(JWTRSAlgorithm)]) {
-        id<JWTRSAlgorithm> jwtRsAlgorithm = (id <JWTRSAlgorithm>) self.jwtAlgorithm;
+        /* algorithms from the factory are shared, so the passphrase is set on a copy */
+        id<JWTRSAlgorithm> jwtRsAlgorithm = [(id <JWTRSAlgorithm>) self.jwtAlgorithm copyWithZone:nil];
+        self.jwtAlgorithm = jwtRsAlgorithm;
         jwtRsAlgorithm.privateKeyCertificatePassphrase = self.jwtPrivateKeyCertificatePassphrase;
     }
     if (self.jwtSecretData && [self.jwtAlgorithm respondsToSelector:@selector(encodePayloadData:withSecret:)]) {
@@ -22,15 +22,29 @@ typedef NS_ENUM(NSInteger, MQTTCFSocketEncoderState) {
 
 @end
 
+/** MQTTCFSocketEncoder writes messages to the output stream.
+ *
+ * Messages are kept in a queue of immutable segments written with an offset cursor, so a partial
+ * write never moves the remaining bytes. Fixed headers and small messages are collected in a
+ * reusable scratch buffer and written together; larger data is queued without being copied.
+ * When a queue is set, writing small messages is deferred to it so that messages sent in the same
+ * turn of the queue are coalesced into one write. As send has already returned TRUE for them,
+ * a failure writing deferred messages is reported through encoder:didFailWithError:.
+ */
 @interface MQTTCFSocketEncoder : NSObject <NSStreamDelegate>
 @property (nonatomic) MQTTCFSocketEncoderState state;
 @property (strong, nonatomic) NSError *error;
 @property (strong, nonatomic) NSOutputStream *stream;
+@property (strong, nonatomic) dispatch_queue_t queue;
 @property (weak, nonatomic ) id<MQTTCFSocketEncoderDelegate> delegate;
 
+/** the number of bytes accepted by send but not yet written to the stream */
+@property (readonly) NSUInteger bufferedLength;
+
 - (void)open;
 - (void)close;
 - (BOOL)send:(NSData *)data;
+- (BOOL)sendFixedHeader:(const UInt8 *)fixedHeader length:(NSUInteger)length data:(NSData *)data;
 
 @end
 
@@ -9,8 +9,20 @@
 
 #import "MQTTLog.h"
 
+/* data up to this length is copied into the scratch buffer instead of being queued as its own segment */
+static const NSUInteger MQTTCFSocketEncoderCopyThreshold = 512;
+
+/* capacity of a scratch buffer collecting fixed headers and small messages */
+static const NSUInteger MQTTCFSocketEncoderScratchCapacity = 16 * 1024;
+
 @interface MQTTCFSocketEncoder()
-@property (strong, nonatomic) NSMutableData *buffer;
+@property (strong, nonatomic) NSMutableArray<NSData *> *segments;
+@property (nonatomic) NSUInteger segmentOffset;
+@property (strong, nonatomic) NSMutableData *scratch;
+@property (nonatomic) BOOL scratchQueued;
+@property (strong, nonatomic) NSMutableData *openBuffer;
+@property (nonatomic) BOOL writeScheduled;
+@property (readwrite) NSUInteger bufferedLength;
 
 @end
 
@@ -19,7 +31,10 @@
 - (instancetype)init {
     self = [super init];
     self.state = MQTTCFSocketEncoderStateInitializing;
-    self.buffer = [[NSMutableData alloc] init];
+    self.segments = [[NSMutableArray alloc] init];
+    self.segmentOffset = 0;
+    self.scratch = [[NSMutableData alloc] initWithCapacity:MQTTCFSocketEncoderScratchCapacity];
+    self.scratchQueued = FALSE;
     self.stream = nil;
     return self;
 }
@@ -34,6 +49,12 @@
 }
 
 - (void)close {
+    @synchronized(self) {
+        // messages whose write was deferred to the queue are flushed before the stream goes away
+        if (self.state == MQTTCFSocketEncoderStateReady && self.segments.count) {
+            [self write];
+        }
+    }
     [self.stream close];
     [self.stream setDelegate:nil];
 }
@@ -60,11 +81,7 @@
             [self.delegate encoderDidOpen:self];
         }
         
-        if (self.state == MQTTCFSocketEncoderStateReady) {
-            if (self.buffer.length) {
-                [self send:nil];
-            }
-        }
+        [self writeReportingFailure];
     }
     
     if (eventCode &  NSStreamEventEndEncountered) {
@@ -83,37 +100,126 @@
 }
 
 - (BOOL)send:(NSData *)data {
+    return [self sendFixedHeader:NULL length:0 data:data];
+}
+
+- (BOOL)sendFixedHeader:(const UInt8 *)fixedHeader length:(NSUInteger)length data:(NSData *)data {
     @synchronized(self) {
         if (self.state != MQTTCFSocketEncoderStateReady) {
             DDLogInfo(@"[MQTTCFSocketEncoder] not MQTTCFSocketEncoderStateReady");
             return FALSE;
         }
-        
-        if (data) {
-            [self.buffer appendData:data];
+
+        if (length) {
+            [self appendBytes:fixedHeader length:length];
         }
-        
-        if (self.buffer.length) {
-            DDLogVerbose(@"[MQTTCFSocketEncoder] buffer to write (%lu)=%@...",
-                         (unsigned long)self.buffer.length,
-                         [self.buffer subdataWithRange:NSMakeRange(0, MIN(256, self.buffer.length))]);
-            
-            NSInteger n = [self.stream write:self.buffer.bytes maxLength:self.buffer.length];
-            
-            if (n == -1) {
-                DDLogVerbose(@"[MQTTCFSocketEncoder] streamError: %@", self.error);
-                self.state = MQTTCFSocketEncoderStateError;
-                self.error = self.stream.streamError;
-                return FALSE;
-            } else {
-                if (n < self.buffer.length) {
-                    DDLogVerbose(@"[MQTTCFSocketEncoder] buffer partially written: %ld", (long)n);
-                }
-                [self.buffer replaceBytesInRange:NSMakeRange(0, n) withBytes:NULL length:0];
+        if (data.length) {
+            [self appendData:data];
+        }
+
+        if (self.queue && data.length <= MQTTCFSocketEncoderCopyThreshold) {
+            [self scheduleWrite];
+            return TRUE;
+        }
+        return [self write];
+    }
+}
+
+- (void)appendBytes:(const void *)bytes length:(NSUInteger)length {
+    if (!self.openBuffer || self.openBuffer.length + length > MQTTCFSocketEncoderScratchCapacity) {
+        NSMutableData *buffer;
+        if (!self.scratchQueued) {
+            buffer = self.scratch;
+            self.scratchQueued = TRUE;
+        } else {
+            buffer = [[NSMutableData alloc] initWithCapacity:MQTTCFSocketEncoderScratchCapacity];
+        }
+        [self.segments addObject:buffer];
+        self.openBuffer = buffer;
+    }
+    [self.openBuffer appendBytes:bytes length:length];
+    self.bufferedLength += length;
+}
+
+- (void)appendData:(NSData *)data {
+    if (data.length <= MQTTCFSocketEncoderCopyThreshold) {
+        [self appendBytes:data.bytes length:data.length];
+    } else {
+        [self.segments addObject:data];
+        self.openBuffer = nil;
+        self.bufferedLength += data.length;
+    }
+}
+
+- (void)scheduleWrite {
+    if (!self.writeScheduled) {
+        self.writeScheduled = TRUE;
+        __weak MQTTCFSocketEncoder *weakSelf = self;
+        dispatch_async(self.queue, ^{
+            [weakSelf scheduledWrite];
+        });
+    }
+}
+
+- (void)scheduledWrite {
+    @synchronized(self) {
+        self.writeScheduled = FALSE;
+    }
+    [self writeReportingFailure];
+}
+
+/* send already reported success for messages written here, so a failed write is reported to the delegate */
+- (void)writeReportingFailure {
+    BOOL failed = FALSE;
+    @synchronized(self) {
+        if (self.state == MQTTCFSocketEncoderStateReady) {
+            failed = ![self write];
+        }
+    }
+    if (failed) {
+        [self.delegate encoder:self didFailWithError:self.error];
+    }
+}
+
+- (BOOL)write {
+    BOOL firstWrite = TRUE;
+    while (self.segments.count && (firstWrite || self.stream.hasSpaceAvailable)) {
+        firstWrite = FALSE;
+        NSData *segment = self.segments.firstObject;
+        NSUInteger remaining = segment.length - self.segmentOffset;
+        DDLogVerbose(@"[MQTTCFSocketEncoder] segment to write (%lu)", (unsigned long)remaining);
+
+        NSInteger n = [self.stream write:(const UInt8 *)segment.bytes + self.segmentOffset maxLength:remaining];
+
+        if (n == -1) {
+            self.state = MQTTCFSocketEncoderStateError;
+            self.error = self.stream.streamError;
+            if (!self.error) {
+                self.error = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                                 code:EIO
+                                             userInfo:@{NSLocalizedDescriptionKey : @"MQTT output stream write failed"}];
             }
+            DDLogVerbose(@"[MQTTCFSocketEncoder] streamError: %@", self.error);
+            return FALSE;
+        }
+        self.segmentOffset += n;
+        self.bufferedLength -= n;
+        if (n < remaining) {
+            DDLogVerbose(@"[MQTTCFSocketEncoder] segment partially written: %ld", (long)n);
+            break;
+        }
+
+        [self.segments removeObjectAtIndex:0];
+        self.segmentOffset = 0;
+        if (segment == self.openBuffer) {
+            self.openBuffer = nil;
+        }
+        if (segment == self.scratch) {
+            self.scratch.length = 0;
+            self.scratchQueued = FALSE;
         }
-        return TRUE;
     }
+    return TRUE;
 }
 
 @end
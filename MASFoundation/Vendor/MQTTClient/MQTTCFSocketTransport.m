@@ -83,6 +83,7 @@
     if (!connectError) {
         self.encoder.delegate = nil;
         self.encoder = [[MQTTCFSocketEncoder alloc] init];
+        self.encoder.queue = self.queue;
         CFWriteStreamSetDispatchQueue(writeStream, self.queue);
         self.encoder.stream = CFBridgingRelease(writeStream);
         self.encoder.delegate = self;
@@ -125,6 +126,10 @@
     return [self.encoder send:data];
 }
 
+- (BOOL)sendFixedHeader:(nonnull const UInt8 *)fixedHeader length:(NSUInteger)length data:(nullable NSData *)data {
+    return [self.encoder sendFixedHeader:fixedHeader length:length data:data];
+}
+
 - (void)decoder:(MQTTCFSocketDecoder *)sender didReceiveMessage:(nonnull NSData *)data {
     [self.delegate mqttTransport:self didReceiveMessage:data];
 }
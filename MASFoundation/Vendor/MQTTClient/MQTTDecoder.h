@@ -36,6 +36,9 @@ typedef NS_ENUM(unsigned int, MQTTDecoderState) {
     MQTTDecoderStateProtocolError
 };
 
+/** the largest packet the MQTT remaining length field can describe, plus the fixed header */
+extern const UInt32 MQTTDecoderMaximumPacketSize;
+
 @class MQTTDecoder;
 
 @protocol MQTTDecoderDelegate <NSObject>
@@ -46,13 +49,21 @@ typedef NS_ENUM(unsigned int, MQTTDecoderState) {
 @end
 
 
-@interface MQTTDecoder: NSObject <NSStreamDelegate>
+/** MQTTDecoder splits the byte stream received from the transport into MQTT control packets.
+ *
+ * Received chunks are parsed in place on the decoder's queue. Packets contained entirely in a chunk
+ * are delivered as zero-copy slices of that chunk; only a packet spanning chunk boundaries is
+ * accumulated in a reusable carry-over buffer. A chunk may contain any number of packets.
+ */
+@interface MQTTDecoder: NSObject
 @property (nonatomic) MQTTDecoderState state;
 @property (strong, nonatomic) dispatch_queue_t queue;
-@property (nonatomic) UInt32 length;
-@property (nonatomic) UInt32 lengthMultiplier;
-@property (nonatomic) int offset;
-@property (strong, nonatomic) NSMutableData *dataBuffer;
+
+/** maximumPacketSize the maximum size in bytes of a packet including its fixed header.
+ * A larger packet is reported as MQTTDecoderEventProtocolError before its body is buffered.
+ * Defaults to MQTTDecoderMaximumPacketSize, the largest size the protocol can encode.
+ */
+@property (nonatomic) UInt32 maximumPacketSize;
 
 @property (weak, nonatomic) id<MQTTDecoderDelegate> delegate;
 
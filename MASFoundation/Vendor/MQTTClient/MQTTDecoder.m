@@ -6,11 +6,44 @@
 //
 
 #import "MQTTDecoder.h"
+#import "MQTTSession.h"
 
 #import "MQTTLog.h"
 
+const UInt32 MQTTDecoderMaximumPacketSize = 268435455 + 5;
+
+/* carry-over buffers grown beyond this capacity are handed off with the packet instead of being kept for reuse */
+static const NSUInteger MQTTDecoderRetainedBufferCapacity = 64 * 1024;
+
+typedef NS_ENUM(unsigned int, MQTTDecoderHeaderResult) {
+    MQTTDecoderHeaderIncomplete,
+    MQTTDecoderHeaderComplete,
+    MQTTDecoderHeaderMalformed
+};
+
+/* Parses the fixed header in place. On MQTTDecoderHeaderComplete, packetLength is set to
+ * the size of the whole packet including the fixed header.
+ */
+static MQTTDecoderHeaderResult MQTTDecoderParseHeader(const UInt8 *bytes, NSUInteger length, UInt32 *packetLength) {
+    UInt32 remainingLength = 0;
+    UInt32 multiplier = 1;
+    for (NSUInteger offset = 1; offset <= 4; offset++) {
+        if (offset >= length) {
+            return MQTTDecoderHeaderIncomplete;
+        }
+        UInt8 digit = bytes[offset];
+        remainingLength += (digit & 0x7f) * multiplier;
+        if ((digit & 0x80) == 0x00) {
+            *packetLength = remainingLength + (UInt32)offset + 1;
+            return MQTTDecoderHeaderComplete;
+        }
+        multiplier *= 128;
+    }
+    return MQTTDecoderHeaderMalformed;
+}
+
 @interface MQTTDecoder()
-@property (nonatomic) NSMutableArray<NSInputStream *> *streams;
+@property (strong, nonatomic) NSMutableData *carryBuffer;
 @end
 
 @implementation MQTTDecoder
@@ -18,156 +51,153 @@
 - (instancetype)init {
     self = [super init];
     self.state = MQTTDecoderStateInitializing;
-    self.streams = [NSMutableArray arrayWithCapacity:5];
     self.queue = dispatch_get_main_queue();
+    self.maximumPacketSize = MQTTDecoderMaximumPacketSize;
+    self.carryBuffer = [[NSMutableData alloc] init];
     return self;
 }
 
-- (void)dealloc {
-    [self close];
+- (void)open {
+    self.carryBuffer.length = 0;
+    self.state = MQTTDecoderStateDecodingHeader;
 }
 
-- (void)decodeMessage:(NSData *)data {
-    NSInputStream *stream = [NSInputStream inputStreamWithData:data];
-    CFReadStreamRef readStream = (__bridge CFReadStreamRef)stream;
-    CFReadStreamSetDispatchQueue(readStream, self.queue);
-    [self openStream:stream];
+- (void)close {
+    self.carryBuffer.length = 0;
+    self.state = MQTTDecoderStateConnectionClosed;
 }
 
-- (void)openStream:(NSInputStream*)stream {
-    [self.streams addObject:stream];
-    stream.delegate = self;
-    DDLogVerbose(@"[MQTTDecoder] #streams=%lu", (unsigned long)self.streams.count);
-    if (self.streams.count == 1) {
-        [stream open];
+- (void)decodeMessage:(NSData *)data {
+    if (!data.length) {
+        return;
     }
+    __weak MQTTDecoder *weakSelf = self;
+    dispatch_async(self.queue, ^{
+        [weakSelf decodeData:data];
+    });
 }
 
-- (void)open {
-    self.state = MQTTDecoderStateDecodingHeader;
+- (BOOL)isDecoding {
+    return self.state == MQTTDecoderStateDecodingHeader ||
+    self.state == MQTTDecoderStateDecodingLength ||
+    self.state == MQTTDecoderStateDecodingData;
 }
 
-- (void)close {
-    if (self.streams) {
-        for (NSInputStream *stream in self.streams) {
-            [stream close];
-            [stream setDelegate:nil];
-        }
-        [self.streams removeAllObjects];
+- (void)decodeData:(NSData *)data {
+    if (![self isDecoding]) {
+        DDLogVerbose(@"[MQTTDecoder] dropping %lu bytes in state %d", (unsigned long)data.length, self.state);
+        return;
     }
-}
 
-- (void)stream:(NSStream*)sender handleEvent:(NSStreamEvent)eventCode {
-    NSInputStream *stream = (NSInputStream *)sender;
-    
-    if (eventCode & NSStreamEventOpenCompleted) {
-        DDLogVerbose(@"[MQTTDecoder] NSStreamEventOpenCompleted");
+    const UInt8 *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger offset = 0;
+
+    if (self.carryBuffer.length) {
+        offset = [self appendToCarriedPacket:bytes length:length];
     }
-    
-    if (eventCode & NSStreamEventHasBytesAvailable) {
-        DDLogVerbose(@"[MQTTDecoder] NSStreamEventHasBytesAvailable");
-        
-        if (self.state == MQTTDecoderStateDecodingHeader) {
-            UInt8 buffer;
-            NSInteger n = [stream read:&buffer maxLength:1];
-            if (n == -1) {
-                self.state = MQTTDecoderStateConnectionError;
-                [self.delegate decoder:self handleEvent:MQTTDecoderEventConnectionError error:stream.streamError];
-            } else if (n == 1) {
-                self.length = 0;
-                self.lengthMultiplier = 1;
-                self.state = MQTTDecoderStateDecodingLength;
-                self.dataBuffer = [[NSMutableData alloc] init];
-                [self.dataBuffer appendBytes:&buffer length:1];
-                self.offset = 1;
-                DDLogVerbose(@"[MQTTDecoder] fixedHeader=0x%02x", buffer);
-            }
+
+    // Packets contained in the chunk are delivered as subranges of it without copying;
+    // the chunk stays alive for as long as any of them does.
+    dispatch_data_t chunk = nil;
+    while (offset < length && self.state == MQTTDecoderStateDecodingHeader) {
+        UInt32 packetLength = 0;
+        MQTTDecoderHeaderResult result = MQTTDecoderParseHeader(bytes + offset, length - offset, &packetLength);
+        if (result == MQTTDecoderHeaderIncomplete) {
+            break;
         }
-        while (self.state == MQTTDecoderStateDecodingLength) {
-            // TODO: check max packet length(prevent evil server response)
-            UInt8 digit;
-            NSInteger n = [stream read:&digit maxLength:1];
-            if (n == -1) {
-                self.state = MQTTDecoderStateConnectionError;
-                [self.delegate decoder:self handleEvent:MQTTDecoderEventConnectionError error:stream.streamError];
-                break;
-            } else if (n == 0) {
-                break;
-            }
-            DDLogVerbose(@"[MQTTDecoder] digit=0x%02x 0x%02x %d %d", digit, digit & 0x7f, (unsigned int)self.length, (unsigned int)self.lengthMultiplier);
-            [self.dataBuffer appendBytes:&digit length:1];
-            self.offset++;
-            self.length += ((digit & 0x7f) * self.lengthMultiplier);
-            if ((digit & 0x80) == 0x00) {
-                self.state = MQTTDecoderStateDecodingData;
-            } else {
-                self.lengthMultiplier *= 128;
-            }
+        if (![self acceptHeader:result packetLength:packetLength]) {
+            return;
         }
-        DDLogVerbose(@"[MQTTDecoder] remainingLength=%d", (unsigned int)self.length);
-
-        if (self.state == MQTTDecoderStateDecodingData) {
-            if (self.length > 0) {
-                NSInteger n, toRead;
-                UInt8 buffer[768];
-                toRead = self.length + self.offset - self.dataBuffer.length;
-                if (toRead > sizeof buffer) {
-                    toRead = sizeof buffer;
-                }
-                n = [stream read:buffer maxLength:toRead];
-                if (n == -1) {
-                    self.state = MQTTDecoderStateConnectionError;
-                    [self.delegate decoder:self handleEvent:MQTTDecoderEventConnectionError error:stream.streamError];
-                } else {
-                    DDLogVerbose(@"[MQTTDecoder] read %ld %ld", (long)toRead, (long)n);
-                    [self.dataBuffer appendBytes:buffer length:n];
-                }
-            }
-            if (self.dataBuffer.length == self.length + self.offset) {
-                DDLogVerbose(@"[MQTTDecoder] received (%lu)=%@...", (unsigned long)self.dataBuffer.length,
-                                    [self.dataBuffer subdataWithRange:NSMakeRange(0, MIN(256, self.dataBuffer.length))]);
-                [self.delegate decoder:self didReceiveMessage:self.dataBuffer];
-                self.dataBuffer = nil;
-                self.state = MQTTDecoderStateDecodingHeader;
-            } else {
-                DDLogError(@"[MQTTDecoder] oops received (%lu)=%@...", (unsigned long)self.dataBuffer.length,
-                             [self.dataBuffer subdataWithRange:NSMakeRange(0, MIN(256, self.dataBuffer.length))]);
-            }
+        if (packetLength > length - offset) {
+            break;
         }
+        if (!chunk) {
+            chunk = dispatch_data_create(bytes, length, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                (void)data;
+            });
+        }
+        dispatch_data_t packet = dispatch_data_create_subrange(chunk, offset, packetLength);
+        offset += packetLength;
+        [self deliverPacket:(NSData *)packet];
     }
-    
-    if (eventCode & NSStreamEventHasSpaceAvailable) {
-        DDLogVerbose(@"[MQTTDecoder] NSStreamEventHasSpaceAvailable");
+
+    if (offset < length && self.state == MQTTDecoderStateDecodingHeader) {
+        [self appendToCarriedPacket:bytes + offset length:length - offset];
     }
-    
-    if (eventCode & NSStreamEventEndEncountered) {
-        DDLogVerbose(@"[MQTTDecoder] NSStreamEventEndEncountered");
-        
-        if (self.streams) {
-            [stream setDelegate:nil];
-            [stream close];
-            [self.streams removeObject:stream];
-            if (self.streams.count) {
-                NSInputStream *stream = (self.streams)[0];
-                [stream open];
-            }
+}
+
+/* Appends bytes to the packet spanning chunk boundaries, delivers it once complete and
+ * returns the number of bytes consumed.
+ */
+- (NSUInteger)appendToCarriedPacket:(const UInt8 *)bytes length:(NSUInteger)length {
+    NSUInteger consumed = 0;
+    UInt32 packetLength = 0;
+    MQTTDecoderHeaderResult result;
+
+    // the fixed header is at most five bytes, so it is completed a byte at a time
+    while ((result = MQTTDecoderParseHeader(self.carryBuffer.bytes, self.carryBuffer.length, &packetLength)) == MQTTDecoderHeaderIncomplete) {
+        if (consumed == length) {
+            self.state = MQTTDecoderStateDecodingLength;
+            return consumed;
         }
+        [self.carryBuffer appendBytes:bytes + consumed length:1];
+        consumed++;
     }
-    
-    if (eventCode & NSStreamEventErrorOccurred) {
-        DDLogVerbose(@"[MQTTDecoder] NSStreamEventErrorOccurred");
-        
-        self.state = MQTTDecoderStateConnectionError;
-        NSError *error = stream.streamError;
-        if (self.streams) {
-            [self.streams removeObject:stream];
-            if (self.streams.count) {
-                NSInputStream *stream = (self.streams)[0];
-                [stream open];
-            }
-        }
-        [self.delegate decoder:self handleEvent:MQTTDecoderEventConnectionError error:error];
+    if (![self acceptHeader:result packetLength:packetLength]) {
+        return length;
+    }
+
+    NSUInteger available = MIN(packetLength - self.carryBuffer.length, length - consumed);
+    [self.carryBuffer appendBytes:bytes + consumed length:available];
+    consumed += available;
+
+    if (self.carryBuffer.length < packetLength) {
+        self.state = MQTTDecoderStateDecodingData;
+        return consumed;
+    }
+
+    NSData *packet;
+    if (packetLength > MQTTDecoderRetainedBufferCapacity) {
+        packet = self.carryBuffer;
+        self.carryBuffer = [[NSMutableData alloc] init];
+    } else {
+        packet = [self.carryBuffer copy];
+        self.carryBuffer.length = 0;
+    }
+    self.state = MQTTDecoderStateDecodingHeader;
+    [self deliverPacket:packet];
+    return consumed;
+}
+
+- (BOOL)acceptHeader:(MQTTDecoderHeaderResult)result packetLength:(UInt32)packetLength {
+    if (result == MQTTDecoderHeaderMalformed) {
+        [self protocolError:MQTTSessionErrorIllegalMessageReceived
+                description:@"MQTT malformed remaining length received"];
+        return NO;
     }
+    if (packetLength > self.maximumPacketSize) {
+        DDLogError(@"[MQTTDecoder] packet length %u exceeds maximum packet size %u",
+                   (unsigned int)packetLength, (unsigned int)self.maximumPacketSize);
+        [self protocolError:MQTTPacketTooLarge
+                description:@"MQTT packet exceeds maximum packet size"];
+        return NO;
+    }
+    return YES;
+}
+
+- (void)protocolError:(NSInteger)code description:(NSString *)description {
+    self.carryBuffer.length = 0;
+    self.state = MQTTDecoderStateProtocolError;
+    NSError *error = [NSError errorWithDomain:MQTTSessionErrorDomain
+                                         code:code
+                                     userInfo:@{NSLocalizedDescriptionKey : description}];
+    [self.delegate decoder:self handleEvent:MQTTDecoderEventProtocolError error:error];
+}
+
+- (void)deliverPacket:(NSData *)packet {
+    DDLogVerbose(@"[MQTTDecoder] received (%lu)", (unsigned long)packet.length);
+    [self.delegate decoder:self didReceiveMessage:packet];
 }
 
 @end
@@ -10,23 +10,363 @@
 
 #import "MQTTLog.h"
 
+@class MQTTInMemoryFlowQueue;
+@class MQTTInMemoryClientFlows;
+
+@interface MQTTInMemoryFlow()
+@property (weak, nonatomic) MQTTInMemoryClientFlows *clientFlows;
+@property (weak, nonatomic) MQTTInMemoryFlowQueue *flowQueue;
+@property (nonatomic) UInt16 msgId;
+@property (nonatomic) NSUInteger heapIndex;
+@property (nonatomic) NSUInteger orderIndex;
+@property (nonatomic) NSTimeInterval deadlineTime;
+@end
+
+/* MQTTInMemoryFlowQueue holds the flows of one clientId and direction.
+ * Flows are indexed by their unboxed message id and kept in the order they were stored.
+ * Queued flows (MQTT_None) are kept in a FIFO in the order they were stored, the other, inflight flows
+ * are arranged in a min-heap by deadline, so the window size never requires a scan and the deadlines
+ * of queued flows never hold up the retransmission of inflight ones.
+ * A removed flow leaves a tombstone in the stored order, so removing does not shift the flows stored after it;
+ * tombstones are compacted once they outnumber the flows.
+ * All methods are called while holding the lock of the owning MQTTInMemoryClientFlows.
+ */
+@interface MQTTInMemoryFlowQueue : NSObject
+@property (nonatomic) CFMutableDictionaryRef flowsById;
+@property (strong, nonatomic) NSMutableArray *orderedFlows;
+@property (nonatomic) NSUInteger tombstoneCount;
+@property (strong, nonatomic) NSMutableArray<MQTTInMemoryFlow *> *deadlineHeap;
+@property (strong, nonatomic) NSMutableArray<MQTTInMemoryFlow *> *queuedFlows;
+
+- (NSUInteger)count;
+- (NSUInteger)queuedCount;
+- (NSArray *)allFlows;
+- (NSArray *)queuedFlowsWithLimit:(NSUInteger)limit;
+- (void)addFlow:(MQTTInMemoryFlow *)flow;
+- (void)removeFlow:(MQTTInMemoryFlow *)flow;
+- (void)removeAllFlows;
+- (void)flow:(MQTTInMemoryFlow *)flow didChangeCommandTypeFrom:(NSNumber *)commandType;
+- (void)flowDidChangeDeadline:(MQTTInMemoryFlow *)flow;
+- (NSArray *)flowsDueBefore:(NSTimeInterval)time;
+- (MQTTInMemoryFlow *)flowForMessageId:(UInt16)messageId;
+@end
+
+/* MQTTInMemoryClientFlows is the shard holding both directions of one clientId.
+ * It is its own lock, so sessions using different clientIds never contend.
+ * A shard is discarded once its last flow is deleted, so clientIds used once do not accumulate.
+ * A discarded shard stays empty: persistences caching it look the clientId up again,
+ * and a store that raced with the discard retries on the current shard.
+ */
+@interface MQTTInMemoryClientFlows : NSObject
+@property (strong, nonatomic) NSString *clientId;
+@property (strong, nonatomic) MQTTInMemoryFlowQueue *incomingFlows;
+@property (strong, nonatomic) MQTTInMemoryFlowQueue *outgoingFlows;
+@property (atomic) BOOL discarded;
+
+- (MQTTInMemoryFlowQueue *)flowQueueforIncomingFlag:(BOOL)incomingFlag;
+@end
+
+/* the shards by clientId, only locked to look up a shard not cached yet, or to discard a shard
+ * while holding its lock; the lock of a shard is never taken while holding this one
+ */
+static NSMutableDictionary<NSString *, MQTTInMemoryClientFlows *> *clientIds;
+
+/* message ids are non-zero for every stored flow, so they are used as dictionary keys directly */
+static inline const void *MQTTInMemoryFlowKey(UInt16 messageId) {
+    return (const void *)(uintptr_t)messageId;
+}
+
+static BOOL MQTTInMemoryFlowIsQueued(NSNumber *commandType) {
+    return commandType.intValue == MQTT_None;
+}
+
 @implementation MQTTInMemoryFlow
 @synthesize clientId;
 @synthesize incomingFlag;
 @synthesize retainedFlag;
-@synthesize commandType;
+@synthesize commandType = _commandType;
 @synthesize qosLevel;
 @synthesize messageId;
 @synthesize topic;
 @synthesize data;
-@synthesize deadline;
+@synthesize deadline = _deadline;
+
+- (void)setCommandType:(NSNumber *)commandType {
+    @synchronized(self.clientFlows ?: self) {
+        NSNumber *previousCommandType = _commandType;
+        _commandType = commandType;
+        [self.flowQueue flow:self didChangeCommandTypeFrom:previousCommandType];
+    }
+}
+
+- (void)setDeadline:(NSDate *)deadline {
+    @synchronized(self.clientFlows ?: self) {
+        _deadline = deadline;
+        self.deadlineTime = deadline ? deadline.timeIntervalSinceReferenceDate : DBL_MAX;
+        [self.flowQueue flowDidChangeDeadline:self];
+    }
+}
 
 @end
 
-@interface MQTTInMemoryPersistence()
+@implementation MQTTInMemoryFlowQueue
+
+- (instancetype)init {
+    self = [super init];
+    self.flowsById = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    self.orderedFlows = [[NSMutableArray alloc] init];
+    self.tombstoneCount = 0;
+    self.deadlineHeap = [[NSMutableArray alloc] init];
+    self.queuedFlows = [[NSMutableArray alloc] init];
+    return self;
+}
+
+- (void)dealloc {
+    [self removeAllFlows];
+    CFRelease(self.flowsById);
+}
+
+- (NSUInteger)count {
+    return self.orderedFlows.count - self.tombstoneCount;
+}
+
+- (NSUInteger)queuedCount {
+    return self.queuedFlows.count;
+}
+
+- (NSArray *)allFlows {
+    NSMutableArray *flows = [NSMutableArray arrayWithCapacity:self.count];
+    for (id flow in self.orderedFlows) {
+        if (flow != [NSNull null]) {
+            [flows addObject:flow];
+        }
+    }
+    return flows;
+}
+
+- (NSArray *)queuedFlowsWithLimit:(NSUInteger)limit {
+    return [self.queuedFlows subarrayWithRange:NSMakeRange(0, MIN(limit, self.queuedFlows.count))];
+}
+
+- (void)addFlow:(MQTTInMemoryFlow *)flow {
+    MQTTInMemoryFlow *existingFlow = [self flowForMessageId:flow.msgId];
+    if (existingFlow) {
+        [self removeFlow:existingFlow];
+    }
+    if (flow.msgId) {
+        CFDictionarySetValue(self.flowsById, MQTTInMemoryFlowKey(flow.msgId), (__bridge const void *)flow);
+    }
+    flow.orderIndex = self.orderedFlows.count;
+    [self.orderedFlows addObject:flow];
+    if (MQTTInMemoryFlowIsQueued(flow.commandType)) {
+        [self.queuedFlows addObject:flow];
+    } else {
+        [self addHeapFlow:flow];
+    }
+    flow.flowQueue = self;
+}
+
+- (void)removeFlow:(MQTTInMemoryFlow *)flow {
+    if (flow.flowQueue != self) {
+        return;
+    }
+    flow.flowQueue = nil;
+    if (flow.msgId) {
+        CFDictionaryRemoveValue(self.flowsById, MQTTInMemoryFlowKey(flow.msgId));
+    }
+    if (MQTTInMemoryFlowIsQueued(flow.commandType)) {
+        [self removeQueuedFlow:flow];
+    } else {
+        [self removeHeapFlow:flow];
+    }
+    [self removeOrderedFlow:flow];
+}
+
+/* the FIFO is sorted by orderIndex, which compaction renumbers without changing the order */
+- (NSUInteger)queuedIndexOfFlow:(MQTTInMemoryFlow *)flow options:(NSBinarySearchingOptions)options {
+    return [self.queuedFlows indexOfObject:flow
+                             inSortedRange:NSMakeRange(0, self.queuedFlows.count)
+                                   options:options
+                           usingComparator:^NSComparisonResult(MQTTInMemoryFlow *flow1, MQTTInMemoryFlow *flow2) {
+                               return flow1.orderIndex < flow2.orderIndex ? NSOrderedAscending : flow1.orderIndex > flow2.orderIndex ? NSOrderedDescending : NSOrderedSame;
+                           }];
+}
+
+- (void)insertQueuedFlow:(MQTTInMemoryFlow *)flow {
+    // a flow requeued after an unsuccessful send goes back to its place, usually the head
+    [self.queuedFlows insertObject:flow atIndex:[self queuedIndexOfFlow:flow options:NSBinarySearchingInsertionIndex]];
+}
+
+- (void)removeQueuedFlow:(MQTTInMemoryFlow *)flow {
+    // queued flows are sent in order, so this is usually the head
+    NSUInteger index = self.queuedFlows.firstObject == flow ? 0 : [self queuedIndexOfFlow:flow options:NSBinarySearchingFirstEqual];
+    if (index != NSNotFound) {
+        [self.queuedFlows removeObjectAtIndex:index];
+    }
+}
+
+- (void)addHeapFlow:(MQTTInMemoryFlow *)flow {
+    flow.heapIndex = self.deadlineHeap.count;
+    [self.deadlineHeap addObject:flow];
+    [self siftUp:flow.heapIndex];
+}
+
+- (void)removeHeapFlow:(MQTTInMemoryFlow *)flow {
+    NSUInteger index = flow.heapIndex;
+    NSUInteger lastIndex = self.deadlineHeap.count - 1;
+    if (index != lastIndex) {
+        [self swapHeapIndex:index with:lastIndex];
+    }
+    [self.deadlineHeap removeLastObject];
+    if (index < self.deadlineHeap.count) {
+        [self siftUp:index];
+        [self siftDown:index];
+    }
+}
+
+- (void)removeOrderedFlow:(MQTTInMemoryFlow *)flow {
+    self.orderedFlows[flow.orderIndex] = [NSNull null];
+    self.tombstoneCount++;
+
+    // trailing tombstones are dropped right away, the others once they outnumber the flows
+    while (self.orderedFlows.count && self.orderedFlows.lastObject == [NSNull null]) {
+        [self.orderedFlows removeLastObject];
+        self.tombstoneCount--;
+    }
+    if (self.tombstoneCount > self.orderedFlows.count / 2) {
+        NSMutableArray *orderedFlows = [[NSMutableArray alloc] initWithCapacity:self.orderedFlows.count - self.tombstoneCount];
+        for (id orderedFlow in self.orderedFlows) {
+            if (orderedFlow != [NSNull null]) {
+                ((MQTTInMemoryFlow *)orderedFlow).orderIndex = orderedFlows.count;
+                [orderedFlows addObject:orderedFlow];
+            }
+        }
+        self.orderedFlows = orderedFlows;
+        self.tombstoneCount = 0;
+    }
+}
+
+- (void)removeAllFlows {
+    for (id flow in self.orderedFlows) {
+        if (flow != [NSNull null]) {
+            ((MQTTInMemoryFlow *)flow).flowQueue = nil;
+        }
+    }
+    CFDictionaryRemoveAllValues(self.flowsById);
+    [self.orderedFlows removeAllObjects];
+    self.tombstoneCount = 0;
+    [self.deadlineHeap removeAllObjects];
+    [self.queuedFlows removeAllObjects];
+}
+
+- (void)flow:(MQTTInMemoryFlow *)flow didChangeCommandTypeFrom:(NSNumber *)commandType {
+    BOOL wasQueued = MQTTInMemoryFlowIsQueued(commandType);
+    BOOL isQueued = MQTTInMemoryFlowIsQueued(flow.commandType);
+    if (wasQueued && !isQueued) {
+        [self removeQueuedFlow:flow];
+        [self addHeapFlow:flow];
+    } else if (!wasQueued && isQueued) {
+        [self removeHeapFlow:flow];
+        [self insertQueuedFlow:flow];
+    }
+}
+
+- (void)flowDidChangeDeadline:(MQTTInMemoryFlow *)flow {
+    if (!MQTTInMemoryFlowIsQueued(flow.commandType)) {
+        [self siftUp:flow.heapIndex];
+        [self siftDown:flow.heapIndex];
+    }
+}
+
+- (MQTTInMemoryFlow *)flowForMessageId:(UInt16)messageId {
+    if (!messageId) {
+        return nil;
+    }
+    return (__bridge MQTTInMemoryFlow *)CFDictionaryGetValue(self.flowsById, MQTTInMemoryFlowKey(messageId));
+}
+
+- (NSArray *)flowsDueBefore:(NSTimeInterval)time {
+    NSMutableArray *dueFlows = [NSMutableArray array];
+    NSUInteger count = self.deadlineHeap.count;
+    if (count && self.deadlineHeap[0].deadlineTime < time) {
+        // children are never due before their parent, so only due subtrees are visited
+        NSMutableArray<NSNumber *> *pending = [NSMutableArray arrayWithObject:@0];
+        while (pending.count) {
+            NSUInteger index = pending.lastObject.unsignedIntegerValue;
+            [pending removeLastObject];
+            [dueFlows addObject:self.deadlineHeap[index]];
+            for (NSUInteger child = 2 * index + 1; child <= 2 * index + 2 && child < count; child++) {
+                if (self.deadlineHeap[child].deadlineTime < time) {
+                    [pending addObject:@(child)];
+                }
+            }
+        }
+        [dueFlows sortUsingComparator:^NSComparisonResult(MQTTInMemoryFlow *flow1, MQTTInMemoryFlow *flow2) {
+            return flow1.orderIndex < flow2.orderIndex ? NSOrderedAscending : flow1.orderIndex > flow2.orderIndex ? NSOrderedDescending : NSOrderedSame;
+        }];
+    }
+    return dueFlows;
+}
+
+- (void)siftUp:(NSUInteger)index {
+    while (index > 0) {
+        NSUInteger parent = (index - 1) / 2;
+        if (self.deadlineHeap[parent].deadlineTime <= self.deadlineHeap[index].deadlineTime) {
+            break;
+        }
+        [self swapHeapIndex:index with:parent];
+        index = parent;
+    }
+}
+
+- (void)siftDown:(NSUInteger)index {
+    NSUInteger count = self.deadlineHeap.count;
+    while (TRUE) {
+        NSUInteger smallest = index;
+        NSUInteger left = 2 * index + 1;
+        NSUInteger right = left + 1;
+        if (left < count && self.deadlineHeap[left].deadlineTime < self.deadlineHeap[smallest].deadlineTime) {
+            smallest = left;
+        }
+        if (right < count && self.deadlineHeap[right].deadlineTime < self.deadlineHeap[smallest].deadlineTime) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        [self swapHeapIndex:index with:smallest];
+        index = smallest;
+    }
+}
+
+- (void)swapHeapIndex:(NSUInteger)index1 with:(NSUInteger)index2 {
+    [self.deadlineHeap exchangeObjectAtIndex:index1 withObjectAtIndex:index2];
+    self.deadlineHeap[index1].heapIndex = index1;
+    self.deadlineHeap[index2].heapIndex = index2;
+}
+
 @end
 
-static NSMutableDictionary *clientIds;
+@implementation MQTTInMemoryClientFlows
+
+- (instancetype)initWithClientId:(NSString *)clientId {
+    self = [super init];
+    self.clientId = clientId;
+    self.incomingFlows = [[MQTTInMemoryFlowQueue alloc] init];
+    self.outgoingFlows = [[MQTTInMemoryFlowQueue alloc] init];
+    return self;
+}
+
+- (MQTTInMemoryFlowQueue *)flowQueueforIncomingFlag:(BOOL)incomingFlag {
+    return incomingFlag ? self.incomingFlows : self.outgoingFlows;
+}
+
+@end
+
+@interface MQTTInMemoryPersistence()
+/* the shard last used, a persistence usually serves a single clientId */
+@property (strong) MQTTInMemoryClientFlows *cachedClientFlows;
+@end
 
 @implementation MQTTInMemoryPersistence
 @synthesize maxSize;
@@ -38,24 +378,33 @@ static NSMutableDictionary *clientIds;
     self = [super init];
     self.maxMessages = MQTT_MAX_MESSAGES;
     self.maxWindowSize = MQTT_MAX_WINDOW_SIZE;
-    @synchronized(clientIds) {
-        if (!clientIds) {
-            clientIds = [[NSMutableDictionary alloc] init];
-        }
-    }
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        clientIds = [[NSMutableDictionary alloc] init];
+    });
     return self;
 }
 
 - (NSUInteger)windowSize:(NSString *)clientId {
-    NSUInteger windowSize = 0;
-    NSArray *flows = [self allFlowsforClientId:clientId
-                                  incomingFlag:NO];
-    for (MQTTInMemoryFlow *flow in flows) {
-        if ((flow.commandType).intValue != MQTT_None) {
-            windowSize++;
-        }
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+        return clientFlows.outgoingFlows.count - clientFlows.outgoingFlows.queuedCount;
+    }
+}
+
+- (NSUInteger)queueSize:(NSString *)clientId {
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+        return clientFlows.outgoingFlows.queuedCount;
+    }
+}
+
+- (NSUInteger)flowCountforClientId:(NSString *)clientId
+                      incomingFlag:(BOOL)incomingFlag {
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+        return [clientFlows flowQueueforIncomingFlag:incomingFlag].count;
     }
-    return windowSize;
 }
 
 - (MQTTInMemoryFlow *)storeMessageForClientId:(NSString *)clientId
@@ -67,43 +416,53 @@ static NSMutableDictionary *clientIds;
                                  incomingFlag:(BOOL)incomingFlag
                                   commandType:(UInt8)commandType
                                      deadline:(NSDate *)deadline {
-    @synchronized(clientIds) {
-        
-        if (([self allFlowsforClientId:clientId incomingFlag:incomingFlag].count <= self.maxMessages)) {
-            MQTTInMemoryFlow *flow = (MQTTInMemoryFlow *)[self createFlowforClientId:clientId
-                                                                        incomingFlag:incomingFlag
-                                                                           messageId:msgId];
-            flow.topic = topic;
-            flow.data = data;
-            flow.retainedFlag = @(retainFlag);
-            flow.qosLevel = @(qos);
-            flow.commandType = [NSNumber numberWithUnsignedInteger:commandType];
-            flow.deadline = deadline;
-            return flow;
-        } else {
-            return nil;
+    while (TRUE) {
+        MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId create:YES];
+        @synchronized(clientFlows) {
+            if (clientFlows.discarded) {
+                continue;
+            }
+            MQTTInMemoryFlowQueue *flowQueue = [clientFlows flowQueueforIncomingFlag:incomingFlag];
+
+            if (flowQueue.count <= self.maxMessages) {
+                MQTTInMemoryFlow *flow = [[MQTTInMemoryFlow alloc] init];
+                flow.clientFlows = clientFlows;
+                flow.msgId = msgId;
+                flow.clientId = clientId;
+                flow.incomingFlag = @(incomingFlag);
+                flow.messageId = [NSNumber numberWithUnsignedInteger:msgId];
+                flow.topic = topic;
+                flow.data = data;
+                flow.retainedFlag = @(retainFlag);
+                flow.qosLevel = @(qos);
+                flow.commandType = [NSNumber numberWithUnsignedInteger:commandType];
+                flow.deadline = deadline;
+                [flowQueue addFlow:flow];
+                return flow;
+            } else {
+                return nil;
+            }
         }
     }
 }
 
 - (void)deleteFlow:(MQTTInMemoryFlow *)flow {
-    @synchronized(clientIds) {
-        
-        NSMutableDictionary *clientIdFlows = clientIds[flow.clientId];
-        if (clientIdFlows) {
-            NSMutableDictionary *clientIdDirectedFlow = clientIdFlows[flow.incomingFlag];
-            if (clientIdDirectedFlow) {
-                [clientIdDirectedFlow removeObjectForKey:flow.messageId];
-            }
-        }
+    MQTTInMemoryClientFlows *clientFlows = flow.clientFlows;
+    @synchronized(clientFlows ?: flow) {
+
+        [flow.flowQueue removeFlow:flow];
+        [self discardClientFlowsIfEmpty:clientFlows];
     }
 }
 
 - (void)deleteAllFlowsForClientId:(NSString *)clientId {
-    @synchronized(clientIds) {
-        
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+
         DDLogInfo(@"[MQTTInMemoryPersistence] deleteAllFlowsForClientId %@", clientId);
-        [clientIds removeObjectForKey:clientId];
+        [clientFlows.incomingFlows removeAllFlows];
+        [clientFlows.outgoingFlows removeAllFlows];
+        [self discardClientFlowsIfEmpty:clientFlows];
     }
 }
 
@@ -113,68 +472,100 @@ static NSMutableDictionary *clientIds;
 
 - (NSArray *)allFlowsforClientId:(NSString *)clientId
                     incomingFlag:(BOOL)incomingFlag {
-    @synchronized(clientIds) {
-        
-        NSMutableArray *flows = nil;
-        NSMutableDictionary *clientIdFlows = clientIds[clientId];
-        if (clientIdFlows) {
-            NSMutableDictionary *clientIdDirectedFlow = clientIdFlows[@(incomingFlag)];
-            if (clientIdDirectedFlow) {
-                flows = [NSMutableArray array];
-                NSArray *keys = [clientIdDirectedFlow.allKeys sortedArrayUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"self" ascending:YES]]];
-                for (id key in keys) {
-                    [flows addObject:clientIdDirectedFlow[key]];
-                }
-            }
-        }
-        return flows;
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+
+        return [[clientFlows flowQueueforIncomingFlag:incomingFlag] allFlows];
+    }
+}
+
+- (NSArray *)flowsforClientId:(NSString *)clientId
+                 incomingFlag:(BOOL)incomingFlag
+                    dueBefore:(NSDate *)date {
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+
+        MQTTInMemoryFlowQueue *flowQueue = [clientFlows flowQueueforIncomingFlag:incomingFlag];
+        return [flowQueue flowsDueBefore:date.timeIntervalSinceReferenceDate];
+    }
+}
+
+- (NSArray *)queuedFlowsforClientId:(NSString *)clientId
+                       incomingFlag:(BOOL)incomingFlag
+                              limit:(NSUInteger)limit {
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+
+        return [[clientFlows flowQueueforIncomingFlag:incomingFlag] queuedFlowsWithLimit:limit];
+    }
+}
+
+- (MQTTInMemoryFlow *)earliestDeadlineFlowforClientId:(NSString *)clientId
+                                         incomingFlag:(BOOL)incomingFlag {
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+
+        return [clientFlows flowQueueforIncomingFlag:incomingFlag].deadlineHeap.firstObject;
     }
 }
 
 - (MQTTInMemoryFlow *)flowforClientId:(NSString *)clientId
                          incomingFlag:(BOOL)incomingFlag
                             messageId:(UInt16)messageId {
+    MQTTInMemoryClientFlows *clientFlows = [self clientFlowsforClientId:clientId];
+    @synchronized(clientFlows) {
+
+        return [[clientFlows flowQueueforIncomingFlag:incomingFlag] flowForMessageId:messageId];
+    }
+}
+
+- (MQTTInMemoryClientFlows *)clientFlowsforClientId:(NSString *)clientId {
+    return [self clientFlowsforClientId:clientId create:NO];
+}
+
+/*
+ * Returns the shard of clientId, creating it if needed.
+ * Without create, a clientId without shard gets an empty discarded shard which is not registered,
+ * so looking up or deleting the flows of unknown clientIds does not add shards.
+ * The global lock is only taken when the shard is not the one cached by this persistence.
+ */
+- (MQTTInMemoryClientFlows *)clientFlowsforClientId:(NSString *)clientId create:(BOOL)create {
+    MQTTInMemoryClientFlows *clientFlows = self.cachedClientFlows;
+    if (clientFlows && !clientFlows.discarded && (clientFlows.clientId == clientId || [clientFlows.clientId isEqualToString:clientId])) {
+        return clientFlows;
+    }
+
+    NSString *key = clientId ?: @"";
     @synchronized(clientIds) {
-        
-        MQTTInMemoryFlow *flow = nil;
-        
-        NSMutableDictionary *clientIdFlows = clientIds[clientId];
-        if (clientIdFlows) {
-            NSMutableDictionary *clientIdDirectedFlow = clientIdFlows[@(incomingFlag)];
-            if (clientIdDirectedFlow) {
-                flow = clientIdDirectedFlow[[NSNumber numberWithUnsignedInteger:messageId]];
+        clientFlows = clientIds[key];
+        if (!clientFlows) {
+            clientFlows = [[MQTTInMemoryClientFlows alloc] initWithClientId:key];
+            if (create) {
+                clientIds[key] = clientFlows;
+            } else {
+                clientFlows.discarded = YES;
+                return clientFlows;
             }
         }
-        
-        return flow;
     }
+    self.cachedClientFlows = clientFlows;
+    return clientFlows;
 }
 
-- (MQTTInMemoryFlow *)createFlowforClientId:(NSString *)clientId
-                               incomingFlag:(BOOL)incomingFlag
-                                  messageId:(UInt16)messageId {
+/*
+ * Removes the shard from the table once it holds no flows.
+ * Called while holding the lock of the shard.
+ */
+- (void)discardClientFlowsIfEmpty:(MQTTInMemoryClientFlows *)clientFlows {
+    if (!clientFlows || clientFlows.discarded || clientFlows.incomingFlows.count || clientFlows.outgoingFlows.count) {
+        return;
+    }
     @synchronized(clientIds) {
-        NSMutableDictionary *clientIdFlows = clientIds[clientId];
-        if (!clientIdFlows) {
-            clientIdFlows = [[NSMutableDictionary alloc] init];
-            clientIds[clientId] = clientIdFlows;
-        }
-        
-        NSMutableDictionary *clientIdDirectedFlow = clientIdFlows[@(incomingFlag)];
-        if (!clientIdDirectedFlow) {
-            clientIdDirectedFlow = [[NSMutableDictionary alloc] init];
-            clientIdFlows[@(incomingFlag)] = clientIdDirectedFlow;
+        if (clientIds[clientFlows.clientId] == clientFlows) {
+            [clientIds removeObjectForKey:clientFlows.clientId];
         }
-        
-        MQTTInMemoryFlow *flow = [[MQTTInMemoryFlow alloc] init];
-        flow.clientId = clientId;
-        flow.incomingFlag = @(incomingFlag);
-        flow.messageId = [NSNumber numberWithUnsignedInteger:messageId];
-        
-        clientIdDirectedFlow[[NSNumber numberWithUnsignedInteger:messageId]] = flow;
-        
-        return flow;
     }
+    clientFlows.discarded = YES;
 }
 
 @end
@@ -0,0 +1,34 @@
+//
+//  MQTTLogPersistence.h
+//  MQTTClient
+//
+//  Copyright © 2015-2017 Christoph Krey. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "MQTTPersistence.h"
+
+/** MQTTLogPersistence keeps flows in memory, indexed per clientId and direction.
+ * When persistent, every change is also appended to a log file. Records are written and
+ * fsync'ed in groups on a background queue and carry a checksum, so a record torn by a crash
+ * is discarded when the log is replayed. sync returns once the records appended so far are durable.
+ * Once the log has grown beyond compactionThreshold and mostly holds obsolete records,
+ * it is rewritten from the live flows.
+ * MQTTSession and MQTTSessionManager use MQTTCoreDataPersistence unless this persistence is selected,
+ * flows stored by MQTTCoreDataPersistence are not migrated.
+ */
+@interface MQTTLogPersistence : NSObject <MQTTPersistence>
+
+/** The size of the log file in bytes above which it is compacted. Defaults to 1024*1024 bytes */
+@property (nonatomic) NSUInteger compactionThreshold;
+
+/** The URL of the log file. Defaults to MQTTClient.log in the application's documents directory.
+ * IMPORTANT: like persistent, set immediately after creating the persistence before calling any other method.
+ * Persistences using the same file share their flows.
+ */
+@property (strong, nonatomic) NSURL *fileURL;
+
+@end
+
+@interface MQTTLogFlow : NSObject <MQTTFlow>
+@end
@@ -0,0 +1,1034 @@
+//
+//  MQTTLogPersistence.m
+//  MQTTClient
+//
+//  Copyright © 2015-2017 Christoph Krey. All rights reserved.
+//
+
+#import "MQTTLogPersistence.h"
+
+#import "MQTTLog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/* The log starts with a header of magic and version, followed by records.
+ * Each record is a little endian UInt32 payload length, the CRC-32 of the payload and the payload,
+ * whose first byte is the MQTTLogRecordType.
+ */
+static const UInt32 MQTTLogMagic = 0x4c54514d; /* MQTL */
+static const UInt32 MQTTLogVersion = 1;
+static const NSUInteger MQTTLogHeaderLength = 8;
+static const NSUInteger MQTTLogRecordHeaderLength = 8;
+static const UInt32 MQTTLogNilLength = 0xffffffff;
+static const NSUInteger MQTTLogCompactionThreshold = 1024 * 1024;
+
+typedef NS_ENUM(UInt8, MQTTLogRecordType) {
+    MQTTLogRecordStore = 1,
+    MQTTLogRecordUpdate = 2,
+    MQTTLogRecordDelete = 3,
+    MQTTLogRecordDeleteAll = 4
+};
+
+static UInt32 MQTTLogCRC32(const UInt8 *bytes, NSUInteger length) {
+    static UInt32 table[256];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (UInt32 n = 0; n < 256; n++) {
+            UInt32 c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+    });
+    UInt32 crc = 0xffffffff;
+    for (NSUInteger i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+#pragma mark - encoding
+
+static void MQTTLogAppendUInt8(NSMutableData *data, UInt8 value) {
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void MQTTLogAppendUInt16(NSMutableData *data, UInt16 value) {
+    value = CFSwapInt16HostToLittle(value);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void MQTTLogAppendUInt32(NSMutableData *data, UInt32 value) {
+    value = CFSwapInt32HostToLittle(value);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void MQTTLogAppendDate(NSMutableData *data, NSDate *date) {
+    MQTTLogAppendUInt8(data, date != nil);
+    CFSwappedFloat64 value = CFConvertDoubleHostToSwapped(date ? date.timeIntervalSinceReferenceDate : 0.0);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void MQTTLogAppendData(NSMutableData *data, NSData *value) {
+    if (!value) {
+        MQTTLogAppendUInt32(data, MQTTLogNilLength);
+        return;
+    }
+    MQTTLogAppendUInt32(data, (UInt32)value.length);
+    [data appendData:value];
+}
+
+static void MQTTLogAppendHeader(NSMutableData *data) {
+    MQTTLogAppendUInt32(data, MQTTLogMagic);
+    MQTTLogAppendUInt32(data, MQTTLogVersion);
+}
+
+/* Reserves the record header and returns the offset of the record */
+static NSUInteger MQTTLogBeginRecord(NSMutableData *data, MQTTLogRecordType type) {
+    NSUInteger offset = data.length;
+    data.length += MQTTLogRecordHeaderLength;
+    MQTTLogAppendUInt8(data, type);
+    return offset;
+}
+
+/* Fills in the record header and returns the length of the whole record */
+static NSUInteger MQTTLogEndRecord(NSMutableData *data, NSUInteger offset) {
+    UInt8 *record = (UInt8 *)data.mutableBytes + offset;
+    UInt32 length = (UInt32)(data.length - offset - MQTTLogRecordHeaderLength);
+    UInt32 header[2] = {
+        CFSwapInt32HostToLittle(length),
+        CFSwapInt32HostToLittle(MQTTLogCRC32(record + MQTTLogRecordHeaderLength, length))
+    };
+    memcpy(record, header, sizeof(header));
+    return data.length - offset;
+}
+
+#pragma mark - decoding
+
+typedef struct {
+    const UInt8 *bytes;
+    NSUInteger length;
+    NSUInteger offset;
+} MQTTLogReader;
+
+static BOOL MQTTLogReadBytes(MQTTLogReader *reader, void *value, NSUInteger length) {
+    if (length > reader->length - reader->offset) {
+        return FALSE;
+    }
+    memcpy(value, reader->bytes + reader->offset, length);
+    reader->offset += length;
+    return TRUE;
+}
+
+static BOOL MQTTLogReadUInt8(MQTTLogReader *reader, UInt8 *value) {
+    return MQTTLogReadBytes(reader, value, sizeof(*value));
+}
+
+static BOOL MQTTLogReadUInt16(MQTTLogReader *reader, UInt16 *value) {
+    if (!MQTTLogReadBytes(reader, value, sizeof(*value))) {
+        return FALSE;
+    }
+    *value = CFSwapInt16LittleToHost(*value);
+    return TRUE;
+}
+
+static BOOL MQTTLogReadUInt32(MQTTLogReader *reader, UInt32 *value) {
+    if (!MQTTLogReadBytes(reader, value, sizeof(*value))) {
+        return FALSE;
+    }
+    *value = CFSwapInt32LittleToHost(*value);
+    return TRUE;
+}
+
+static BOOL MQTTLogReadDate(MQTTLogReader *reader, NSDate **date) {
+    UInt8 present;
+    CFSwappedFloat64 value;
+    if (!MQTTLogReadUInt8(reader, &present) || !MQTTLogReadBytes(reader, &value, sizeof(value))) {
+        return FALSE;
+    }
+    *date = present ? [NSDate dateWithTimeIntervalSinceReferenceDate:CFConvertDoubleSwappedToHost(value)] : nil;
+    return TRUE;
+}
+
+/* The bytes are copied, the log they are read from is only mapped during recovery */
+static BOOL MQTTLogReadData(MQTTLogReader *reader, NSData **data) {
+    UInt32 length;
+    if (!MQTTLogReadUInt32(reader, &length)) {
+        return FALSE;
+    }
+    if (length == MQTTLogNilLength) {
+        *data = nil;
+        return TRUE;
+    }
+    if (length > reader->length - reader->offset) {
+        return FALSE;
+    }
+    *data = [NSData dataWithBytes:reader->bytes + reader->offset length:length];
+    reader->offset += length;
+    return TRUE;
+}
+
+static BOOL MQTTLogReadString(MQTTLogReader *reader, NSString **string) {
+    NSData *data;
+    if (!MQTTLogReadData(reader, &data)) {
+        return FALSE;
+    }
+    *string = data ? [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] : nil;
+    return !data || *string != nil;
+}
+
+#pragma mark - flows
+
+@class MQTTLogStore;
+
+@interface MQTTLogFlow()
+@property (weak, nonatomic) MQTTLogStore *store;
+@property (nonatomic) NSUInteger recordLength;
+@property (nonatomic) NSUInteger heapIndex;
+@end
+
+/* MQTTLogFlowIndex holds the flows of one clientId and direction, indexed by message id and
+ * kept in the order they were stored. Queued flows (MQTT_None) are kept in a FIFO in the order
+ * they were stored, the other, inflight flows are arranged in a min-heap by deadline.
+ * All methods are called while holding the store lock.
+ */
+@interface MQTTLogFlowIndex : NSObject
+@property (strong, nonatomic) NSMutableDictionary<NSNumber *, MQTTLogFlow *> *flowsById;
+@property (strong, nonatomic) NSMutableOrderedSet<MQTTLogFlow *> *orderedFlows;
+@property (strong, nonatomic) NSMutableOrderedSet<MQTTLogFlow *> *queuedFlows;
+@property (strong, nonatomic) NSMutableArray<MQTTLogFlow *> *deadlineHeap;
+
+- (NSUInteger)queuedCount;
+- (void)addFlow:(MQTTLogFlow *)flow;
+- (void)removeFlow:(MQTTLogFlow *)flow;
+- (void)flowDidChange:(MQTTLogFlow *)flow previousCommandType:(NSNumber *)commandType;
+- (NSArray *)queuedFlowsWithLimit:(NSUInteger)limit;
+- (NSArray *)flowsDueBefore:(NSTimeInterval)time;
+@end
+
+/* MQTTLogStore owns the flows and the log file shared by all persistences using the same file.
+ * All flow changes are serialized by @synchronized(store); the file is only written on ioQueue.
+ * Each commit writes one generation of records; commitCondition signals when a generation is durable.
+ */
+@interface MQTTLogStore : NSObject
+@property (strong, nonatomic) NSURL *fileURL;
+@property (nonatomic) NSUInteger compactionThreshold;
+@property (strong, nonatomic) NSMutableDictionary *clientIds;
+@property (strong, nonatomic) NSMutableOrderedSet<MQTTLogFlow *> *dirtyFlows;
+@property (strong, nonatomic) NSMutableData *pendingRecords;
+@property (nonatomic) BOOL commitScheduled;
+@property (nonatomic) unsigned long long pendingGeneration;
+@property (nonatomic) unsigned long long durableGeneration;
+@property (strong, nonatomic) NSCondition *commitCondition;
+@property (nonatomic) unsigned long long logLength;
+@property (nonatomic) unsigned long long liveLength;
+@property (strong, nonatomic) dispatch_queue_t ioQueue;
+@property (nonatomic) int fd;
+
++ (MQTTLogStore *)storeWithFileURL:(NSURL *)fileURL;
+- (MQTTLogFlowIndex *)indexForClientId:(NSString *)clientId
+                          incomingFlag:(BOOL)incomingFlag
+                                create:(BOOL)create;
+- (void)addFlow:(MQTTLogFlow *)flow;
+- (void)removeFlow:(MQTTLogFlow *)flow;
+- (void)removeAllFlowsForClientId:(NSString *)clientId;
+- (void)flowDidChange:(MQTTLogFlow *)flow previousCommandType:(NSNumber *)commandType;
+- (void)sync;
+@end
+
+static BOOL MQTTLogFlowIsQueued(NSNumber *commandType) {
+    return commandType.intValue == MQTT_None;
+}
+
+static NSTimeInterval MQTTLogFlowDeadlineTime(MQTTLogFlow *flow) {
+    return flow.deadline ? flow.deadline.timeIntervalSinceReferenceDate : DBL_MAX;
+}
+
+@implementation MQTTLogFlow
+@synthesize clientId;
+@synthesize incomingFlag;
+@synthesize retainedFlag;
+@synthesize commandType = _commandType;
+@synthesize qosLevel;
+@synthesize messageId;
+@synthesize topic;
+@synthesize data;
+@synthesize deadline = _deadline;
+
+- (void)setCommandType:(NSNumber *)commandType {
+    NSNumber *previousCommandType = _commandType;
+    _commandType = commandType;
+    [self.store flowDidChange:self previousCommandType:previousCommandType];
+}
+
+- (void)setDeadline:(NSDate *)deadline {
+    _deadline = deadline;
+    [self.store flowDidChange:self previousCommandType:_commandType];
+}
+
+@end
+
+@implementation MQTTLogFlowIndex
+
+- (instancetype)init {
+    self = [super init];
+    self.flowsById = [[NSMutableDictionary alloc] init];
+    self.orderedFlows = [[NSMutableOrderedSet alloc] init];
+    self.queuedFlows = [[NSMutableOrderedSet alloc] init];
+    self.deadlineHeap = [[NSMutableArray alloc] init];
+    return self;
+}
+
+- (NSUInteger)queuedCount {
+    return self.queuedFlows.count;
+}
+
+- (void)addFlow:(MQTTLogFlow *)flow {
+    self.flowsById[flow.messageId] = flow;
+    [self.orderedFlows addObject:flow];
+    if (MQTTLogFlowIsQueued(flow.commandType)) {
+        [self.queuedFlows addObject:flow];
+    } else {
+        [self addHeapFlow:flow];
+    }
+}
+
+- (void)removeFlow:(MQTTLogFlow *)flow {
+    [self.flowsById removeObjectForKey:flow.messageId];
+    if (MQTTLogFlowIsQueued(flow.commandType)) {
+        [self.queuedFlows removeObject:flow];
+    } else {
+        [self removeHeapFlow:flow];
+    }
+    [self.orderedFlows removeObject:flow];
+}
+
+- (void)flowDidChange:(MQTTLogFlow *)flow previousCommandType:(NSNumber *)commandType {
+    BOOL wasQueued = MQTTLogFlowIsQueued(commandType);
+    BOOL isQueued = MQTTLogFlowIsQueued(flow.commandType);
+    if (wasQueued && !isQueued) {
+        [self.queuedFlows removeObject:flow];
+        [self addHeapFlow:flow];
+    } else if (!wasQueued && isQueued) {
+        [self removeHeapFlow:flow];
+        [self insertQueuedFlow:flow];
+    } else if (!isQueued) {
+        [self siftUp:flow.heapIndex];
+        [self siftDown:flow.heapIndex];
+    }
+}
+
+/* a flow requeued after an unsuccessful send goes back to its place in the stored order */
+- (void)insertQueuedFlow:(MQTTLogFlow *)flow {
+    NSUInteger position = [self.orderedFlows indexOfObject:flow];
+    NSUInteger index = [self.queuedFlows indexOfObject:flow
+                                         inSortedRange:NSMakeRange(0, self.queuedFlows.count)
+                                               options:NSBinarySearchingInsertionIndex
+                                       usingComparator:^NSComparisonResult(MQTTLogFlow *flow1, MQTTLogFlow *flow2) {
+                                           NSUInteger position1 = flow1 == flow ? position : [self.orderedFlows indexOfObject:flow1];
+                                           NSUInteger position2 = flow2 == flow ? position : [self.orderedFlows indexOfObject:flow2];
+                                           return position1 < position2 ? NSOrderedAscending : position1 > position2 ? NSOrderedDescending : NSOrderedSame;
+                                       }];
+    [self.queuedFlows insertObject:flow atIndex:index];
+}
+
+- (NSArray *)queuedFlowsWithLimit:(NSUInteger)limit {
+    return [self.queuedFlows.array subarrayWithRange:NSMakeRange(0, MIN(limit, self.queuedFlows.count))];
+}
+
+- (NSArray *)flowsDueBefore:(NSTimeInterval)time {
+    NSMutableArray *dueFlows = [NSMutableArray array];
+    NSUInteger count = self.deadlineHeap.count;
+    if (count && MQTTLogFlowDeadlineTime(self.deadlineHeap[0]) < time) {
+        // children are never due before their parent, so only due subtrees are visited
+        NSMutableArray<NSNumber *> *pending = [NSMutableArray arrayWithObject:@0];
+        while (pending.count) {
+            NSUInteger index = pending.lastObject.unsignedIntegerValue;
+            [pending removeLastObject];
+            [dueFlows addObject:self.deadlineHeap[index]];
+            for (NSUInteger child = 2 * index + 1; child <= 2 * index + 2 && child < count; child++) {
+                if (MQTTLogFlowDeadlineTime(self.deadlineHeap[child]) < time) {
+                    [pending addObject:@(child)];
+                }
+            }
+        }
+        [dueFlows sortUsingComparator:^NSComparisonResult(MQTTLogFlow *flow1, MQTTLogFlow *flow2) {
+            NSUInteger position1 = [self.orderedFlows indexOfObject:flow1];
+            NSUInteger position2 = [self.orderedFlows indexOfObject:flow2];
+            return position1 < position2 ? NSOrderedAscending : position1 > position2 ? NSOrderedDescending : NSOrderedSame;
+        }];
+    }
+    return dueFlows;
+}
+
+- (void)addHeapFlow:(MQTTLogFlow *)flow {
+    flow.heapIndex = self.deadlineHeap.count;
+    [self.deadlineHeap addObject:flow];
+    [self siftUp:flow.heapIndex];
+}
+
+- (void)removeHeapFlow:(MQTTLogFlow *)flow {
+    NSUInteger index = flow.heapIndex;
+    NSUInteger lastIndex = self.deadlineHeap.count - 1;
+    if (index != lastIndex) {
+        [self swapHeapIndex:index with:lastIndex];
+    }
+    [self.deadlineHeap removeLastObject];
+    if (index < self.deadlineHeap.count) {
+        [self siftUp:index];
+        [self siftDown:index];
+    }
+}
+
+- (void)siftUp:(NSUInteger)index {
+    while (index > 0) {
+        NSUInteger parent = (index - 1) / 2;
+        if (MQTTLogFlowDeadlineTime(self.deadlineHeap[parent]) <= MQTTLogFlowDeadlineTime(self.deadlineHeap[index])) {
+            break;
+        }
+        [self swapHeapIndex:index with:parent];
+        index = parent;
+    }
+}
+
+- (void)siftDown:(NSUInteger)index {
+    NSUInteger count = self.deadlineHeap.count;
+    while (TRUE) {
+        NSUInteger smallest = index;
+        NSUInteger left = 2 * index + 1;
+        NSUInteger right = left + 1;
+        if (left < count && MQTTLogFlowDeadlineTime(self.deadlineHeap[left]) < MQTTLogFlowDeadlineTime(self.deadlineHeap[smallest])) {
+            smallest = left;
+        }
+        if (right < count && MQTTLogFlowDeadlineTime(self.deadlineHeap[right]) < MQTTLogFlowDeadlineTime(self.deadlineHeap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        [self swapHeapIndex:index with:smallest];
+        index = smallest;
+    }
+}
+
+- (void)swapHeapIndex:(NSUInteger)index1 with:(NSUInteger)index2 {
+    [self.deadlineHeap exchangeObjectAtIndex:index1 withObjectAtIndex:index2];
+    self.deadlineHeap[index1].heapIndex = index1;
+    self.deadlineHeap[index2].heapIndex = index2;
+}
+
+@end
+
+#pragma mark - store
+
+static NSMapTable<NSString *, MQTTLogStore *> *stores;
+
+@implementation MQTTLogStore
+
++ (MQTTLogStore *)storeWithFileURL:(NSURL *)fileURL {
+    if (!fileURL) {
+        return [[MQTTLogStore alloc] initWithFileURL:nil];
+    }
+    @synchronized(self) {
+        if (!stores) {
+            stores = [NSMapTable strongToWeakObjectsMapTable];
+        }
+        MQTTLogStore *store = [stores objectForKey:fileURL.path];
+        if (!store) {
+            store = [[MQTTLogStore alloc] initWithFileURL:fileURL];
+            [stores setObject:store forKey:fileURL.path];
+        }
+        return store;
+    }
+}
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL {
+    self = [super init];
+    self.fileURL = fileURL;
+    self.compactionThreshold = MQTTLogCompactionThreshold;
+    self.clientIds = [[NSMutableDictionary alloc] init];
+    self.dirtyFlows = [[NSMutableOrderedSet alloc] init];
+    self.pendingRecords = [[NSMutableData alloc] init];
+    self.pendingGeneration = 1;
+    self.durableGeneration = 0;
+    self.commitCondition = [[NSCondition alloc] init];
+    self.fd = -1;
+    if (fileURL) {
+        self.ioQueue = dispatch_queue_create("com.ca.MQTTClient.log", DISPATCH_QUEUE_SERIAL);
+        [self recover];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (self.fd >= 0) {
+        close(self.fd);
+    }
+}
+
+- (MQTTLogFlowIndex *)indexForClientId:(NSString *)clientId
+                          incomingFlag:(BOOL)incomingFlag
+                                create:(BOOL)create {
+    NSMutableDictionary *clientIdFlows = self.clientIds[clientId];
+    if (!clientIdFlows && create) {
+        clientIdFlows = [[NSMutableDictionary alloc] init];
+        self.clientIds[clientId] = clientIdFlows;
+    }
+
+    MQTTLogFlowIndex *index = clientIdFlows[@(incomingFlag)];
+    if (!index && create) {
+        index = [[MQTTLogFlowIndex alloc] init];
+        clientIdFlows[@(incomingFlag)] = index;
+    }
+    return index;
+}
+
+- (MQTTLogFlowIndex *)indexForFlow:(MQTTLogFlow *)flow {
+    return [self indexForClientId:flow.clientId incomingFlag:flow.incomingFlag.boolValue create:TRUE];
+}
+
+- (void)addFlow:(MQTTLogFlow *)flow {
+    @synchronized(self) {
+        MQTTLogFlowIndex *index = [self indexForFlow:flow];
+        MQTTLogFlow *existingFlow = index.flowsById[flow.messageId];
+        if (existingFlow) {
+            [self detachFlow:existingFlow fromIndex:index];
+        }
+        [index addFlow:flow];
+        flow.store = self;
+        if (self.fileURL) {
+            flow.recordLength = [self appendStoreRecordForFlow:flow toData:self.pendingRecords];
+            self.liveLength += flow.recordLength;
+            self.logLength += flow.recordLength;
+            [self scheduleCommit];
+        }
+    }
+}
+
+- (void)removeFlow:(MQTTLogFlow *)flow {
+    @synchronized(self) {
+        if (flow.store != self) {
+            return;
+        }
+        [self detachFlow:flow fromIndex:[self indexForFlow:flow]];
+        if (self.fileURL) {
+            NSUInteger offset = MQTTLogBeginRecord(self.pendingRecords, MQTTLogRecordDelete);
+            [self appendKeyOfFlow:flow toData:self.pendingRecords];
+            self.logLength += MQTTLogEndRecord(self.pendingRecords, offset);
+            [self scheduleCommit];
+        }
+    }
+}
+
+- (void)removeAllFlowsForClientId:(NSString *)clientId {
+    @synchronized(self) {
+        NSMutableDictionary *clientIdFlows = self.clientIds[clientId];
+        for (MQTTLogFlowIndex *index in clientIdFlows.allValues) {
+            for (MQTTLogFlow *flow in [index.orderedFlows.array copy]) {
+                [self detachFlow:flow fromIndex:index];
+            }
+        }
+        [self.clientIds removeObjectForKey:clientId];
+        if (self.fileURL) {
+            NSUInteger offset = MQTTLogBeginRecord(self.pendingRecords, MQTTLogRecordDeleteAll);
+            MQTTLogAppendData(self.pendingRecords, [clientId dataUsingEncoding:NSUTF8StringEncoding]);
+            self.logLength += MQTTLogEndRecord(self.pendingRecords, offset);
+            [self scheduleCommit];
+        }
+    }
+}
+
+- (void)detachFlow:(MQTTLogFlow *)flow fromIndex:(MQTTLogFlowIndex *)index {
+    [index removeFlow:flow];
+    flow.store = nil;
+    self.liveLength -= flow.recordLength;
+    [self.dirtyFlows removeObject:flow];
+}
+
+- (void)flowDidChange:(MQTTLogFlow *)flow previousCommandType:(NSNumber *)commandType {
+    @synchronized(self) {
+        if (flow.store != self) {
+            return;
+        }
+        [[self indexForFlow:flow] flowDidChange:flow previousCommandType:commandType];
+        if (self.fileURL) {
+            [self.dirtyFlows addObject:flow];
+        }
+    }
+}
+
+/* Changes of commandType and deadline are only recorded when the session syncs.
+ * sync returns once all records appended so far, by any persistence sharing the store, are durable.
+ * The records of concurrent syncs are written by the same commit and share its fsync.
+ */
+- (void)sync {
+    unsigned long long generation;
+    @synchronized(self) {
+        if (!self.fileURL) {
+            return;
+        }
+        for (MQTTLogFlow *flow in self.dirtyFlows) {
+            NSUInteger offset = MQTTLogBeginRecord(self.pendingRecords, MQTTLogRecordUpdate);
+            [self appendKeyOfFlow:flow toData:self.pendingRecords];
+            [self appendStateOfFlow:flow toData:self.pendingRecords];
+            self.logLength += MQTTLogEndRecord(self.pendingRecords, offset);
+        }
+        [self.dirtyFlows removeAllObjects];
+        if (self.pendingRecords.length) {
+            [self scheduleCommit];
+            generation = self.pendingGeneration;
+        } else {
+            // the last generation taken by a commit, which may still be writing
+            generation = self.pendingGeneration - 1;
+        }
+    }
+
+    [self.commitCondition lock];
+    while (self.durableGeneration < generation) {
+        [self.commitCondition wait];
+    }
+    [self.commitCondition unlock];
+}
+
+#pragma mark - records
+
+- (void)appendKeyOfFlow:(MQTTLogFlow *)flow toData:(NSMutableData *)data {
+    MQTTLogAppendData(data, [flow.clientId dataUsingEncoding:NSUTF8StringEncoding]);
+    MQTTLogAppendUInt8(data, flow.incomingFlag.boolValue);
+    MQTTLogAppendUInt16(data, flow.messageId.unsignedShortValue);
+}
+
+- (void)appendStateOfFlow:(MQTTLogFlow *)flow toData:(NSMutableData *)data {
+    MQTTLogAppendUInt8(data, flow.commandType.unsignedCharValue);
+    MQTTLogAppendDate(data, flow.deadline);
+}
+
+- (NSUInteger)appendStoreRecordForFlow:(MQTTLogFlow *)flow toData:(NSMutableData *)data {
+    NSUInteger offset = MQTTLogBeginRecord(data, MQTTLogRecordStore);
+    [self appendKeyOfFlow:flow toData:data];
+    [self appendStateOfFlow:flow toData:data];
+    MQTTLogAppendUInt8(data, flow.qosLevel.unsignedCharValue);
+    MQTTLogAppendUInt8(data, flow.retainedFlag.boolValue);
+    MQTTLogAppendData(data, [flow.topic dataUsingEncoding:NSUTF8StringEncoding]);
+    MQTTLogAppendData(data, flow.data);
+    return MQTTLogEndRecord(data, offset);
+}
+
+- (BOOL)replayRecord:(const UInt8 *)bytes length:(NSUInteger)length {
+    MQTTLogReader reader = {bytes, length, 0};
+    UInt8 type;
+    NSString *clientId;
+    if (!MQTTLogReadUInt8(&reader, &type) || !MQTTLogReadString(&reader, &clientId) || !clientId) {
+        return FALSE;
+    }
+    if (type == MQTTLogRecordDeleteAll) {
+        [self.clientIds removeObjectForKey:clientId];
+        return TRUE;
+    }
+
+    UInt8 incomingFlag;
+    UInt16 messageId;
+    if (!MQTTLogReadUInt8(&reader, &incomingFlag) || !MQTTLogReadUInt16(&reader, &messageId)) {
+        return FALSE;
+    }
+    MQTTLogFlowIndex *index = [self indexForClientId:clientId incomingFlag:incomingFlag create:TRUE];
+    MQTTLogFlow *flow = index.flowsById[@(messageId)];
+
+    UInt8 commandType;
+    NSDate *deadline;
+    switch (type) {
+        case MQTTLogRecordStore: {
+            UInt8 qosLevel;
+            UInt8 retainedFlag;
+            NSString *topic;
+            NSData *data;
+            if (!MQTTLogReadUInt8(&reader, &commandType) ||
+                !MQTTLogReadDate(&reader, &deadline) ||
+                !MQTTLogReadUInt8(&reader, &qosLevel) ||
+                !MQTTLogReadUInt8(&reader, &retainedFlag) ||
+                !MQTTLogReadString(&reader, &topic) ||
+                !MQTTLogReadData(&reader, &data)) {
+                return FALSE;
+            }
+            if (flow) {
+                [index removeFlow:flow];
+                self.liveLength -= flow.recordLength;
+            }
+            flow = [[MQTTLogFlow alloc] init];
+            flow.clientId = clientId;
+            flow.incomingFlag = @(incomingFlag != 0);
+            flow.messageId = [NSNumber numberWithUnsignedInteger:messageId];
+            flow.commandType = [NSNumber numberWithUnsignedInteger:commandType];
+            flow.deadline = deadline;
+            flow.qosLevel = @(qosLevel);
+            flow.retainedFlag = @(retainedFlag != 0);
+            flow.topic = topic;
+            flow.data = data;
+            flow.recordLength = MQTTLogRecordHeaderLength + length;
+            [index addFlow:flow];
+            self.liveLength += flow.recordLength;
+            break;
+        }
+        case MQTTLogRecordUpdate: {
+            if (!MQTTLogReadUInt8(&reader, &commandType) || !MQTTLogReadDate(&reader, &deadline)) {
+                return FALSE;
+            }
+            if (flow) {
+                NSNumber *previousCommandType = flow.commandType;
+                flow.commandType = [NSNumber numberWithUnsignedInteger:commandType];
+                flow.deadline = deadline;
+                [index flowDidChange:flow previousCommandType:previousCommandType];
+            }
+            break;
+        }
+        case MQTTLogRecordDelete:
+            if (flow) {
+                [index removeFlow:flow];
+                self.liveLength -= flow.recordLength;
+            }
+            break;
+        default:
+            return FALSE;
+    }
+    return TRUE;
+}
+
+#pragma mark - file
+
+/* Replays the log up to the first incomplete or corrupt record and truncates it there */
+- (void)recover {
+    NSString *path = self.fileURL.path;
+    NSUInteger fileLength = 0;
+    NSUInteger validLength = 0;
+    NSDate *start = [NSDate date];
+
+    @autoreleasepool {
+        NSData *log = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+        const UInt8 *bytes = log.bytes;
+        fileLength = log.length;
+        MQTTLogReader reader = {bytes, fileLength, 0};
+        UInt32 magic;
+        UInt32 version;
+        if (MQTTLogReadUInt32(&reader, &magic) && magic == MQTTLogMagic &&
+            MQTTLogReadUInt32(&reader, &version) && version == MQTTLogVersion) {
+            validLength = MQTTLogHeaderLength;
+            UInt32 length;
+            UInt32 crc;
+            while (MQTTLogReadUInt32(&reader, &length) &&
+                   MQTTLogReadUInt32(&reader, &crc) &&
+                   length <= fileLength - reader.offset &&
+                   MQTTLogCRC32(bytes + reader.offset, length) == crc &&
+                   [self replayRecord:bytes + reader.offset length:length]) {
+                reader.offset += length;
+                validLength = reader.offset;
+            }
+        }
+    }
+
+    for (NSDictionary *clientIdFlows in self.clientIds.allValues) {
+        for (MQTTLogFlowIndex *index in clientIdFlows.allValues) {
+            for (MQTTLogFlow *flow in index.orderedFlows) {
+                flow.store = self;
+            }
+        }
+    }
+    self.liveLength += MQTTLogHeaderLength;
+
+    self.fd = open(path.fileSystemRepresentation, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (self.fd < 0) {
+        DDLogError(@"[MQTTLogPersistence] cannot open %@: %s", path, strerror(errno));
+        self.fileURL = nil;
+        return;
+    }
+    if (validLength < fileLength) {
+        DDLogWarn(@"[MQTTLogPersistence] discarding %lu bytes after the last complete record",
+                  (unsigned long)(fileLength - validLength));
+    }
+    if (validLength == 0) {
+        NSMutableData *header = [[NSMutableData alloc] init];
+        MQTTLogAppendHeader(header);
+        if (ftruncate(self.fd, 0) != 0 || ![self writeData:header toFile:self.fd]) {
+            DDLogError(@"[MQTTLogPersistence] cannot initialize %@: %s", path, strerror(errno));
+        }
+        validLength = MQTTLogHeaderLength;
+    } else if (validLength < fileLength) {
+        if (ftruncate(self.fd, validLength) != 0) {
+            DDLogError(@"[MQTTLogPersistence] cannot truncate %@: %s", path, strerror(errno));
+        }
+    }
+    self.logLength = validLength;
+    DDLogInfo(@"[MQTTLogPersistence] recovered %@ (%lu bytes) in %.3fs",
+              path, (unsigned long)validLength, -start.timeIntervalSinceNow);
+}
+
+/* Called while holding the store lock. Records added while a commit is writing are grouped
+ * into the next commit, so that concurrent syncs share a single fsync.
+ */
+- (void)scheduleCommit {
+    if (self.commitScheduled) {
+        return;
+    }
+    self.commitScheduled = TRUE;
+    dispatch_async(self.ioQueue, ^{
+        [self commit];
+    });
+}
+
+- (void)commit {
+    NSData *records;
+    NSData *snapshot = nil;
+    unsigned long long compactedLength = 0;
+    unsigned long long generation;
+    @synchronized(self) {
+        self.commitScheduled = FALSE;
+        records = self.pendingRecords;
+        self.pendingRecords = [[NSMutableData alloc] init];
+        generation = self.pendingGeneration++;
+        if (self.logLength >= self.compactionThreshold && self.logLength > 2 * self.liveLength) {
+            snapshot = [self snapshot];
+            compactedLength = self.logLength;
+        }
+    }
+
+    // the records are only appended if the snapshot, which already contains them, could not replace the log
+    if (snapshot && [self writeSnapshot:snapshot]) {
+        @synchronized(self) {
+            // records appended since the snapshot was taken are kept on top of its length
+            self.logLength -= compactedLength - snapshot.length;
+        }
+    } else if (records.length) {
+        if (![self writeData:records toFile:self.fd]) {
+            DDLogError(@"[MQTTLogPersistence] write error %s", strerror(errno));
+        }
+    }
+
+    // syncs waiting for this generation are released even after a write error, which was logged
+    [self.commitCondition lock];
+    self.durableGeneration = generation;
+    [self.commitCondition broadcast];
+    [self.commitCondition unlock];
+}
+
+/* Called while holding the store lock. The snapshot holds the current state of all flows,
+ * whose store records have the same length as the ones already counted in liveLength.
+ */
+- (NSData *)snapshot {
+    NSMutableData *snapshot = [[NSMutableData alloc] init];
+    MQTTLogAppendHeader(snapshot);
+    for (NSDictionary *clientIdFlows in self.clientIds.allValues) {
+        for (MQTTLogFlowIndex *index in clientIdFlows.allValues) {
+            for (MQTTLogFlow *flow in index.orderedFlows) {
+                [self appendStoreRecordForFlow:flow toData:snapshot];
+            }
+        }
+    }
+    return snapshot;
+}
+
+/* The snapshot is made durable under a temporary name before it atomically replaces the log.
+ * The directory is synced as well, so the rename survives a crash.
+ */
+- (BOOL)writeSnapshot:(NSData *)snapshot {
+    NSString *path = self.fileURL.path;
+    NSString *compactionPath = [path stringByAppendingString:@".compact"];
+    int fd = open(compactionPath.fileSystemRepresentation, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    if (fd < 0 || ![self writeData:snapshot toFile:fd] ||
+        rename(compactionPath.fileSystemRepresentation, path.fileSystemRepresentation) != 0) {
+        DDLogError(@"[MQTTLogPersistence] compaction error %s", strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return FALSE;
+    }
+    int directoryFd = open(path.stringByDeletingLastPathComponent.fileSystemRepresentation, O_RDONLY);
+    if (directoryFd < 0 || fsync(directoryFd) != 0) {
+        DDLogError(@"[MQTTLogPersistence] cannot sync the directory of %@: %s", path, strerror(errno));
+    }
+    if (directoryFd >= 0) {
+        close(directoryFd);
+    }
+    DDLogVerbose(@"[MQTTLogPersistence] compacted to %lu bytes", (unsigned long)snapshot.length);
+    close(self.fd);
+    self.fd = fd;
+    return TRUE;
+}
+
+- (BOOL)writeData:(NSData *)data toFile:(int)fd {
+    const UInt8 *bytes = data.bytes;
+    NSUInteger written = 0;
+    while (written < data.length) {
+        ssize_t result = write(fd, bytes + written, data.length - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        written += result;
+    }
+#ifdef F_FULLFSYNC
+    if (fcntl(fd, F_FULLFSYNC) == 0) {
+        return TRUE;
+    }
+#endif
+    return fsync(fd) == 0;
+}
+
+@end
+
+#pragma mark - persistence
+
+@interface MQTTLogPersistence()
+@property (strong, nonatomic) MQTTLogStore *logStore;
+@end
+
+@implementation MQTTLogPersistence
+@synthesize maxSize;
+@synthesize persistent;
+@synthesize maxMessages;
+@synthesize maxWindowSize;
+
+- (MQTTLogPersistence *)init {
+    self = [super init];
+    self.persistent = MQTT_PERSISTENT;
+    self.maxSize = MQTT_MAX_SIZE;
+    self.maxMessages = MQTT_MAX_MESSAGES;
+    self.maxWindowSize = MQTT_MAX_WINDOW_SIZE;
+    self.compactionThreshold = MQTTLogCompactionThreshold;
+    self.fileURL = [[[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory
+                                                           inDomains:NSUserDomainMask].lastObject
+                    URLByAppendingPathComponent:@"MQTTClient.log"];
+    return self;
+}
+
+/* The store is opened, and the log replayed, on first use so persistent and fileURL can be set after init */
+- (MQTTLogStore *)store {
+    @synchronized(self) {
+        if (!self.logStore) {
+            self.logStore = [MQTTLogStore storeWithFileURL:self.persistent ? self.fileURL : nil];
+            self.logStore.compactionThreshold = self.compactionThreshold;
+        }
+        return self.logStore;
+    }
+}
+
+- (NSUInteger)windowSize:(NSString *)clientId {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        MQTTLogFlowIndex *index = [store indexForClientId:clientId incomingFlag:NO create:FALSE];
+        return index.orderedFlows.count - index.queuedCount;
+    }
+}
+
+- (NSUInteger)queueSize:(NSString *)clientId {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        return [store indexForClientId:clientId incomingFlag:NO create:FALSE].queuedCount;
+    }
+}
+
+- (NSUInteger)flowCountforClientId:(NSString *)clientId
+                      incomingFlag:(BOOL)incomingFlag {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        return [store indexForClientId:clientId incomingFlag:incomingFlag create:FALSE].orderedFlows.count;
+    }
+}
+
+- (MQTTLogFlow *)storeMessageForClientId:(NSString *)clientId
+                                   topic:(NSString *)topic
+                                    data:(NSData *)data
+                              retainFlag:(BOOL)retainFlag
+                                     qos:(MQTTQosLevel)qos
+                                   msgId:(UInt16)msgId
+                            incomingFlag:(BOOL)incomingFlag
+                             commandType:(UInt8)commandType
+                                deadline:(NSDate *)deadline {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        MQTTLogFlowIndex *index = [store indexForClientId:clientId incomingFlag:incomingFlag create:FALSE];
+        if (index.orderedFlows.count <= self.maxMessages && store.liveLength <= self.maxSize) {
+            MQTTLogFlow *flow = [[MQTTLogFlow alloc] init];
+            flow.clientId = clientId;
+            flow.incomingFlag = @(incomingFlag);
+            flow.messageId = [NSNumber numberWithUnsignedInteger:msgId];
+            flow.topic = topic;
+            flow.data = data;
+            flow.retainedFlag = @(retainFlag);
+            flow.qosLevel = @(qos);
+            flow.commandType = [NSNumber numberWithUnsignedInteger:commandType];
+            flow.deadline = deadline;
+            [store addFlow:flow];
+            return flow;
+        } else {
+            return nil;
+        }
+    }
+}
+
+- (void)deleteFlow:(MQTTLogFlow *)flow {
+    [[self store] removeFlow:flow];
+}
+
+- (void)deleteAllFlowsForClientId:(NSString *)clientId {
+    DDLogInfo(@"[MQTTLogPersistence] deleteAllFlowsForClientId %@", clientId);
+    [[self store] removeAllFlowsForClientId:clientId];
+}
+
+- (void)sync {
+    [[self store] sync];
+}
+
+- (NSArray *)allFlowsforClientId:(NSString *)clientId
+                    incomingFlag:(BOOL)incomingFlag {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        // the array of an ordered set reflects later changes, so a copy is returned
+        NSArray *flows = [[store indexForClientId:clientId incomingFlag:incomingFlag create:FALSE].orderedFlows.array copy];
+        return flows ? flows : @[];
+    }
+}
+
+- (NSArray *)flowsforClientId:(NSString *)clientId
+                 incomingFlag:(BOOL)incomingFlag
+                    dueBefore:(NSDate *)date {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        NSArray *flows = [[store indexForClientId:clientId incomingFlag:incomingFlag create:FALSE] flowsDueBefore:date.timeIntervalSinceReferenceDate];
+        return flows ? flows : @[];
+    }
+}
+
+- (NSArray *)queuedFlowsforClientId:(NSString *)clientId
+                       incomingFlag:(BOOL)incomingFlag
+                              limit:(NSUInteger)limit {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        NSArray *flows = [[store indexForClientId:clientId incomingFlag:incomingFlag create:FALSE] queuedFlowsWithLimit:limit];
+        return flows ? flows : @[];
+    }
+}
+
+- (MQTTLogFlow *)earliestDeadlineFlowforClientId:(NSString *)clientId
+                                    incomingFlag:(BOOL)incomingFlag {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        return [store indexForClientId:clientId incomingFlag:incomingFlag create:FALSE].deadlineHeap.firstObject;
+    }
+}
+
+- (MQTTLogFlow *)flowforClientId:(NSString *)clientId
+                    incomingFlag:(BOOL)incomingFlag
+                       messageId:(UInt16)messageId {
+    MQTTLogStore *store = [self store];
+    @synchronized(store) {
+        MQTTLogFlowIndex *index = [store indexForClientId:clientId incomingFlag:incomingFlag create:FALSE];
+        return index.flowsById[[NSNumber numberWithUnsignedInteger:messageId]];
+    }
+}
+
+@end
@@ -218,6 +218,15 @@ typedef NS_ENUM(NSUInteger, MQTTReturnCode) {
 
 @property (NS_NONATOMIC_IOSONLY, readonly, copy) NSData *wireFormat;
 
+/** the largest possible fixed header: the header byte and four remaining length bytes */
+#define MQTTMessageMaximumFixedHeaderLength 5
+
+/** getFixedHeader: serializes the fixed header of the message without copying its data
+ * @param fixedHeader a buffer of at least MQTTMessageMaximumFixedHeaderLength bytes
+ * @return the number of bytes written to fixedHeader
+ */
+- (NSUInteger)getFixedHeader:(UInt8 *)fixedHeader;
+
 
 @end
 
@@ -230,3 +239,13 @@ typedef NS_ENUM(NSUInteger, MQTTReturnCode) {
 - (void)appendBinaryData:(NSData *)data;
 
 @end
+
+@interface NSData (MQTT)
+/** mqttSliceWithRange returns the bytes in range without copying them
+ * the slice keeps the receiver alive, which therefore must not be modified afterwards
+ * @param range the range of the bytes
+ * @return an immutable NSData sharing the receiver's bytes
+ */
+- (NSData *)mqttSliceWithRange:(NSRange)range;
+
+@end
@@ -486,10 +486,7 @@
     return self;
 }
 
-- (NSData *)wireFormat {
-    NSMutableData *buffer = [[NSMutableData alloc] init];
-
-    // encode fixed header
+- (NSUInteger)getFixedHeader:(UInt8 *)fixedHeader {
     UInt8 header;
     header = (self.type & 0x0f) << 4;
     if (self.dupFlag) {
@@ -499,8 +496,28 @@
     if (self.retainFlag) {
         header |= 0x01;
     }
-    [buffer appendBytes:&header length:1];
-    [buffer appendVariableLength:self.data.length];
+    fixedHeader[0] = header;
+
+    NSUInteger length = 1;
+    unsigned long remainingLength = self.data.length;
+    do {
+        UInt8 digit = remainingLength % 128;
+        remainingLength /= 128;
+        if (remainingLength > 0) {
+            digit |= 0x80;
+        }
+        fixedHeader[length++] = digit;
+    }
+    while (remainingLength > 0 && length < MQTTMessageMaximumFixedHeaderLength);
+    return length;
+}
+
+- (NSData *)wireFormat {
+    NSMutableData *buffer = [[NSMutableData alloc] initWithCapacity:MQTTMessageMaximumFixedHeaderLength + self.data.length];
+
+    // encode fixed header
+    UInt8 fixedHeader[MQTTMessageMaximumFixedHeaderLength];
+    [buffer appendBytes:fixedHeader length:[self getFixedHeader:fixedHeader]];
 
     // encode message data
     if (self.data != nil) {
@@ -568,7 +585,7 @@
                     message.dupFlag = dupFlag == 1;
                     message.retainFlag = retainFlag == 1;
                     message.qos = qos;
-                    message.data = [data subdataWithRange:NSMakeRange(offset, remainingLength)];
+                    message.data = [data mqttSliceWithRange:NSMakeRange(offset, remainingLength)];
                     if ((type == MQTTPublish &&
                          (qos == MQTTQosLevelAtLeastOnce ||
                           qos == MQTTQosLevelExactlyOnce)
@@ -760,3 +777,17 @@
 
 @end
 
+@implementation NSData (MQTT)
+
+- (NSData *)mqttSliceWithRange:(NSRange)range {
+    NSData *data = self;
+    dispatch_data_t slice = dispatch_data_create((const UInt8 *)self.bytes + range.location,
+                                                 range.length,
+                                                 dispatch_get_global_queue(QOS_CLASS_UTILITY, 0),
+                                                 ^{
+                                                     (void)data;
+                                                 });
+    return (NSData *)slice;
+}
+
+@end
@@ -121,4 +121,51 @@ static NSInteger const MQTT_MAX_MESSAGES = 1024;
 /** sync is called to allow the MQTTPersistence implemetation to save data permanently */
 - (void)sync;
 
+@optional
+
+/** The current number of outgoing messages queued but not yet sent per clientID.
+ * Implementations keeping incremental counters provide this so the session does not have to scan all flows.
+ * @param clientId identifying the session
+ * @return the number of outgoing flows with commandType MQTT_None
+ */
+- (NSUInteger)queueSize:(NSString *)clientId;
+
+/** The number of MQTTFlow elements of a clientId and direction
+ * @param clientId identifying the session
+ * @param incomingFlag specifies the direction of the flows
+ * @return the number of flows
+ */
+- (NSUInteger)flowCountforClientId:(NSString *)clientId
+                      incomingFlag:(BOOL)incomingFlag;
+
+/** Retrieves the inflight MQTTFlow element with the earliest deadline
+ * Queued flows (commandType MQTT_None) are not considered, their deadlines are meaningless.
+ * @param clientId to which the MQTTFlow belongs to
+ * @param incomingFlag specifies the direction of the flow
+ * @return the retrieved MQTTFlow element or nil if there are no inflight flows
+ */
+- (id<MQTTFlow>)earliestDeadlineFlowforClientId:(NSString *)clientId
+                                   incomingFlag:(BOOL)incomingFlag;
+
+/** Retrieves the inflight MQTTFlow elements whose deadline lies before a date
+ * Queued flows (commandType MQTT_None) are retrieved with queuedFlowsforClientId:incomingFlag:limit: instead.
+ * @param clientId whos MQTTFlows should be retrieved
+ * @param incomingFlag specifies the direction of the flows
+ * @param date the date the deadlines are compared to
+ * @return an NSArray of the retrieved MQTTFlow elements in the order they were stored
+ */
+- (NSArray *)flowsforClientId:(NSString *)clientId
+                 incomingFlag:(BOOL)incomingFlag
+                    dueBefore:(NSDate *)date;
+
+/** Retrieves the oldest queued MQTTFlow elements (commandType MQTT_None)
+ * @param clientId whos MQTTFlows should be retrieved
+ * @param incomingFlag specifies the direction of the flows
+ * @param limit the maximum number of flows retrieved
+ * @return an NSArray of the retrieved MQTTFlow elements in the order they were stored
+ */
+- (NSArray *)queuedFlowsforClientId:(NSString *)clientId
+                       incomingFlag:(BOOL)incomingFlag
+                              limit:(NSUInteger)limit;
+
 @end
@@ -69,6 +69,7 @@
     
     if (!connectError) {
         self.encoder = [[MQTTSSLSecurityPolicyEncoder alloc] init];
+        self.encoder.queue = self.queue;
         CFWriteStreamSetDispatchQueue(writeStream, self.queue);
         self.encoder.stream = CFBridgingRelease(writeStream);
         self.encoder.securityPolicy = self.tls ? self.securityPolicy : nil;
@@ -386,6 +386,45 @@ typedef void (^MQTTPublishHandler)(NSError *error);
  */
 @property (readonly, nonatomic) UInt16 effectiveKeepAlive;
 
+/** pingInterval is the time interval in seconds between PINGREQs sent while connected.
+ *  Zero (the default) or a value above effectiveKeepAlive means effectiveKeepAlive.
+ *  Changing it while connected takes effect immediately, so the interval can be adapted
+ *  to the network without reconnecting.
+ */
+@property (nonatomic) NSTimeInterval pingInterval;
+
+/** pingTimeout is the time in seconds to wait for the PINGRESP after a PINGREQ.
+ *  If it does not arrive in time, the connection is considered lost and closed
+ *  with MQTTSessionEventConnectionError. Zero (the default) never times out.
+ */
+@property (nonatomic) NSTimeInterval pingTimeout;
+
+/** roundTripTime is the time in seconds between the last PINGREQ sent and the PINGRESP received.
+ *  Zero until a PINGRESP has been received on the current connection.
+ */
+@property (readonly, nonatomic) NSTimeInterval roundTripTime;
+
+/** The serverReceiveMaximum is the number of QoS 1 and QoS 2 publications the broker
+ *  is willing to process concurrently, as sent in the CONNACK. nil if the broker did not limit it. MQTT v5.0
+ */
+@property (readonly, strong, nonatomic) NSNumber *serverReceiveMaximum;
+
+/** The serverTopicAliasMaximum is the highest topic alias the broker accepts, as sent in the CONNACK.
+ *  nil or zero if the broker does not accept topic aliases. MQTT v5.0
+ */
+@property (readonly, strong, nonatomic) NSNumber *serverTopicAliasMaximum;
+
+/** effectiveWindowSize is the number of outgoing QoS 1 and QoS 2 messages kept in flight.
+ *  It is persistence.maxWindowSize, limited by serverReceiveMaximum after a successfull connect.
+ */
+@property (readonly, nonatomic) NSUInteger effectiveWindowSize;
+
+/** topicAliasesEnabled lets the session assign topic aliases to outgoing PUBLISH messages, up to
+ *  serverTopicAliasMaximum. Once the broker has received a topic with its alias, the topic is replaced
+ *  by the alias for the rest of the connection. Defaults to TRUE. MQTT v5.0
+ */
+@property (nonatomic) BOOL topicAliasesEnabled;
+
 
 /**
  * dupTimeout If PUBACK or PUBREC not received, message will be resent after this interval
@@ -451,7 +490,7 @@ typedef void (^MQTTPublishHandler)(NSError *error);
 /** topicAliasMaximum specifies the number of seconds after which a session should expire MQTT v5.0*/
 @property (strong, nonatomic) NSDictionary <NSString *, NSString*> *userProperty;
 
-/** maximumPacketSize specifies the number of seconds after which a session should expire MQTT v5.0*/
+/** maximumPacketSize specifies the maximum packet size the client accepts MQTT v5.0, also enforced by the decoder for all protocol levels */
 @property (strong, nonatomic) NSNumber *maximumPacketSize;
 
 /** queue The queue where the streams are scheduled. */
@@ -26,8 +26,13 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 @property (nonatomic, readwrite) BOOL sessionPresent;
 
 @property (strong, nonatomic) Timer *keepAliveTimer;
+@property (strong, nonatomic) Timer *pingTimeoutTimer;
 @property (strong, nonatomic) NSNumber *serverKeepAlive;
 @property (nonatomic) UInt16 effectiveKeepAlive;
+@property (nonatomic) NSTimeInterval roundTripTime;
+@property (strong, nonatomic) NSDate *pingreqDate;
+@property (strong, nonatomic) NSNumber *serverReceiveMaximum;
+@property (strong, nonatomic) NSNumber *serverTopicAliasMaximum;
 @property (strong, nonatomic) Timer *checkDupTimer;
 
 @property (strong, nonatomic) MQTTDecoder *decoder;
@@ -36,23 +41,25 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 @property (nonatomic, strong) NSMutableDictionary<NSNumber *, MQTTSubscribeHandler> *subscribeHandlers;
 @property (nonatomic, strong) NSMutableDictionary<NSNumber *, MQTTUnsubscribeHandler> *unsubscribeHandlers;
 @property (nonatomic, strong) NSMutableDictionary<NSNumber *, MQTTPublishHandler> *publishHandlers;
+@property (nonatomic, strong) NSMutableDictionary<NSData *, NSString *> *topicCache;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *topicAliases;
+@property (nonatomic, strong) NSMutableSet<NSNumber *> *announcedTopicAliases;
 
 @property (nonatomic) UInt16 txMsgId;
 
-@property (nonatomic) BOOL synchronPub;
-@property (nonatomic) UInt16 synchronPubMid;
-@property (nonatomic) BOOL synchronUnsub;
-@property (nonatomic) UInt16 synchronUnsubMid;
-@property (nonatomic) BOOL synchronSub;
-@property (nonatomic) UInt16 synchronSubMid;
-@property (nonatomic) BOOL synchronConnect;
-@property (nonatomic) BOOL synchronDisconnect;
+@property (strong, nonatomic) NSMutableSet *synchronFutures;
 
 @property (strong, nonatomic) MQTTSSLSecurityPolicy *securityPolicy;
 
 @end
 
+/* implemented in MQTTSessionSynchron.m */
+@interface MQTTSession(SynchronFutures)
+- (void)failSynchronFutures;
+@end
+
 #define DUPLOOP 1.0
+#define TOPIC_CACHE_SIZE 256
 
 @implementation MQTTSession
 @synthesize certificates;
@@ -74,6 +81,9 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
     self.subscribeHandlers = [[NSMutableDictionary alloc] init];
     self.unsubscribeHandlers = [[NSMutableDictionary alloc] init];
     self.publishHandlers = [[NSMutableDictionary alloc] init];
+    self.topicAliases = [[NSMutableDictionary alloc] init];
+    self.announcedTopicAliases = [[NSMutableSet alloc] init];
+    self.topicAliasesEnabled = TRUE;
 
     self.clientId = nil;
     self.userName = nil;
@@ -94,6 +104,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 
 - (void)dealloc {
     [self.keepAliveTimer invalidate];
+    [self.pingTimeoutTimer invalidate];
     [self.checkDupTimer invalidate];
 }
 
@@ -360,22 +371,13 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 
     UInt16 msgId = 0;
     if (!qos) {
-        MQTTMessage *msg = [MQTTMessage publishMessageWithData:data
-                                                       onTopic:topic
-                                                           qos:qos
-                                                         msgId:msgId
-                                                    retainFlag:retainFlag
-                                                       dupFlag:FALSE
-                                                 protocolLevel:self.protocolLevel
-                                        payloadFormatIndicator:nil
-                                     publicationExpiryInterval:nil
-                                                    topicAlias:nil
-                                                 responseTopic:nil
-                                               correlationData:nil
-                                                  userProperty:nil
-                                                   contentType:nil];
         NSError *error = nil;
-        if (![self encode:msg]) {
+        if (![self encodePublishWithData:data
+                                 onTopic:topic
+                                     qos:qos
+                                   msgId:msgId
+                              retainFlag:retainFlag
+                                 dupFlag:FALSE]) {
             error = [NSError errorWithDomain:MQTTSessionErrorDomain
                                         code:MQTTSessionErrorEncoderNotReady
                                     userInfo:@{NSLocalizedDescriptionKey : @"Encoder not ready"}];
@@ -385,37 +387,28 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
         }
     } else {
         msgId = [self nextMsgId];
-        MQTTMessage *msg = nil;
+        BOOL sendNow = FALSE;
 
         id<MQTTFlow> flow;
         if (self.status == MQTTSessionStatusConnected) {
-            NSArray *flows = [self.persistence allFlowsforClientId:self.clientId
-                                                      incomingFlag:NO];
-
             BOOL unprocessedMessageNotExists = TRUE;
             NSUInteger windowSize = 0;
-            for (id<MQTTFlow> flow in flows) {
-                if ((flow.commandType).intValue != MQTT_None) {
-                    windowSize++;
-                } else {
-                    unprocessedMessageNotExists = FALSE;
+            if ([self.persistence respondsToSelector:@selector(queueSize:)]) {
+                unprocessedMessageNotExists = [self.persistence queueSize:self.clientId] == 0;
+                windowSize = [self.persistence windowSize:self.clientId];
+            } else {
+                NSArray *flows = [self.persistence allFlowsforClientId:self.clientId
+                                                          incomingFlag:NO];
+                for (id<MQTTFlow> flow in flows) {
+                    if ((flow.commandType).intValue != MQTT_None) {
+                        windowSize++;
+                    } else {
+                        unprocessedMessageNotExists = FALSE;
+                    }
                 }
             }
-            if (unprocessedMessageNotExists && windowSize <= self.persistence.maxWindowSize) {
-                msg = [MQTTMessage publishMessageWithData:data
-                                                  onTopic:topic
-                                                      qos:qos
-                                                    msgId:msgId
-                                               retainFlag:retainFlag
-                                                  dupFlag:FALSE
-                                            protocolLevel:self.protocolLevel
-                                   payloadFormatIndicator:nil
-                                publicationExpiryInterval:nil
-                                               topicAlias:nil
-                                            responseTopic:nil
-                                          correlationData:nil
-                                             userProperty:nil
-                                              contentType:nil];
+            if (unprocessedMessageNotExists && windowSize < self.effectiveWindowSize) {
+                sendNow = TRUE;
                 flow = [self.persistence storeMessageForClientId:self.clientId
                                                            topic:topic
                                                             data:data
@@ -427,7 +420,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                                         deadline:[NSDate dateWithTimeIntervalSinceNow:self.dupTimeout]];
             }
         }
-        if (!msg) {
+        if (!sendNow) {
             flow = [self.persistence storeMessageForClientId:self.clientId
                                                        topic:topic
                                                         data:data
@@ -457,7 +450,12 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 
             if ((flow.commandType).intValue == MQTTPublish) {
                 DDLogVerbose(@"[MQTTSession] PUBLISH %d", msgId);
-                if (![self encode:msg]) {
+                if (![self encodePublishWithData:data
+                                         onTopic:topic
+                                             qos:qos
+                                           msgId:msgId
+                                      retainFlag:retainFlag
+                                         dupFlag:FALSE]) {
                     DDLogInfo(@"[MQTTSession] queueing message %d after unsuccessfull attempt", msgId);
                     flow.commandType = [NSNumber numberWithUnsignedInt:MQTT_None];
                     flow.deadline = [NSDate date];
@@ -466,6 +464,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
             } else {
                 DDLogInfo(@"[MQTTSession] queueing message %d", msgId);
             }
+            [self scheduleTxFlows];
         }
     }
     [self tell];
@@ -538,6 +537,15 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
         self.keepAliveTimer = nil;
     }
 
+    if (self.pingTimeoutTimer) {
+        [self.pingTimeoutTimer invalidate];
+        self.pingTimeoutTimer = nil;
+    }
+
+    /* topic aliases only live as long as the network connection */
+    [self.topicAliases removeAllObjects];
+    [self.announcedTopicAliases removeAllObjects];
+
     if (self.transport) {
         [self.transport close];
         self.transport.delegate = nil;
@@ -591,18 +599,73 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
     }
 
     [self tell];
-    self.synchronPub = FALSE;
-    self.synchronPubMid = 0;
-    self.synchronSub = FALSE;
-    self.synchronSubMid = 0;
-    self.synchronUnsub = FALSE;
-    self.synchronUnsubMid = 0;
+    [self failSynchronFutures];
 }
 
 
 - (void)keepAlive {
     DDLogVerbose(@"[MQTTSession] keepAlive %@ @%.0f", self.clientId, [[NSDate date] timeIntervalSince1970]);
-    (void)[self encode:[MQTTMessage pingreqMessage]];
+    if ([self encode:[MQTTMessage pingreqMessage]] && !self.pingreqDate) {
+        self.pingreqDate = [NSDate date];
+
+        if (self.pingTimeout > 0) {
+            __weak MQTTSession *weakSelf = self;
+            [self.pingTimeoutTimer invalidate];
+            self.pingTimeoutTimer = [Timer scheduledTimerWithTimeInterval:self.pingTimeout
+                                                                  repeats:NO
+                                                                    queue:self.queue
+                                                                    block:^{
+                                                                        [weakSelf pingTimedOut];
+                                                                    }];
+        }
+    }
+}
+
+- (void)handlePingresp {
+    [self.pingTimeoutTimer invalidate];
+    self.pingTimeoutTimer = nil;
+
+    if (self.pingreqDate) {
+        self.roundTripTime = -self.pingreqDate.timeIntervalSinceNow;
+        self.pingreqDate = nil;
+    }
+}
+
+/* a connection silently dropped, e.g. by a NAT timeout, is only noticed by the missing PINGRESP */
+- (void)pingTimedOut {
+    self.pingTimeoutTimer = nil;
+    if (self.pingreqDate && self.status == MQTTSessionStatusConnected) {
+        DDLogWarn(@"[MQTTSession] no PINGRESP within %.0f seconds", self.pingTimeout);
+        NSError *error = [NSError errorWithDomain:MQTTSessionErrorDomain
+                                             code:MQTTSessionErrorNoResponse
+                                         userInfo:@{NSLocalizedDescriptionKey : @"No PINGRESP received"}];
+        [self error:MQTTSessionEventConnectionError error:error];
+    }
+}
+
+- (NSTimeInterval)effectivePingInterval {
+    if (self.pingInterval > 0 && self.pingInterval < self.effectiveKeepAlive) {
+        return self.pingInterval;
+    }
+    return self.effectiveKeepAlive;
+}
+
+- (void)setPingInterval:(NSTimeInterval)pingInterval {
+    _pingInterval = pingInterval;
+    if (self.keepAliveTimer) {
+        [self scheduleKeepAliveTimer];
+    }
+}
+
+- (void)scheduleKeepAliveTimer {
+    __weak MQTTSession *weakSelf = self;
+    [self.keepAliveTimer invalidate];
+    self.keepAliveTimer = [Timer scheduledTimerWithTimeInterval:[self effectivePingInterval]
+                                                        repeats:YES
+                                                          queue:self.queue
+                                                          block:^() {
+                                                              [weakSelf keepAlive];
+                                                          }];
 }
 
 - (void)checkDup {
@@ -617,64 +680,63 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
         return;
     }
 
-    NSArray *flows = [self.persistence allFlowsforClientId:self.clientId
-                                              incomingFlag:NO];
-    windowSize = 0;
-    message = nil;
-
-    for (id<MQTTFlow> flow in flows) {
-        if ((flow.commandType).intValue != MQTT_None) {
-            windowSize++;
+    NSDate *now = [NSDate date];
+    NSDate *deadline = [now dateByAddingTimeInterval:self.dupTimeout];
+    NSArray *flows;
+    if ([self persistenceIndexesFlows]) {
+        windowSize = [self.persistence windowSize:self.clientId];
+        flows = [self.persistence flowsforClientId:self.clientId
+                                      incomingFlag:NO
+                                         dueBefore:now];
+        if (windowSize < self.effectiveWindowSize) {
+            NSArray *queuedFlows = [self.persistence queuedFlowsforClientId:self.clientId
+                                                               incomingFlag:NO
+                                                                      limit:self.effectiveWindowSize - windowSize];
+            flows = [flows arrayByAddingObjectsFromArray:queuedFlows];
+        }
+    } else {
+        flows = [self.persistence allFlowsforClientId:self.clientId
+                                         incomingFlag:NO];
+        windowSize = 0;
+        for (id<MQTTFlow> flow in flows) {
+            if ((flow.commandType).intValue != MQTT_None) {
+                windowSize++;
+            }
         }
     }
+    message = nil;
+
+    BOOL flowsChanged = FALSE;
     for (id<MQTTFlow> flow in flows) {
         DDLogVerbose(@"[MQTTSession] %@ flow %@ %@ %@", self.clientId, flow.deadline, flow.commandType, flow.messageId);
-        if ([flow.deadline compare:[NSDate date]] == NSOrderedAscending) {
+        if ((flow.commandType).intValue == MQTT_None || [flow.deadline compare:now] == NSOrderedAscending) {
             switch ((flow.commandType).intValue) {
                 case 0:
-                    if (windowSize <= self.persistence.maxWindowSize) {
+                    if (windowSize < self.effectiveWindowSize) {
                         DDLogVerbose(@"[MQTTSession] PUBLISH queued message %@", flow.messageId);
-                        message = [MQTTMessage publishMessageWithData:flow.data
-                                                              onTopic:flow.topic
-                                                                  qos:(flow.qosLevel).intValue
-                                                                msgId:(flow.messageId).intValue
-                                                           retainFlag:(flow.retainedFlag).boolValue
-                                                              dupFlag:NO
-                                                        protocolLevel:self.protocolLevel
-                                               payloadFormatIndicator:nil
-                                            publicationExpiryInterval:nil
-                                                           topicAlias:nil
-                                                        responseTopic:nil
-                                                      correlationData:nil
-                                                         userProperty:nil
-                                                          contentType:nil];
-                        if ([self encode:message]) {
+                        if ([self encodePublishWithData:flow.data
+                                                onTopic:flow.topic
+                                                    qos:(flow.qosLevel).intValue
+                                                  msgId:(flow.messageId).intValue
+                                             retainFlag:(flow.retainedFlag).boolValue
+                                                dupFlag:NO]) {
                             flow.commandType = @(MQTTPublish);
-                            flow.deadline = [NSDate dateWithTimeIntervalSinceNow:self.dupTimeout];
-                            [self.persistence sync];
+                            flow.deadline = deadline;
+                            flowsChanged = TRUE;
                             windowSize++;
                         }
                     }
                     break;
                 case MQTTPublish:
                     DDLogInfo(@"[MQTTSession] resend PUBLISH %@", flow.messageId);
-                    message = [MQTTMessage publishMessageWithData:flow.data
-                                                          onTopic:flow.topic
-                                                              qos:(flow.qosLevel).intValue
-                                                            msgId:(flow.messageId).intValue
-                                                       retainFlag:(flow.retainedFlag).boolValue
-                                                          dupFlag:YES
-                                                    protocolLevel:self.protocolLevel
-                                           payloadFormatIndicator:nil
-                                        publicationExpiryInterval:nil
-                                                       topicAlias:nil
-                                                    responseTopic:nil
-                                                  correlationData:nil
-                                                     userProperty:nil
-                                                      contentType:nil];
-                    if ([self encode:message]) {
-                        flow.deadline = [NSDate dateWithTimeIntervalSinceNow:self.dupTimeout];
-                        [self.persistence sync];
+                    if ([self encodePublishWithData:flow.data
+                                            onTopic:flow.topic
+                                                qos:(flow.qosLevel).intValue
+                                              msgId:(flow.messageId).intValue
+                                         retainFlag:(flow.retainedFlag).boolValue
+                                            dupFlag:YES]) {
+                        flow.deadline = deadline;
+                        flowsChanged = TRUE;
                     }
                     break;
                 case MQTTPubrel:
@@ -685,8 +747,8 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                                          reasonString:nil
                                                          userProperty:nil];
                     if ([self encode:message]) {
-                        flow.deadline = [NSDate dateWithTimeIntervalSinceNow:self.dupTimeout];
-                        [self.persistence sync];
+                        flow.deadline = deadline;
+                        flowsChanged = TRUE;
                     }
                     break;
                 default:
@@ -694,6 +756,117 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
             }
         }
     }
+    if (flowsChanged) {
+        [self.persistence sync];
+    }
+    [self scheduleTxFlows];
+}
+
+/*
+ * A persistence indexing flows keeps queued flows in a FIFO and inflight flows by deadline,
+ * so checkTxFlows neither scans all flows nor polls for queued ones.
+ */
+- (BOOL)persistenceIndexesFlows {
+    return [self.persistence respondsToSelector:@selector(flowsforClientId:incomingFlag:dueBefore:)] &&
+           [self.persistence respondsToSelector:@selector(earliestDeadlineFlowforClientId:incomingFlag:)] &&
+           [self.persistence respondsToSelector:@selector(queuedFlowsforClientId:incomingFlag:limit:)] &&
+           [self.persistence respondsToSelector:@selector(queueSize:)];
+}
+
+/*
+ * With a persistence indexing flows, checkDupTimer is armed for the earliest inflight deadline
+ * instead of scanning all flows every DUPLOOP. While the window is full, queued flows are sent
+ * when an acknowledgement frees it, see txFlowsAcknowledged.
+ * Flows still due after checkTxFlows, and queued flows while the window has room, are waiting
+ * for the encoder, so they are retried after DUPLOOP.
+ */
+- (void)scheduleTxFlows {
+    if (!self.checkDupTimer || ![self persistenceIndexesFlows]) {
+        return;
+    }
+    id<MQTTFlow> flow = [self.persistence earliestDeadlineFlowforClientId:self.clientId
+                                                             incomingFlag:NO];
+    NSTimeInterval interval = -1;
+    if (flow) {
+        interval = flow.deadline ? flow.deadline.timeIntervalSinceNow : DUPLOOP;
+        if (interval <= 0) {
+            interval = DUPLOOP;
+        }
+    }
+    if ([self.persistence queueSize:self.clientId] > 0 &&
+        [self.persistence windowSize:self.clientId] < self.effectiveWindowSize) {
+        interval = interval < 0 ? DUPLOOP : MIN(interval, DUPLOOP);
+    }
+    [self.checkDupTimer rescheduleWithTimeInterval:interval];
+}
+
+/*
+ * Called after an acknowledgement released an outgoing flow: queued messages are sent
+ * right away when the window allows it, otherwise the timer is rearmed.
+ */
+- (void)txFlowsAcknowledged {
+    if ([self.persistence respondsToSelector:@selector(queueSize:)] &&
+        [self.persistence queueSize:self.clientId] > 0) {
+        [self checkTxFlows];
+    } else {
+        [self scheduleTxFlows];
+    }
+}
+
+- (NSUInteger)effectiveWindowSize {
+    NSUInteger windowSize = self.persistence.maxWindowSize;
+    if (self.serverReceiveMaximum && self.serverReceiveMaximum.unsignedIntegerValue < windowSize) {
+        windowSize = self.serverReceiveMaximum.unsignedIntegerValue;
+    }
+    return windowSize;
+}
+
+/*
+ * Encodes a PUBLISH message. With topic aliases, the topic is sent together with its alias
+ * until one such message has been encoded on the current connection, and only the alias afterwards.
+ */
+- (BOOL)encodePublishWithData:(NSData *)data
+                      onTopic:(NSString *)topic
+                          qos:(MQTTQosLevel)qos
+                        msgId:(UInt16)msgId
+                   retainFlag:(BOOL)retainFlag
+                      dupFlag:(BOOL)dupFlag {
+    NSNumber *topicAlias = [self topicAliasForTopic:topic];
+    BOOL announced = topicAlias && [self.announcedTopicAliases containsObject:topicAlias];
+    MQTTMessage *message = [MQTTMessage publishMessageWithData:data
+                                                       onTopic:announced ? @"" : topic
+                                                           qos:qos
+                                                         msgId:msgId
+                                                    retainFlag:retainFlag
+                                                       dupFlag:dupFlag
+                                                 protocolLevel:self.protocolLevel
+                                        payloadFormatIndicator:nil
+                                     publicationExpiryInterval:nil
+                                                    topicAlias:topicAlias
+                                                 responseTopic:nil
+                                               correlationData:nil
+                                                  userProperty:nil
+                                                   contentType:nil];
+    if (![self encode:message]) {
+        return FALSE;
+    }
+    if (topicAlias) {
+        [self.announcedTopicAliases addObject:topicAlias];
+    }
+    return TRUE;
+}
+
+/* Aliases are assigned in order of first use and kept until the next connect */
+- (NSNumber *)topicAliasForTopic:(NSString *)topic {
+    if (!self.topicAliasesEnabled || self.protocolLevel != MQTTProtocolVersion50 || !topic.length) {
+        return nil;
+    }
+    NSNumber *topicAlias = self.topicAliases[topic];
+    if (!topicAlias && self.topicAliases.count < self.serverTopicAliasMaximum.unsignedIntegerValue) {
+        topicAlias = @(self.topicAliases.count + 1);
+        self.topicAliases[topic] = topicAlias;
+    }
+    return topicAlias;
 }
 
 - (void)decoder:(MQTTDecoder *)sender handleEvent:(MQTTDecoderEvent)eventCode error:(NSError *)error {
@@ -783,6 +956,11 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                 } else {
                                     self.sessionPresent = false;
                                 }
+                                /* checkDup resends flows right away, so the window and the aliases of this connection apply */
+                                self.serverReceiveMaximum = message.properties.receiveMaximum;
+                                self.serverTopicAliasMaximum = message.properties.topicAliasMaximum;
+                                [self.topicAliases removeAllObjects];
+                                [self.announcedTopicAliases removeAllObjects];
                                 __weak typeof(self) weakSelf = self;
                                 self.checkDupTimer = [Timer scheduledTimerWithTimeInterval:DUPLOOP
                                                                                    repeats:YES
@@ -794,6 +972,8 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                 if (message.properties) {
                                     self.serverKeepAlive = message.properties.serverKeepAlive;
                                 }
+                                self.roundTripTime = 0;
+                                self.pingreqDate = nil;
                                 if (self.serverKeepAlive) {
                                     self.effectiveKeepAlive = (self.serverKeepAlive).unsignedShortValue;
                                 } else {
@@ -801,12 +981,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                 }
 
                                 if (self.effectiveKeepAlive > 0) {
-                                    self.keepAliveTimer = [Timer scheduledTimerWithTimeInterval:self.effectiveKeepAlive
-                                                                                        repeats:YES
-                                                                                          queue: self.queue
-                                                                                          block:^() {
-                                                                                              [weakSelf keepAlive];
-                                                                                          }];
+                                    [self scheduleKeepAliveTimer];
                                 }
 
                                 if ([self.delegate respondsToSelector:@selector(handleEvent:event:error:)]) {
@@ -873,8 +1048,6 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                     [self onConnect:connectHandler error:error];
                                 }
                             }
-
-                            self.synchronConnect = FALSE;
                         }
                         break;
                     case MQTTDisconnect: {
@@ -927,6 +1100,9 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                     case MQTTUnsuback:
                         [self handleUnsuback:message];
                         break;
+                    case MQTTPingresp:
+                        [self handlePingresp];
+                        break;
                     case MQTTDisconnect: {
                         NSError *error = [NSError errorWithDomain:MQTTSessionErrorDomain
                                                              code:(message.returnCode).intValue
@@ -956,16 +1132,9 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
     if (data.length < 2 + topicLength) {
         return;
     }
-    NSData *topicData = [data subdataWithRange:NSMakeRange(2, topicLength)];
-    NSString *topic = [[NSString alloc] initWithData:topicData
-                                            encoding:NSUTF8StringEncoding];
-    if (!topic) {
-        topic = [[NSString alloc] initWithData:topicData
-                                      encoding:NSISOLatin1StringEncoding];
-        DDLogError(@"non UTF8 topic %@", topic);
-    }
+    NSString *topic = [self topicWithBytes:bytes + 2 length:topicLength];
     NSRange range = NSMakeRange(2 + topicLength, data.length - topicLength - 2);
-    data = [data subdataWithRange:range];
+    data = [data mqttSliceWithRange:range];
 
     if (msg.qos == 0) {
         if (self.protocolLevel == MQTTProtocolVersion50) {
@@ -973,7 +1142,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
             int variableLength = [MQTTProperties variableIntLength:propertiesLength];
             msg.properties = [[MQTTProperties alloc] initFromData:data];
             NSRange range = NSMakeRange(variableLength + propertiesLength, data.length - variableLength - propertiesLength);
-            data = [data subdataWithRange:range];
+            data = [data mqttSliceWithRange:range];
         }
         if ([self.delegate respondsToSelector:@selector(newMessage:data:onTopic:qos:retained:mid:)]) {
             [self.delegate newMessage:self
@@ -999,14 +1168,14 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
             bytes = data.bytes;
             UInt16 msgId = 256 * bytes[0] + bytes[1];
             msg.mid = msgId;
-            data = [data subdataWithRange:NSMakeRange(2, data.length - 2)];
+            data = [data mqttSliceWithRange:NSMakeRange(2, data.length - 2)];
             if (msg.qos == 1) {
                 if (self.protocolLevel == MQTTProtocolVersion50) {
                     int propertiesLength = [MQTTProperties getVariableLength:data];
                     int variableLength = [MQTTProperties variableIntLength:propertiesLength];
                     msg.properties = [[MQTTProperties alloc] initFromData:data];
                     NSRange range = NSMakeRange(variableLength + propertiesLength, data.length - variableLength - propertiesLength);
-                    data = [data subdataWithRange:range];
+                    data = [data mqttSliceWithRange:range];
                 }
 
                 BOOL processed = true;
@@ -1062,6 +1231,31 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
     }
 }
 
+/*
+ * Topic names are interned: messages arriving on the same topics decode each name once
+ * instead of creating a new NSString per message.
+ */
+- (NSString *)topicWithBytes:(const UInt8 *)bytes length:(NSUInteger)length {
+    NSData *key = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+    NSString *topic = self.topicCache[key];
+    if (!topic) {
+        topic = [[NSString alloc] initWithBytes:bytes
+                                         length:length
+                                       encoding:NSUTF8StringEncoding];
+        if (!topic) {
+            topic = [[NSString alloc] initWithBytes:bytes
+                                             length:length
+                                           encoding:NSISOLatin1StringEncoding];
+            DDLogError(@"non UTF8 topic %@", topic);
+        }
+        if (!self.topicCache || self.topicCache.count >= TOPIC_CACHE_SIZE) {
+            self.topicCache = [[NSMutableDictionary alloc] init];
+        }
+        self.topicCache[[NSData dataWithBytes:bytes length:length]] = topic;
+    }
+    return topic;
+}
+
 - (void)handlePuback:(MQTTMessage*)msg {
     id<MQTTFlow> flow = [self.persistence flowforClientId:self.clientId
                                              incomingFlag:NO
@@ -1079,9 +1273,6 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                             qos:(flow.qosLevel).intValue
                                      retainFlag:(flow.retainedFlag).boolValue];
             }
-            if (self.synchronPub && self.synchronPubMid == msg.mid) {
-                self.synchronPub = FALSE;
-            }
             MQTTPublishHandler publishHandler = (self.publishHandlers)[@(msg.mid)];
             if (publishHandler) {
                 [self.publishHandlers removeObjectForKey:@(msg.mid)];
@@ -1090,6 +1281,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
             [self.persistence deleteFlow:flow];
             [self.persistence sync];
             [self tell];
+            [self txFlowsAcknowledged];
         }
     }
 }
@@ -1107,9 +1299,6 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
         if ([self.delegate respondsToSelector:@selector(subAckReceived:msgID:grantedQoss:)]) {
             [self.delegate subAckReceived:self msgID:msg.mid grantedQoss:qoss];
         }
-        if (self.synchronSub && self.synchronSubMid == msg.mid) {
-            self.synchronSub = FALSE;
-        }
         MQTTSubscribeHandler subscribeHandler = (self.subscribeHandlers)[@(msg.mid)];
         if (subscribeHandler) {
             [self.subscribeHandlers removeObjectForKey:@(msg.mid)];
@@ -1122,9 +1311,6 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
     if ([self.delegate respondsToSelector:@selector(unsubAckReceived:msgID:)]) {
         [self.delegate unsubAckReceived:self msgID:message.mid];
     }
-    if (self.synchronUnsub && self.synchronUnsubMid == message.mid) {
-        self.synchronUnsub = FALSE;
-    }
     MQTTUnsubscribeHandler unsubscribeHandler = (self.unsubscribeHandlers)[@(message.mid)];
     if (unsubscribeHandler) {
         [self.unsubscribeHandlers removeObjectForKey:@(message.mid)];
@@ -1146,6 +1332,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
             flow.commandType = @(MQTTPubrel);
             flow.deadline = [NSDate dateWithTimeIntervalSinceNow:self.dupTimeout];
             [self.persistence sync];
+            [self scheduleTxFlows];
         }
     }
     (void)[self encode:pubrelmessage];
@@ -1162,7 +1349,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
             int propertiesLength = [MQTTProperties getVariableLength:data];
             int variableLength = [MQTTProperties variableIntLength:propertiesLength];
             NSRange range = NSMakeRange(variableLength + propertiesLength, data.length - variableLength - propertiesLength);
-            data = [data subdataWithRange:range];
+            data = [data mqttSliceWithRange:range];
         }
 
 
@@ -1217,9 +1404,6 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
                                  retainFlag:(flow.retainedFlag).boolValue];
         }
 
-        if (self.synchronPub && self.synchronPubMid == message.mid) {
-            self.synchronPub = FALSE;
-        }
         MQTTPublishHandler publishHandler = (self.publishHandlers)[@(message.mid)];
         if (publishHandler) {
             [self.publishHandlers removeObjectForKey:@(message.mid)];
@@ -1228,6 +1412,7 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
         [self.persistence deleteFlow:flow];
         [self.persistence sync];
         [self tell];
+        [self txFlowsAcknowledged];
     }
 }
 
@@ -1270,15 +1455,6 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
         self.connectHandler = nil;
         [self onConnect:connectHandler error:error];
     }
-
-    self.synchronPub = FALSE;
-    self.synchronPubMid = 0;
-    self.synchronSub = FALSE;
-    self.synchronSubMid = 0;
-    self.synchronUnsub = FALSE;
-    self.synchronUnsubMid = 0;
-    self.synchronConnect = FALSE;
-    self.synchronDisconnect = FALSE;
 }
 
 - (UInt16)nextMsgId {
@@ -1297,10 +1473,19 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 }
 
 - (void)tell {
-    NSUInteger incoming = [self.persistence allFlowsforClientId:self.clientId
-                                                   incomingFlag:YES].count;
-    NSUInteger outflowing = [self.persistence allFlowsforClientId:self.clientId
-                                                     incomingFlag:NO].count;
+    NSUInteger incoming;
+    NSUInteger outflowing;
+    if ([self.persistence respondsToSelector:@selector(flowCountforClientId:incomingFlag:)]) {
+        incoming = [self.persistence flowCountforClientId:self.clientId
+                                             incomingFlag:YES];
+        outflowing = [self.persistence flowCountforClientId:self.clientId
+                                               incomingFlag:NO];
+    } else {
+        incoming = [self.persistence allFlowsforClientId:self.clientId
+                                            incomingFlag:YES].count;
+        outflowing = [self.persistence allFlowsforClientId:self.clientId
+                                              incomingFlag:NO].count;
+    }
     if ([self.delegate respondsToSelector:@selector(buffered:flowingIn:flowingOut:)]) {
         [self.delegate buffered:self
                       flowingIn:incoming
@@ -1606,6 +1791,9 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 
     self.decoder = [[MQTTDecoder alloc] init];
     self.decoder.queue = self.queue;
+    if (self.maximumPacketSize) {
+        self.decoder.maximumPacketSize = self.maximumPacketSize.unsignedIntValue;
+    }
     self.decoder.delegate = self;
     [self.decoder open];
 
@@ -1621,19 +1809,17 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
 
 - (BOOL)encode:(MQTTMessage *)message {
     if (message) {
+        // transports accepting the fixed header separately queue the message data without copying it
+        if ([self.transport respondsToSelector:@selector(sendFixedHeader:length:data:)]) {
+            [self notifySending:message];
+            UInt8 fixedHeader[MQTTMessageMaximumFixedHeaderLength];
+            NSUInteger length = [message getFixedHeader:fixedHeader];
+            DDLogVerbose(@"[MQTTSession] mqttTransport sendFixedHeader");
+            return [self.transport sendFixedHeader:fixedHeader length:length data:message.data];
+        }
         NSData *wireFormat = message.wireFormat;
         if (wireFormat) {
-            if (self.delegate) {
-                if ([self.delegate respondsToSelector:@selector(sending:type:qos:retained:duped:mid:data:)]) {
-                    [self.delegate sending:self
-                                      type:message.type
-                                       qos:message.qos
-                                  retained:message.retainFlag
-                                     duped:message.dupFlag
-                                       mid:message.mid
-                                      data:message.data];
-                }
-            }
+            [self notifySending:message];
             DDLogVerbose(@"[MQTTSession] mqttTransport send");
             return [self.transport send:wireFormat];
         } else {
@@ -1646,6 +1832,20 @@ NSString * const MQTTSessionErrorDomain = @"MQTT";
     }
 }
 
+- (void)notifySending:(MQTTMessage *)message {
+    if (self.delegate) {
+        if ([self.delegate respondsToSelector:@selector(sending:type:qos:retained:duped:mid:data:)]) {
+            [self.delegate sending:self
+                              type:message.type
+                               qos:message.qos
+                          retained:message.retainFlag
+                             duped:message.dupFlag
+                               mid:message.mid
+                              data:message.data];
+        }
+    }
+}
+
 #pragma mark - MQTTTransport delegate
 - (void)mqttTransport:(id<MQTTTransport>)mqttTransport didReceiveMessage:(NSData *)message {
     DDLogVerbose(@"[MQTTSession] mqttTransport didReceiveMessage");
@@ -98,6 +98,12 @@ typedef NS_ENUM(int, MQTTSessionManagerState) {
  */
 @property (readonly) BOOL requiresTearDown;
 
+/** logPersistence selects MQTTLogPersistence instead of MQTTCoreDataPersistence for the sessions
+ *  created by subsequent connects. Flows kept by MQTTCoreDataPersistence are not migrated, so switching
+ *  drops messages which were not delivered yet. Defaults to NO.
+ */
+@property (nonatomic) BOOL logPersistence;
+
 /** subscriptions is a dictionary of NSNumber instances indicating the MQTTQoSLevel.
  *  The keys are topic filters.
  *  The SessionManager subscribes to the given subscriptions after successfull (re-)connect
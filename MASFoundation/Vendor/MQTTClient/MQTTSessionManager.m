@@ -8,6 +8,7 @@
 
 #import "MQTTSessionManager.h"
 #import "MQTTCoreDataPersistence.h"
+#import "MQTTLogPersistence.h"
 #import "MQTTLog.h"
 #import "ReconnectTimer.h"
 #import "ForegroundReconnection.h"
@@ -303,7 +304,12 @@
                                               securityPolicy:securityPolicy
                                                 certificates:certificates];
 
-        MQTTCoreDataPersistence *persistence = [[MQTTCoreDataPersistence alloc] init];
+        id<MQTTPersistence> persistence;
+        if (self.logPersistence) {
+            persistence = [[MQTTLogPersistence alloc] init];
+        } else {
+            persistence = [[MQTTCoreDataPersistence alloc] init];
+        }
 
         persistence.persistent = self.persistent;
         persistence.maxWindowSize = self.maxWindowSize;
@@ -15,8 +15,90 @@
 #import <Foundation/Foundation.h>
 #import "MQTTSession.h"
 
+/** MQTTFuture represents the outcome of an MQTT operation which completes later.
+ The future is completed directly from the session's handler callbacks, so waiting on it does not poll.
+ */
+@interface MQTTFuture : NSObject
+
+/** TRUE once the operation has completed, successfully or not */
+@property (readonly) BOOL done;
+
+/** the error the operation failed with, nil while pending or on success */
+@property (strong, readonly) NSError *error;
+
+/** the QoS levels granted by the broker for a subscribe operation */
+@property (strong, readonly) NSArray<NSNumber *> *gQoss;
+
+/** the Message Identifier of the operation, 0 for QoS 0 publishes and connect or close operations */
+@property (readonly) UInt16 msgId;
+
+/** waits until the operation has completed
+
+ Waiting blocks the current thread. When called on the main thread for a session scheduled on the main queue,
+ the main run loop is run until the operation completes so the session keeps being serviced.
+ Waiting on any other queue the session is scheduled on fails immediately as it could never complete.
+
+ @param timeout defines the maximum time to wait. 0 for no timeout.
+
+ @return TRUE if the operation completed successfully within timeout
+ */
+- (BOOL)waitWithTimeout:(NSTimeInterval)timeout;
+
+/** executes a block once the operation has completed, immediately if it has already
+
+ @param queue the queue the block is executed on
+ @param completion the block to be executed with the completed future
+ */
+- (void)notifyOnQueue:(dispatch_queue_t)queue completion:(void (^)(MQTTFuture *future))completion;
+
+@end
+
 @interface MQTTSession(Synchron)
 
+/** connects to the MQTT server
+
+ @return an MQTTFuture completed once the connection was established or refused
+ */
+- (MQTTFuture *)connectFuture;
+
+/** subscribes a number of topics
+
+ @param topics an NSDictionary<NSString *, NSNumber *> containing the Topic Filters to subscribe to as keys and
+ the corresponding QoS as NSNumber values
+
+ @return an MQTTFuture completed once the SUBACK was received or the session was closed
+ */
+- (MQTTFuture *)subscribeFutureToTopics:(NSDictionary<NSString *, NSNumber *> *)topics;
+
+/** unsubscribes from a number of topics
+
+ @param topics an NSArray<NSString *> of topics to unsubscribe from
+
+ @return an MQTTFuture completed once the UNSUBACK was received or the session was closed
+ */
+- (MQTTFuture *)unsubscribeFutureTopics:(NSArray<NSString *> *)topics;
+
+/** publishes data on a given topic at a specified QoS level and retain flag
+
+ @param data the data to be sent
+ @param topic the Topic to identify the data
+ @param retainFlag if YES, data is stored on the MQTT broker until overwritten by the next publish with retainFlag = YES
+ @param qos specifies the Quality of Service for the publish
+
+ @return an MQTTFuture completed once the data was sent for QoS 0, acknowledged for QoS 1 and 2,
+ or the session was closed
+ */
+- (MQTTFuture *)publishFutureData:(NSData *)data
+                          onTopic:(NSString *)topic
+                           retain:(BOOL)retainFlag
+                              qos:(MQTTQosLevel)qos;
+
+/** closes an MQTTSession gracefully
+
+ @return an MQTTFuture completed once the session was closed
+ */
+- (MQTTFuture *)closeFuture;
+
 /** connects to the specified MQTT server synchronously
  
  @param timeout defines the maximum time to wait. Defaults to 0 for no timeout.
@@ -7,7 +7,7 @@
 
 /**
  Synchronous API
- 
+
  @author Christoph Krey c@ckrey.de
  @see http://mqtt.org
  */
@@ -18,38 +18,199 @@
 
 #import "MQTTLog.h"
 
-@interface MQTTSession()
-@property (nonatomic) BOOL synchronPub;
-@property (nonatomic) UInt16 synchronPubMid;
-@property (nonatomic) BOOL synchronUnsub;
-@property (nonatomic) UInt16 synchronUnsubMid;
-@property (nonatomic) BOOL synchronSub;
-@property (nonatomic) UInt16 synchronSubMid;
-@property (nonatomic) BOOL synchronConnect;
-@property (nonatomic) BOOL synchronDisconnect;
+static void *MQTTFutureQueueKey = &MQTTFutureQueueKey;
+
+@interface MQTTFuture()
+@property (readwrite) BOOL done;
+@property (strong, readwrite) NSError *error;
+@property (strong, readwrite) NSArray<NSNumber *> *gQoss;
+@property (readwrite) UInt16 msgId;
+@property (strong, nonatomic) dispatch_queue_t queue;
+@property (strong, nonatomic) dispatch_group_t group;
+@end
+
+@implementation MQTTFuture
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue {
+    self = [super init];
+    self.queue = queue;
+    self.group = dispatch_group_create();
+    dispatch_group_enter(self.group);
+
+    /* marks the session's queue so waiting on it can be detected */
+    dispatch_queue_set_specific(queue, MQTTFutureQueueKey, (__bridge void *)queue, NULL);
+    return self;
+}
+
+- (void)dealloc {
+    /* a dispatch group must not be released while entered */
+    if (!_done) {
+        dispatch_group_leave(_group);
+    }
+}
+
+- (void)completeWithError:(NSError *)error gQoss:(NSArray<NSNumber *> *)gQoss {
+    @synchronized(self) {
+        if (self.done) {
+            return;
+        }
+        self.error = error;
+        self.gQoss = gQoss;
+        self.done = TRUE;
+    }
+    dispatch_group_leave(self.group);
+}
+
+- (BOOL)waitWithTimeout:(NSTimeInterval)timeout {
+    if (self.queue == dispatch_get_main_queue() && [NSThread isMainThread]) {
+        /*
+         * The session is serviced by the main run loop, so it is run instead of blocking.
+         * The empty block wakes the run loop up as soon as the future completes.
+         */
+        NSDate *deadline = timeout > 0 ? [NSDate dateWithTimeIntervalSinceNow:timeout] : [NSDate distantFuture];
+        dispatch_group_notify(self.group, dispatch_get_main_queue(), ^{
+        });
+        while (!self.done && deadline.timeIntervalSinceNow > 0) {
+            DDLogVerbose(@"[MQTTSessionSynchron] waiting in main run loop");
+            if (![[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:deadline]) {
+                DDLogError(@"[MQTTSessionSynchron] main run loop cannot be run");
+                break;
+            }
+        }
+    } else if (dispatch_get_specific(MQTTFutureQueueKey) == (__bridge void *)self.queue) {
+        DDLogError(@"[MQTTSessionSynchron] cannot wait on the session's queue");
+    } else {
+        dispatch_time_t when = timeout > 0 ? dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)) : DISPATCH_TIME_FOREVER;
+        dispatch_group_wait(self.group, when);
+    }
+
+    return self.done && !self.error;
+}
+
+- (void)notifyOnQueue:(dispatch_queue_t)queue completion:(void (^)(MQTTFuture *future))completion {
+    dispatch_group_notify(self.group, queue, ^{
+        completion(self);
+    });
+}
 
 @end
 
+@interface MQTTSession()
+@property (strong, nonatomic) NSMutableSet *synchronFutures;
+@end
+
 @implementation MQTTSession(Synchron)
 
+#pragma mark - Futures
+
+- (MQTTFuture *)connectFuture {
+    MQTTFuture *future = [[MQTTFuture alloc] initWithQueue:self.queue];
+
+    [self connectWithConnectHandler:^(NSError *error) {
+        [future completeWithError:error gQoss:nil];
+    }];
+
+    return future;
+}
+
+- (MQTTFuture *)subscribeFutureToTopics:(NSDictionary<NSString *, NSNumber *> *)topics {
+    MQTTFuture *future = [[MQTTFuture alloc] initWithQueue:self.queue];
+    __weak MQTTSession *weakSelf = self;
+
+    future.msgId = [self subscribeToTopics:topics subscribeHandler:^(NSError *error, NSArray<NSNumber *> *gQoss) {
+        [future completeWithError:error gQoss:gQoss];
+        [weakSelf removeSynchronFuture:future];
+    }];
+    [self addSynchronFuture:future];
+
+    return future;
+}
+
+- (MQTTFuture *)unsubscribeFutureTopics:(NSArray<NSString *> *)topics {
+    MQTTFuture *future = [[MQTTFuture alloc] initWithQueue:self.queue];
+    __weak MQTTSession *weakSelf = self;
+
+    future.msgId = [self unsubscribeTopics:topics unsubscribeHandler:^(NSError *error) {
+        [future completeWithError:error gQoss:nil];
+        [weakSelf removeSynchronFuture:future];
+    }];
+    [self addSynchronFuture:future];
+
+    return future;
+}
+
+- (MQTTFuture *)publishFutureData:(NSData *)data
+                          onTopic:(NSString *)topic
+                           retain:(BOOL)retainFlag
+                              qos:(MQTTQosLevel)qos {
+    MQTTFuture *future = [[MQTTFuture alloc] initWithQueue:self.queue];
+    __weak MQTTSession *weakSelf = self;
+
+    future.msgId = [self publishData:data onTopic:topic retain:retainFlag qos:qos publishHandler:^(NSError *error) {
+        [future completeWithError:error gQoss:nil];
+        [weakSelf removeSynchronFuture:future];
+    }];
+    [self addSynchronFuture:future];
+
+    return future;
+}
+
+- (MQTTFuture *)closeFuture {
+    MQTTFuture *future = [[MQTTFuture alloc] initWithQueue:self.queue];
+
+    [self closeWithDisconnectHandler:^(NSError *error) {
+        [future completeWithError:error gQoss:nil];
+    }];
+
+    return future;
+}
+
+/*
+ * Pending acknowledgements are failed when the connection is closed, as the session
+ * forgets about them. Publish handlers survive a close, so those futures are tracked here.
+ */
+- (void)addSynchronFuture:(MQTTFuture *)future {
+    @synchronized(self) {
+        if (!future.done) {
+            if (!self.synchronFutures) {
+                self.synchronFutures = [[NSMutableSet alloc] init];
+            }
+            [self.synchronFutures addObject:future];
+        }
+    }
+}
+
+- (void)removeSynchronFuture:(MQTTFuture *)future {
+    @synchronized(self) {
+        [self.synchronFutures removeObject:future];
+    }
+}
+
+- (void)failSynchronFutures {
+    NSArray *futures;
+    @synchronized(self) {
+        futures = self.synchronFutures.allObjects;
+        [self.synchronFutures removeAllObjects];
+    }
+
+    NSError *error = [NSError errorWithDomain:MQTTSessionErrorDomain
+                                         code:MQTTSessionErrorNoResponse
+                                     userInfo:@{NSLocalizedDescriptionKey : @"No response"}];
+    for (MQTTFuture *future in futures) {
+        [future completeWithError:error gQoss:nil];
+    }
+}
+
+#pragma mark - Synchron
+
 /** Synchron connect
  *
  */
 - (BOOL)connectAndWaitTimeout:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
-    self.synchronConnect = TRUE;
-    
-    [self connect];
-    
-    [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-    
-    while (self.synchronConnect && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-        DDLogVerbose(@"[MQTTSessionSynchron] waiting for connect");
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-    }
-    
+    [[self connectFuture] waitWithTimeout:timeout];
+
     DDLogVerbose(@"[MQTTSessionSynchron] end connect");
-    
+
     return (self.status == MQTTSessionStatusConnected);
 }
 
@@ -64,20 +225,15 @@
  * @deprecated
  */
 - (BOOL)connectAndWaitToHost:(NSString*)host port:(UInt32)port usingSSL:(BOOL)usingSSL timeout:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
-    self.synchronConnect = TRUE;
-    
-    [self connectToHost:host port:port usingSSL:usingSSL];
-    
-    [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-    
-    while (self.synchronConnect && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-        DDLogVerbose(@"[MQTTSessionSynchron] waiting for connect");
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-    }
-    
+    MQTTFuture *future = [[MQTTFuture alloc] initWithQueue:self.queue];
+
+    [self connectToHost:host port:port usingSSL:usingSSL connectHandler:^(NSError *error) {
+        [future completeWithError:error gQoss:nil];
+    }];
+    [future waitWithTimeout:timeout];
+
     DDLogVerbose(@"[MQTTSessionSynchron] end connect");
-    
+
     return (self.status == MQTTSessionStatusConnected);
 }
 
@@ -86,25 +242,7 @@
 }
 
 - (BOOL)subscribeAndWaitToTopic:(NSString *)topic atLevel:(MQTTQosLevel)qosLevel timeout:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
-    self.synchronSub = TRUE;
-    UInt16 mid = [self subscribeToTopic:topic atLevel:qosLevel];
-    self.synchronSubMid = mid;
-    
-    [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-    
-    while (self.synchronSub && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-        DDLogVerbose(@"[MQTTSessionSynchron] waiting for suback %d", mid);
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-    }
-    
-    DDLogVerbose(@"[MQTTSessionSynchron] end subscribe");
-    
-    if (self.synchronSub || self.synchronSubMid != mid) {
-        return FALSE;
-    } else {
-        return TRUE;
-    }
+    return [self subscribeAndWaitToTopics:topic ? @{topic: @(qosLevel)} : @{} timeout:timeout];
 }
 
 - (BOOL)subscribeAndWaitToTopics:(NSDictionary<NSString *, NSNumber *> *)topics {
@@ -112,25 +250,11 @@
 }
 
 - (BOOL)subscribeAndWaitToTopics:(NSDictionary<NSString *, NSNumber *> *)topics timeout:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
-    self.synchronSub = TRUE;
-    UInt16 mid = [self subscribeToTopics:topics];
-    self.synchronSubMid = mid;
-    
-    [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-    
-    while (self.synchronSub && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-        DDLogVerbose(@"[MQTTSessionSynchron] waiting for suback %d", mid);
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-    }
-    
+    BOOL subscribed = [[self subscribeFutureToTopics:topics] waitWithTimeout:timeout];
+
     DDLogVerbose(@"[MQTTSessionSynchron] end subscribe");
-    
-    if (self.synchronSub || self.synchronSubMid != mid) {
-        return FALSE;
-    } else {
-        return TRUE;
-    }
+
+    return subscribed;
 }
 
 - (BOOL)unsubscribeAndWaitTopic:(NSString *)theTopic {
@@ -138,26 +262,7 @@
 }
 
 - (BOOL)unsubscribeAndWaitTopic:(NSString *)theTopic timeout:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
-
-    self.synchronUnsub = TRUE;
-    UInt16 mid = [self unsubscribeTopic:theTopic];
-    self.synchronUnsubMid = mid;
-    
-    [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-    
-    while (self.synchronUnsub && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-        DDLogVerbose(@"[MQTTSessionSynchron] waiting for unsuback %d", mid);
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-    }
-    
-    DDLogVerbose(@"[MQTTSessionSynchron] end unsubscribe");
-    
-    if (self.synchronUnsub || self.synchronUnsubMid != mid) {
-        return FALSE;
-    } else {
-        return TRUE;
-    }
+    return [self unsubscribeAndWaitTopics:theTopic ? @[theTopic] : @[] timeout:timeout];
 }
 
 - (BOOL)unsubscribeAndWaitTopics:(NSArray<NSString *> *)topics {
@@ -165,25 +270,11 @@
 }
 
 - (BOOL)unsubscribeAndWaitTopics:(NSArray<NSString *> *)topics timeout:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
-    self.synchronUnsub = TRUE;
-    UInt16 mid = [self unsubscribeTopics:topics];
-    self.synchronUnsubMid = mid;
-    
-    [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-    
-    while (self.synchronUnsub && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-        DDLogVerbose(@"[MQTTSessionSynchron] waiting for unsuback %d", mid);
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-    }
-    
+    BOOL unsubscribed = [[self unsubscribeFutureTopics:topics] waitWithTimeout:timeout];
+
     DDLogVerbose(@"[MQTTSessionSynchron] end unsubscribe");
-    
-    if (self.synchronUnsub || self.synchronUnsubMid != mid) {
-        return FALSE;
-    } else {
-        return TRUE;
-    }
+
+    return unsubscribed;
 }
 
 - (BOOL)publishAndWaitData:(NSData*)data
@@ -198,32 +289,11 @@
                     retain:(BOOL)retainFlag
                        qos:(MQTTQosLevel)qos
                    timeout:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
+    BOOL published = [[self publishFutureData:data onTopic:topic retain:retainFlag qos:qos] waitWithTimeout:timeout];
 
-    if (qos != MQTTQosLevelAtMostOnce) {
-        self.synchronPub = TRUE;
-    }
-    
-    UInt16 mid = self.synchronPubMid = [self publishData:data onTopic:topic retain:retainFlag qos:qos];
-    if (qos == MQTTQosLevelAtMostOnce) {
-        return TRUE;
-    } else {
-        
-        [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-        
-        while (self.synchronPub && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-            DDLogVerbose(@"[MQTTSessionSynchron] waiting for mid %d", mid);
-            [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-        }
-        
-        DDLogVerbose(@"[MQTTSessionSynchron] end publish");
-        
-        if (self.synchronPub || self.synchronPubMid != mid) {
-            return FALSE;
-        } else {
-            return TRUE;
-        }
-    }
+    DDLogVerbose(@"[MQTTSessionSynchron] end publish");
+
+    return published;
 }
 
 - (void)closeAndWait {
@@ -231,16 +301,8 @@
 }
 
 - (void)closeAndWait:(NSTimeInterval)timeout {
-    NSDate *started = [NSDate date];
-    self.synchronDisconnect = TRUE;
-    [self close];
-    
-    [[NSRunLoop currentRunLoop] addPort:[NSMachPort port] forMode:NSRunLoopCommonModes];
-    
-    while (self.synchronDisconnect && (timeout == 0 || started.timeIntervalSince1970 + timeout > [NSDate date].timeIntervalSince1970)) {
-        DDLogVerbose(@"[MQTTSessionSynchron] waiting for close");
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:.1]];
-    }
+    [[self closeFuture] waitWithTimeout:timeout];
+
     DDLogVerbose(@"[MQTTSessionSynchron] end close");
 }
 
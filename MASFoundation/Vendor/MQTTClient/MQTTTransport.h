@@ -67,6 +67,17 @@
 /** close closes the transport */
 - (void)close;
 
+@optional
+
+/** sendFixedHeader transmits a message given as its serialized fixed header followed by its data,
+ * allowing the transport to queue the data without concatenating it with the header first
+ * @param fixedHeader the serialized fixed header, copied by the transport
+ * @param length the length of the fixed header
+ * @param data the data of the message, which must not be modified afterwards; might be nil
+ * @result a boolean indicating if the data could be send or not
+ */
+- (BOOL)sendFixedHeader:(nonnull const UInt8 *)fixedHeader length:(NSUInteger)length data:(nullable NSData *)data;
+
 @end
 
 /** MQTTTransportDelegate protocol
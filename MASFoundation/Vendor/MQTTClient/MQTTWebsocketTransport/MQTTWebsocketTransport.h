@@ -7,13 +7,18 @@
 //
 
 #import <Foundation/Foundation.h>
-#import "MQTTTransport.h"
-#import <SocketRocket/SRWebSocket.h>
-
-/** MQTTCFSocketTransport
- * implements an MQTTTransport on top of Websockets (SocketRocket)
+#import "../MQTTTransport.h"
+#import "../MQTTSSLSecurityPolicyTransport.h"
+
+/** MQTTWebsocketTransport
+ * implements an MQTTTransport on top of Websockets (RFC 6455), using the socket streams and
+ * the security policy of MQTTSSLSecurityPolicyTransport.
+ *
+ * MQTT packets are sent as binary messages, compressed with permessage-deflate (RFC 7692)
+ * when the server accepts it. Received payloads are passed on as the bytes arrive, without waiting
+ * for complete frames, so MQTT packets spanning frames are reassembled by the session's decoder.
  */
-@interface MQTTWebsocketTransport : MQTTTransport <MQTTTransport, SRWebSocketDelegate>
+@interface MQTTWebsocketTransport : MQTTSSLSecurityPolicyTransport
 
 /** host an NSString containing the hostName or IP address of the host to connect to
  * defaults to @"localhost"
@@ -22,28 +27,30 @@
 
 /** port an unsigned 32 bit integer containing the IP port number to connect to
  * defaults to 80
- */ka
-@property (nonatomic) UInt32 port;
-
-/** tls a boolean indicating whether the transport should be using security 
- * defaults to NO
  */
-@property (nonatomic) BOOL tls;
+@property (nonatomic) UInt32 port;
 
 /** path an NSString indicating the path component of the websocket URL request
- * defaults to @"/html"
+ * defaults to @"/mqtt"
  */
 @property (strong, nonatomic) NSString *path;
 
-/** allowUntrustedCertificates a boolean indicating whether self signed or expired certificates should be accepted
- * defaults to NO
+/** compression a boolean indicating whether permessage-deflate is offered to the server
+ * defaults to YES
  */
-@property (nonatomic) BOOL allowUntrustedCertificates;
+@property (nonatomic) BOOL compression;
 
-/** pinnedCertificates an NSArray containing certificates to validate server certificates against
- * defaults to nil
- */
-@property (strong, nonatomic) NSArray *pinnedCertificates;
+/** compressionNegotiated a boolean indicating whether the server accepted permessage-deflate */
+@property (readonly, nonatomic) BOOL compressionNegotiated;
+
+/** bufferedAmount the number of bytes sent but not yet written to the network */
+@property (readonly, nonatomic) NSUInteger bufferedAmount;
 
+/** maxBufferedAmount the number of buffered bytes above which send refuses further PUBLISH packets
+ * until the buffer drained, so the session keeps them queued. Other packets, such as acknowledgements
+ * and PINGREQ, are always accepted. A message is always accepted while nothing is buffered.
+ * defaults to 256 * 1024 bytes
+ */
+@property (nonatomic) NSUInteger maxBufferedAmount;
 
 @end
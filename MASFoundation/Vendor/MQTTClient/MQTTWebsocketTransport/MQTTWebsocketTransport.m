@@ -7,16 +7,110 @@
 //
 
 #import "MQTTWebsocketTransport.h"
+#import "../MQTTSSLSecurityPolicyEncoder.h"
 
 #import "../MQTTLog.h"
+#import "../MQTTMessage.h"
 
-@interface MQTTWebsocketTransport()
-@property (strong, nonatomic) SRWebSocket *websocket;
+#import <CFNetwork/CFNetwork.h>
+#import <CommonCrypto/CommonDigest.h>
+#include <zlib.h>
+
+static NSString * const MQTTWebsocketAcceptGUID = @"258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+/* an upgrade response not complete after this many bytes is rejected */
+static const NSUInteger MQTTWebsocketMaxHandshakeLength = 16 * 1024;
+
+/* messages shorter than this are sent uncompressed, deflate would not make them smaller */
+static const NSUInteger MQTTWebsocketCompressionThreshold = 64;
+
+static const NSUInteger MQTTWebsocketInflateBufferLength = 16 * 1024;
+
+/* the empty stored block ending every compressed message, omitted on the wire (RFC 7692 7.2.1) */
+static const UInt8 MQTTWebsocketDeflateTail[4] = {0x00, 0x00, 0xff, 0xff};
+
+/* error codes reported for a failed upgrade are the HTTP status, otherwise the close code */
+static const NSInteger MQTTWebsocketErrorProtocol = 1002;
+static const NSInteger MQTTWebsocketErrorUnsupportedData = 1003;
+
+typedef NS_ENUM(UInt8, MQTTWebsocketOpcode) {
+    MQTTWebsocketOpcodeContinuation = 0x0,
+    MQTTWebsocketOpcodeText = 0x1,
+    MQTTWebsocketOpcodeBinary = 0x2,
+    MQTTWebsocketOpcodeClose = 0x8,
+    MQTTWebsocketOpcodePing = 0x9,
+    MQTTWebsocketOpcodePong = 0xA
+};
+
+/* the length of a frame header given its first bytes, including the extended length and masking key */
+static NSUInteger MQTTWebsocketFrameHeaderLength(const UInt8 *header, NSUInteger length) {
+    if (length < 2) {
+        return 2;
+    }
+    NSUInteger headerLength = 2;
+    UInt8 payloadLength = header[1] & 0x7f;
+    if (payloadLength == 126) {
+        headerLength += 2;
+    } else if (payloadLength == 127) {
+        headerLength += 8;
+    }
+    if (header[1] & 0x80) {
+        headerLength += 4;
+    }
+    return headerLength;
+}
+
+static void MQTTWebsocketMask(UInt8 *destination, const UInt8 *source, NSUInteger length, const UInt8 *mask, NSUInteger offset) {
+    for (NSUInteger i = 0; i < length; i++) {
+        destination[i] = source[i] ^ mask[(offset + i) & 3];
+    }
+}
+
+static BOOL MQTTWebsocketDeflate(z_stream *stream, const UInt8 *bytes, NSUInteger length, int flush, NSMutableData *output) {
+    stream->next_in = (Bytef *)bytes;
+    stream->avail_in = (uInt)length;
+    do {
+        NSUInteger used = output.length;
+        [output increaseLengthBy:length + 64];
+        stream->next_out = (Bytef *)output.mutableBytes + used;
+        stream->avail_out = (uInt)(output.length - used);
+        int status = deflate(stream, flush);
+        output.length -= stream->avail_out;
+        if (status == Z_STREAM_ERROR) {
+            return FALSE;
+        }
+    } while (stream->avail_out == 0);
+    return TRUE;
+}
+
+@interface MQTTSSLSecurityPolicyTransport()
+@property (strong, nonatomic) MQTTSSLSecurityPolicyEncoder *encoder;
+@end
+
+@interface MQTTWebsocketTransport() {
+    z_stream _deflater;
+    z_stream _inflater;
+}
+@property (readwrite, nonatomic) BOOL compressionNegotiated;
+@property (nonatomic) BOOL clientNoContextTakeover;
+@property (nonatomic) BOOL serverNoContextTakeover;
+@property (nonatomic) BOOL zlibReady;
+
+@property (strong, nonatomic) NSString *key;
+@property (strong, nonatomic) NSMutableData *handshakeBuffer;
+@property (nonatomic) BOOL handshakeComplete;
+
+@property (strong, nonatomic) NSMutableData *headerBuffer;
+@property (nonatomic) BOOL frameHeaderParsed;
+@property (nonatomic) UInt8 frameOpcode;
+@property (nonatomic) BOOL frameFinal;
+@property (nonatomic) UInt64 payloadRemaining;
+@property (nonatomic) BOOL messageInProgress;
+@property (nonatomic) BOOL messageCompressed;
+@property (strong, nonatomic) NSMutableData *controlPayload;
 @end
 
 @implementation MQTTWebsocketTransport
-@synthesize state;
-@synthesize delegate;
 @dynamic host;
 @dynamic port;
 
@@ -25,107 +119,484 @@
     self.host = @"localhost";
     self.port = 80;
     self.path = @"/mqtt";
-    self.tls = false;
-    self.allowUntrustedCertificates = false;
-    self.pinnedCertificates = nil;
+    self.compression = TRUE;
+    self.maxBufferedAmount = 256 * 1024;
     return self;
 }
 
+- (void)dealloc {
+    [self endZlib];
+}
+
 - (void)open {
     DDLogVerbose(@"[MQTTWebsocketTransport] open");
-    self.state = MQTTTransportOpening;
-    
-    NSMutableURLRequest *urlRequest = [NSMutableURLRequest requestWithURL:[self endpointURL]];
-    urlRequest.SR_SSLPinnedCertificates = self.pinnedCertificates;
-    NSArray <NSString *> *protocols = @[@"mqtt"];
-    
-    self.websocket = [[SRWebSocket alloc] initWithURLRequest:urlRequest
-                                                   protocols:protocols
-                              allowsUntrustedSSLCertificates:self.allowUntrustedCertificates];
-    
-    self.websocket.delegate = self;
-    [self.websocket open];
-}
-
-- (NSURL*) endpointURL {
-    NSString *protocol = (self.tls) ? @"wss" : @"ws";
-    NSString *portString = (self.port == 0) ? @"" : [NSString stringWithFormat:@":%d",(unsigned int)self.port];
-    NSString *path = self.path;
-    NSString *urlString = [NSString stringWithFormat:@"%@://%@%@%@",
-                           protocol,
-                           self.host,
-                           portString,
-                           path];
-    NSURL *url = [NSURL URLWithString:urlString];
-    return url;
-}
+    @synchronized(self) {
+        [self endZlib];
+        self.compressionNegotiated = FALSE;
+        self.clientNoContextTakeover = FALSE;
+        self.serverNoContextTakeover = FALSE;
 
-- (BOOL)send:(nonnull NSData *)data {
-    DDLogVerbose(@"[MQTTWebsocketTransport] send(%ld):%@", (unsigned long)data.length,
-                 [data subdataWithRange:NSMakeRange(0, MIN(256, data.length))]);
-    if (self.websocket.readyState == SR_OPEN) {
-        [self.websocket send:data];
-        return true;
-    } else {
-        return false;
+        UInt8 keyBytes[16];
+        arc4random_buf(keyBytes, sizeof(keyBytes));
+        self.key = [[NSData dataWithBytes:keyBytes length:sizeof(keyBytes)] base64EncodedStringWithOptions:0];
+        self.handshakeBuffer = [[NSMutableData alloc] init];
+        self.handshakeComplete = FALSE;
+
+        self.headerBuffer = [[NSMutableData alloc] initWithCapacity:14];
+        self.frameHeaderParsed = FALSE;
+        self.payloadRemaining = 0;
+        self.messageInProgress = FALSE;
+        self.messageCompressed = FALSE;
     }
+    [super open];
 }
 
 - (void)close {
     DDLogVerbose(@"[MQTTWebsocketTransport] close");
-    self.state = MQTTTransportClosing;
-    [self.websocket close];
+    @synchronized(self) {
+        if (self.state == MQTTTransportOpen) {
+            UInt8 statusCode[2] = {1000 >> 8, 1000 & 0xff};
+            [self sendFrameWithOpcode:MQTTWebsocketOpcodeClose compressed:FALSE prefix:statusCode length:sizeof(statusCode) data:nil];
+        }
+    }
+    [super close];
 }
 
-- (void)webSocket:(SRWebSocket *)webSocket didReceiveMessage:(id)message {
-    NSData *data;
-    if ([message isKindOfClass:[NSData class]]) {
-        data = (NSData *)message;
+- (NSUInteger)bufferedAmount {
+    return self.encoder.bufferedLength;
+}
+
+#pragma mark - Sending
+
+- (BOOL)send:(nonnull NSData *)data {
+    return [self sendFixedHeader:NULL length:0 data:data];
+}
+
+- (BOOL)sendFixedHeader:(nonnull const UInt8 *)fixedHeader length:(NSUInteger)length data:(nullable NSData *)data {
+    @synchronized(self) {
+        if (self.state != MQTTTransportOpen) {
+            DDLogInfo(@"[MQTTWebsocketTransport] not MQTTTransportOpen");
+            return FALSE;
+        }
+
+        /* only PUBLISH packets are refused, the session keeps them queued; acknowledgements,
+         * PINGREQ and DISCONNECT are always sent so the connection stays alive while the buffer drains
+         */
+        NSUInteger messageLength = length + data.length;
+        NSUInteger bufferedAmount = self.bufferedAmount;
+        const UInt8 *firstByte = length ? fixedHeader : data.bytes;
+        BOOL publish = messageLength && (firstByte[0] >> 4) == MQTTPublish;
+        if (publish && bufferedAmount && bufferedAmount + messageLength > self.maxBufferedAmount) {
+            DDLogVerbose(@"[MQTTWebsocketTransport] refusing %lu bytes with %lu bytes buffered",
+                         (unsigned long)messageLength, (unsigned long)bufferedAmount);
+            return FALSE;
+        }
+
+        if (self.compressionNegotiated && messageLength >= MQTTWebsocketCompressionThreshold) {
+            NSData *payload = [self deflateFixedHeader:fixedHeader length:length data:data];
+            if (!payload) {
+                return FALSE;
+            }
+            return [self sendFrameWithOpcode:MQTTWebsocketOpcodeBinary compressed:TRUE prefix:NULL length:0 data:payload];
+        }
+        return [self sendFrameWithOpcode:MQTTWebsocketOpcodeBinary compressed:FALSE prefix:fixedHeader length:length data:data];
     }
-    DDLogVerbose(@"[MQTTWebsocketTransport] didReceiveMessage(%ld)", (unsigned long)(data ? data.length : -1));
+}
+
+/*
+ * Frames are always final and masked as required for clients. The payload is copied once,
+ * masking it into the frame, so the fixed header and data are never concatenated separately.
+ */
+- (BOOL)sendFrameWithOpcode:(MQTTWebsocketOpcode)opcode
+                 compressed:(BOOL)compressed
+                     prefix:(const UInt8 *)prefix
+                     length:(NSUInteger)prefixLength
+                       data:(NSData *)data {
+    UInt64 payloadLength = prefixLength + data.length;
+    UInt8 header[14];
+    NSUInteger headerLength = 2;
 
-    if (self.delegate) {
-        if ([self.delegate respondsToSelector:@selector(mqttTransport:didReceiveMessage:)]) {
-            [self.delegate mqttTransport:self didReceiveMessage:message];
+    header[0] = 0x80 | (compressed ? 0x40 : 0x00) | opcode;
+    if (payloadLength < 126) {
+        header[1] = 0x80 | (UInt8)payloadLength;
+    } else if (payloadLength <= 0xffff) {
+        header[1] = 0x80 | 126;
+        header[2] = (UInt8)(payloadLength >> 8);
+        header[3] = (UInt8)payloadLength;
+        headerLength = 4;
+    } else {
+        header[1] = 0x80 | 127;
+        for (int i = 0; i < 8; i++) {
+            header[2 + i] = (UInt8)(payloadLength >> (56 - 8 * i));
         }
+        headerLength = 10;
+    }
+    UInt8 *mask = header + headerLength;
+    arc4random_buf(mask, 4);
+    headerLength += 4;
+
+    NSMutableData *frame = [NSMutableData dataWithLength:headerLength + (NSUInteger)payloadLength];
+    UInt8 *bytes = frame.mutableBytes;
+    memcpy(bytes, header, headerLength);
+    MQTTWebsocketMask(bytes + headerLength, prefix, prefixLength, mask, 0);
+    MQTTWebsocketMask(bytes + headerLength + prefixLength, data.bytes, data.length, mask, prefixLength);
+
+    return [super send:frame];
+}
+
+- (NSData *)deflateFixedHeader:(const UInt8 *)fixedHeader length:(NSUInteger)length data:(NSData *)data {
+    NSMutableData *output = [[NSMutableData alloc] init];
+    if ((length && !MQTTWebsocketDeflate(&_deflater, fixedHeader, length, Z_NO_FLUSH, output)) ||
+        !MQTTWebsocketDeflate(&_deflater, data.bytes, data.length, Z_SYNC_FLUSH, output)) {
+        DDLogError(@"[MQTTWebsocketTransport] deflate failed");
+        return nil;
+    }
+
+    if (output.length >= sizeof(MQTTWebsocketDeflateTail) &&
+        memcmp((const UInt8 *)output.bytes + output.length - sizeof(MQTTWebsocketDeflateTail),
+               MQTTWebsocketDeflateTail, sizeof(MQTTWebsocketDeflateTail)) == 0) {
+        output.length -= sizeof(MQTTWebsocketDeflateTail);
+    }
+    if (self.clientNoContextTakeover) {
+        deflateReset(&_deflater);
+    }
+    return output;
+}
+
+#pragma mark - Handshake
+
+- (void)encoderDidOpen:(MQTTCFSocketEncoder *)sender {
+    DDLogVerbose(@"[MQTTWebsocketTransport] sending upgrade request");
+    [super send:[self upgradeRequest]];
+}
+
+- (NSData *)upgradeRequest {
+    NSString *hostField = self.host;
+    if (self.port != (self.tls ? 443 : 80)) {
+        hostField = [NSString stringWithFormat:@"%@:%u", self.host, (unsigned int)self.port];
+    }
+
+    NSMutableString *request = [NSMutableString stringWithFormat:@"GET %@ HTTP/1.1\r\n", self.path.length ? self.path : @"/"];
+    [request appendFormat:@"Host: %@\r\n", hostField];
+    [request appendString:@"Upgrade: websocket\r\n"];
+    [request appendString:@"Connection: Upgrade\r\n"];
+    [request appendFormat:@"Sec-WebSocket-Key: %@\r\n", self.key];
+    [request appendString:@"Sec-WebSocket-Version: 13\r\n"];
+    [request appendString:@"Sec-WebSocket-Protocol: mqtt\r\n"];
+    if (self.compression) {
+        [request appendString:@"Sec-WebSocket-Extensions: permessage-deflate\r\n"];
     }
+    [request appendString:@"\r\n"];
+    return [request dataUsingEncoding:NSUTF8StringEncoding];
 }
 
-- (void)webSocketDidOpen:(SRWebSocket *)webSocket{
-    DDLogVerbose(@"[MQTTWebsocketTransport] connected to websocket");
+- (void)decoder:(MQTTCFSocketDecoder *)sender didReceiveMessage:(nonnull NSData *)data {
+    if (self.handshakeComplete) {
+        [self decodeFrames:data];
+        return;
+    }
+    if (self.state != MQTTTransportOpening) {
+        return;
+    }
+
+    [self.handshakeBuffer appendData:data];
+    NSRange end = [self.handshakeBuffer rangeOfData:[NSData dataWithBytes:"\r\n\r\n" length:4]
+                                            options:0
+                                              range:NSMakeRange(0, self.handshakeBuffer.length)];
+    if (end.location == NSNotFound) {
+        if (self.handshakeBuffer.length > MQTTWebsocketMaxHandshakeLength) {
+            [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket upgrade response too long"];
+        }
+        return;
+    }
+
+    NSUInteger responseLength = NSMaxRange(end);
+    if (![self acceptUpgradeResponse:[self.handshakeBuffer subdataWithRange:NSMakeRange(0, responseLength)]]) {
+        return;
+    }
+
+    NSData *remainder = nil;
+    if (responseLength < self.handshakeBuffer.length) {
+        remainder = [self.handshakeBuffer subdataWithRange:NSMakeRange(responseLength, self.handshakeBuffer.length - responseLength)];
+    }
+    self.handshakeBuffer = nil;
+    self.handshakeComplete = TRUE;
+
+    DDLogVerbose(@"[MQTTWebsocketTransport] connected to websocket compression=%d", self.compressionNegotiated);
     self.state = MQTTTransportOpen;
-    if (self.delegate) {
-        if ([self.delegate respondsToSelector:@selector(mqttTransportDidOpen:)]) {
-            [self.delegate mqttTransportDidOpen:self];
+    [self.delegate mqttTransportDidOpen:self];
+
+    if (remainder) {
+        [self decodeFrames:remainder];
+    }
+}
+
+- (BOOL)acceptUpgradeResponse:(NSData *)data {
+    CFHTTPMessageRef response = CFHTTPMessageCreateEmpty(NULL, FALSE);
+    CFHTTPMessageAppendBytes(response, data.bytes, data.length);
+    BOOL complete = CFHTTPMessageIsHeaderComplete(response);
+    CFIndex statusCode = complete ? CFHTTPMessageGetResponseStatusCode(response) : 0;
+    NSString *upgrade = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(response, CFSTR("Upgrade")));
+    NSString *accept = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(response, CFSTR("Sec-WebSocket-Accept")));
+    NSString *protocol = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(response, CFSTR("Sec-WebSocket-Protocol")));
+    NSString *extensions = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(response, CFSTR("Sec-WebSocket-Extensions")));
+    CFRelease(response);
+
+    if (statusCode != 101) {
+        [self failWithCode:statusCode ? statusCode : MQTTWebsocketErrorProtocol
+               description:[NSString stringWithFormat:@"Websocket upgrade refused with status %ld", (long)statusCode]];
+        return FALSE;
+    }
+    if ([upgrade caseInsensitiveCompare:@"websocket"] != NSOrderedSame ||
+        ![accept isEqualToString:[self expectedAccept]]) {
+        [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket upgrade response invalid"];
+        return FALSE;
+    }
+    if (protocol && ![protocol isEqualToString:@"mqtt"]) {
+        [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket subprotocol not mqtt"];
+        return FALSE;
+    }
+    if (extensions.length && ![self acceptExtensions:extensions]) {
+        [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket extension not offered"];
+        return FALSE;
+    }
+    return TRUE;
+}
+
+- (NSString *)expectedAccept {
+    NSData *input = [[self.key stringByAppendingString:MQTTWebsocketAcceptGUID] dataUsingEncoding:NSUTF8StringEncoding];
+    UInt8 digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(input.bytes, (CC_LONG)input.length, digest);
+    return [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+}
+
+/*
+ * Only permessage-deflate is offered, without client_max_window_bits, so the server may only
+ * restrict context takeover. Its window size never matters for inflating.
+ */
+- (BOOL)acceptExtensions:(NSString *)extensions {
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+    for (NSString *extension in [extensions componentsSeparatedByString:@","]) {
+        NSArray<NSString *> *parameters = [extension componentsSeparatedByString:@";"];
+        if (!self.compression || self.compressionNegotiated ||
+            ![[parameters[0] stringByTrimmingCharactersInSet:whitespace] isEqualToString:@"permessage-deflate"]) {
+            return FALSE;
+        }
+        for (NSUInteger i = 1; i < parameters.count; i++) {
+            NSString *parameter = [parameters[i] stringByTrimmingCharactersInSet:whitespace];
+            if ([parameter isEqualToString:@"client_no_context_takeover"]) {
+                self.clientNoContextTakeover = TRUE;
+            } else if ([parameter isEqualToString:@"server_no_context_takeover"]) {
+                self.serverNoContextTakeover = TRUE;
+            } else if (![parameter hasPrefix:@"server_max_window_bits"]) {
+                return FALSE;
+            }
         }
+
+        memset(&_deflater, 0, sizeof(_deflater));
+        memset(&_inflater, 0, sizeof(_inflater));
+        if (deflateInit2(&_deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return FALSE;
+        }
+        if (inflateInit2(&_inflater, -MAX_WBITS) != Z_OK) {
+            deflateEnd(&_deflater);
+            return FALSE;
+        }
+        self.zlibReady = TRUE;
+        self.compressionNegotiated = TRUE;
+    }
+    return TRUE;
+}
+
+- (void)endZlib {
+    if (self.zlibReady) {
+        deflateEnd(&_deflater);
+        inflateEnd(&_inflater);
+        self.zlibReady = FALSE;
     }
 }
 
-- (void)webSocket:(SRWebSocket *)webSocket didFailWithError:(NSError *)error{
-    DDLogInfo(@"[MQTTWebsocketTransport] Failed to connect : %@",[error debugDescription]);
-    self.state = MQTTTransportClosed;
-    self.websocket.delegate = nil;
-    [self.websocket close];
-    if (self.delegate) {
-        if ([self.delegate respondsToSelector:@selector(mqttTransport:didFailWithError:)]) {
-            [self.delegate mqttTransport:self didFailWithError:error];
+#pragma mark - Receiving
+
+/*
+ * Payload bytes are passed on as soon as they arrive. Uncompressed payloads are handed to the
+ * delegate as subranges of the received chunk without copying; compressed ones are inflated
+ * incrementally.
+ */
+- (void)decodeFrames:(NSData *)data {
+    const UInt8 *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger offset = 0;
+    dispatch_data_t chunk = nil;
+
+    while (offset < length && self.state == MQTTTransportOpen) {
+        if (!self.frameHeaderParsed) {
+            offset += [self decodeFrameHeader:bytes + offset length:length - offset];
+            if (self.frameHeaderParsed && self.payloadRemaining == 0) {
+                [self finishFrame];
+            }
+            continue;
+        }
+
+        NSUInteger available = (NSUInteger)MIN((UInt64)(length - offset), self.payloadRemaining);
+        if (self.frameOpcode >= MQTTWebsocketOpcodeClose) {
+            [self.controlPayload appendBytes:bytes + offset length:available];
+        } else if (self.messageCompressed) {
+            if (![self inflateBytes:bytes + offset length:available]) {
+                return;
+            }
+        } else if (offset == 0 && available == length) {
+            [self.delegate mqttTransport:self didReceiveMessage:data];
+        } else {
+            if (!chunk) {
+                chunk = dispatch_data_create(bytes, length, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                    (void)data;
+                });
+            }
+            [self.delegate mqttTransport:self didReceiveMessage:(NSData *)dispatch_data_create_subrange(chunk, offset, available)];
+        }
+        offset += available;
+        self.payloadRemaining -= available;
+        if (self.payloadRemaining == 0) {
+            [self finishFrame];
         }
     }
 }
 
-- (void)webSocket:(SRWebSocket *)webSocket didCloseWithCode:(NSInteger)code reason:(NSString *)reason wasClean:(BOOL)wasClean{
-    DDLogVerbose(@"[MQTTWebsocketTransport] ConnectionClosed : %@",reason);
-    self.state = MQTTTransportClosed;
-    self.websocket.delegate = nil;
-    if (self.delegate) {
-        if ([self.delegate respondsToSelector:@selector(mqttTransportDidClose:)]) {
-            [self.delegate mqttTransportDidClose:self];
+/* Collects the frame header, which may span chunks, and returns the number of bytes consumed. */
+- (NSUInteger)decodeFrameHeader:(const UInt8 *)bytes length:(NSUInteger)length {
+    NSUInteger consumed = 0;
+    NSUInteger headerLength;
+    while ((headerLength = MQTTWebsocketFrameHeaderLength(self.headerBuffer.bytes, self.headerBuffer.length)) > self.headerBuffer.length) {
+        if (consumed == length) {
+            return consumed;
+        }
+        NSUInteger n = MIN(headerLength - self.headerBuffer.length, length - consumed);
+        [self.headerBuffer appendBytes:bytes + consumed length:n];
+        consumed += n;
+    }
+
+    const UInt8 *header = self.headerBuffer.bytes;
+    BOOL final = (header[0] & 0x80) != 0;
+    BOOL compressed = (header[0] & 0x40) != 0;
+    UInt8 opcode = header[0] & 0x0f;
+    UInt64 payloadLength = header[1] & 0x7f;
+    if (payloadLength == 126) {
+        payloadLength = ((UInt64)header[2] << 8) | header[3];
+    } else if (payloadLength == 127) {
+        payloadLength = 0;
+        for (int i = 0; i < 8; i++) {
+            payloadLength = (payloadLength << 8) | header[2 + i];
         }
     }
+    BOOL masked = (header[1] & 0x80) != 0;
+    BOOL reservedBits = (header[0] & 0x30) != 0;
+    self.headerBuffer.length = 0;
+
+    if (masked || reservedBits || (compressed && !self.compressionNegotiated)) {
+        [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket frame header invalid"];
+        return length;
+    }
+    switch (opcode) {
+        case MQTTWebsocketOpcodeBinary:
+            if (self.messageInProgress) {
+                [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket message interrupted"];
+                return length;
+            }
+            self.messageCompressed = compressed;
+            self.messageInProgress = !final;
+            break;
+        case MQTTWebsocketOpcodeContinuation:
+            if (!self.messageInProgress || compressed) {
+                [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket continuation unexpected"];
+                return length;
+            }
+            self.messageInProgress = !final;
+            break;
+        case MQTTWebsocketOpcodeClose:
+        case MQTTWebsocketOpcodePing:
+        case MQTTWebsocketOpcodePong:
+            if (!final || compressed || payloadLength > 125) {
+                [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket control frame invalid"];
+                return length;
+            }
+            self.controlPayload = [[NSMutableData alloc] initWithCapacity:(NSUInteger)payloadLength];
+            break;
+        default:
+            // MQTT packets are only ever sent in binary messages
+            [self failWithCode:MQTTWebsocketErrorUnsupportedData description:@"Websocket frame type unsupported"];
+            return length;
+    }
+
+    self.frameOpcode = opcode;
+    self.frameFinal = final;
+    self.payloadRemaining = payloadLength;
+    self.frameHeaderParsed = TRUE;
+    return consumed;
+}
+
+- (void)finishFrame {
+    self.frameHeaderParsed = FALSE;
+    switch (self.frameOpcode) {
+        case MQTTWebsocketOpcodeBinary:
+        case MQTTWebsocketOpcodeContinuation:
+            if (self.frameFinal && self.messageCompressed) {
+                self.messageCompressed = FALSE;
+                if ([self inflateBytes:MQTTWebsocketDeflateTail length:sizeof(MQTTWebsocketDeflateTail)] &&
+                    self.serverNoContextTakeover) {
+                    inflateReset(&_inflater);
+                }
+            }
+            break;
+        case MQTTWebsocketOpcodePing:
+            @synchronized(self) {
+                [self sendFrameWithOpcode:MQTTWebsocketOpcodePong compressed:FALSE prefix:NULL length:0 data:self.controlPayload];
+            }
+            break;
+        case MQTTWebsocketOpcodeClose:
+            DDLogVerbose(@"[MQTTWebsocketTransport] close frame received");
+            [self close];
+            self.state = MQTTTransportClosed;
+            [self.delegate mqttTransportDidClose:self];
+            break;
+        default:
+            break;
+    }
 }
 
-- (void)webSocket:(SRWebSocket *)webSocket didReceivePong:(NSData *)pongPayload{
-    DDLogVerbose(@"[MQTTWebsocketTransport] webSocket didReceivePong:%@", pongPayload);
+- (BOOL)inflateBytes:(const UInt8 *)bytes length:(NSUInteger)length {
+    _inflater.next_in = (Bytef *)bytes;
+    _inflater.avail_in = (uInt)length;
+    do {
+        NSMutableData *output = [[NSMutableData alloc] initWithLength:MQTTWebsocketInflateBufferLength];
+        _inflater.next_out = output.mutableBytes;
+        _inflater.avail_out = (uInt)output.length;
+        int status = inflate(&_inflater, Z_SYNC_FLUSH);
+        if (status != Z_OK && status != Z_BUF_ERROR && status != Z_STREAM_END) {
+            [self failWithCode:MQTTWebsocketErrorProtocol description:@"Websocket message cannot be inflated"];
+            return FALSE;
+        }
+        output.length -= _inflater.avail_out;
+        if (output.length) {
+            [self.delegate mqttTransport:self didReceiveMessage:output];
+        }
+        if (status == Z_STREAM_END) {
+            // a final deflate block ends the stream, the next message starts a new one
+            inflateReset(&_inflater);
+        } else if (status == Z_BUF_ERROR) {
+            break;
+        }
+    } while (_inflater.avail_in > 0 || _inflater.avail_out == 0);
+    return TRUE;
+}
+
+- (void)failWithCode:(NSInteger)code description:(NSString *)description {
+    DDLogWarn(@"[MQTTWebsocketTransport] %@", description);
+    NSError *error = [NSError errorWithDomain:@"MQTT"
+                                         code:code
+                                     userInfo:@{NSLocalizedDescriptionKey : description}];
+    self.state = MQTTTransportClosing;
+    [self.delegate mqttTransport:self didFailWithError:error];
 }
 
 @end
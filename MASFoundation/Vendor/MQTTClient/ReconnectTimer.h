@@ -10,12 +10,26 @@
 
 @interface ReconnectTimer : NSObject
 
+/** Each retry is delayed by a random interval between zero and the current retry interval
+ * instead of the retry interval itself ("full jitter"), so that clients disconnected at the
+ * same time do not reconnect in lockstep. Defaults to FALSE
+ */
+@property (assign, nonatomic) BOOL jitter;
+
+/** The time a connection has to stay up before resetRetryInterval takes effect. Defaults to 0 */
+@property (assign, nonatomic) NSTimeInterval stableInterval;
+
 - (instancetype)initWithRetryInterval:(NSTimeInterval)retryInterval
                      maxRetryInterval:(NSTimeInterval)maxRetryInterval
                                 queue:(dispatch_queue_t)queue
                        reconnectBlock:(void (^)(void))block;
 - (void)schedule;
 - (void)stop;
+
+/** Resets the retry interval after stableInterval, unless a retry is scheduled before */
 - (void)resetRetryInterval;
 
+/** Performs a scheduled retry immediately, e.g. when the network became reachable again, without increasing the retry interval */
+- (void)retryNow;
+
 @end
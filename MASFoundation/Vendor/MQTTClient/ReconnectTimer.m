@@ -12,6 +12,7 @@
 @interface ReconnectTimer()
 
 @property (strong, nonatomic) Timer *timer;
+@property (strong, nonatomic) Timer *resetTimer;
 @property (assign, nonatomic) NSTimeInterval retryInterval;
 @property (assign, nonatomic) NSTimeInterval currentRetryInterval;
 @property (assign, nonatomic) NSTimeInterval maxRetryInterval;
@@ -33,13 +34,23 @@
         self.maxRetryInterval = maxRetryInterval;
         self.reconnectBlock = block;
         self.queue = queue;
+        self.jitter = FALSE;
+        self.stableInterval = 0;
     }
     return self;
 }
 
 - (void)schedule {
+    [self.resetTimer invalidate];
+    self.resetTimer = nil;
+
+    NSTimeInterval interval = self.currentRetryInterval;
+    if (self.jitter) {
+        interval *= arc4random_uniform(UINT32_MAX) / (double)UINT32_MAX;
+    }
     __weak typeof(self) weakSelf = self;
-    self.timer = [Timer scheduledTimerWithTimeInterval:self.currentRetryInterval
+    [self.timer invalidate];
+    self.timer = [Timer scheduledTimerWithTimeInterval:interval
                                                repeats:NO
                                                  queue:self.queue
                                                  block:^{
@@ -50,17 +61,40 @@
 - (void)stop {
     [self.timer invalidate];
     self.timer = nil;
+    [self.resetTimer invalidate];
+    self.resetTimer = nil;
 }
 
 - (void)resetRetryInterval {
-    self.currentRetryInterval = self.retryInterval;
+    [self.resetTimer invalidate];
+    self.resetTimer = nil;
+    if (self.stableInterval <= 0) {
+        self.currentRetryInterval = self.retryInterval;
+        return;
+    }
+    __weak typeof(self) weakSelf = self;
+    self.resetTimer = [Timer scheduledTimerWithTimeInterval:self.stableInterval
+                                                    repeats:NO
+                                                      queue:self.queue
+                                                      block:^{
+                                                          weakSelf.currentRetryInterval = weakSelf.retryInterval;
+                                                          weakSelf.resetTimer = nil;
+                                                      }];
 }
 
-- (void)reconnect {
-    [self stop];
-    if (self.currentRetryInterval < self.maxRetryInterval) {
-        self.currentRetryInterval *= 2;
+- (void)retryNow {
+    if (!self.timer) {
+        return;
     }
+    [self.timer invalidate];
+    self.timer = nil;
+    self.reconnectBlock();
+}
+
+- (void)reconnect {
+    [self.timer invalidate];
+    self.timer = nil;
+    self.currentRetryInterval = MIN(self.currentRetryInterval * 2, self.maxRetryInterval);
     self.reconnectBlock();
 }
 
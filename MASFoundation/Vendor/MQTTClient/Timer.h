@@ -16,4 +16,9 @@
                                     block:(void (^)(void))block;
 - (void)invalidate;
 
+/** Moves the next firing of the timer. A repeating timer keeps its original interval after that firing.
+ * @param interval the time interval from now until the next firing, or a negative interval to hold the timer until it is rescheduled
+ */
+- (void)rescheduleWithTimeInterval:(NSTimeInterval)interval;
+
 @end
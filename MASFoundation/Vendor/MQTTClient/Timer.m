@@ -11,6 +11,7 @@
 @interface Timer ()
 
 @property (strong, nonatomic) dispatch_source_t timer;
+@property (nonatomic) NSTimeInterval interval;
 
 @end
 
@@ -33,6 +34,7 @@
                            block:(void (^)(void))block {
     self = [super init];
     if (self) {
+        self.interval = interval;
         self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
         dispatch_source_set_timer(self.timer, dispatch_time(DISPATCH_TIME_NOW, interval * NSEC_PER_SEC), interval * NSEC_PER_SEC, 0);
         dispatch_source_set_event_handler(self.timer, ^{
@@ -56,4 +58,11 @@
     }
 }
 
+- (void)rescheduleWithTimeInterval:(NSTimeInterval)interval {
+    if (self.timer) {
+        dispatch_time_t start = interval < 0 ? DISPATCH_TIME_FOREVER : dispatch_time(DISPATCH_TIME_NOW, interval * NSEC_PER_SEC);
+        dispatch_source_set_timer(self.timer, start, self.interval * NSEC_PER_SEC, 0);
+    }
+}
+
 @end
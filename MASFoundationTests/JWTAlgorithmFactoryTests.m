@@ -0,0 +1,205 @@
+//
+//  JWTAlgorithmFactoryTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "JWT.h"
+#import "JWTAlgorithmNone.h"
+#import "JWTCryptoKey.h"
+
+static NSUInteger const JWTAlgorithmFactoryTestsTokenCount = 32;
+
+
+//
+//  An algorithm registered under a name chosen by the test
+//
+@interface JWTTestAlgorithm : JWTAlgorithmNone
+
+@property (nonatomic, copy) NSString *testName;
+
+@end
+
+
+@implementation JWTTestAlgorithm
+
+- (NSString *)name {
+    return self.testName;
+}
+
+@end
+
+
+//
+//  Hands the JWT library a key directly, instead of importing it through the keychain
+//
+@interface JWTTestCryptoKey : NSObject <JWTCryptoKeyProtocol>
+
+- (instancetype)initWithKey:(SecKeyRef)key;
+
+@end
+
+
+@implementation JWTTestCryptoKey {
+    SecKeyRef _key;
+}
+
+- (instancetype)initWithKey:(SecKeyRef)key {
+    self = [super init];
+    if (self) {
+        _key = (SecKeyRef)CFRetain(key);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    CFRelease(_key);
+}
+
+- (NSString *)tag {
+    return nil;
+}
+
+- (SecKeyRef)key {
+    return _key;
+}
+
+- (NSData *)rawKey {
+    return (__bridge_transfer NSData *)SecKeyCopyExternalRepresentation(_key, NULL);
+}
+
+@end
+
+
+@interface JWTAlgorithmFactoryTests : XCTestCase
+
+@end
+
+
+@implementation JWTAlgorithmFactoryTests
+
+#pragma mark - Helpers
+
+- (JWTTestAlgorithm *)algorithmNamed:(NSString *)name {
+    JWTTestAlgorithm *algorithm = [JWTTestAlgorithm new];
+    algorithm.testName = name;
+    return algorithm;
+}
+
+//
+//  Returns the private key and its public key
+//
+- (NSArray<JWTTestCryptoKey *> *)generateKeyPair {
+    NSDictionary *attributes = @{ (__bridge id)kSecAttrKeyType: (__bridge id)kSecAttrKeyTypeRSA,
+                                  (__bridge id)kSecAttrKeySizeInBits: @2048 };
+    SecKeyRef privateKey = SecKeyCreateRandomKey((__bridge CFDictionaryRef)attributes, NULL);
+    XCTAssertTrue(privateKey != NULL);
+    SecKeyRef publicKey = SecKeyCopyPublicKey(privateKey);
+
+    NSArray *keyPair = @[[[JWTTestCryptoKey alloc] initWithKey:privateKey], [[JWTTestCryptoKey alloc] initWithKey:publicKey]];
+    CFRelease(privateKey);
+    CFRelease(publicKey);
+    return keyPair;
+}
+
+- (NSString *)encodePayload:(NSDictionary *)payload withKey:(JWTTestCryptoKey *)key {
+    id<JWTAlgorithmDataHolderProtocol> holder = [JWTAlgorithmRSFamilyDataHolder new].signKey(key).algorithmName(@"RS256").secretData([NSData new]);
+    return [JWTEncodingBuilder encodePayload:payload].addHolder(holder).result.successResult.encoded;
+}
+
+- (NSDictionary *)decodeToken:(NSString *)token withKey:(JWTTestCryptoKey *)key {
+    id<JWTAlgorithmDataHolderProtocol> holder = [JWTAlgorithmRSFamilyDataHolder new].verifyKey(key).algorithmName(@"RS256").secretData([NSData new]);
+    return [JWTDecodingBuilder decodeMessage:token].addHolder(holder).options(@NO).result.successResult.payload;
+}
+
+#pragma mark - Lookup
+
+- (void)testLookupIsCaseInsensitive {
+    id<JWTAlgorithm> algorithm = [JWTAlgorithmFactory algorithmByName:@"RS256"];
+    XCTAssertNotNil(algorithm);
+    XCTAssertEqualObjects(algorithm.name, @"RS256");
+    XCTAssertEqual([JWTAlgorithmFactory algorithmByName:@"rs256"], algorithm);
+    XCTAssertEqual([JWTAlgorithmFactory algorithmByName:@"Rs256"], algorithm);
+
+    XCTAssertEqualObjects([JWTAlgorithmFactory algorithmByName:@"hs512"].name, @"HS512");
+    XCTAssertEqualObjects([JWTAlgorithmFactory algorithmByName:@"NONE"].name, JWTAlgorithmNameNone);
+}
+
+- (void)testUnknownNamesAreNotFound {
+    XCTAssertNil([JWTAlgorithmFactory algorithmByName:nil]);
+    XCTAssertNil([JWTAlgorithmFactory algorithmByName:@""]);
+    XCTAssertNil([JWTAlgorithmFactory algorithmByName:@"RS1024"]);
+    XCTAssertNil([JWTAlgorithmFactory algorithmByName:JWTAlgorithmNameES256], @"ES256 is not implemented");
+}
+
+#pragma mark - Registration
+
+- (void)testRegisteringReplacesAlgorithmByName {
+    NSString *name = [NSString stringWithFormat:@"TEST%@", [[NSUUID UUID] UUIDString]];
+    NSUInteger count = [JWTAlgorithmFactory algorithms].count;
+
+    JWTTestAlgorithm *algorithm = [self algorithmNamed:name];
+    [JWTAlgorithmFactory registerAlgorithm:algorithm];
+    XCTAssertEqual([JWTAlgorithmFactory algorithms].count, count + 1);
+    XCTAssertEqual([JWTAlgorithmFactory algorithmByName:name], algorithm);
+    XCTAssertEqual([JWTAlgorithmFactory algorithmByName:name.lowercaseString], algorithm);
+
+    //
+    //  A name differing only in case replaces the registered algorithm, under both spellings
+    //
+    JWTTestAlgorithm *replacement = [self algorithmNamed:name.lowercaseString];
+    [JWTAlgorithmFactory registerAlgorithm:replacement];
+    XCTAssertEqual([JWTAlgorithmFactory algorithms].count, count + 1);
+    XCTAssertFalse([[JWTAlgorithmFactory algorithms] containsObject:algorithm]);
+    XCTAssertEqual([JWTAlgorithmFactory algorithmByName:name], replacement);
+    XCTAssertEqual([JWTAlgorithmFactory algorithmByName:name.lowercaseString], replacement);
+}
+
+- (void)testRegisteringWithoutNameIsIgnored {
+    NSArray *algorithms = [JWTAlgorithmFactory algorithms];
+
+    [JWTAlgorithmFactory registerAlgorithm:[self algorithmNamed:nil]];
+    XCTAssertEqualObjects([JWTAlgorithmFactory algorithms], algorithms);
+}
+
+#pragma mark - Shared instances
+
+- (void)testConcurrentSigningWithTwoKeys {
+    NSArray<NSArray<JWTTestCryptoKey *> *> *keyPairs = @[[self generateKeyPair], [self generateKeyPair]];
+    NSMutableArray *tokens = [NSMutableArray array];
+    for (NSUInteger i = 0; i < JWTAlgorithmFactoryTestsTokenCount; i++) {
+        [tokens addObject:[NSNull null]];
+    }
+
+    //
+    //  The factory shares one RS256 instance, so each holder must sign with a copy carrying its own key
+    //
+    dispatch_apply(JWTAlgorithmFactoryTestsTokenCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        NSString *token = [self encodePayload:@{ @"i": @(i) } withKey:keyPairs[i % 2][0]];
+        @synchronized(tokens) {
+            tokens[i] = token ?: [NSNull null];
+        }
+    });
+
+    for (NSUInteger i = 0; i < JWTAlgorithmFactoryTestsTokenCount; i++) {
+        XCTAssertTrue([tokens[i] isKindOfClass:[NSString class]]);
+
+        NSDictionary *payload = [self decodeToken:tokens[i] withKey:keyPairs[i % 2][1]];
+        XCTAssertEqualObjects(payload[@"i"], @(i));
+        XCTAssertNil([self decodeToken:tokens[i] withKey:keyPairs[(i + 1) % 2][1]], @"signed with the other key");
+    }
+
+    id<JWTRSAlgorithm> sharedAlgorithm = (id<JWTRSAlgorithm>)[JWTAlgorithmFactory algorithmByName:@"RS256"];
+    XCTAssertNil(sharedAlgorithm.signKey);
+    XCTAssertNil(sharedAlgorithm.verifyKey);
+}
+
+@end
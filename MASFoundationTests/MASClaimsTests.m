@@ -0,0 +1,175 @@
+//
+//  MASClaimsTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASClaims+MASPrivate.h"
+#import "MASSecurityService.h"
+
+#import "JWT.h"
+#import "JWTCryptoKey.h"
+
+static NSString * const MASClaimsTestsClaimKey = @"claim";
+static NSString * const MASClaimsTestsClaimValue = @"value";
+
+
+//
+//  Hands the JWT library a public key directly, instead of importing it through the keychain
+//
+@interface MASTestJWTPublicKey : NSObject <JWTCryptoKeyProtocol>
+
+- (instancetype)initWithPrivateKey:(SecKeyRef)privateKey;
+
+@end
+
+
+@implementation MASTestJWTPublicKey {
+    SecKeyRef _key;
+}
+
+- (instancetype)initWithPrivateKey:(SecKeyRef)privateKey {
+    self = [super init];
+    if (self) {
+        _key = SecKeyCopyPublicKey(privateKey);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_key) {
+        CFRelease(_key);
+    }
+}
+
+- (NSString *)tag {
+    return nil;
+}
+
+- (SecKeyRef)key {
+    return _key;
+}
+
+- (NSData *)rawKey {
+    return (__bridge_transfer NSData *)SecKeyCopyExternalRepresentation(_key, NULL);
+}
+
+@end
+
+
+@interface MASClaimsTests : XCTestCase
+
+@property (nonatomic, assign) SecKeyRef privateKey;
+
+@end
+
+
+@implementation MASClaimsTests
+
+- (void)setUp {
+    [super setUp];
+
+    NSDictionary *attributes = @{ (__bridge id)kSecAttrKeyType: (__bridge id)kSecAttrKeyTypeRSA,
+                                  (__bridge id)kSecAttrKeySizeInBits: @2048 };
+    self.privateKey = SecKeyCreateRandomKey((__bridge CFDictionaryRef)attributes, NULL);
+    XCTAssertTrue(self.privateKey != NULL);
+    [[MASSecurityService sharedService] setSigningKey:self.privateKey];
+}
+
+- (void)tearDown {
+    [[MASSecurityService sharedService] invalidateSigningKey];
+    if (self.privateKey) {
+        CFRelease(self.privateKey);
+        self.privateKey = NULL;
+    }
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (NSString *)buildClaims:(MASClaims *)claims {
+    NSError *error = nil;
+    NSString *jwt = [claims buildWithError:&error];
+    XCTAssertNotNil(jwt, @"%@", error);
+    XCTAssertEqual([jwt componentsSeparatedByString:@"."].count, 3);
+    return jwt;
+}
+
+//
+//  Decodes the token the way MASJWTService verifies id_tokens, returning nil unless the signature verifies with the key
+//
+- (NSDictionary *)verifiedHeaderAndPayloadOfToken:(NSString *)token withKey:(id<JWTCryptoKeyProtocol>)key {
+    id<JWTAlgorithmDataHolderProtocol> holder = [JWTAlgorithmRSFamilyDataHolder new].verifyKey(key).algorithmName(@"RS256").secretData([NSData new]);
+    JWTCodingBuilder *builder = [JWTDecodingBuilder decodeMessage:token].addHolder(holder).options(@NO);
+    return builder.result.successResult.headerAndPayloadDictionary;
+}
+
+#pragma mark - Round trip
+
+- (void)testBuiltTokenVerifiesWithDevicePublicKey {
+    MASClaims *claims = [MASClaims claims];
+    claims.sub = @"subject";
+    claims.content = @{ @"key": @"content" };
+    claims.contentType = @"application/json";
+    claims.exp = [NSDate dateWithTimeIntervalSinceNow:300];
+
+    NSError *error = nil;
+    [claims setValue:MASClaimsTestsClaimValue forClaimKey:MASClaimsTestsClaimKey error:&error];
+    XCTAssertNil(error);
+
+    NSString *jwt = [self buildClaims:claims];
+    MASTestJWTPublicKey *publicKey = [[MASTestJWTPublicKey alloc] initWithPrivateKey:self.privateKey];
+    NSDictionary *decoded = [self verifiedHeaderAndPayloadOfToken:jwt withKey:publicKey];
+    XCTAssertNotNil(decoded);
+
+    NSDictionary *header = decoded[JWTCodingResultHeaders];
+    XCTAssertEqualObjects(header[@"alg"], @"RS256");
+    XCTAssertEqualObjects(header[@"typ"], @"JWT");
+
+    NSDictionary *payload = decoded[JWTCodingResultPayload];
+    XCTAssertEqualObjects(payload[@"sub"], @"subject");
+    XCTAssertEqualObjects(payload[@"jti"], claims.jti);
+    XCTAssertEqualObjects(payload[@"iat"], @((NSInteger)[claims.iat timeIntervalSince1970]));
+    XCTAssertEqualObjects(payload[@"exp"], @((NSInteger)[claims.exp timeIntervalSince1970]));
+    XCTAssertEqualObjects(payload[@"content"], claims.content);
+    XCTAssertEqualObjects(payload[@"content-type"], @"application/json");
+    XCTAssertEqualObjects(payload[MASClaimsTestsClaimKey], MASClaimsTestsClaimValue);
+}
+
+- (void)testTamperedTokenDoesNotVerify {
+    NSString *jwt = [self buildClaims:[MASClaims claims]];
+    NSArray<NSString *> *segments = [jwt componentsSeparatedByString:@"."];
+
+    //
+    //  Replace the payload with another one, keeping the original signature
+    //
+    NSData *payload = [NSJSONSerialization dataWithJSONObject:@{ @"sub": @"someone else" } options:0 error:nil];
+    NSString *tampered = [@[segments[0], [JWTBase64Coder base64UrlEncodedStringWithData:payload], segments[2]] componentsJoinedByString:@"."];
+
+    MASTestJWTPublicKey *publicKey = [[MASTestJWTPublicKey alloc] initWithPrivateKey:self.privateKey];
+    XCTAssertNotNil([self verifiedHeaderAndPayloadOfToken:jwt withKey:publicKey]);
+    XCTAssertNil([self verifiedHeaderAndPayloadOfToken:tampered withKey:publicKey]);
+}
+
+- (void)testTokenDoesNotVerifyWithAnotherKey {
+    NSString *jwt = [self buildClaims:[MASClaims claims]];
+
+    NSDictionary *attributes = @{ (__bridge id)kSecAttrKeyType: (__bridge id)kSecAttrKeyTypeRSA,
+                                  (__bridge id)kSecAttrKeySizeInBits: @2048 };
+    SecKeyRef otherKey = SecKeyCreateRandomKey((__bridge CFDictionaryRef)attributes, NULL);
+    MASTestJWTPublicKey *otherPublicKey = [[MASTestJWTPublicKey alloc] initWithPrivateKey:otherKey];
+    CFRelease(otherKey);
+
+    XCTAssertNil([self verifiedHeaderAndPayloadOfToken:jwt withKey:otherPublicKey]);
+}
+
+@end
@@ -0,0 +1,204 @@
+//
+//  MASDataTaskCancellationTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASDataTask+MASPrivate.h"
+#import "MASSessionDataTaskOperation.h"
+#import "MASURLRequest.h"
+#import "MASURLSessionManager.h"
+
+//
+//  Nothing listens on the discard port of the loopback address; the connection is refused right away
+//
+static NSString *const MASDataTaskCancellationTestURL = @"https://127.0.0.1:9/cancellation";
+static NSUInteger const MASDataTaskCancellationStressCount = 1000;
+
+
+@interface MASDataTaskCancellationTests : XCTestCase
+
+@property (nonatomic, strong) MASURLSessionManager *sessionManager;
+
+@end
+
+
+@implementation MASDataTaskCancellationTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.sessionManager = [[MASURLSessionManager alloc] initWithConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+}
+
+- (void)tearDown {
+    [self.sessionManager.operationQueue cancelAllOperations];
+    self.sessionManager = nil;
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (MASSessionDataTaskOperation *)operationWithCompletion:(void (^)(NSError *error))completion {
+    MASURLRequest *request = [MASURLRequest requestWithURL:[NSURL URLWithString:MASDataTaskCancellationTestURL]];
+    request.isPublic = YES;
+
+    return [self.sessionManager dataOperationWithRequest:request completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        completion(error);
+    }];
+}
+
+- (BOOL)isCancellationError:(NSError *)error {
+    return [error.domain isEqualToString:MASFoundationErrorDomainLocal] && error.code == MASFoundationErrorCodeTaskCancelled;
+}
+
+#pragma mark - Operation
+
+- (void)testCancelRacingStartCompletesEachOperationOnce {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"every operation completes once"];
+    expectation.expectedFulfillmentCount = MASDataTaskCancellationStressCount;
+    expectation.assertForOverFulfill = YES;
+
+    for (NSUInteger i = 0; i < MASDataTaskCancellationStressCount; i++) {
+        __block MASSessionDataTaskOperation *operation = nil;
+        operation = [self operationWithCompletion:^(NSError *error) {
+            //
+            //  A cancelled operation reports the cancellation, whether it was cancelled before or after it started
+            //
+            if (operation.isCancelled) {
+                XCTAssertTrue([self isCancellationError:error], @"unexpected error %@", error);
+            }
+
+            operation = nil;
+            [expectation fulfill];
+        }];
+
+        [self.sessionManager.operationQueue addOperation:operation];
+
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            [operation cancel];
+        });
+    }
+
+    [self waitForExpectationsWithTimeout:60 handler:nil];
+}
+
+#pragma mark - Chained retries
+
+- (void)testCancelCancelsPendingOperation {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"cancellation reported"];
+
+    MASDataTask *dataTask = [[MASDataTask alloc] initForChainedOperations];
+    MASSessionDataTaskOperation *operation = [self operationWithCompletion:^(NSError *error) {
+        XCTAssertTrue([self isCancellationError:error]);
+        [dataTask completeTask];
+        [expectation fulfill];
+    }];
+    [dataTask chainOperation:operation];
+
+    XCTAssertTrue([dataTask cancelTask]);
+    XCTAssertTrue(operation.isCancelled);
+    XCTAssertFalse([dataTask cancelTask], @"a data task is only cancelled once");
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertTrue([dataTask isFinished]);
+}
+
+- (void)testCancelWhileRetryIsPreparedCancelsRetry {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"retry reports cancellation"];
+
+    MASDataTask *dataTask = [[MASDataTask alloc] initForChainedOperations];
+    MASSessionDataTaskOperation *originalOperation = [self operationWithCompletion:^(NSError *error) {}];
+    [dataTask chainOperation:originalOperation];
+
+    //
+    //  The original operation is finished, and its completion is waiting for a fresh location or a renewed certificate
+    //
+    [originalOperation completeOperation];
+
+    XCTAssertFalse([dataTask isFinished], @"the data task is not finished until its completion is delivered");
+    XCTAssertTrue([dataTask cancelTask], @"the data task can be cancelled while the retry is prepared");
+    XCTAssertTrue([dataTask isCancelled]);
+
+    MASSessionDataTaskOperation *retryOperation = [self operationWithCompletion:^(NSError *error) {
+        XCTAssertTrue([self isCancellationError:error]);
+        [dataTask completeTask];
+        [expectation fulfill];
+    }];
+    [dataTask chainOperation:retryOperation];
+
+    XCTAssertTrue(retryOperation.isCancelled);
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertTrue([dataTask isFinished]);
+    XCTAssertFalse([dataTask cancelTask], @"a finished data task cannot be cancelled");
+}
+
+- (void)testCancelRacingRetryCancelsEveryChain {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"every chain reports cancellation once"];
+    expectation.expectedFulfillmentCount = MASDataTaskCancellationStressCount;
+    expectation.assertForOverFulfill = YES;
+
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    dispatch_group_t group = dispatch_group_create();
+    NSMutableArray *dataTasks = [NSMutableArray array];
+    NSMutableArray *retryOperations = [NSMutableArray array];
+    __block NSUInteger successfulCancellations = 0;
+    NSObject *lock = [[NSObject alloc] init];
+
+    for (NSUInteger i = 0; i < MASDataTaskCancellationStressCount; i++) {
+        MASDataTask *dataTask = [[MASDataTask alloc] initForChainedOperations];
+        MASSessionDataTaskOperation *originalOperation = [self operationWithCompletion:^(NSError *error) {}];
+        [dataTask chainOperation:originalOperation];
+        [originalOperation completeOperation];
+
+        MASSessionDataTaskOperation *retryOperation = [self operationWithCompletion:^(NSError *error) {
+            XCTAssertTrue([self isCancellationError:error]);
+            [dataTask completeTask];
+            [expectation fulfill];
+        }];
+
+        [dataTasks addObject:dataTask];
+        [retryOperations addObject:retryOperation];
+
+        //
+        //  The retry is chained while the data task is cancelled twice from other threads
+        //
+        for (NSUInteger j = 0; j < 2; j++) {
+            dispatch_group_async(group, queue, ^{
+                if ([dataTask cancelTask]) {
+                    @synchronized (lock) {
+                        successfulCancellations++;
+                    }
+                }
+            });
+        }
+
+        dispatch_group_async(group, queue, ^{
+            [dataTask chainOperation:retryOperation];
+        });
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    XCTAssertEqual(successfulCancellations, MASDataTaskCancellationStressCount, @"each data task is cancelled exactly once");
+
+    for (MASSessionDataTaskOperation *retryOperation in retryOperations) {
+        XCTAssertTrue(retryOperation.isCancelled, @"the retry of a cancelled data task is cancelled");
+    }
+
+    [self waitForExpectationsWithTimeout:60 handler:nil];
+}
+
+@end
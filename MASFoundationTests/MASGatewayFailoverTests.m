@@ -0,0 +1,186 @@
+//
+//  MASGatewayFailoverTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASConfigurationService.h"
+#import "MASConstantsPrivate.h"
+#import "MASGatewayEndpointSelector.h"
+
+static NSString *const MASGatewayFailoverTestsPrimaryURL = @"https://primary.example.com:8443";
+static NSString *const MASGatewayFailoverTestsAlternateURL = @"https://alternate.example.com:8443";
+
+
+@interface MASGatewayFailoverTests : XCTestCase
+
+@property (nonatomic, strong) NSURL *primaryURL;
+@property (nonatomic, strong) NSURL *alternateURL;
+@property (nonatomic, strong) MASGatewayEndpointSelector *selector;
+
+@end
+
+
+@implementation MASGatewayFailoverTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.primaryURL = [NSURL URLWithString:MASGatewayFailoverTestsPrimaryURL];
+    self.alternateURL = [NSURL URLWithString:MASGatewayFailoverTestsAlternateURL];
+
+    //
+    //  Monitoring is not started; endpoints with unknown reachability are healthy until requests fail
+    //
+    self.selector = [[MASGatewayEndpointSelector alloc] initWithPrimaryURL:self.primaryURL primaryReachability:nil alternateURLs:@[self.alternateURL]];
+}
+
+- (void)tearDown {
+    [MASConfigurationService setAlternateDomains:nil forDomain:self.primaryURL];
+    [MASConfigurationService removeNetworkConfigurationForDomain:self.primaryURL];
+    [MASConfigurationService removeNetworkConfigurationForDomain:self.alternateURL];
+    [MASConfigurationService removeSecurityConfigurationForDomain:self.primaryURL];
+    [MASConfigurationService removeSecurityConfigurationForDomain:self.alternateURL];
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (NSURL *)requestURLWithEndpoint:(NSURL *)endpoint {
+    return [NSURL URLWithString:@"/connect/device/register" relativeToURL:endpoint].absoluteURL;
+}
+
+- (void)failRequestsToURL:(NSURL *)URL count:(NSUInteger)count {
+    NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotConnectToHost userInfo:nil];
+    for (NSUInteger i = 0; i < count; i++) {
+        [self.selector recordCompletionForURL:[self requestURLWithEndpoint:URL] response:nil error:error];
+    }
+}
+
+- (NSHTTPURLResponse *)responseForURL:(NSURL *)URL statusCode:(NSInteger)statusCode {
+    return [[NSHTTPURLResponse alloc] initWithURL:[self requestURLWithEndpoint:URL] statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:nil];
+}
+
+#pragma mark - Failover
+
+- (void)testPrimaryIsSelectedInitially {
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.primaryURL);
+
+    NSURL *requestURL = [self requestURLWithEndpoint:self.primaryURL];
+    XCTAssertEqualObjects([self.selector endpointURLForURL:requestURL], requestURL);
+}
+
+- (void)testFailsOverAfterConsecutiveFailures {
+    [self failRequestsToURL:self.primaryURL count:MASGatewayEndpointFailureThreshold - 1];
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.primaryURL);
+
+    [self failRequestsToURL:self.primaryURL count:1];
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.alternateURL);
+
+    //
+    //  Requests made to the primary gateway are routed to the alternate gateway, keeping path and query
+    //
+    NSURL *requestURL = [NSURL URLWithString:@"https://primary.example.com:8443/connect/device/register?client=1"];
+    XCTAssertEqualObjects([self.selector endpointURLForURL:requestURL], [NSURL URLWithString:@"https://alternate.example.com:8443/connect/device/register?client=1"]);
+}
+
+- (void)testGatewayErrorsCountAsFailures {
+    for (NSUInteger i = 0; i < MASGatewayEndpointFailureThreshold; i++) {
+        [self.selector recordCompletionForURL:[self requestURLWithEndpoint:self.primaryURL] response:[self responseForURL:self.primaryURL statusCode:503] error:nil];
+    }
+
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.alternateURL);
+}
+
+- (void)testSuccessResetsConsecutiveFailures {
+    [self failRequestsToURL:self.primaryURL count:MASGatewayEndpointFailureThreshold - 1];
+    [self.selector recordCompletionForURL:[self requestURLWithEndpoint:self.primaryURL] response:[self responseForURL:self.primaryURL statusCode:401] error:nil];
+    [self failRequestsToURL:self.primaryURL count:MASGatewayEndpointFailureThreshold - 1];
+
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.primaryURL);
+}
+
+- (void)testCancellationIsNotAFailure {
+    NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    for (NSUInteger i = 0; i < MASGatewayEndpointFailureThreshold; i++) {
+        [self.selector recordCompletionForURL:[self requestURLWithEndpoint:self.primaryURL] response:nil error:error];
+    }
+
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.primaryURL);
+}
+
+- (void)testSelectionIsStickyAfterRecovery {
+    [self failRequestsToURL:self.primaryURL count:MASGatewayEndpointFailureThreshold];
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.alternateURL);
+
+    [self.selector recordCompletionForURL:[self requestURLWithEndpoint:self.primaryURL] response:[self responseForURL:self.primaryURL statusCode:200] error:nil];
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.alternateURL);
+}
+
+- (void)testFallsBackToPrimaryWhenNoEndpointIsHealthy {
+    [self failRequestsToURL:self.primaryURL count:MASGatewayEndpointFailureThreshold];
+    [self failRequestsToURL:self.alternateURL count:MASGatewayEndpointFailureThreshold];
+
+    XCTAssertEqualObjects(self.selector.activeEndpointURL, self.primaryURL);
+}
+
+- (void)testOtherHostsAreNotRouted {
+    [self failRequestsToURL:self.primaryURL count:MASGatewayEndpointFailureThreshold];
+
+    NSURL *requestURL = [NSURL URLWithString:@"https://primary.example.com:443/connect/device/register"];
+    XCTAssertEqualObjects([self.selector endpointURLForURL:requestURL], requestURL);
+
+    requestURL = [NSURL URLWithString:@"https://other.example.com:8443/connect/device/register"];
+    XCTAssertEqualObjects([self.selector endpointURLForURL:requestURL], requestURL);
+}
+
+#pragma mark - Configuration
+
+- (void)testAlternateInheritsPrimaryConfiguration {
+    [MASConfigurationService setAlternateDomains:@[self.alternateURL] forDomain:self.primaryURL];
+
+    //
+    //  Configuration set for the primary gateway after SDK initialization applies to the alternate gateway
+    //
+    MASNetworkConfiguration *networkConfiguration = [[MASNetworkConfiguration alloc] initWithURL:self.primaryURL];
+    networkConfiguration.timeoutInterval = 5;
+    [MASConfigurationService setNetworkConfiguration:networkConfiguration];
+
+    MASSecurityConfiguration *securityConfiguration = [[MASSecurityConfiguration alloc] initWithURL:self.primaryURL];
+    securityConfiguration.publicKeyHashes = @[@"k2v657xBsOVe1PQRwOsHsw3bsGT2VzIqz5K+59sNQws="];
+    [MASConfigurationService setSecurityConfiguration:securityConfiguration];
+
+    NSURL *requestURL = [self requestURLWithEndpoint:self.alternateURL];
+    XCTAssertEqual([MASConfigurationService networkConfigurationForDomain:requestURL], networkConfiguration);
+    XCTAssertEqual([MASConfigurationService securityConfigurationForDomain:requestURL], securityConfiguration);
+}
+
+- (void)testAlternateConfigurationTakesPrecedence {
+    [MASConfigurationService setAlternateDomains:@[self.alternateURL] forDomain:self.primaryURL];
+    [MASConfigurationService setNetworkConfiguration:[[MASNetworkConfiguration alloc] initWithURL:self.primaryURL]];
+
+    MASNetworkConfiguration *alternateConfiguration = [[MASNetworkConfiguration alloc] initWithURL:self.alternateURL];
+    [MASConfigurationService setNetworkConfiguration:alternateConfiguration];
+
+    XCTAssertEqual([MASConfigurationService networkConfigurationForDomain:self.alternateURL], alternateConfiguration);
+}
+
+- (void)testRemovedAlternateDoesNotInherit {
+    [MASConfigurationService setAlternateDomains:@[self.alternateURL] forDomain:self.primaryURL];
+    [MASConfigurationService setNetworkConfiguration:[[MASNetworkConfiguration alloc] initWithURL:self.primaryURL]];
+    [MASConfigurationService setAlternateDomains:nil forDomain:self.primaryURL];
+
+    XCTAssertNil([MASConfigurationService networkConfigurationForDomain:self.alternateURL]);
+    XCTAssertNotNil([MASConfigurationService networkConfigurationForDomain:self.primaryURL]);
+}
+
+@end
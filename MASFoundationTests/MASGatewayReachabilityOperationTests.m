@@ -0,0 +1,183 @@
+//
+//  MASGatewayReachabilityOperationTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASGatewayReachabilityOperation.h"
+#import "MASSessionDataTaskOperation.h"
+#import "MASURLRequest.h"
+#import "MASURLSessionManager.h"
+
+static NSString *const MASGatewayReachabilityOperationTestURL = @"https://127.0.0.1:9/reachability";
+static NSTimeInterval const MASGatewayReachabilityOperationTestWaitInterval = 60;
+
+
+//
+//  Reports the reachability set by the test instead of the gateway monitor of the networking service
+//
+@interface MASTestGatewayReachabilityOperation : MASGatewayReachabilityOperation
+
+@property (atomic, assign) BOOL notReachable;
+
+@end
+
+
+@implementation MASTestGatewayReachabilityOperation
+
+- (BOOL)gatewayEndpointIsNotReachable {
+    return self.notReachable;
+}
+
+@end
+
+
+@interface MASGatewayReachabilityOperationTests : XCTestCase
+
+@property (nonatomic, strong) NSOperationQueue *operationQueue;
+
+@end
+
+
+@implementation MASGatewayReachabilityOperationTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.operationQueue = [[NSOperationQueue alloc] init];
+}
+
+- (void)tearDown {
+    [self.operationQueue cancelAllOperations];
+    self.operationQueue = nil;
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (MASTestGatewayReachabilityOperation *)startedOperationWithMaximumWaitInterval:(NSTimeInterval)maximumWaitInterval {
+    MASTestGatewayReachabilityOperation *operation = [MASTestGatewayReachabilityOperation operationWithMaximumWaitInterval:maximumWaitInterval];
+    operation.notReachable = YES;
+
+    [self expectationForPredicate:[NSPredicate predicateWithFormat:@"isExecuting == YES"] evaluatedWithObject:operation handler:nil];
+    [self.operationQueue addOperation:operation];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    return operation;
+}
+
+- (NSBlockOperation *)heldOperationDependingOn:(MASGatewayReachabilityOperation *)reachabilityOperation expectation:(XCTestExpectation *)expectation {
+    NSBlockOperation *heldOperation = [NSBlockOperation blockOperationWithBlock:^{
+        [expectation fulfill];
+    }];
+    [heldOperation addDependency:reachabilityOperation];
+    [self.operationQueue addOperation:heldOperation];
+
+    return heldOperation;
+}
+
+#pragma mark - Holding requests
+
+- (void)testOperationsAreEachNew {
+    XCTAssertNotEqual([MASGatewayReachabilityOperation operationWithMaximumWaitInterval:0], [MASGatewayReachabilityOperation operationWithMaximumWaitInterval:0]);
+}
+
+- (void)testFinishesRightAwayWhenReachable {
+    MASTestGatewayReachabilityOperation *operation = [MASTestGatewayReachabilityOperation operationWithMaximumWaitInterval:MASGatewayReachabilityOperationTestWaitInterval];
+    [self heldOperationDependingOn:operation expectation:[self expectationWithDescription:@"released"]];
+    [self.operationQueue addOperation:operation];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertTrue(operation.result);
+    XCTAssertNil(operation.error);
+}
+
+- (void)testHoldsOperationsUntilGatewayIsReachable {
+    MASTestGatewayReachabilityOperation *operation = [self startedOperationWithMaximumWaitInterval:MASGatewayReachabilityOperationTestWaitInterval];
+    XCTestExpectation *released = [self expectationWithDescription:@"released"];
+    NSBlockOperation *heldOperation = [self heldOperationDependingOn:operation expectation:released];
+
+    //
+    //  A status update which leaves the gateway not reachable keeps the operations on hold
+    //
+    [[NSNotificationCenter defaultCenter] postNotificationName:MASGatewayMonitorStatusUpdateNotification object:nil];
+    [NSThread sleepForTimeInterval:0.2];
+    XCTAssertFalse(heldOperation.isFinished);
+    XCTAssertTrue(operation.isExecuting);
+
+    operation.notReachable = NO;
+    [[NSNotificationCenter defaultCenter] postNotificationName:MASGatewayMonitorStatusUpdateNotification object:nil];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertTrue(operation.result);
+    XCTAssertTrue(operation.isFinished);
+}
+
+- (void)testFailsAfterMaximumWaitInterval {
+    MASTestGatewayReachabilityOperation *operation = [self startedOperationWithMaximumWaitInterval:0.1];
+    [self heldOperationDependingOn:operation expectation:[self expectationWithDescription:@"released"]];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertFalse(operation.result);
+    XCTAssertNotNil(operation.error);
+}
+
+#pragma mark - Cancellation
+
+- (void)testCancelReleasesHeldOperations {
+    MASTestGatewayReachabilityOperation *operation = [self startedOperationWithMaximumWaitInterval:MASGatewayReachabilityOperationTestWaitInterval];
+    [self heldOperationDependingOn:operation expectation:[self expectationWithDescription:@"released"]];
+
+    [operation cancel];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertFalse(operation.result);
+    XCTAssertTrue(operation.isFinished);
+}
+
+- (void)testCancelledRequestIsNoLongerHeld {
+    MASTestGatewayReachabilityOperation *reachabilityOperation = [self startedOperationWithMaximumWaitInterval:MASGatewayReachabilityOperationTestWaitInterval];
+
+    MASURLSessionManager *sessionManager = [[MASURLSessionManager alloc] initWithConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+    MASURLRequest *request = [MASURLRequest requestWithURL:[NSURL URLWithString:MASGatewayReachabilityOperationTestURL]];
+    request.isPublic = YES;
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"cancellation reported"];
+    MASSessionDataTaskOperation *operation = [sessionManager dataOperationWithRequest:request completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertEqualObjects(error.domain, MASFoundationErrorDomainLocal);
+        XCTAssertEqual(error.code, MASFoundationErrorCodeTaskCancelled);
+        [expectation fulfill];
+    }];
+
+    [reachabilityOperation addPendingOperation];
+    [operation addDependency:reachabilityOperation];
+    [sessionManager.operationQueue addOperation:operation];
+
+    //
+    //  The cancelled request completes while the gateway is still not reachable, and no longer counts as held
+    //
+    [operation cancel];
+
+    XCTAssertEqual(reachabilityOperation.pendingOperationCount, 0);
+    XCTAssertFalse([operation.dependencies containsObject:reachabilityOperation]);
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertTrue(reachabilityOperation.isExecuting);
+    [sessionManager.operationQueue cancelAllOperations];
+}
+
+@end
@@ -0,0 +1,336 @@
+//
+//  MASMQTTBatchPublisherTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "NSData+MASPrivate.h"
+
+static NSUInteger const MASMQTTBatchPublisherTestsMessageCount = 1000;
+static NSUInteger const MASMQTTBatchPublisherTestsPayloadLength = 64;
+
+
+//
+//  Records the batches instead of publishing them over a connection
+//
+@interface MASTestMQTTBatchClient : MASMQTTClient
+
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *publishedBatches;
+@property (nonatomic, strong) NSError *publishError;
+
+- (NSArray<NSDictionary *> *)batches;
+
+@end
+
+
+@implementation MASTestMQTTBatchClient
+
+- (void)publishData:(NSData *)data toTopic:(NSString *)topic withQos:(MQTTQualityOfService)qos retain:(BOOL)retain completion:(MQTTPublishingCompletionBlock)completion {
+    int mid;
+    @synchronized (self) {
+        if (!self.publishedBatches) {
+            self.publishedBatches = [NSMutableArray array];
+        }
+        [self.publishedBatches addObject:@{ @"topic": topic, @"data": data }];
+        mid = (int)self.publishedBatches.count;
+    }
+
+    if (completion) {
+        completion(self.publishError == nil, self.publishError, self.publishError ? 0 : mid);
+    }
+}
+
+- (NSArray<NSDictionary *> *)batches {
+    @synchronized (self) {
+        return [self.publishedBatches copy] ?: @[];
+    }
+}
+
+@end
+
+
+@interface MASMQTTBatchPublisherTests : XCTestCase
+
+@property (nonatomic, strong) MASTestMQTTBatchClient *client;
+@property (nonatomic, strong) MASMQTTBatchPublisher *publisher;
+
+@end
+
+
+@implementation MASMQTTBatchPublisherTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.client = [[MASTestMQTTBatchClient alloc] initWithClientId:[[NSUUID UUID] UUIDString] cleanSession:YES];
+    self.publisher = [[MASMQTTBatchPublisher alloc] initWithClient:self.client qos:AtLeastOnce];
+}
+
+#pragma mark - Helpers
+
+//
+//  Publishes the payloads, fulfilling the expectation once all their completions were invoked
+//
+- (NSArray<NSNumber *> *)publishPayloads:(NSArray<NSData *> *)payloads toTopic:(NSString *)topic expectation:(XCTestExpectation *)expectation {
+    NSMutableArray<NSNumber *> *mids = [NSMutableArray array];
+    for (NSUInteger i = 0; i < payloads.count; i++) {
+        [mids addObject:@(-1)];
+    }
+    expectation.expectedFulfillmentCount = MAX(payloads.count, 1);
+
+    [payloads enumerateObjectsUsingBlock:^(NSData *payload, NSUInteger index, BOOL *stop) {
+        [self.publisher publishData:payload toTopic:topic completion:^(BOOL completed, NSError *error, int mid) {
+            XCTAssertTrue(completed, @"%@", error);
+            @synchronized (mids) {
+                mids[index] = @(mid);
+            }
+            [expectation fulfill];
+        }];
+    }];
+
+    return mids;
+}
+
+- (void)waitForBatchCount:(NSUInteger)count {
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:2];
+    while (self.client.batches.count < count && timeout.timeIntervalSinceNow > 0) {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    XCTAssertEqual(self.client.batches.count, count);
+}
+
+- (NSArray<NSData *> *)payloadsOfBatchAtIndex:(NSUInteger)index {
+    return [MASMQTTBatchPublisher payloadsFromBatchData:self.client.batches[index][@"data"]];
+}
+
+//
+//  Builds a batch the way MASMQTTBatchPublisher does: magic, version, flags and the length prefixed payloads
+//
+- (NSData *)batchWithPayloads:(NSArray<NSData *> *)payloads compressed:(BOOL)compressed {
+    NSMutableData *body = [NSMutableData data];
+    for (NSData *payload in payloads) {
+        UInt32 length = CFSwapInt32HostToBig((UInt32)payload.length);
+        [body appendBytes:&length length:sizeof(length)];
+        [body appendData:payload];
+    }
+
+    const UInt8 header[6] = { 'M', 'A', 'S', 'B', 1, compressed ? 0x01 : 0x00 };
+    NSMutableData *batch = [NSMutableData dataWithBytes:header length:sizeof(header)];
+    [batch appendData:compressed ? [body gzipCompressedData] : body];
+
+    return batch;
+}
+
+- (NSArray<NSData *> *)payloadsWithCount:(NSUInteger)count length:(NSUInteger)length {
+    NSMutableArray *payloads = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSMutableData *payload = [NSMutableData dataWithLength:length];
+        snprintf(payload.mutableBytes, length, "{\"sensor\":%lu,\"value\":%lu}", (unsigned long)i, (unsigned long)(i * 31 % 97));
+        [payloads addObject:payload];
+    }
+
+    return payloads;
+}
+
+#pragma mark - Batching
+
+- (void)testMessagesAreBatchedUntilMaxDelay {
+    self.publisher.maxDelay = 0.2;
+    NSArray<NSData *> *payloads = [self payloadsWithCount:3 length:MASMQTTBatchPublisherTestsPayloadLength];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    NSArray<NSNumber *> *mids = [self publishPayloads:payloads toTopic:@"sensors" expectation:expectation];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+
+    //
+    //  One PUBLISH carries all messages, whose completions report its message id
+    //
+    XCTAssertEqual(self.client.batches.count, 1);
+    XCTAssertEqualObjects(self.client.batches[0][@"topic"], @"sensors");
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:0], payloads);
+    XCTAssertEqualObjects(mids, (@[@1, @1, @1]));
+}
+
+- (void)testBatchIsPublishedAtMaxMessageCount {
+    self.publisher.maxDelay = 60;
+    self.publisher.maxMessageCount = 2;
+    NSArray<NSData *> *payloads = [self payloadsWithCount:5 length:MASMQTTBatchPublisherTestsPayloadLength];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    NSArray<NSNumber *> *mids = [self publishPayloads:payloads toTopic:@"sensors" expectation:expectation];
+
+    [self waitForBatchCount:2];
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:0], [payloads subarrayWithRange:NSMakeRange(0, 2)]);
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:1], [payloads subarrayWithRange:NSMakeRange(2, 2)]);
+
+    //
+    //  The last message waits for maxDelay, or a flush
+    //
+    [self.publisher flush];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+
+    XCTAssertEqual(self.client.batches.count, 3);
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:2], @[payloads[4]]);
+    XCTAssertEqualObjects(mids, (@[@1, @1, @2, @2, @3]));
+}
+
+- (void)testBatchIsPublishedAtMaxBatchSize {
+    self.publisher.maxDelay = 60;
+
+    //
+    //  Two messages of 10 bytes and their length prefixes fit, a third one would overflow the batch
+    //
+    self.publisher.maxBatchSize = 30;
+    NSArray<NSData *> *payloads = [self payloadsWithCount:3 length:10];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    NSArray<NSNumber *> *mids = [self publishPayloads:payloads toTopic:@"sensors" expectation:expectation];
+
+    [self waitForBatchCount:1];
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:0], [payloads subarrayWithRange:NSMakeRange(0, 2)]);
+
+    [self.publisher flush];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:1], @[payloads[2]]);
+    XCTAssertEqualObjects(mids, (@[@1, @1, @2]));
+}
+
+- (void)testFlushPublishesEveryTopic {
+    self.publisher.maxDelay = 60;
+    NSArray<NSData *> *payloads = [self payloadsWithCount:2 length:MASMQTTBatchPublisherTestsPayloadLength];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    expectation.expectedFulfillmentCount = 2;
+    [self.publisher publishData:payloads[0] toTopic:@"sensors/1" completion:^(BOOL completed, NSError *error, int mid) {
+        [expectation fulfill];
+    }];
+    [self.publisher publishData:payloads[1] toTopic:@"sensors/2" completion:^(BOOL completed, NSError *error, int mid) {
+        [expectation fulfill];
+    }];
+    [self.publisher flush];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+
+    NSSet *topics = [NSSet setWithArray:[self.client.batches valueForKey:@"topic"]];
+    XCTAssertEqualObjects(topics, ([NSSet setWithObjects:@"sensors/1", @"sensors/2", nil]));
+}
+
+- (void)testCompressedBatch {
+    self.publisher.compressionEnabled = YES;
+    self.publisher.maxDelay = 60;
+    NSArray<NSData *> *payloads = [self payloadsWithCount:50 length:MASMQTTBatchPublisherTestsPayloadLength];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    [self publishPayloads:payloads toTopic:@"sensors" expectation:expectation];
+    [self.publisher flush];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+
+    const UInt8 *header = [self.client.batches[0][@"data"] bytes];
+    XCTAssertEqual(header[5] & 0x01, 0x01);
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:0], payloads);
+}
+
+#pragma mark - Completions
+
+- (void)testCompletionsReportPublishFailure {
+    self.client.publishError = [NSError errorWithDomain:@"MASMQTTBatchPublisherTests" code:1 userInfo:nil];
+    self.publisher.maxDelay = 60;
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    expectation.expectedFulfillmentCount = 2;
+    for (NSData *payload in [self payloadsWithCount:2 length:MASMQTTBatchPublisherTestsPayloadLength]) {
+        [self.publisher publishData:payload toTopic:@"sensors" completion:^(BOOL completed, NSError *error, int mid) {
+            XCTAssertFalse(completed);
+            XCTAssertEqualObjects(error, self.client.publishError);
+            [expectation fulfill];
+        }];
+    }
+    [self.publisher flush];
+
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+}
+
+- (void)testInvalidParametersCompleteRightAway {
+    __block BOOL completed = YES;
+    [self.publisher publishData:[NSData data] toTopic:@"" completion:^(BOOL publishCompleted, NSError *error, int mid) {
+        completed = publishCompleted;
+    }];
+
+    XCTAssertFalse(completed);
+}
+
+- (void)testBufferedMessagesArePublishedOnDealloc {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    NSArray<NSData *> *payloads = [self payloadsWithCount:2 length:MASMQTTBatchPublisherTestsPayloadLength];
+
+    @autoreleasepool {
+        self.publisher.maxDelay = 60;
+        [self publishPayloads:payloads toTopic:@"sensors" expectation:expectation];
+        self.publisher = nil;
+    }
+
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    XCTAssertEqualObjects([self payloadsOfBatchAtIndex:0], payloads);
+}
+
+#pragma mark - Decompression limit
+
+- (void)testDecompressionStopsAtMaximumLength {
+    NSData *data = [NSMutableData dataWithLength:4 * 1024 * 1024];
+    NSData *compressed = [data gzipCompressedData];
+
+    XCTAssertLessThan(compressed.length, 64 * 1024, @"zeros compress well");
+    XCTAssertNil([compressed gzipDecompressedDataWithMaximumLength:data.length - 1]);
+    XCTAssertEqualObjects([compressed gzipDecompressedDataWithMaximumLength:data.length], data);
+}
+
+- (void)testCompressedBatchBeyondMaximumLengthIsRejected {
+    NSArray<NSData *> *payloads = @[[NSMutableData dataWithLength:MASMQTTBatchDefaultMaxBatchLength]];
+    NSData *batch = [self batchWithPayloads:payloads compressed:YES];
+
+    XCTAssertNil([MASMQTTBatchPublisher payloadsFromBatchData:batch], @"the body and its length prefix exceed the default limit");
+    XCTAssertEqualObjects([MASMQTTBatchPublisher payloadsFromBatchData:batch maxBatchLength:2 * MASMQTTBatchDefaultMaxBatchLength], payloads);
+}
+
+- (void)testBatchRoundTrip {
+    NSArray<NSData *> *payloads = [self payloadsWithCount:10 length:MASMQTTBatchPublisherTestsPayloadLength];
+
+    XCTAssertEqualObjects([MASMQTTBatchPublisher payloadsFromBatchData:[self batchWithPayloads:payloads compressed:NO]], payloads);
+    XCTAssertEqualObjects([MASMQTTBatchPublisher payloadsFromBatchData:[self batchWithPayloads:payloads compressed:YES]], payloads);
+}
+
+#pragma mark - Benchmark
+
+- (void)testCompressedBatchSplittingPerformance {
+    NSArray<NSData *> *payloads = [self payloadsWithCount:MASMQTTBatchPublisherTestsMessageCount length:MASMQTTBatchPublisherTestsPayloadLength];
+    NSData *batch = [self batchWithPayloads:payloads compressed:YES];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 100; i++) {
+            XCTAssertEqual([MASMQTTBatchPublisher payloadsFromBatchData:batch].count, MASMQTTBatchPublisherTestsMessageCount);
+        }
+    }];
+}
+
+- (void)testOversizedBatchRejectionPerformance {
+    //
+    //  A few kilobytes which would inflate to 64 MB are rejected after decompressing the first megabyte
+    //
+    NSData *batch = [self batchWithPayloads:@[[NSMutableData dataWithLength:64 * 1024 * 1024]] compressed:YES];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 10; i++) {
+            XCTAssertNil([MASMQTTBatchPublisher payloadsFromBatchData:batch]);
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,192 @@
+//
+//  MASMQTTClientTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASMQTTKeepAliveTuner.h"
+#import "MQTTSession.h"
+#import "MQTTTestTransport.h"
+
+static NSString * const MASMQTTClientTestsTopic = @"mas/tests";
+
+
+//
+//  The session delegate methods the client observes traffic through
+//
+@interface MASMQTTClient (MASMQTTClientTests)
+
+- (void)sending:(MQTTSession *)session type:(MQTTCommandType)type qos:(MQTTQosLevel)qos retained:(BOOL)retained duped:(BOOL)duped mid:(UInt16)mid data:(NSData *)data;
+- (void)received:(MQTTSession *)session type:(MQTTCommandType)type qos:(MQTTQosLevel)qos retained:(BOOL)retained duped:(BOOL)duped mid:(UInt16)mid data:(NSData *)data;
+
+@end
+
+
+@interface MASMQTTClientTests : XCTestCase
+
+@property (nonatomic, strong) MASMQTTClient *client;
+@property (nonatomic, strong) MQTTSession *session;
+@property (nonatomic, strong) dispatch_queue_t queue;
+
+@end
+
+
+@implementation MASMQTTClientTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.client = [[MASMQTTClient alloc] initWithClientId:[[NSUUID UUID] UUIDString] cleanSession:YES];
+    self.session = [self.client valueForKey:@"currentSession"];
+    self.queue = [self.client valueForKey:@"queue"];
+}
+
+- (void)tearDown {
+    dispatch_sync(self.queue, ^{
+        [self.session closeWithDisconnectHandler:nil];
+    });
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+//
+//  Connects the client's session through an in-memory transport instead of a socket
+//
+- (MQTTTestTransport *)connect {
+    MQTTTestTransport *transport = [[MQTTTestTransport alloc] init];
+    transport.queue = self.queue;
+    transport.connack = [MQTTTestTransport connack];
+    self.session.transport = transport;
+
+    [self.session connect];
+    dispatch_sync(self.queue, ^{});
+    dispatch_sync(self.queue, ^{});
+    XCTAssertTrue(self.client.connected);
+
+    return transport;
+}
+
+- (MASMQTTKeepAliveTuner *)enableAdaptiveKeepAlive {
+    MASMQTTKeepAliveTuner *tuner = [[MASMQTTKeepAliveTuner alloc] initWithWiFiInterval:120 cellularInterval:60];
+    tuner.maximumInterval = 1200;
+    tuner.probingEnabled = YES;
+
+    self.client.adaptiveKeepAliveEnabled = YES;
+    [self.client setValue:tuner forKey:@"keepAliveTuner"];
+    self.session.pingInterval = tuner.interval;
+
+    return tuner;
+}
+
+//
+//  A PINGREQ answered by the broker, after the given packets were sent and received since the previous PINGREQ
+//
+- (void)pingAfterSending:(MQTTCommandType)sent receiving:(MQTTCommandType)received {
+    if (sent != MQTT_None) {
+        [self.client sending:self.session type:sent qos:MQTTQosLevelAtLeastOnce retained:NO duped:NO mid:1 data:nil];
+    }
+    if (received != MQTT_None) {
+        [self.client received:self.session type:received qos:MQTTQosLevelAtLeastOnce retained:NO duped:NO mid:1 data:nil];
+    }
+    [self.client sending:self.session type:MQTTPingreq qos:MQTTQosLevelAtMostOnce retained:NO duped:NO mid:0 data:nil];
+    [self.client received:self.session type:MQTTPingresp qos:MQTTQosLevelAtMostOnce retained:NO duped:NO mid:0 data:nil];
+}
+
+- (NSError *)publishAtMostOnceExpectingSuccess:(BOOL)success {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"publish completion"];
+    __block NSError *publishError = nil;
+
+    [self.client publishData:[@"payload" dataUsingEncoding:NSUTF8StringEncoding] toTopic:MASMQTTClientTestsTopic withQos:AtMostOnce retain:NO completion:^(BOOL completed, NSError *error, int mid) {
+        XCTAssertEqual(completed, success);
+        XCTAssertEqual(mid, 0);
+        publishError = error;
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    return publishError;
+}
+
+#pragma mark - Publish
+
+- (void)testAtMostOnceFailsWhileDisconnected {
+    NSError *error = [self publishAtMostOnceExpectingSuccess:NO];
+
+    XCTAssertEqualObjects(error.domain, MQTTSessionErrorDomain);
+    XCTAssertEqual(error.code, MQTTSessionErrorEncoderNotReady);
+}
+
+- (void)testAtMostOnceCompletesOnceSent {
+    MQTTTestTransport *transport = [self connect];
+
+    XCTAssertNil([self publishAtMostOnceExpectingSuccess:YES]);
+
+    NSArray<MQTTMessage *> *publishes = [transport sentMessagesOfType:MQTTPublish protocolLevel:self.session.protocolLevel];
+    XCTAssertEqual(publishes.count, 1);
+    XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publishes[0]], MASMQTTClientTestsTopic);
+}
+
+- (void)testAtMostOnceFailsWhenTransportRefusesIt {
+    MQTTTestTransport *transport = [self connect];
+
+    //
+    //  A connected client used to report success for a message the transport never took
+    //
+    transport.refusesSend = YES;
+    NSError *error = [self publishAtMostOnceExpectingSuccess:NO];
+
+    XCTAssertEqualObjects(error.domain, MQTTSessionErrorDomain);
+    XCTAssertEqual(error.code, MQTTSessionErrorEncoderNotReady);
+    XCTAssertEqual([transport sentMessagesOfType:MQTTPublish protocolLevel:self.session.protocolLevel].count, 0);
+}
+
+#pragma mark - Keep alive
+
+- (void)testOnlyPingsAfterAnIdleIntervalConfirmTheKeepAliveInterval {
+    MASMQTTKeepAliveTuner *tuner = [self enableAdaptiveKeepAlive];
+
+    //
+    //  Any packet since the previous PINGREQ kept the connection alive on its own
+    //
+    for (NSUInteger i = 0; i < 3; i++) {
+        [self pingAfterSending:MQTTPublish receiving:MQTT_None];
+        [self pingAfterSending:MQTT_None receiving:MQTTPublish];
+        [self pingAfterSending:MQTTPuback receiving:MQTTSuback];
+    }
+    XCTAssertEqual(tuner.interval, 120);
+    XCTAssertEqual(self.session.pingInterval, 120);
+
+    //
+    //  Three pings after idle intervals confirm it, and the session then pings at the doubled interval
+    //
+    [self pingAfterSending:MQTT_None receiving:MQTT_None];
+    [self pingAfterSending:MQTT_None receiving:MQTT_None];
+    [self pingAfterSending:MQTTPublish receiving:MQTT_None];
+    XCTAssertEqual(tuner.interval, 120);
+
+    [self pingAfterSending:MQTT_None receiving:MQTT_None];
+    XCTAssertEqual(tuner.interval, 240);
+    XCTAssertEqual(self.session.pingInterval, 240);
+}
+
+- (void)testPingsAreIgnoredWithoutAdaptiveKeepAlive {
+    MASMQTTKeepAliveTuner *tuner = [self enableAdaptiveKeepAlive];
+    self.client.adaptiveKeepAliveEnabled = NO;
+
+    for (NSUInteger i = 0; i < 6; i++) {
+        [self pingAfterSending:MQTT_None receiving:MQTT_None];
+    }
+    XCTAssertEqual(tuner.interval, 120);
+}
+
+@end
@@ -0,0 +1,155 @@
+//
+//  MASMQTTCompletionTableTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASMQTTCompletionTable.h"
+
+static NSUInteger const MASMQTTCompletionTablePublishCount = 100000;
+
+//
+//  Message ids are unique within a batch, the way the session only reuses a message id once it was acknowledged
+//
+static NSUInteger const MASMQTTCompletionTableBatchSize = 10000;
+
+
+@interface MASMQTTCompletionTableTests : XCTestCase
+
+//  The MQTT session's queue, on which acknowledgements are processed and completions invoked
+@property (nonatomic, strong) dispatch_queue_t sessionQueue;
+@property (nonatomic, strong) MASMQTTCompletionTable *table;
+
+@end
+
+
+@implementation MASMQTTCompletionTableTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.sessionQueue = dispatch_queue_create("com.ca.MASFoundationTests.completionTable", DISPATCH_QUEUE_SERIAL);
+    self.table = [[MASMQTTCompletionTable alloc] initWithCallbackQueue:self.sessionQueue];
+}
+
+#pragma mark - Early acknowledgements
+
+- (void)testEarlyAcknowledgementCompletesAddedMessage {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completion"];
+
+    [self.table beginPublish];
+    [self.table completeMid:7];
+    [self.table addCompletion:^(BOOL completed, NSError *error, UInt16 mid) {
+        XCTAssertTrue(completed);
+        XCTAssertEqual(mid, 7);
+        [expectation fulfill];
+    } forMid:7];
+
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+}
+
+- (void)testAcknowledgementWithoutPublishInProgressIsIgnored {
+    __block NSUInteger completions = 0;
+
+    //
+    //  A duplicate acknowledgement must not complete the next message with the same id
+    //
+    [self.table completeMid:7];
+    [self.table beginPublish];
+    [self.table addCompletion:^(BOOL completed, NSError *error, UInt16 mid) {
+        XCTAssertTrue(completed);
+        completions++;
+    } forMid:7];
+
+    dispatch_sync(self.sessionQueue, ^{});
+    XCTAssertEqual(completions, 0);
+
+    [self.table completeMid:7];
+    XCTAssertEqual(completions, 1);
+}
+
+- (void)testEarlyAcknowledgementExpires {
+    __block NSUInteger completions = 0;
+    self.table.earlyAcknowledgementTimeout = 0.1;
+
+    [self.table beginPublish];
+    [self.table completeMid:7];
+    [self.table endPublish];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"expired"];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.5 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+
+    [self.table beginPublish];
+    [self.table addCompletion:^(BOOL completed, NSError *error, UInt16 mid) {
+        completions++;
+    } forMid:7];
+
+    dispatch_sync(self.sessionQueue, ^{});
+    XCTAssertEqual(completions, 0);
+
+    [self.table failAllWithError:[NSError errorWithDomain:@"MASMQTTCompletionTableTests" code:0 userInfo:nil]];
+    XCTAssertEqual(completions, 1);
+}
+
+#pragma mark - Stress
+
+- (void)testConcurrentPublishStress {
+    NSMutableData *acknowledgedData = [NSMutableData dataWithLength:(UINT16_MAX + 1) * sizeof(BOOL)];
+    BOOL *acknowledged = acknowledgedData.mutableBytes;
+    __block NSUInteger completions = 0;
+    __block NSUInteger failures = 0;
+
+    [self measureBlock:^{
+        completions = 0;
+        failures = 0;
+
+        for (NSUInteger batch = 0; batch < MASMQTTCompletionTablePublishCount / MASMQTTCompletionTableBatchSize; batch++) {
+            memset(acknowledged, 0, acknowledgedData.length);
+
+            //
+            //  Publishers on many threads race the acknowledgements processed on the session's queue
+            //
+            dispatch_apply(MASMQTTCompletionTableBatchSize, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+                UInt16 mid = (UInt16)(i + 1);
+
+                [self.table beginPublish];
+                dispatch_async(self.sessionQueue, ^{
+                    acknowledged[mid] = YES;
+                    [self.table completeMid:mid];
+                });
+                [self.table addCompletion:^(BOOL completed, NSError *error, UInt16 completedMid) {
+                    if (!completed || !acknowledged[completedMid]) {
+                        failures++;
+                    }
+                    completions++;
+                } forMid:mid];
+            });
+
+            //
+            //  Duplicate acknowledgements arrive with no publish in progress
+            //
+            dispatch_sync(self.sessionQueue, ^{
+                for (UInt16 mid = 1; mid <= MASMQTTCompletionTableBatchSize; mid++) {
+                    [self.table completeMid:mid];
+                }
+            });
+        }
+
+        dispatch_sync(self.sessionQueue, ^{});
+        XCTAssertEqual(completions, MASMQTTCompletionTablePublishCount);
+        XCTAssertEqual(failures, 0);
+    }];
+}
+
+@end
@@ -0,0 +1,177 @@
+//
+//  MASMQTTForegroundReconnectionTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASMQTTForegroundReconnection.h"
+
+#if TARGET_OS_IPHONE == 1
+
+#import <UIKit/UIKit.h>
+
+static UIBackgroundTaskIdentifier const MASMQTTForegroundReconnectionTestsTask = 42;
+
+
+//
+//  Counts disconnects and reconnects instead of talking to a broker
+//
+@interface MASTestMQTTForegroundClient : MASMQTTClient
+
+@property (nonatomic, assign) BOOL testConnected;
+@property (nonatomic, assign) NSUInteger disconnectCount;
+@property (nonatomic, assign) NSUInteger reconnectCount;
+
+@end
+
+
+@implementation MASTestMQTTForegroundClient
+
+- (BOOL)connected {
+    return self.testConnected;
+}
+
+- (void)disconnectWithCompletionHandler:(MQTTDisconnectionHandler)completionHandler {
+    self.disconnectCount++;
+    self.testConnected = NO;
+}
+
+- (void)reconnect {
+    self.reconnectCount++;
+}
+
+@end
+
+
+//
+//  Keeps the background task to itself, so that tests can expire it
+//
+@interface MASTestMQTTForegroundReconnection : MASMQTTForegroundReconnection
+
+@property (nonatomic, copy) void (^expirationHandler)(void);
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *endedTasks;
+
+@end
+
+
+@implementation MASTestMQTTForegroundReconnection
+
+- (UIBackgroundTaskIdentifier)beginBackgroundTaskWithExpirationHandler:(void (^)(void))handler {
+    self.expirationHandler = handler;
+    return MASMQTTForegroundReconnectionTestsTask;
+}
+
+- (void)endBackgroundTaskWithIdentifier:(UIBackgroundTaskIdentifier)identifier {
+    if (!self.endedTasks) {
+        self.endedTasks = [NSMutableArray array];
+    }
+    [self.endedTasks addObject:@(identifier)];
+}
+
+@end
+
+
+//
+//  The application lifecycle observers, invoked directly rather than through notifications
+//
+@interface MASMQTTForegroundReconnection (MASMQTTForegroundReconnectionTests)
+
+- (void)appWillResignActive;
+- (void)appDidEnterBackground;
+- (void)appDidBecomeActive;
+
+@end
+
+
+@interface MASMQTTForegroundReconnectionTests : XCTestCase
+
+@end
+
+
+@implementation MASMQTTForegroundReconnectionTests
+
+#pragma mark - Helpers
+
+- (MASTestMQTTForegroundClient *)connectedClientWithCleanSession:(BOOL)cleanSession {
+    MASTestMQTTForegroundClient *client = [[MASTestMQTTForegroundClient alloc] initWithClientId:[[NSUUID UUID] UUIDString] cleanSession:cleanSession];
+    client.testConnected = YES;
+    return client;
+}
+
+#pragma mark - Background task expiry
+
+- (void)testExpiryDisconnectsPersistentSession {
+    MASTestMQTTForegroundClient *client = [self connectedClientWithCleanSession:NO];
+    MASTestMQTTForegroundReconnection *reconnection = [[MASTestMQTTForegroundReconnection alloc] initWithMQTTClient:client];
+
+    //
+    //  A persistent session stays connected while the background task runs
+    //
+    [reconnection appWillResignActive];
+    [reconnection appDidEnterBackground];
+    XCTAssertEqual(client.disconnectCount, 0);
+    XCTAssertNotNil(reconnection.expirationHandler);
+
+    reconnection.expirationHandler();
+    XCTAssertEqual(client.disconnectCount, 1);
+    XCTAssertEqualObjects(reconnection.endedTasks, @[@(MASMQTTForegroundReconnectionTestsTask)]);
+
+    //
+    //  Becoming active again reconnects, without ending the expired task a second time
+    //
+    [reconnection appDidBecomeActive];
+    XCTAssertEqual(client.reconnectCount, 1);
+    XCTAssertEqual(reconnection.endedTasks.count, 1);
+}
+
+- (void)testCleanSessionDisconnectsOnResignActiveOnly {
+    MASTestMQTTForegroundClient *client = [self connectedClientWithCleanSession:YES];
+    MASTestMQTTForegroundReconnection *reconnection = [[MASTestMQTTForegroundReconnection alloc] initWithMQTTClient:client];
+
+    [reconnection appWillResignActive];
+    XCTAssertEqual(client.disconnectCount, 1);
+
+    //
+    //  Already disconnected, so no background task is needed
+    //
+    [reconnection appDidEnterBackground];
+    XCTAssertNil(reconnection.expirationHandler);
+}
+
+- (void)testExpiryOfConnectedCleanSessionOnlyEndsTheTask {
+    MASTestMQTTForegroundClient *client = [self connectedClientWithCleanSession:YES];
+    MASTestMQTTForegroundReconnection *reconnection = [[MASTestMQTTForegroundReconnection alloc] initWithMQTTClient:client];
+
+    //
+    //  A clean session connected again while resigning, e.g. by a reconnect timer
+    //
+    [reconnection appDidEnterBackground];
+    reconnection.expirationHandler();
+
+    XCTAssertEqual(client.disconnectCount, 0);
+    XCTAssertEqualObjects(reconnection.endedTasks, @[@(MASMQTTForegroundReconnectionTestsTask)]);
+}
+
+- (void)testBecomingActiveEndsTheBackgroundTask {
+    MASTestMQTTForegroundClient *client = [self connectedClientWithCleanSession:NO];
+    MASTestMQTTForegroundReconnection *reconnection = [[MASTestMQTTForegroundReconnection alloc] initWithMQTTClient:client];
+
+    [reconnection appDidEnterBackground];
+    [reconnection appDidBecomeActive];
+
+    XCTAssertEqualObjects(reconnection.endedTasks, @[@(MASMQTTForegroundReconnectionTestsTask)]);
+    XCTAssertEqual(client.reconnectCount, 1);
+    XCTAssertEqual(client.disconnectCount, 0);
+}
+
+@end
+
+#endif
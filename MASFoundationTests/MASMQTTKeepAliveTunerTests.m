@@ -0,0 +1,172 @@
+//
+//  MASMQTTKeepAliveTunerTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASMQTTKeepAliveTuner.h"
+
+static NSTimeInterval const MASMQTTKeepAliveTunerTestsWiFiInterval = 120;
+static NSTimeInterval const MASMQTTKeepAliveTunerTestsCellularInterval = 60;
+static NSTimeInterval const MASMQTTKeepAliveTunerTestsMaximumInterval = 1200;
+
+//
+//  Consecutive answered pings after which the tuner considers an interval safe
+//
+static NSUInteger const MASMQTTKeepAliveTunerTestsConfirmations = 3;
+
+
+@interface MASMQTTKeepAliveTunerTests : XCTestCase
+
+@property (nonatomic, strong) MASMQTTKeepAliveTuner *tuner;
+
+@end
+
+
+@implementation MASMQTTKeepAliveTunerTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.tuner = [[MASMQTTKeepAliveTuner alloc] initWithWiFiInterval:MASMQTTKeepAliveTunerTestsWiFiInterval
+                                                    cellularInterval:MASMQTTKeepAliveTunerTestsCellularInterval];
+    self.tuner.maximumInterval = MASMQTTKeepAliveTunerTestsMaximumInterval;
+    self.tuner.probingEnabled = YES;
+}
+
+#pragma mark - Helpers
+
+//
+//  Answers pings at the current interval until it is confirmed, returning whether the interval changed
+//
+- (BOOL)confirmInterval {
+    for (NSUInteger i = 1; i < MASMQTTKeepAliveTunerTestsConfirmations; i++) {
+        XCTAssertFalse([self.tuner pingSucceeded]);
+    }
+    return [self.tuner pingSucceeded];
+}
+
+#pragma mark - Doubling
+
+- (void)testIntervalDoublesUntilTheMaximum {
+    XCTAssertEqual(self.tuner.interval, 120);
+
+    NSArray<NSNumber *> *intervals = @[@240, @480, @960, @1200];
+    for (NSNumber *interval in intervals) {
+        XCTAssertTrue([self confirmInterval]);
+        XCTAssertEqual(self.tuner.interval, interval.doubleValue);
+    }
+
+    XCTAssertFalse([self confirmInterval], @"probing stops at the maximum");
+    XCTAssertEqual(self.tuner.interval, 1200);
+}
+
+- (void)testLossResetsConfirmations {
+    XCTAssertFalse([self.tuner pingSucceeded]);
+    XCTAssertFalse([self.tuner pingSucceeded]);
+    XCTAssertFalse([self.tuner connectionLost]);
+
+    XCTAssertTrue([self confirmInterval], @"three pings after the loss are needed again");
+    XCTAssertEqual(self.tuner.interval, 240);
+}
+
+#pragma mark - Bisection
+
+- (void)testFailedProbeIsBisected {
+    XCTAssertTrue([self confirmInterval]);
+    XCTAssertTrue([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 480);
+
+    //
+    //  480 seconds is too long; fall back to 240 and bisect towards it
+    //
+    XCTAssertTrue([self.tuner connectionLost]);
+    XCTAssertEqual(self.tuner.interval, 240);
+
+    XCTAssertTrue([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 360);
+    XCTAssertTrue([self.tuner connectionLost]);
+    XCTAssertEqual(self.tuner.interval, 240);
+
+    XCTAssertTrue([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 300);
+    XCTAssertTrue([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 330);
+
+    //
+    //  The next probe would be 345 seconds, closer than the resolution to the failed 360
+    //
+    XCTAssertFalse([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 330);
+}
+
+- (void)testRepeatedLossAtTheSafeIntervalHalvesIt {
+    XCTAssertFalse([self.tuner connectionLost]);
+    XCTAssertTrue([self.tuner connectionLost]);
+    XCTAssertEqual(self.tuner.interval, 60);
+
+    XCTAssertFalse([self.tuner connectionLost]);
+    XCTAssertTrue([self.tuner connectionLost]);
+    XCTAssertEqual(self.tuner.interval, 30);
+
+    //
+    //  The interval never drops below 30 seconds, and is not probed again closer than the resolution to the one which failed
+    //
+    XCTAssertFalse([self.tuner connectionLost]);
+    XCTAssertFalse([self.tuner connectionLost]);
+    XCTAssertEqual(self.tuner.interval, 30);
+
+    XCTAssertFalse([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 30);
+}
+
+#pragma mark - Probing
+
+- (void)testIntervalIsOnlyRaisedWhileProbing {
+    self.tuner.probingEnabled = NO;
+    XCTAssertFalse([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 120);
+
+    //
+    //  The interval is already confirmed, so the next answered ping probes a longer one
+    //
+    self.tuner.probingEnabled = YES;
+    XCTAssertTrue([self.tuner pingSucceeded]);
+    XCTAssertEqual(self.tuner.interval, 240);
+
+    //
+    //  Disabling probing abandons the unconfirmed interval
+    //
+    self.tuner.probingEnabled = NO;
+    XCTAssertEqual(self.tuner.interval, 120);
+}
+
+- (void)testNetworksAreTunedIndependently {
+    XCTAssertTrue([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 240);
+
+    self.tuner.network = MASMQTTKeepAliveNetworkCellular;
+    XCTAssertEqual(self.tuner.interval, 60);
+    XCTAssertTrue([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 120);
+
+    self.tuner.network = MASMQTTKeepAliveNetworkWiFi;
+    XCTAssertEqual(self.tuner.interval, 240);
+}
+
+- (void)testMaximumIntervalCapsTheInterval {
+    self.tuner.maximumInterval = 100;
+    XCTAssertEqual(self.tuner.interval, 100);
+    XCTAssertFalse([self confirmInterval]);
+    XCTAssertEqual(self.tuner.interval, 100);
+}
+
+@end
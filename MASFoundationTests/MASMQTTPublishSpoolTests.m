@@ -0,0 +1,347 @@
+//
+//  MASMQTTPublishSpoolTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASMQTTPublishSpool.h"
+#import "MQTTSession.h"
+
+static NSString * const MASMQTTPublishSpoolTestsTopic = @"spool/topic";
+
+//
+//  Every test payload has the same length, so maxBytes can be given as a number of messages
+//
+static NSUInteger const MASMQTTPublishSpoolTestsPayloadLength = 16;
+
+
+//
+//  The session delegate methods the client receives acknowledgements and disconnects through
+//
+@interface MASMQTTClient (MASMQTTPublishSpoolTests)
+
+- (void)messageDelivered:(MQTTSession *)session
+                   msgID:(UInt16)msgID
+                   topic:(NSString *)topic
+                    data:(NSData *)data
+                     qos:(MQTTQosLevel)qos
+              retainFlag:(BOOL)retainFlag;
+- (void)connectionClosed:(MQTTSession *)session;
+
+@end
+
+
+@interface MASMQTTPublishSpoolTests : XCTestCase
+
+@property (nonatomic, copy) NSString *directory;
+@property (nonatomic, strong) NSMutableArray *outcomes;
+
+@end
+
+
+@implementation MASMQTTPublishSpoolTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.outcomes = [NSMutableArray array];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (MASMQTTPublishSpool *)spool {
+    MASMQTTPublishSpool *spool = [[MASMQTTPublishSpool alloc] initWithDirectory:self.directory];
+    spool.outcomeHandler = ^(MASMQTTSpooledMessage *message, BOOL delivered, NSError *error) {
+        [self.outcomes addObject:@{ @"payload": message.payload, @"delivered": @(delivered), @"code": @(error.code) }];
+    };
+    return spool;
+}
+
+- (NSData *)payloadWithIndex:(NSUInteger)index {
+    NSString *payload = [NSString stringWithFormat:@"%0*lu", (int)MASMQTTPublishSpoolTestsPayloadLength, (unsigned long)index];
+    return [payload dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (NSUInteger)messageLength {
+    return MASMQTTPublishSpoolTestsPayloadLength + MASMQTTPublishSpoolTestsTopic.length;
+}
+
+- (void)spool:(MASMQTTPublishSpool *)spool count:(NSUInteger)count from:(NSUInteger)first {
+    for (NSUInteger i = first; i < first + count; i++) {
+        [spool spoolData:[self payloadWithIndex:i] toTopic:MASMQTTPublishSpoolTestsTopic withQos:AtLeastOnce retain:NO completion:nil];
+    }
+}
+
+//
+//  Drains the spool, giving published messages the ids firstMid, firstMid + 1, ..., and returns their payloads
+//
+- (NSArray<NSData *> *)drain:(MASMQTTPublishSpool *)spool window:(NSUInteger)window firstMid:(UInt16)firstMid {
+    NSMutableArray *payloads = [NSMutableArray array];
+    [spool drainWithWindow:window publisher:^UInt16(MASMQTTSpooledMessage *message) {
+        [payloads addObject:message.payload];
+        return (UInt16)(firstMid + payloads.count - 1);
+    }];
+    return payloads;
+}
+
+- (NSArray<NSData *> *)payloadsFrom:(NSUInteger)first count:(NSUInteger)count {
+    NSMutableArray *payloads = [NSMutableArray array];
+    for (NSUInteger i = first; i < first + count; i++) {
+        [payloads addObject:[self payloadWithIndex:i]];
+    }
+    return payloads;
+}
+
+- (NSUInteger)spoolFileCount {
+    return [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory error:nil].count;
+}
+
+#pragma mark - Order
+
+- (void)testMessagesAreDrainedInOrderWithinTheWindow {
+    MASMQTTPublishSpool *spool = [self spool];
+    [self spool:spool count:5 from:1];
+    XCTAssertTrue(spool.hasPendingMessages);
+
+    XCTAssertEqualObjects([self drain:spool window:2 firstMid:1], [self payloadsFrom:1 count:2]);
+    XCTAssertEqualObjects([self drain:spool window:2 firstMid:3], @[], @"the window is full until a message is acknowledged");
+
+    XCTAssertTrue([spool completeMessageWithMid:1]);
+    XCTAssertFalse([spool completeMessageWithMid:1]);
+    XCTAssertEqualObjects([self drain:spool window:2 firstMid:3], [self payloadsFrom:3 count:1]);
+
+    XCTAssertTrue([spool completeMessageWithMid:2]);
+    XCTAssertTrue([spool completeMessageWithMid:3]);
+    XCTAssertEqualObjects([self drain:spool window:2 firstMid:4], [self payloadsFrom:4 count:2]);
+    XCTAssertFalse(spool.hasPendingMessages);
+
+    XCTAssertEqual(self.outcomes.count, 3);
+    XCTAssertEqualObjects(self.outcomes[0][@"payload"], [self payloadWithIndex:1]);
+    XCTAssertEqualObjects(self.outcomes[0][@"delivered"], @YES);
+}
+
+- (void)testMessageRefusedByThePublisherIsRetried {
+    MASMQTTPublishSpool *spool = [self spool];
+    [self spool:spool count:2 from:1];
+
+    [spool drainWithWindow:10 publisher:^UInt16(MASMQTTSpooledMessage *message) {
+        return 0;
+    }];
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:1], [self payloadsFrom:1 count:2]);
+}
+
+- (void)testCompletionReportsDeliveryWithMessageId {
+    MASMQTTPublishSpool *spool = [self spool];
+    __block BOOL reportedDelivered = NO;
+    __block int reportedMid = 0;
+
+    [spool spoolData:[self payloadWithIndex:1] toTopic:MASMQTTPublishSpoolTestsTopic withQos:ExactlyOnce retain:YES completion:^(BOOL completed, NSError *error, int mid) {
+        reportedDelivered = completed;
+        reportedMid = mid;
+    }];
+    [spool drainWithWindow:1 publisher:^UInt16(MASMQTTSpooledMessage *message) {
+        XCTAssertEqual(message.qos, ExactlyOnce);
+        XCTAssertTrue(message.retained);
+        XCTAssertEqualObjects(message.topic, MASMQTTPublishSpoolTestsTopic);
+        return 42;
+    }];
+    XCTAssertEqual(reportedMid, 0);
+
+    XCTAssertTrue([spool completeMessageWithMid:42]);
+    XCTAssertTrue(reportedDelivered);
+    XCTAssertEqual(reportedMid, 42);
+    XCTAssertEqual([self spoolFileCount], 0);
+}
+
+#pragma mark - Persistence
+
+- (void)testPendingMessagesSurviveRelaunch {
+    MASMQTTPublishSpool *spool = [self spool];
+    [self spool:spool count:4 from:1];
+    [self drain:spool window:1 firstMid:1];
+    XCTAssertTrue([spool completeMessageWithMid:1]);
+    spool = nil;
+
+    //
+    //  Messages spooled after the relaunch follow the ones loaded from disk
+    //
+    MASMQTTPublishSpool *relaunchedSpool = [self spool];
+    XCTAssertTrue(relaunchedSpool.hasPendingMessages);
+    [self spool:relaunchedSpool count:1 from:5];
+    XCTAssertEqualObjects([self drain:relaunchedSpool window:10 firstMid:1], [self payloadsFrom:2 count:4]);
+}
+
+- (void)testIncompleteFileIsDiscardedOnLoad {
+    MASMQTTPublishSpool *spool = [self spool];
+    [self spool:spool count:2 from:1];
+    spool = nil;
+
+    NSString *fileName = [[[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory error:nil] sortedArrayUsingSelector:@selector(compare:)].firstObject;
+    [[NSData dataWithBytes:"bplist" length:6] writeToFile:[self.directory stringByAppendingPathComponent:fileName] atomically:YES];
+
+    XCTAssertEqualObjects([self drain:[self spool] window:10 firstMid:1], [self payloadsFrom:2 count:1]);
+    XCTAssertEqual([self spoolFileCount], 1);
+}
+
+#pragma mark - Eviction
+
+- (void)testOldestPendingMessagesAreDroppedWhenFull {
+    MASMQTTPublishSpool *spool = [self spool];
+    spool.maxBytes = 3 * [self messageLength];
+
+    //
+    //  The message in flight is kept, only pending ones make room
+    //
+    [self spool:spool count:1 from:1];
+    [self drain:spool window:1 firstMid:1];
+    [self spool:spool count:3 from:2];
+
+    XCTAssertEqual(self.outcomes.count, 1);
+    XCTAssertEqualObjects(self.outcomes[0][@"payload"], [self payloadWithIndex:2]);
+    XCTAssertEqualObjects(self.outcomes[0][@"delivered"], @NO);
+    XCTAssertEqualObjects(self.outcomes[0][@"code"], @911003);
+
+    XCTAssertTrue([spool completeMessageWithMid:1]);
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:2], [self payloadsFrom:3 count:2]);
+    XCTAssertEqual([self spoolFileCount], 2);
+}
+
+- (void)testMessageLargerThanTheSpoolIsRefused {
+    MASMQTTPublishSpool *spool = [self spool];
+    spool.maxBytes = [self messageLength] - 1;
+    __block NSError *reportedError = nil;
+
+    XCTAssertFalse([spool spoolData:[self payloadWithIndex:1] toTopic:MASMQTTPublishSpoolTestsTopic withQos:AtLeastOnce retain:NO completion:^(BOOL completed, NSError *error, int mid) {
+        XCTAssertFalse(completed);
+        reportedError = error;
+    }]);
+    XCTAssertEqual(reportedError.code, 911003);
+    XCTAssertFalse(spool.hasPendingMessages);
+    XCTAssertEqual([self spoolFileCount], 0);
+}
+
+- (void)testExpiredMessagesAreDroppedInsteadOfPublished {
+    MASMQTTPublishSpool *spool = [self spool];
+    spool.maxAge = 0.1;
+    [self spool:spool count:2 from:1];
+
+    [NSThread sleepForTimeInterval:0.2];
+    [self spool:spool count:1 from:3];
+
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:1], [self payloadsFrom:3 count:1]);
+    XCTAssertEqual(self.outcomes.count, 2);
+    for (NSDictionary *outcome in self.outcomes) {
+        XCTAssertEqualObjects(outcome[@"delivered"], @NO);
+        XCTAssertEqualObjects(outcome[@"code"], @911004, @"expiry is not reported as a full spool");
+    }
+
+    //
+    //  Messages in flight are not expired, the broker already has them
+    //
+    [NSThread sleepForTimeInterval:0.2];
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:2], @[]);
+    XCTAssertTrue([spool completeMessageWithMid:1]);
+    XCTAssertEqualObjects(self.outcomes.lastObject[@"delivered"], @YES);
+}
+
+- (void)testExpiryIsReportedWhenDraining {
+    MASMQTTPublishSpool *spool = [self spool];
+    spool.maxAge = 0.1;
+    [self spool:spool count:1 from:1];
+
+    [NSThread sleepForTimeInterval:0.2];
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:1], @[]);
+    XCTAssertEqual(self.outcomes.count, 1);
+    XCTAssertEqualObjects(self.outcomes[0][@"code"], @911004);
+    XCTAssertEqual([self spoolFileCount], 0);
+}
+
+#pragma mark - Requeue
+
+- (void)testInflightMessagesAreRequeuedInOrder {
+    MASMQTTPublishSpool *spool = [self spool];
+    [self spool:spool count:4 from:1];
+    [self drain:spool window:2 firstMid:1];
+
+    //
+    //  A clean session reconnect forgets messages 1 and 2, they go out again ahead of 3 and 4
+    //
+    [spool requeueInflightMessages];
+    XCTAssertFalse([spool completeMessageWithMid:1]);
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:10], [self payloadsFrom:1 count:4]);
+    XCTAssertEqual(self.outcomes.count, 0);
+    XCTAssertEqual([self spoolFileCount], 4);
+}
+
+#pragma mark - Client
+
+- (void)testDisablingTheSpoolKeepsInflightCompletionsAndPendingMessages {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    MASMQTTClient *client = [[MASMQTTClient alloc] initWithClientId:clientId cleanSession:YES];
+    client.offlineSpoolEnabled = YES;
+    MASMQTTPublishSpool *spool = [client valueForKey:@"publishSpool"];
+    self.directory = [spool valueForKey:@"directory"];
+
+    __block BOOL delivered = NO;
+    [client publishData:[self payloadWithIndex:1] toTopic:MASMQTTPublishSpoolTestsTopic withQos:AtLeastOnce retain:NO completion:^(BOOL completed, NSError *error, int mid) {
+        delivered = completed;
+    }];
+    [client publishData:[self payloadWithIndex:2] toTopic:MASMQTTPublishSpoolTestsTopic withQos:AtLeastOnce retain:NO completion:nil];
+    XCTAssertEqualObjects([self drain:spool window:1 firstMid:7], [self payloadsFrom:1 count:1]);
+
+    //
+    //  The acknowledgement of the message in flight still completes it while the spool is disabled
+    //
+    client.offlineSpoolEnabled = NO;
+    [client messageDelivered:nil msgID:7 topic:MASMQTTPublishSpoolTestsTopic data:[self payloadWithIndex:1] qos:MQTTQosLevelAtLeastOnce retainFlag:NO];
+    XCTAssertTrue(delivered);
+
+    //
+    //  Enabling it again neither loads the pending message a second time nor the delivered one
+    //
+    client.offlineSpoolEnabled = YES;
+    XCTAssertEqual([client valueForKey:@"publishSpool"], spool);
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:8], [self payloadsFrom:2 count:1]);
+    XCTAssertEqual([self spoolFileCount], 1);
+}
+
+- (void)testCleanSessionCloseRequeuesSpooledMessages {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    MASMQTTClient *client = [[MASMQTTClient alloc] initWithClientId:clientId cleanSession:YES];
+    client.offlineSpoolEnabled = YES;
+    MASMQTTPublishSpool *spool = [client valueForKey:@"publishSpool"];
+    self.directory = [spool valueForKey:@"directory"];
+
+    __block NSUInteger completions = 0;
+    for (NSUInteger i = 1; i <= 2; i++) {
+        [client publishData:[self payloadWithIndex:i] toTopic:MASMQTTPublishSpoolTestsTopic withQos:AtLeastOnce retain:NO completion:^(BOOL completed, NSError *error, int mid) {
+            completions++;
+        }];
+    }
+    [self drain:spool window:10 firstMid:1];
+
+    [client connectionClosed:nil];
+    XCTAssertEqual(completions, 0, @"requeued messages complete once published again");
+    XCTAssertEqualObjects([self drain:spool window:10 firstMid:3], [self payloadsFrom:1 count:2]);
+
+    [client messageDelivered:nil msgID:3 topic:MASMQTTPublishSpoolTestsTopic data:[self payloadWithIndex:1] qos:MQTTQosLevelAtLeastOnce retainFlag:NO];
+    [client messageDelivered:nil msgID:4 topic:MASMQTTPublishSpoolTestsTopic data:[self payloadWithIndex:2] qos:MQTTQosLevelAtLeastOnce retainFlag:NO];
+    XCTAssertEqual(completions, 2);
+}
+
+@end
@@ -0,0 +1,153 @@
+//
+//  MASMQTTTopicRouterTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASMQTTTopicRouter.h"
+
+static NSUInteger const MASMQTTTopicRouterFilterCount = 10000;
+static NSUInteger const MASMQTTTopicRouterMessageCount = 10000;
+
+
+@interface MASMQTTTopicRouterTests : XCTestCase
+
+@property (nonatomic, strong) dispatch_queue_t handlerQueue;
+
+@end
+
+
+@implementation MASMQTTTopicRouterTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.handlerQueue = dispatch_queue_create("com.ca.MASFoundationTests.topicRouter", DISPATCH_QUEUE_SERIAL);
+}
+
+#pragma mark - Helpers
+
+//
+//  One exact filter per device, plus a single-level and a multi-level wildcard filter per hundred devices
+//
+- (MASMQTTTopicRouter *)routerWithFilterCount:(NSUInteger)filterCount {
+    MASMQTTTopicRouter *router = [[MASMQTTTopicRouter alloc] init];
+    void (^handler)(MASMQTTMessage *message) = ^(MASMQTTMessage *message) {};
+
+    for (NSUInteger i = 0; i < filterCount; i++) {
+        NSString *topicFilter;
+        switch (i % 100) {
+            case 0:
+                topicFilter = [NSString stringWithFormat:@"tenants/%lu/devices/+/status", (unsigned long)(i / 100)];
+                break;
+            case 1:
+                topicFilter = [NSString stringWithFormat:@"tenants/%lu/#", (unsigned long)(i / 100)];
+                break;
+            default:
+                topicFilter = [NSString stringWithFormat:@"tenants/%lu/devices/%lu/status", (unsigned long)(i / 100), (unsigned long)i];
+                break;
+        }
+        XCTAssertTrue([router addHandler:handler queue:self.handlerQueue forTopicFilter:topicFilter]);
+    }
+
+    return router;
+}
+
+- (NSArray<MASMQTTMessage *> *)messagesWithCount:(NSUInteger)count filterCount:(NSUInteger)filterCount {
+    NSMutableArray *messages = [NSMutableArray arrayWithCapacity:count];
+    NSData *payload = [@"payload" dataUsingEncoding:NSUTF8StringEncoding];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        NSUInteger device = (i * 7919) % filterCount;
+        NSString *topic = [NSString stringWithFormat:@"tenants/%lu/devices/%lu/status", (unsigned long)(device / 100), (unsigned long)device];
+        [messages addObject:[[MASMQTTMessage alloc] initWithTopic:topic payload:payload qos:AtMostOnce retain:NO mid:0]];
+    }
+
+    return messages;
+}
+
+#pragma mark - Routing
+
+- (void)testRoutesToExactAndWildcardFilters {
+    MASMQTTTopicRouter *router = [self routerWithFilterCount:200];
+    NSData *payload = [NSData data];
+
+    //
+    //  The exact filter of the device and both wildcard filters of its tenant
+    //
+    MASMQTTMessage *message = [[MASMQTTMessage alloc] initWithTopic:@"tenants/1/devices/150/status" payload:payload qos:AtMostOnce retain:NO mid:0];
+    XCTAssertEqual([router routeMessage:message], 3);
+
+    message = [[MASMQTTMessage alloc] initWithTopic:@"tenants/1/devices/150/config" payload:payload qos:AtMostOnce retain:NO mid:0];
+    XCTAssertEqual([router routeMessage:message], 1);
+
+    message = [[MASMQTTMessage alloc] initWithTopic:@"tenants/2/devices/150/status" payload:payload qos:AtMostOnce retain:NO mid:0];
+    XCTAssertEqual([router routeMessage:message], 0);
+
+    [router removeHandlersForTopicFilter:@"tenants/1/#"];
+    message = [[MASMQTTMessage alloc] initWithTopic:@"tenants/1/devices/150/status" payload:payload qos:AtMostOnce retain:NO mid:0];
+    XCTAssertEqual([router routeMessage:message], 2);
+
+    [router removeAllHandlers];
+    XCTAssertFalse(router.hasHandlers);
+}
+
+- (void)testRemovesSingleHandler {
+    MASMQTTTopicRouter *router = [[MASMQTTTopicRouter alloc] init];
+    void (^rejected)(MASMQTTMessage *message) = [^(MASMQTTMessage *message) {} copy];
+    void (^subscribed)(MASMQTTMessage *message) = [^(MASMQTTMessage *message) {} copy];
+    MASMQTTMessage *message = [[MASMQTTMessage alloc] initWithTopic:@"devices/1/status" payload:[NSData data] qos:AtMostOnce retain:NO mid:0];
+
+    XCTAssertTrue([router addHandler:subscribed queue:self.handlerQueue forTopicFilter:@"devices/+/status"]);
+    XCTAssertTrue([router addHandler:rejected queue:self.handlerQueue forTopicFilter:@"devices/+/status"]);
+    XCTAssertEqual([router routeMessage:message], 2);
+
+    //
+    //  Only the handler of the failed subscription is removed
+    //
+    [router removeHandler:rejected forTopicFilter:@"devices/+/status"];
+    XCTAssertEqual([router routeMessage:message], 1);
+    XCTAssertTrue(router.hasHandlers);
+
+    [router removeHandler:subscribed forTopicFilter:@"devices/+/status"];
+    XCTAssertEqual([router routeMessage:message], 0);
+    XCTAssertFalse(router.hasHandlers);
+}
+
+#pragma mark - Benchmark
+
+- (void)testRoutingPerformanceWith10kFilters {
+    MASMQTTTopicRouter *router = [self routerWithFilterCount:MASMQTTTopicRouterFilterCount];
+    NSArray<MASMQTTMessage *> *messages = [self messagesWithCount:MASMQTTTopicRouterMessageCount filterCount:MASMQTTTopicRouterFilterCount];
+
+    [self measureBlock:^{
+        NSUInteger dispatchCount = 0;
+        for (MASMQTTMessage *message in messages) {
+            dispatchCount += [router routeMessage:message];
+        }
+
+        //
+        //  Every message matches its device's exact filter and the wildcard filters of its tenant
+        //
+        XCTAssertGreaterThanOrEqual(dispatchCount, MASMQTTTopicRouterMessageCount * 2);
+
+        dispatch_sync(self.handlerQueue, ^{});
+    }];
+}
+
+- (void)testRegistrationPerformanceWith10kFilters {
+    [self measureBlock:^{
+        MASMQTTTopicRouter *router = [self routerWithFilterCount:MASMQTTTopicRouterFilterCount];
+        XCTAssertTrue(router.hasHandlers);
+    }];
+}
+
+@end
@@ -0,0 +1,93 @@
+//
+//  MASSecurityServiceTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASSecurityService.h"
+
+static NSUInteger const MASSecurityServiceSignatureCount = 1000;
+static NSUInteger const MASSecurityServiceThreadCount = 8;
+
+
+@interface MASSecurityServiceTests : XCTestCase
+
+@property (nonatomic, assign) SecKeyRef privateKey;
+@property (nonatomic, strong) NSData *signingInput;
+
+@end
+
+
+@implementation MASSecurityServiceTests
+
+- (void)setUp {
+    [super setUp];
+
+    //
+    //  A key of the size generated for registered devices, kept in memory rather than in the keychain
+    //
+    NSDictionary *attributes = @{ (__bridge id)kSecAttrKeyType: (__bridge id)kSecAttrKeyTypeRSA,
+                                  (__bridge id)kSecAttrKeySizeInBits: @2048 };
+    self.privateKey = SecKeyCreateRandomKey((__bridge CFDictionaryRef)attributes, NULL);
+    XCTAssertTrue(self.privateKey != NULL);
+    [[MASSecurityService sharedService] setSigningKey:self.privateKey];
+
+    //
+    //  The header and payload of a typical signed request
+    //
+    NSString *header = [[@"{\"alg\":\"RS256\",\"typ\":\"JWT\"}" dataUsingEncoding:NSUTF8StringEncoding] base64EncodedStringWithOptions:0];
+    NSString *payload = [[NSMutableData dataWithLength:450] base64EncodedStringWithOptions:0];
+    self.signingInput = [[NSString stringWithFormat:@"%@.%@", header, payload] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (void)tearDown {
+    [[MASSecurityService sharedService] invalidateSigningKey];
+    if (self.privateKey) {
+        CFRelease(self.privateKey);
+        self.privateKey = NULL;
+    }
+
+    [super tearDown];
+}
+
+#pragma mark - Signing
+
+- (void)testSignatureVerifiesWithPublicKey {
+    NSError *error = nil;
+    NSData *signature = [[MASSecurityService sharedService] signData:self.signingInput error:&error];
+    XCTAssertNotNil(signature, @"%@", error);
+
+    SecKeyRef publicKey = SecKeyCopyPublicKey(self.privateKey);
+    XCTAssertTrue(SecKeyVerifySignature(publicKey, kSecKeyAlgorithmRSASignatureMessagePKCS1v15SHA256, (__bridge CFDataRef)self.signingInput, (__bridge CFDataRef)signature, NULL));
+    CFRelease(publicKey);
+}
+
+#pragma mark - Benchmark
+
+- (void)testSigningPerformance {
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < MASSecurityServiceSignatureCount; i++) {
+            XCTAssertNotNil([[MASSecurityService sharedService] signData:self.signingInput error:nil]);
+        }
+    }];
+}
+
+- (void)testConcurrentSigningPerformance {
+    [self measureBlock:^{
+        dispatch_apply(MASSecurityServiceThreadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread) {
+            for (NSUInteger i = 0; i < MASSecurityServiceSignatureCount / MASSecurityServiceThreadCount; i++) {
+                XCTAssertNotNil([[MASSecurityService sharedService] signData:self.signingInput error:nil]);
+            }
+        });
+    }];
+}
+
+@end
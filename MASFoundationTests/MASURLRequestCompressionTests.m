@@ -0,0 +1,103 @@
+//
+//  MASURLRequestCompressionTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MASConstantsPrivate.h"
+#import "MASPostURLRequest.h"
+#import "NSData+MASPrivate.h"
+
+static NSString *const MASURLRequestCompressionTestURL = @"https://127.0.0.1:9/compression";
+static NSUInteger const MASURLRequestCompressionTestThreshold = 1024;
+
+
+@interface MASURLRequestCompressionTests : XCTestCase
+
+@end
+
+
+@implementation MASURLRequestCompressionTests
+
+#pragma mark - Helpers
+
+- (MASURLRequest *)requestWithValueCount:(NSUInteger)count {
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionaryWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        parameters[[NSString stringWithFormat:@"sensor%lu", (unsigned long)i]] = @{ @"value": @(i * 31 % 97), @"unit": @"celsius" };
+    }
+
+    MASURLRequest *request = [MASPostURLRequest requestForEndpoint:MASURLRequestCompressionTestURL
+                                                    withParameters:parameters
+                                                        andHeaders:nil
+                                                       requestType:MASRequestResponseTypeJson
+                                                      responseType:MASRequestResponseTypeJson
+                                                          isPublic:YES
+                                                   timeoutInterval:MASDefaultNetworkTimeoutConfiguration];
+    request.compressRequestBody = YES;
+    request.compressionThreshold = MASURLRequestCompressionTestThreshold;
+
+    return request;
+}
+
+#pragma mark - Round trip
+
+- (void)testCompressedBodyRoundTrip {
+    MASURLRequest *request = [self requestWithValueCount:200];
+    NSData *body = request.HTTPBody;
+    XCTAssertGreaterThan(body.length, MASURLRequestCompressionTestThreshold);
+
+    [request compressBodyIfNeeded];
+
+    XCTAssertEqualObjects([request valueForHTTPHeaderField:MASContentEncodingRequestResponseKey], MASContentEncodingGzipValue);
+    XCTAssertTrue([request.HTTPBody isGzipCompressed]);
+    XCTAssertLessThan(request.HTTPBody.length, body.length);
+    XCTAssertEqualObjects([request.HTTPBody gzipDecompressedDataWithMaximumLength:body.length], body);
+}
+
+- (void)testRebuiltRequestIsNotCompressedTwice {
+    //
+    //  A request retried after re-authentication is rebuilt from the already compressed request
+    //
+    MASURLRequest *request = [self requestWithValueCount:200];
+    NSData *body = request.HTTPBody;
+
+    [request compressBodyIfNeeded];
+    NSData *compressedBody = request.HTTPBody;
+    [[request rebuildRequest] compressBodyIfNeeded];
+
+    XCTAssertEqualObjects(request.HTTPBody, compressedBody);
+    XCTAssertEqualObjects([request.HTTPBody gzipDecompressedDataWithMaximumLength:body.length], body);
+}
+
+- (void)testSmallBodyIsNotCompressed {
+    MASURLRequest *request = [self requestWithValueCount:1];
+    NSData *body = request.HTTPBody;
+    XCTAssertLessThan(body.length, MASURLRequestCompressionTestThreshold);
+
+    [request compressBodyIfNeeded];
+
+    XCTAssertEqualObjects(request.HTTPBody, body);
+    XCTAssertNil([request valueForHTTPHeaderField:MASContentEncodingRequestResponseKey]);
+}
+
+- (void)testBodyIsNotCompressedWhenDisabled {
+    MASURLRequest *request = [self requestWithValueCount:200];
+    request.compressRequestBody = NO;
+    NSData *body = request.HTTPBody;
+
+    [request compressBodyIfNeeded];
+
+    XCTAssertEqualObjects(request.HTTPBody, body);
+    XCTAssertNil([request valueForHTTPHeaderField:MASContentEncodingRequestResponseKey]);
+}
+
+@end
@@ -0,0 +1,268 @@
+//
+//  MQTTCFSocketEncoderTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MQTTCFSocketEncoder.h"
+
+
+//
+//  An output stream recording each write, which accepts at most maxWriteLength bytes per write, or fails writes
+//
+@interface MQTTTestOutputStream : NSOutputStream
+
+@property (nonatomic, strong) NSMutableData *writtenData;
+@property (nonatomic, assign) NSUInteger writeCount;
+@property (nonatomic, assign) NSUInteger maxWriteLength;
+@property (nonatomic, strong) NSError *writeError;
+
+@end
+
+
+@implementation MQTTTestOutputStream
+
+@synthesize delegate = _delegate;
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _writtenData = [NSMutableData data];
+        _maxWriteLength = NSUIntegerMax;
+    }
+
+    return self;
+}
+
+- (void)open {
+}
+
+- (void)close {
+}
+
+- (NSStreamStatus)streamStatus {
+    return self.writeError ? NSStreamStatusError : NSStreamStatusOpen;
+}
+
+- (NSError *)streamError {
+    return self.writeError;
+}
+
+- (BOOL)hasSpaceAvailable {
+    return YES;
+}
+
+- (NSInteger)write:(const uint8_t *)buffer maxLength:(NSUInteger)len {
+    if (self.writeError) {
+        return -1;
+    }
+
+    NSUInteger length = MIN(len, self.maxWriteLength);
+    [self.writtenData appendBytes:buffer length:length];
+    self.writeCount++;
+
+    return (NSInteger)length;
+}
+
+- (void)scheduleInRunLoop:(NSRunLoop *)aRunLoop forMode:(NSRunLoopMode)mode {
+}
+
+- (void)removeFromRunLoop:(NSRunLoop *)aRunLoop forMode:(NSRunLoopMode)mode {
+}
+
+@end
+
+
+@interface MQTTCFSocketEncoderTests : XCTestCase <MQTTCFSocketEncoderDelegate>
+
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) MQTTTestOutputStream *stream;
+@property (nonatomic, strong) MQTTCFSocketEncoder *encoder;
+@property (nonatomic, strong) NSError *error;
+
+@end
+
+
+@implementation MQTTCFSocketEncoderTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.queue = dispatch_queue_create("com.ca.MASFoundationTests.encoder", DISPATCH_QUEUE_SERIAL);
+    self.stream = [[MQTTTestOutputStream alloc] init];
+    self.error = nil;
+
+    self.encoder = [[MQTTCFSocketEncoder alloc] init];
+    self.encoder.stream = self.stream;
+    self.encoder.delegate = self;
+    [self.encoder open];
+
+    //
+    //  The stream reports space available once it is open
+    //
+    [self.encoder stream:self.stream handleEvent:NSStreamEventHasSpaceAvailable];
+    XCTAssertEqual(self.encoder.state, MQTTCFSocketEncoderStateReady);
+}
+
+- (void)tearDown {
+    self.encoder.delegate = nil;
+    [self.encoder close];
+
+    [super tearDown];
+}
+
+#pragma mark - Writing
+
+- (void)testMessagesAreWrittenInOrder {
+    NSData *small = [self dataWithLength:10 seed:1];
+    NSData *large = [self dataWithLength:4000 seed:2];
+
+    XCTAssertTrue([self.encoder send:small]);
+    XCTAssertTrue([self.encoder send:large]);
+    XCTAssertTrue([self.encoder send:small]);
+
+    XCTAssertEqualObjects(self.stream.writtenData, [self concatenate:@[small, large, small]]);
+    XCTAssertEqual(self.encoder.bufferedLength, 0);
+}
+
+- (void)testFixedHeaderIsWrittenBeforeData {
+    const UInt8 fixedHeader[] = { 0x30, 0xa0, 0x1f };
+    NSData *data = [self dataWithLength:4000 seed:3];
+
+    XCTAssertTrue([self.encoder sendFixedHeader:fixedHeader length:sizeof(fixedHeader) data:data]);
+
+    XCTAssertEqualObjects(self.stream.writtenData, [self concatenate:@[[NSData dataWithBytes:fixedHeader length:sizeof(fixedHeader)], data]]);
+}
+
+- (void)testSmallMessagesSentInOneTurnAreCoalesced {
+    self.encoder.queue = self.queue;
+    NSMutableArray *messages = [NSMutableArray array];
+
+    dispatch_sync(self.queue, ^{
+        for (NSUInteger i = 0; i < 20; i++) {
+            NSData *message = [self dataWithLength:4 seed:i];
+            [messages addObject:message];
+            XCTAssertTrue([self.encoder send:message]);
+        }
+        XCTAssertEqual(self.stream.writeCount, 0);
+        XCTAssertEqual(self.encoder.bufferedLength, 80);
+    });
+    dispatch_sync(self.queue, ^{});
+
+    XCTAssertEqual(self.stream.writeCount, 1);
+    XCTAssertEqualObjects(self.stream.writtenData, [self concatenate:messages]);
+    XCTAssertEqual(self.encoder.bufferedLength, 0);
+}
+
+- (void)testPartialWritesContinueFromCursor {
+    self.stream.maxWriteLength = 7;
+    NSData *small = [self dataWithLength:100 seed:4];
+    NSData *large = [self dataWithLength:1000 seed:5];
+
+    XCTAssertTrue([self.encoder send:small]);
+    XCTAssertTrue([self.encoder send:large]);
+    XCTAssertGreaterThan(self.encoder.bufferedLength, 0);
+
+    //
+    //  The rest is written as the stream reports space available again
+    //
+    for (NSUInteger i = 0; i < 1000 && self.encoder.bufferedLength; i++) {
+        [self.encoder stream:self.stream handleEvent:NSStreamEventHasSpaceAvailable];
+    }
+
+    XCTAssertEqualObjects(self.stream.writtenData, [self concatenate:@[small, large]]);
+    XCTAssertEqual(self.encoder.bufferedLength, 0);
+}
+
+- (void)testDeferredMessagesAreFlushedOnClose {
+    self.encoder.queue = self.queue;
+    NSData *message = [self dataWithLength:10 seed:6];
+
+    dispatch_sync(self.queue, ^{
+        XCTAssertTrue([self.encoder send:message]);
+        [self.encoder close];
+    });
+
+    XCTAssertEqualObjects(self.stream.writtenData, message);
+}
+
+#pragma mark - Write failures
+
+- (void)testFailedWriteIsReturnedBySend {
+    self.stream.writeError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EPIPE userInfo:nil];
+
+    XCTAssertFalse([self.encoder send:[self dataWithLength:10 seed:7]]);
+    XCTAssertEqual(self.encoder.state, MQTTCFSocketEncoderStateError);
+    XCTAssertEqualObjects(self.encoder.error, self.stream.writeError);
+}
+
+- (void)testFailedDeferredWriteIsReportedToDelegate {
+    self.encoder.queue = self.queue;
+    self.stream.writeError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EPIPE userInfo:nil];
+
+    //
+    //  The deferred message was accepted, so its failure can only be reported to the delegate
+    //
+    dispatch_sync(self.queue, ^{
+        XCTAssertTrue([self.encoder send:[self dataWithLength:10 seed:8]]);
+    });
+    dispatch_sync(self.queue, ^{});
+
+    XCTAssertEqualObjects(self.error, self.stream.writeError);
+    XCTAssertEqual(self.encoder.state, MQTTCFSocketEncoderStateError);
+    XCTAssertFalse([self.encoder send:[self dataWithLength:10 seed:9]]);
+}
+
+- (void)testFailedWriteOnSpaceAvailableIsReportedToDelegate {
+    self.stream.maxWriteLength = 0;
+    XCTAssertTrue([self.encoder send:[self dataWithLength:10 seed:10]]);
+    XCTAssertNil(self.error);
+
+    self.stream.writeError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EPIPE userInfo:nil];
+    [self.encoder stream:self.stream handleEvent:NSStreamEventHasSpaceAvailable];
+
+    XCTAssertEqualObjects(self.error, self.stream.writeError);
+}
+
+#pragma mark - MQTTCFSocketEncoderDelegate
+
+- (void)encoderDidOpen:(MQTTCFSocketEncoder *)sender {
+}
+
+- (void)encoder:(MQTTCFSocketEncoder *)sender didFailWithError:(NSError *)error {
+    self.error = error;
+}
+
+- (void)encoderdidClose:(MQTTCFSocketEncoder *)sender {
+}
+
+#pragma mark - Helpers
+
+- (NSData *)dataWithLength:(NSUInteger)length seed:(NSUInteger)seed {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    UInt8 *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < length; i++) {
+        bytes[i] = (UInt8)(i * 31 + seed);
+    }
+
+    return data;
+}
+
+- (NSData *)concatenate:(NSArray<NSData *> *)messages {
+    NSMutableData *data = [NSMutableData data];
+    for (NSData *message in messages) {
+        [data appendData:message];
+    }
+
+    return data;
+}
+
+@end
@@ -0,0 +1,214 @@
+//
+//  MQTTDecoderTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MQTTDecoder.h"
+#import "MQTTSession.h"
+
+
+@interface MQTTDecoderTests : XCTestCase <MQTTDecoderDelegate>
+
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) MQTTDecoder *decoder;
+@property (nonatomic, strong) NSMutableArray<NSData *> *packets;
+@property (nonatomic, strong) NSError *error;
+
+@end
+
+
+@implementation MQTTDecoderTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.queue = dispatch_queue_create("com.ca.MASFoundationTests.decoder", DISPATCH_QUEUE_SERIAL);
+    self.packets = [NSMutableArray array];
+    self.error = nil;
+
+    self.decoder = [[MQTTDecoder alloc] init];
+    self.decoder.queue = self.queue;
+    self.decoder.delegate = self;
+    [self.decoder open];
+}
+
+- (void)tearDown {
+    [self.decoder close];
+
+    [super tearDown];
+}
+
+#pragma mark - Framing
+
+- (void)testSeveralPacketsInOneChunk {
+    NSArray<NSData *> *packets = @[[self packetWithType:MQTTPublish bodyLength:10],
+                                   [self packetWithType:MQTTPingresp bodyLength:0],
+                                   [self packetWithType:MQTTPuback bodyLength:2]];
+
+    [self decodeChunks:@[[self concatenate:packets]]];
+
+    XCTAssertEqualObjects(self.packets, packets);
+    XCTAssertNil(self.error);
+}
+
+- (void)testPacketSplitAtEveryByteBoundary {
+    NSData *packet = [self packetWithType:MQTTPublish bodyLength:200];
+
+    for (NSUInteger split = 1; split < packet.length; split++) {
+        [self.packets removeAllObjects];
+
+        [self decodeChunks:@[[packet subdataWithRange:NSMakeRange(0, split)],
+                             [packet subdataWithRange:NSMakeRange(split, packet.length - split)]]];
+
+        XCTAssertEqual(self.packets.count, 1, @"split at %lu", (unsigned long)split);
+        XCTAssertEqualObjects(self.packets.firstObject, packet, @"split at %lu", (unsigned long)split);
+    }
+    XCTAssertNil(self.error);
+}
+
+- (void)testPacketDeliveredOneByteAtATime {
+    NSData *first = [self packetWithType:MQTTPublish bodyLength:20000];
+    NSData *second = [self packetWithType:MQTTPingresp bodyLength:0];
+    NSData *stream = [self concatenate:@[first, second]];
+
+    NSMutableArray *chunks = [NSMutableArray arrayWithCapacity:stream.length];
+    for (NSUInteger i = 0; i < stream.length; i++) {
+        [chunks addObject:[stream subdataWithRange:NSMakeRange(i, 1)]];
+    }
+    [self decodeChunks:chunks];
+
+    XCTAssertEqualObjects(self.packets, (@[first, second]));
+    XCTAssertNil(self.error);
+}
+
+- (void)testMultiByteRemainingLength {
+    NSData *twoBytes = [self packetWithType:MQTTPublish bodyLength:200];
+    NSData *threeBytes = [self packetWithType:MQTTPublish bodyLength:20000];
+    XCTAssertEqual(twoBytes.length, 200 + 3);
+    XCTAssertEqual(threeBytes.length, 20000 + 4);
+
+    [self decodeChunks:@[[self concatenate:@[twoBytes, threeBytes]]]];
+
+    XCTAssertEqualObjects(self.packets, (@[twoBytes, threeBytes]));
+}
+
+- (void)testPacketWithoutBody {
+    NSData *pingresp = [self packetWithType:MQTTPingresp bodyLength:0];
+    XCTAssertEqual(pingresp.length, 2);
+
+    [self decodeChunks:@[pingresp, pingresp]];
+
+    XCTAssertEqualObjects(self.packets, (@[pingresp, pingresp]));
+}
+
+- (void)testDeliveredBytesMatchWireBytes {
+    NSData *packet = [self packetWithType:MQTTPublish bodyLength:1000];
+    NSData *stream = [self concatenate:@[packet, packet, packet]];
+
+    //
+    //  Chunks straddling packet boundaries exercise both the zero-copy slices and the carry-over buffer
+    //
+    [self decodeChunks:@[[stream subdataWithRange:NSMakeRange(0, 700)],
+                         [stream subdataWithRange:NSMakeRange(700, 1700)],
+                         [stream subdataWithRange:NSMakeRange(2400, stream.length - 2400)]]];
+
+    XCTAssertEqual(self.packets.count, 3);
+    for (NSData *received in self.packets) {
+        XCTAssertEqual(received.length, packet.length);
+        XCTAssertEqual(memcmp(received.bytes, packet.bytes, packet.length), 0);
+    }
+}
+
+#pragma mark - Protocol errors
+
+- (void)testMalformedRemainingLength {
+    const UInt8 bytes[] = { MQTTPublish << 4, 0xff, 0xff, 0xff, 0xff, 0x01 };
+
+    [self decodeChunks:@[[NSData dataWithBytes:bytes length:sizeof(bytes)]]];
+
+    XCTAssertEqual(self.packets.count, 0);
+    XCTAssertEqual(self.error.code, MQTTSessionErrorIllegalMessageReceived);
+    XCTAssertEqual(self.decoder.state, MQTTDecoderStateProtocolError);
+}
+
+- (void)testPacketAboveMaximumPacketSizeIsRejectedBeforeItsBody {
+    self.decoder.maximumPacketSize = 128;
+    NSData *packet = [self packetWithType:MQTTPublish bodyLength:200];
+
+    //
+    //  Only the fixed header is received, the body has not arrived yet
+    //
+    [self decodeChunks:@[[packet subdataWithRange:NSMakeRange(0, 3)]]];
+
+    XCTAssertEqual(self.packets.count, 0);
+    XCTAssertEqual(self.error.code, MQTTPacketTooLarge);
+    XCTAssertEqual(self.decoder.state, MQTTDecoderStateProtocolError);
+
+    //
+    //  Nothing is decoded after a protocol error
+    //
+    [self decodeChunks:@[[packet subdataWithRange:NSMakeRange(3, packet.length - 3)],
+                         [self packetWithType:MQTTPingresp bodyLength:0]]];
+    XCTAssertEqual(self.packets.count, 0);
+}
+
+- (void)testPacketAtMaximumPacketSizeIsAccepted {
+    NSData *packet = [self packetWithType:MQTTPublish bodyLength:200];
+    self.decoder.maximumPacketSize = (UInt32)packet.length;
+
+    [self decodeChunks:@[packet]];
+
+    XCTAssertEqualObjects(self.packets, @[packet]);
+    XCTAssertNil(self.error);
+}
+
+#pragma mark - MQTTDecoderDelegate
+
+- (void)decoder:(MQTTDecoder *)sender didReceiveMessage:(NSData *)data {
+    [self.packets addObject:[data copy]];
+}
+
+- (void)decoder:(MQTTDecoder *)sender handleEvent:(MQTTDecoderEvent)eventCode error:(NSError *)error {
+    XCTAssertEqual(eventCode, MQTTDecoderEventProtocolError);
+    self.error = error;
+}
+
+#pragma mark - Helpers
+
+- (void)decodeChunks:(NSArray<NSData *> *)chunks {
+    for (NSData *chunk in chunks) {
+        [self.decoder decodeMessage:chunk];
+    }
+    dispatch_sync(self.queue, ^{});
+}
+
+- (NSData *)packetWithType:(MQTTCommandType)type bodyLength:(NSUInteger)bodyLength {
+    NSMutableData *packet = [NSMutableData data];
+    [packet appendByte:(UInt8)(type << 4)];
+    [packet appendVariableLength:bodyLength];
+    for (NSUInteger i = 0; i < bodyLength; i++) {
+        [packet appendByte:(UInt8)i];
+    }
+
+    return packet;
+}
+
+- (NSData *)concatenate:(NSArray<NSData *> *)packets {
+    NSMutableData *stream = [NSMutableData data];
+    for (NSData *packet in packets) {
+        [stream appendData:packet];
+    }
+
+    return stream;
+}
+
+@end
@@ -0,0 +1,184 @@
+//
+//  MQTTInMemoryPersistenceTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MQTTInMemoryPersistence.h"
+
+//
+//  Every client stores and deletes the same total number of flows, so the client counts compare contention only
+//
+static NSUInteger const MQTTInMemoryPersistenceFlowCount = 40000;
+
+//
+//  Each client owns a range of message ids on the clientId shared by all clients
+//
+static NSUInteger const MQTTInMemoryPersistenceSharedFlowCount = 8000;
+
+
+@interface MQTTInMemoryPersistenceTests : XCTestCase
+
+@end
+
+
+@implementation MQTTInMemoryPersistenceTests
+
+#pragma mark - Helpers
+
+- (MQTTInMemoryPersistence *)persistence {
+    MQTTInMemoryPersistence *persistence = [[MQTTInMemoryPersistence alloc] init];
+    persistence.maxMessages = NSUIntegerMax - 1;
+    persistence.maxWindowSize = NSUIntegerMax;
+
+    return persistence;
+}
+
+- (void)storeAndDeleteFlowsWithPersistence:(MQTTInMemoryPersistence *)persistence
+                                  clientId:(NSString *)clientId
+                            firstMessageId:(NSUInteger)firstMessageId
+                                     count:(NSUInteger)count {
+    NSData *data = [@"payload" dataUsingEncoding:NSUTF8StringEncoding];
+    NSMutableArray *flows = [NSMutableArray arrayWithCapacity:count];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        MQTTInMemoryFlow *flow = [persistence storeMessageForClientId:clientId
+                                                                topic:@"benchmark/topic"
+                                                                 data:data
+                                                           retainFlag:NO
+                                                                  qos:MQTTQosLevelAtLeastOnce
+                                                                msgId:(UInt16)(firstMessageId + i)
+                                                         incomingFlag:NO
+                                                          commandType:MQTTPublish
+                                                             deadline:[NSDate date]];
+        XCTAssertNotNil(flow);
+        if (flow) {
+            [flows addObject:flow];
+        }
+    }
+
+    for (MQTTInMemoryFlow *flow in flows) {
+        [persistence deleteFlow:flow];
+    }
+}
+
+#pragma mark - Shards
+
+- (void)testShardIsDiscardedWithItsLastFlow {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    MQTTInMemoryPersistence *persistence = [self persistence];
+
+    [self storeAndDeleteFlowsWithPersistence:persistence clientId:clientId firstMessageId:1 count:10];
+    XCTAssertEqual([persistence allFlowsforClientId:clientId incomingFlag:NO].count, 0);
+
+    //
+    //  A persistence caching the discarded shard stores into a new one
+    //
+    MQTTInMemoryFlow *flow = [persistence storeMessageForClientId:clientId
+                                                            topic:@"topic"
+                                                             data:[NSData data]
+                                                       retainFlag:NO
+                                                              qos:MQTTQosLevelAtLeastOnce
+                                                            msgId:1
+                                                     incomingFlag:NO
+                                                      commandType:MQTTPublish
+                                                         deadline:[NSDate date]];
+    XCTAssertNotNil(flow);
+    XCTAssertEqual([[self persistence] allFlowsforClientId:clientId incomingFlag:NO].count, 1, @"the new shard is shared by all persistences");
+
+    [persistence deleteAllFlowsForClientId:clientId];
+    XCTAssertEqual([[self persistence] allFlowsforClientId:clientId incomingFlag:NO].count, 0);
+}
+
+#pragma mark - Flows
+
+- (void)testQueuedFlowsAreKeptOutOfTheDeadlineIndex {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    MQTTInMemoryPersistence *persistence = [self persistence];
+
+    NSMutableArray *flows = [NSMutableArray array];
+    for (UInt16 msgId = 1; msgId <= 4; msgId++) {
+        [flows addObject:[persistence storeMessageForClientId:clientId
+                                                        topic:@"topic"
+                                                         data:[NSData data]
+                                                   retainFlag:NO
+                                                          qos:MQTTQosLevelAtLeastOnce
+                                                        msgId:msgId
+                                                 incomingFlag:NO
+                                                  commandType:MQTT_None
+                                                     deadline:[NSDate distantPast]]];
+    }
+    XCTAssertNil([persistence earliestDeadlineFlowforClientId:clientId incomingFlag:NO]);
+    XCTAssertEqual([persistence flowsforClientId:clientId incomingFlag:NO dueBefore:[NSDate date]].count, 0);
+    XCTAssertEqualObjects([persistence queuedFlowsforClientId:clientId incomingFlag:NO limit:2], [flows subarrayWithRange:NSMakeRange(0, 2)]);
+
+    //
+    //  Sending moves a flow into the deadline index, requeueing puts it back in its place
+    //
+    MQTTInMemoryFlow *flow = flows[0];
+    flow.commandType = @(MQTTPublish);
+    flow.deadline = [NSDate dateWithTimeIntervalSinceNow:10];
+    XCTAssertEqual([persistence earliestDeadlineFlowforClientId:clientId incomingFlag:NO], flow);
+    XCTAssertEqual([persistence windowSize:clientId], 1);
+    XCTAssertEqual([persistence queueSize:clientId], 3);
+
+    flow.commandType = @(MQTT_None);
+    XCTAssertNil([persistence earliestDeadlineFlowforClientId:clientId incomingFlag:NO]);
+    XCTAssertEqualObjects([persistence queuedFlowsforClientId:clientId incomingFlag:NO limit:10], flows);
+
+    [persistence deleteFlow:flows[1]];
+    XCTAssertEqual([persistence queueSize:clientId], 3);
+    XCTAssertEqual([persistence queuedFlowsforClientId:clientId incomingFlag:NO limit:10][1], flows[2]);
+
+    [persistence deleteAllFlowsForClientId:clientId];
+}
+
+#pragma mark - Benchmark
+
+- (void)testSingleClientStoreAndDeletePerformance {
+    [self measureStoreAndDeleteWithClientCount:1];
+}
+
+- (void)testConcurrentStoreAndDeletePerformance {
+    [self measureStoreAndDeleteWithClientCount:8];
+}
+
+- (void)testHighlyConcurrentStoreAndDeletePerformance {
+    [self measureStoreAndDeleteWithClientCount:64];
+}
+
+- (void)measureStoreAndDeleteWithClientCount:(NSUInteger)clientCount {
+    NSString *sharedClientId = [[NSUUID UUID] UUIDString];
+    NSUInteger flowsPerClient = MQTTInMemoryPersistenceFlowCount / clientCount;
+    NSUInteger sharedFlowsPerClient = MQTTInMemoryPersistenceSharedFlowCount / clientCount;
+
+    [self measureBlock:^{
+        dispatch_apply(clientCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t client) {
+            MQTTInMemoryPersistence *persistence = [self persistence];
+            NSString *clientId = [[NSUUID UUID] UUIDString];
+
+            [self storeAndDeleteFlowsWithPersistence:persistence
+                                            clientId:clientId
+                                      firstMessageId:1
+                                               count:flowsPerClient];
+            [self storeAndDeleteFlowsWithPersistence:persistence
+                                            clientId:sharedClientId
+                                      firstMessageId:1 + client * sharedFlowsPerClient
+                                               count:sharedFlowsPerClient];
+
+            XCTAssertEqual([persistence allFlowsforClientId:clientId incomingFlag:NO].count, 0);
+        });
+
+        XCTAssertEqual([[self persistence] allFlowsforClientId:sharedClientId incomingFlag:NO].count, 0);
+    }];
+}
+
+@end
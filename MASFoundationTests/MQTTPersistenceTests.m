@@ -0,0 +1,397 @@
+//
+//  MQTTPersistenceTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MQTTCoreDataPersistence.h"
+#import "MQTTInMemoryPersistence.h"
+#import "MQTTLogPersistence.h"
+
+static NSUInteger const MQTTPersistenceMessageCount = 1000;
+static NSUInteger const MQTTPersistencePayloadLength = 256;
+
+
+@interface MQTTPersistenceTests : XCTestCase
+
+@property (nonatomic, strong) NSURL *logFileURL;
+
+@end
+
+
+@implementation MQTTPersistenceTests
+
+- (void)setUp {
+    [super setUp];
+
+    NSString *fileName = [NSString stringWithFormat:@"MQTTPersistenceTests-%@.log", [[NSUUID UUID] UUIDString]];
+    self.logFileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:fileName]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:self.logFileURL error:nil];
+    [[NSFileManager defaultManager] removeItemAtURL:[self.logFileURL URLByAppendingPathExtension:@"compact"] error:nil];
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (MQTTLogPersistence *)logPersistenceWithPersistent:(BOOL)persistent {
+    MQTTLogPersistence *persistence = [[MQTTLogPersistence alloc] init];
+    persistence.persistent = persistent;
+    persistence.fileURL = self.logFileURL;
+
+    return persistence;
+}
+
+- (MQTTLogFlow *)storeFlowWithPersistence:(id<MQTTPersistence>)persistence
+                                 clientId:(NSString *)clientId
+                                    msgId:(UInt16)msgId
+                              commandType:(UInt8)commandType
+                                 deadline:(NSDate *)deadline {
+    return [persistence storeMessageForClientId:clientId
+                                          topic:@"benchmark/topic"
+                                           data:[NSMutableData dataWithLength:MQTTPersistencePayloadLength]
+                                     retainFlag:NO
+                                            qos:MQTTQosLevelAtLeastOnce
+                                          msgId:msgId
+                                   incomingFlag:NO
+                                    commandType:commandType
+                                       deadline:deadline];
+}
+
+//
+//  Opens the log of the test, and closes it once the block returns so the next persistence replays it
+//
+- (void)withLogPersistence:(void (^)(MQTTLogPersistence *persistence))block {
+    __weak id store = nil;
+
+    @autoreleasepool {
+        MQTTLogPersistence *persistence = [self logPersistenceWithPersistent:YES];
+        block(persistence);
+        store = [persistence valueForKey:@"logStore"];
+    }
+
+    //
+    //  The store is released by its I/O queue once the last commit returned
+    //
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (store && timeout.timeIntervalSinceNow > 0) {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    XCTAssertNil(store);
+}
+
+- (unsigned long long)logFileLength {
+    return [[NSFileManager defaultManager] attributesOfItemAtPath:self.logFileURL.path error:nil].fileSize;
+}
+
+- (NSArray<NSNumber *> *)messageIdsOfFlows:(NSArray<id<MQTTFlow>> *)flows {
+    NSMutableArray *messageIds = [NSMutableArray arrayWithCapacity:flows.count];
+    for (id<MQTTFlow> flow in flows) {
+        [messageIds addObject:flow.messageId];
+    }
+
+    return [messageIds sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (NSString *)populatePersistence:(id<MQTTPersistence>)persistence {
+    persistence.maxMessages = MQTTPersistenceMessageCount;
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+
+    for (NSUInteger i = 0; i < MQTTPersistenceMessageCount; i++) {
+        XCTAssertNotNil([self storeFlowWithPersistence:persistence
+                                              clientId:clientId
+                                                 msgId:(UInt16)(i + 1)
+                                           commandType:MQTTPublish
+                                              deadline:[NSDate dateWithTimeIntervalSinceNow:20]]);
+    }
+    [persistence sync];
+
+    return clientId;
+}
+
+//
+//  Follows a session publishing at QoS 1: each message is stored and synced when it is published,
+//  and deleted and synced when its PUBACK arrives
+//
+- (void)measurePublishCycleWithPersistence:(id<MQTTPersistence>)persistence {
+    persistence.maxMessages = MQTTPersistenceMessageCount;
+    persistence.maxWindowSize = MQTTPersistenceMessageCount;
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+
+    [self measureBlock:^{
+        NSMutableArray *flows = [NSMutableArray arrayWithCapacity:MQTTPersistenceMessageCount];
+        for (NSUInteger i = 0; i < MQTTPersistenceMessageCount; i++) {
+            id<MQTTFlow> flow = [self storeFlowWithPersistence:persistence
+                                                      clientId:clientId
+                                                         msgId:(UInt16)(i + 1)
+                                                   commandType:MQTTPublish
+                                                      deadline:[NSDate dateWithTimeIntervalSinceNow:20]];
+            XCTAssertNotNil(flow);
+            [persistence sync];
+            if (flow) {
+                [flows addObject:flow];
+            }
+        }
+        for (id<MQTTFlow> flow in flows) {
+            [persistence deleteFlow:flow];
+            [persistence sync];
+        }
+
+        XCTAssertEqual([persistence allFlowsforClientId:clientId incomingFlag:NO].count, 0);
+    }];
+}
+
+#pragma mark - Log persistence
+
+- (void)testSyncMakesRecordsDurable {
+    MQTTLogPersistence *persistence = [self logPersistenceWithPersistent:YES];
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+
+    [self storeFlowWithPersistence:persistence clientId:clientId msgId:1 commandType:MQTTPublish deadline:[NSDate date]];
+    [persistence sync];
+
+    //
+    //  The log header is 8 bytes, the store record follows it once sync returns
+    //
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:self.logFileURL.path error:nil];
+    XCTAssertGreaterThan(attributes.fileSize, 8 + MQTTPersistencePayloadLength);
+
+    [persistence deleteAllFlowsForClientId:clientId];
+    [persistence sync];
+}
+
+- (void)testFlowsAreIndexedByDeadlineAndQueue {
+    MQTTLogPersistence *persistence = [self logPersistenceWithPersistent:NO];
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+
+    MQTTLogFlow *laterFlow = [self storeFlowWithPersistence:persistence clientId:clientId msgId:1 commandType:MQTTPublish deadline:[NSDate dateWithTimeIntervalSinceNow:20]];
+    MQTTLogFlow *earlierFlow = [self storeFlowWithPersistence:persistence clientId:clientId msgId:2 commandType:MQTTPublish deadline:[NSDate dateWithTimeIntervalSinceNow:-1]];
+    MQTTLogFlow *queuedFlow = [self storeFlowWithPersistence:persistence clientId:clientId msgId:3 commandType:MQTT_None deadline:[NSDate distantPast]];
+
+    XCTAssertEqual([persistence earliestDeadlineFlowforClientId:clientId incomingFlag:NO], earlierFlow);
+    XCTAssertEqualObjects([persistence flowsforClientId:clientId incomingFlag:NO dueBefore:[NSDate date]], @[earlierFlow]);
+    XCTAssertEqualObjects([persistence queuedFlowsforClientId:clientId incomingFlag:NO limit:10], @[queuedFlow]);
+    XCTAssertEqual([persistence windowSize:clientId], 2);
+
+    //
+    //  Retrieved flows are a snapshot
+    //
+    NSArray *flows = [persistence allFlowsforClientId:clientId incomingFlag:NO];
+    [persistence deleteFlow:laterFlow];
+    XCTAssertEqual(flows.count, 3);
+    XCTAssertEqual([persistence allFlowsforClientId:clientId incomingFlag:NO].count, 2);
+
+    earlierFlow.commandType = @(MQTT_None);
+    XCTAssertNil([persistence earliestDeadlineFlowforClientId:clientId incomingFlag:NO]);
+    XCTAssertEqualObjects([persistence queuedFlowsforClientId:clientId incomingFlag:NO limit:10], (@[earlierFlow, queuedFlow]));
+
+    [persistence deleteAllFlowsForClientId:clientId];
+}
+
+#pragma mark - Log recovery
+
+- (void)testRecoveryReplaysLog {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:20];
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:1 commandType:MQTTPublish deadline:deadline];
+        MQTTLogFlow *updatedFlow = [self storeFlowWithPersistence:persistence clientId:clientId msgId:2 commandType:MQTTPublish deadline:deadline];
+        MQTTLogFlow *deletedFlow = [self storeFlowWithPersistence:persistence clientId:clientId msgId:3 commandType:MQTTPublish deadline:deadline];
+        [persistence sync];
+
+        updatedFlow.commandType = @(MQTTPubrel);
+        [persistence deleteFlow:deletedFlow];
+        [persistence sync];
+    }];
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        NSArray<id<MQTTFlow>> *flows = [persistence allFlowsforClientId:clientId incomingFlag:NO];
+        XCTAssertEqualObjects([self messageIdsOfFlows:flows], (@[@1, @2]));
+
+        id<MQTTFlow> flow = [persistence flowforClientId:clientId incomingFlag:NO messageId:2];
+        XCTAssertEqualObjects(flow.commandType, @(MQTTPubrel));
+        XCTAssertEqualObjects(flow.topic, @"benchmark/topic");
+        XCTAssertEqualObjects(flow.data, [NSMutableData dataWithLength:MQTTPersistencePayloadLength]);
+        XCTAssertEqualObjects(flow.qosLevel, @(MQTTQosLevelAtLeastOnce));
+        XCTAssertEqualWithAccuracy(flow.deadline.timeIntervalSinceReferenceDate, deadline.timeIntervalSinceReferenceDate, 0.001);
+        XCTAssertEqual([persistence windowSize:clientId], 2);
+    }];
+}
+
+- (void)testRecoveryTruncatesTornTail {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    __block unsigned long long validLength = 0;
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:1 commandType:MQTTPublish deadline:[NSDate date]];
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:2 commandType:MQTTPublish deadline:[NSDate date]];
+        [persistence sync];
+        validLength = [self logFileLength];
+
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:3 commandType:MQTTPublish deadline:[NSDate date]];
+        [persistence sync];
+    }];
+
+    //
+    //  A crash while appending the last record leaves it incomplete
+    //
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingToURL:self.logFileURL error:nil];
+    [fileHandle truncateFileAtOffset:[self logFileLength] - 3];
+    [fileHandle closeFile];
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        XCTAssertEqualObjects([self messageIdsOfFlows:[persistence allFlowsforClientId:clientId incomingFlag:NO]], (@[@1, @2]));
+        XCTAssertEqual([self logFileLength], validLength);
+
+        //
+        //  Records appended after the truncation are replayed
+        //
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:4 commandType:MQTTPublish deadline:[NSDate date]];
+        [persistence sync];
+    }];
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        XCTAssertEqualObjects([self messageIdsOfFlows:[persistence allFlowsforClientId:clientId incomingFlag:NO]], (@[@1, @2, @4]));
+    }];
+}
+
+- (void)testRecoveryDiscardsCorruptLastRecord {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    __block unsigned long long validLength = 0;
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:1 commandType:MQTTPublish deadline:[NSDate date]];
+        [persistence sync];
+        validLength = [self logFileLength];
+
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:2 commandType:MQTTPublish deadline:[NSDate date]];
+        [persistence sync];
+    }];
+
+    //
+    //  A flipped bit in the payload of the last record no longer matches its checksum
+    //
+    NSMutableData *log = [NSMutableData dataWithContentsOfURL:self.logFileURL];
+    ((UInt8 *)log.mutableBytes)[log.length - 1] ^= 0x01;
+    XCTAssertTrue([log writeToURL:self.logFileURL atomically:NO]);
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        XCTAssertEqualObjects([self messageIdsOfFlows:[persistence allFlowsforClientId:clientId incomingFlag:NO]], @[@1]);
+        XCTAssertEqual([self logFileLength], validLength);
+    }];
+}
+
+- (void)testRecoveryAfterCompaction {
+    NSString *clientId = [[NSUUID UUID] UUIDString];
+    NSUInteger const compactionThreshold = 4096;
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        persistence.compactionThreshold = compactionThreshold;
+
+        NSMutableArray *flows = [NSMutableArray array];
+        for (UInt16 msgId = 1; msgId <= 50; msgId++) {
+            [flows addObject:[self storeFlowWithPersistence:persistence clientId:clientId msgId:msgId commandType:MQTTPublish deadline:[NSDate date]]];
+            [persistence sync];
+        }
+        for (id<MQTTFlow> flow in [flows subarrayWithRange:NSMakeRange(0, 45)]) {
+            [persistence deleteFlow:flow];
+            [persistence sync];
+        }
+
+        //
+        //  The log was rewritten from the live flows instead of growing with every record
+        //
+        XCTAssertLessThan([self logFileLength], compactionThreshold);
+        XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[self.logFileURL.path stringByAppendingString:@".compact"]]);
+
+        [self storeFlowWithPersistence:persistence clientId:clientId msgId:51 commandType:MQTTPublish deadline:[NSDate date]];
+        [persistence sync];
+    }];
+
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        XCTAssertEqualObjects([self messageIdsOfFlows:[persistence allFlowsforClientId:clientId incomingFlag:NO]], (@[@46, @47, @48, @49, @50, @51]));
+    }];
+}
+
+#pragma mark - Benchmark
+
+- (void)testCoreDataPersistencePerformance {
+    [self measurePublishCycleWithPersistence:[[MQTTCoreDataPersistence alloc] init]];
+}
+
+- (void)testInMemoryPersistencePerformance {
+    [self measurePublishCycleWithPersistence:[[MQTTInMemoryPersistence alloc] init]];
+}
+
+- (void)testLogPersistencePerformance {
+    [self measurePublishCycleWithPersistence:[self logPersistenceWithPersistent:NO]];
+}
+
+- (void)testInMemoryPersistenceRecoveryPerformance {
+    MQTTInMemoryPersistence *persistence = [[MQTTInMemoryPersistence alloc] init];
+    NSString *clientId = [self populatePersistence:persistence];
+
+    //
+    //  Flows are kept in memory only, so another persistence reads them without any recovery
+    //
+    [self measureBlock:^{
+        MQTTInMemoryPersistence *reopenedPersistence = [[MQTTInMemoryPersistence alloc] init];
+        XCTAssertEqual([reopenedPersistence allFlowsforClientId:clientId incomingFlag:NO].count, MQTTPersistenceMessageCount);
+    }];
+
+    [persistence deleteAllFlowsForClientId:clientId];
+}
+
+- (void)testCoreDataPersistenceRecoveryPerformance {
+    MQTTCoreDataPersistence *persistence = [[MQTTCoreDataPersistence alloc] init];
+    NSString *clientId = [self populatePersistence:persistence];
+    NSManagedObjectContext *context = [persistence valueForKey:@"managedObjectContext"];
+
+    //
+    //  The store is opened with the persistence, the flows are fetched from it again the way a relaunched client reads them
+    //
+    [self measureBlock:^{
+        [context performBlockAndWait:^{
+            [context reset];
+        }];
+        XCTAssertEqual([persistence allFlowsforClientId:clientId incomingFlag:NO].count, MQTTPersistenceMessageCount);
+    }];
+}
+
+- (void)testLogPersistenceRecoveryPerformance {
+    __block NSString *clientId = nil;
+    [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+        clientId = [self populatePersistence:persistence];
+    }];
+
+    [self measureBlock:^{
+        [self withLogPersistence:^(MQTTLogPersistence *persistence) {
+            XCTAssertEqual([persistence allFlowsforClientId:clientId incomingFlag:NO].count, MQTTPersistenceMessageCount);
+        }];
+    }];
+}
+
+- (void)testPersistentLogPersistencePerformance {
+    MQTTLogPersistence *persistence = [self logPersistenceWithPersistent:YES];
+
+    //
+    //  A small threshold compacts the log several times during each run
+    //
+    persistence.compactionThreshold = 64 * 1024;
+
+    [self measurePublishCycleWithPersistence:persistence];
+}
+
+@end
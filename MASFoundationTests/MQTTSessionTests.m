@@ -0,0 +1,341 @@
+//
+//  MQTTSessionTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MQTTInMemoryPersistence.h"
+#import "MQTTSession.h"
+#import "MQTTTestTransport.h"
+
+static NSUInteger const MQTTSessionTestsWindowSize = 2;
+
+
+@interface MQTTSessionTests : XCTestCase
+
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) MQTTTestTransport *transport;
+@property (nonatomic, strong) MQTTSession *session;
+
+@end
+
+
+@implementation MQTTSessionTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.queue = dispatch_queue_create("com.ca.MASFoundationTests.session", DISPATCH_QUEUE_SERIAL);
+
+    self.transport = [[MQTTTestTransport alloc] init];
+    self.transport.queue = self.queue;
+    self.transport.connack = [MQTTTestTransport connack];
+
+    MQTTInMemoryPersistence *persistence = [[MQTTInMemoryPersistence alloc] init];
+    persistence.maxWindowSize = MQTTSessionTestsWindowSize;
+
+    self.session = [[MQTTSession alloc] init];
+    self.session.clientId = [NSUUID UUID].UUIDString;
+    self.session.persistence = persistence;
+    self.session.transport = self.transport;
+    self.session.queue = self.queue;
+}
+
+- (void)tearDown {
+    dispatch_sync(self.queue, ^{
+        [self.session closeWithDisconnectHandler:nil];
+    });
+
+    [super tearDown];
+}
+
+#pragma mark - Flow control
+
+- (void)testWindowLimitsInflightPublishes {
+    [self connect];
+
+    NSArray<NSNumber *> *messageIds = [self publishCount:4 qos:MQTTQosLevelAtLeastOnce];
+
+    NSArray<MQTTMessage *> *publishes = [self.transport sentMessagesOfType:MQTTPublish protocolLevel:self.session.protocolLevel];
+    XCTAssertEqual(publishes.count, MQTTSessionTestsWindowSize);
+    XCTAssertEqual([MQTTTestTransport messageIdOfPublish:publishes[0]], messageIds[0].unsignedShortValue);
+    XCTAssertEqual([MQTTTestTransport messageIdOfPublish:publishes[1]], messageIds[1].unsignedShortValue);
+}
+
+- (void)testAcknowledgementSendsQueuedPublishRightAway {
+    [self connect];
+
+    NSArray<NSNumber *> *messageIds = [self publishCount:4 qos:MQTTQosLevelAtLeastOnce];
+    [self.transport removeAllSentPackets];
+
+    //
+    //  The queued message is sent on the acknowledgement, without waiting for the dup timer
+    //
+    [self receivePacket:[MQTTTestTransport pubackWithMessageId:messageIds[0].unsignedShortValue protocolLevel:self.session.protocolLevel]];
+
+    NSArray<MQTTMessage *> *publishes = [self.transport sentMessagesOfType:MQTTPublish protocolLevel:self.session.protocolLevel];
+    XCTAssertEqual(publishes.count, 1);
+    XCTAssertEqual([MQTTTestTransport messageIdOfPublish:publishes[0]], messageIds[2].unsignedShortValue);
+    XCTAssertFalse(publishes[0].dupFlag);
+
+    [self receivePacket:[MQTTTestTransport pubackWithMessageId:messageIds[1].unsignedShortValue protocolLevel:self.session.protocolLevel]];
+    [self receivePacket:[MQTTTestTransport pubackWithMessageId:messageIds[2].unsignedShortValue protocolLevel:self.session.protocolLevel]];
+
+    publishes = [self.transport sentMessagesOfType:MQTTPublish protocolLevel:self.session.protocolLevel];
+    XCTAssertEqual(publishes.count, 2);
+    XCTAssertEqual([MQTTTestTransport messageIdOfPublish:publishes[1]], messageIds[3].unsignedShortValue);
+}
+
+- (void)testUnacknowledgedPublishIsResentWithDupFlag {
+    self.session.dupTimeout = 0.2;
+    [self connect];
+
+    UInt16 messageId = [self publishCount:1 qos:MQTTQosLevelAtLeastOnce].firstObject.unsignedShortValue;
+
+    [self waitForInterval:1.5];
+
+    NSArray<MQTTMessage *> *publishes = [self.transport sentMessagesOfType:MQTTPublish protocolLevel:self.session.protocolLevel];
+    XCTAssertGreaterThanOrEqual(publishes.count, 2);
+    XCTAssertFalse(publishes.firstObject.dupFlag);
+    XCTAssertTrue(publishes.lastObject.dupFlag);
+    XCTAssertEqual([MQTTTestTransport messageIdOfPublish:publishes.lastObject], messageId);
+
+    //
+    //  Once acknowledged, the message is not resent any more
+    //
+    [self receivePacket:[MQTTTestTransport pubackWithMessageId:messageId protocolLevel:self.session.protocolLevel]];
+    [self.transport removeAllSentPackets];
+    [self waitForInterval:1.5];
+
+    XCTAssertEqual([self.transport sentMessagesOfType:MQTTPublish protocolLevel:self.session.protocolLevel].count, 0);
+}
+
+#pragma mark - Receiving
+
+- (void)testReceivedMessageReachesMessageHandler {
+    NSMutableArray<NSString *> *topics = [NSMutableArray array];
+    NSMutableArray<NSData *> *messages = [NSMutableArray array];
+    self.session.messageHandler = ^(NSData *message, NSString *topic) {
+        [topics addObject:topic];
+        [messages addObject:[message copy]];
+    };
+    [self connect];
+
+    NSData *payload = [@"payload" dataUsingEncoding:NSUTF8StringEncoding];
+    [self receivePacket:[MQTTTestTransport publishWithTopic:@"mas/tests/0" payload:payload qos:MQTTQosLevelAtMostOnce messageId:0]];
+    [self receivePacket:[MQTTTestTransport publishWithTopic:@"mas/tests/1" payload:payload qos:MQTTQosLevelAtLeastOnce messageId:7]];
+
+    XCTAssertEqualObjects(topics, (@[@"mas/tests/0", @"mas/tests/1"]));
+    XCTAssertEqualObjects(messages, (@[payload, payload]));
+
+    //
+    //  The QoS 1 message is acknowledged
+    //
+    NSArray<MQTTMessage *> *pubacks = [self.transport sentMessagesOfType:MQTTPuback protocolLevel:self.session.protocolLevel];
+    XCTAssertEqual(pubacks.count, 1);
+    XCTAssertEqual(pubacks.firstObject.mid, 7);
+}
+
+- (void)testReceivedTopicsAreInterned {
+    NSMutableArray<NSString *> *topics = [NSMutableArray array];
+    self.session.messageHandler = ^(NSData *message, NSString *topic) {
+        [topics addObject:topic];
+    };
+    [self connect];
+
+    NSData *payload = [@"payload" dataUsingEncoding:NSUTF8StringEncoding];
+    [self receivePacket:[MQTTTestTransport publishWithTopic:@"mas/tests" payload:payload qos:MQTTQosLevelAtMostOnce messageId:0]];
+    [self receivePacket:[MQTTTestTransport publishWithTopic:@"mas/tests" payload:payload qos:MQTTQosLevelAtMostOnce messageId:0]];
+    [self receivePacket:[MQTTTestTransport publishWithTopic:@"mas/other" payload:payload qos:MQTTQosLevelAtMostOnce messageId:0]];
+
+    XCTAssertEqual(topics.count, 3);
+    XCTAssertTrue(topics[0] == topics[1]);
+    XCTAssertEqualObjects(topics[2], @"mas/other");
+}
+
+- (void)testEmptyPayloadIsDelivered {
+    __block NSData *received = nil;
+    self.session.messageHandler = ^(NSData *message, NSString *topic) {
+        received = message;
+    };
+    [self connect];
+
+    [self receivePacket:[MQTTTestTransport publishWithTopic:@"mas/tests" payload:[NSData data] qos:MQTTQosLevelAtMostOnce messageId:0]];
+
+    XCTAssertNotNil(received);
+    XCTAssertEqual(received.length, 0);
+}
+
+- (void)testSliceSharesBytesOfParent {
+    NSMutableData *parent = [NSMutableData dataWithLength:1024];
+    for (NSUInteger i = 0; i < parent.length; i++) {
+        ((UInt8 *)parent.mutableBytes)[i] = (UInt8)i;
+    }
+
+    NSRange range = NSMakeRange(100, 500);
+    NSData *slice = [parent mqttSliceWithRange:range];
+
+    XCTAssertEqual(slice.length, range.length);
+    XCTAssertTrue(slice.bytes == (const UInt8 *)parent.bytes + range.location);
+    XCTAssertEqualObjects(slice, [parent subdataWithRange:range]);
+
+    //
+    //  A slice of a slice still points into the original bytes
+    //
+    NSData *nestedSlice = [slice mqttSliceWithRange:NSMakeRange(10, 20)];
+    XCTAssertTrue(nestedSlice.bytes == (const UInt8 *)parent.bytes + range.location + 10);
+}
+
+#pragma mark - MQTT 5
+
+- (void)testServerReceiveMaximumCapsWindow {
+    self.session.protocolLevel = MQTTProtocolVersion50;
+    self.transport.connack = [MQTTTestTransport connackWithReceiveMaximum:@1 topicAliasMaximum:nil];
+    [self connect];
+
+    XCTAssertEqualObjects(self.session.serverReceiveMaximum, @1);
+    XCTAssertEqual(self.session.effectiveWindowSize, 1);
+
+    NSArray<NSNumber *> *messageIds = [self publishCount:3 qos:MQTTQosLevelAtLeastOnce];
+    XCTAssertEqual([self.transport sentMessagesOfType:MQTTPublish protocolLevel:MQTTProtocolVersion50].count, 1);
+
+    [self receivePacket:[MQTTTestTransport pubackWithMessageId:messageIds[0].unsignedShortValue protocolLevel:MQTTProtocolVersion50]];
+    NSArray<MQTTMessage *> *publishes = [self.transport sentMessagesOfType:MQTTPublish protocolLevel:MQTTProtocolVersion50];
+    XCTAssertEqual(publishes.count, 2);
+    XCTAssertEqual([MQTTTestTransport messageIdOfPublish:publishes[1]], messageIds[1].unsignedShortValue);
+}
+
+- (void)testTopicAliasesReplaceRepeatedTopics {
+    self.session.protocolLevel = MQTTProtocolVersion50;
+    self.transport.connack = [MQTTTestTransport connackWithReceiveMaximum:nil topicAliasMaximum:@2];
+    [self connect];
+
+    NSData *payload = [@"payload" dataUsingEncoding:NSUTF8StringEncoding];
+    dispatch_sync(self.queue, ^{
+        for (NSString *topic in @[@"mas/a", @"mas/a", @"mas/b", @"mas/c"]) {
+            [self.session publishData:payload onTopic:topic retain:NO qos:MQTTQosLevelAtMostOnce];
+        }
+    });
+
+    NSArray<MQTTMessage *> *publishes = [self.transport sentMessagesOfType:MQTTPublish protocolLevel:MQTTProtocolVersion50];
+    XCTAssertEqual(publishes.count, 4);
+
+    //
+    //  The topic is sent with its alias once, and only the alias afterwards
+    //
+    XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publishes[0]], @"mas/a");
+    XCTAssertEqualObjects([self topicAliasOfPublish:publishes[0]], @1);
+    XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publishes[1]], @"");
+    XCTAssertEqualObjects([self topicAliasOfPublish:publishes[1]], @1);
+    XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publishes[2]], @"mas/b");
+    XCTAssertEqualObjects([self topicAliasOfPublish:publishes[2]], @2);
+
+    //
+    //  No alias is left for a third topic
+    //
+    XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publishes[3]], @"mas/c");
+    XCTAssertNil([self topicAliasOfPublish:publishes[3]]);
+}
+
+- (void)testTopicAliasesAreNotUsedWithoutServerTopicAliasMaximum {
+    self.session.protocolLevel = MQTTProtocolVersion50;
+    self.transport.connack = [MQTTTestTransport connackWithReceiveMaximum:nil topicAliasMaximum:nil];
+    [self connect];
+
+    [self publishCount:2 qos:MQTTQosLevelAtMostOnce];
+
+    for (MQTTMessage *publish in [self.transport sentMessagesOfType:MQTTPublish protocolLevel:MQTTProtocolVersion50]) {
+        XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publish], @"mas/tests");
+        XCTAssertNil([self topicAliasOfPublish:publish]);
+    }
+}
+
+- (void)testResentFlowsUseLimitsOfNewConnection {
+    self.session.protocolLevel = MQTTProtocolVersion50;
+    self.session.cleanSessionFlag = NO;
+    self.transport.connack = [MQTTTestTransport connackWithReceiveMaximum:@1 topicAliasMaximum:@1];
+    [self connect];
+
+    [self publishCount:2 qos:MQTTQosLevelAtLeastOnce];
+    XCTAssertEqual([self.transport sentMessagesOfType:MQTTPublish protocolLevel:MQTTProtocolVersion50].count, 1);
+
+    dispatch_sync(self.queue, ^{
+        [self.session closeWithDisconnectHandler:nil];
+    });
+    [self.transport removeAllSentPackets];
+
+    //
+    //  The broker now allows both messages inflight; the alias announced on the previous connection is announced again
+    //
+    self.transport.connack = [MQTTTestTransport connackWithReceiveMaximum:@2 topicAliasMaximum:@1];
+    [self connect];
+
+    XCTAssertEqualObjects(self.session.serverReceiveMaximum, @2);
+
+    NSArray<MQTTMessage *> *publishes = [self.transport sentMessagesOfType:MQTTPublish protocolLevel:MQTTProtocolVersion50];
+    XCTAssertEqual(publishes.count, 2);
+    XCTAssertTrue(publishes[0].dupFlag);
+    XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publishes[0]], @"mas/tests");
+    XCTAssertEqualObjects([self topicAliasOfPublish:publishes[0]], @1);
+    XCTAssertFalse(publishes[1].dupFlag);
+    XCTAssertEqualObjects([MQTTTestTransport topicOfPublish:publishes[1]], @"");
+    XCTAssertEqualObjects([self topicAliasOfPublish:publishes[1]], @1);
+}
+
+#pragma mark - Helpers
+
+- (void)connect {
+    [self.session connect];
+    [self drainQueue];
+
+    XCTAssertEqual(self.session.status, MQTTSessionStatusConnected);
+}
+
+- (NSArray<NSNumber *> *)publishCount:(NSUInteger)count qos:(MQTTQosLevel)qos {
+    NSMutableArray *messageIds = [NSMutableArray arrayWithCapacity:count];
+    dispatch_sync(self.queue, ^{
+        for (NSUInteger i = 0; i < count; i++) {
+            NSData *payload = [[NSString stringWithFormat:@"message %lu", (unsigned long)i] dataUsingEncoding:NSUTF8StringEncoding];
+            [messageIds addObject:@([self.session publishData:payload onTopic:@"mas/tests" retain:NO qos:qos])];
+        }
+    });
+
+    return messageIds;
+}
+
+- (void)receivePacket:(NSData *)packet {
+    [self.transport receivePacket:packet];
+    [self drainQueue];
+}
+
+//
+//  The transport opens, and the decoder delivers received packets, asynchronously on the session's queue
+//
+- (void)drainQueue {
+    for (NSUInteger i = 0; i < 3; i++) {
+        dispatch_sync(self.queue, ^{});
+    }
+}
+
+- (NSNumber *)topicAliasOfPublish:(MQTTMessage *)publish {
+    return [MQTTTestTransport propertiesOfPublish:publish protocolLevel:MQTTProtocolVersion50].topicAlias;
+}
+
+- (void)waitForInterval:(NSTimeInterval)interval {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"interval"];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(interval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:interval + 1 handler:nil];
+    [self drainQueue];
+}
+
+@end
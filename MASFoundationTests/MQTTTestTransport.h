@@ -0,0 +1,56 @@
+//
+//  MQTTTestTransport.h
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MQTTMessage.h"
+#import "MQTTProperties.h"
+#import "MQTTTransport.h"
+
+
+//
+//  An in-memory transport standing in for the broker: packets sent by the session are recorded,
+//  and packets of the broker are injected with receivePacket:
+//
+@interface MQTTTestTransport : MQTTTransport
+
+//  Wire format of every packet sent through the transport, in order
+@property (atomic, strong, readonly) NSArray<NSData *> *sentPackets;
+
+//  Packet the transport answers CONNECT with; nil leaves the session connecting
+@property (atomic, strong) NSData *connack;
+
+//  Whether send: fails, the way a transport does while its output buffer is full
+@property (atomic, assign) BOOL refusesSend;
+
+- (void)receivePacket:(NSData *)packet;
+
+- (void)removeAllSentPackets;
+
+- (NSArray<MQTTMessage *> *)sentMessagesOfType:(MQTTCommandType)type protocolLevel:(MQTTProtocolVersion)protocolLevel;
+
++ (NSData *)packetWithType:(MQTTCommandType)type flags:(UInt8)flags body:(NSData *)body;
+
++ (NSData *)connack;
+
++ (NSData *)connackWithReceiveMaximum:(NSNumber *)receiveMaximum topicAliasMaximum:(NSNumber *)topicAliasMaximum;
+
++ (NSData *)pubackWithMessageId:(UInt16)messageId protocolLevel:(MQTTProtocolVersion)protocolLevel;
+
++ (NSData *)publishWithTopic:(NSString *)topic payload:(NSData *)payload qos:(MQTTQosLevel)qos messageId:(UInt16)messageId;
+
+//  The variable header of a sent PUBLISH, which MQTTMessage does not parse
++ (NSString *)topicOfPublish:(MQTTMessage *)publish;
+
++ (UInt16)messageIdOfPublish:(MQTTMessage *)publish;
+
++ (MQTTProperties *)propertiesOfPublish:(MQTTMessage *)publish protocolLevel:(MQTTProtocolVersion)protocolLevel;
+
+@end
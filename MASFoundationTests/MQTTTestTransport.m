@@ -0,0 +1,192 @@
+//
+//  MQTTTestTransport.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import "MQTTTestTransport.h"
+
+
+@interface MQTTTestTransport ()
+
+@property (nonatomic, strong) NSMutableArray<NSData *> *packets;
+
+@end
+
+
+@implementation MQTTTestTransport
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _packets = [NSMutableArray array];
+        self.queue = dispatch_get_main_queue();
+        self.host = @"localhost";
+        self.port = 1883;
+    }
+
+    return self;
+}
+
+#pragma mark - MQTTTransport
+
+- (void)open {
+    self.state = MQTTTransportOpen;
+    dispatch_async(self.queue, ^{
+        [self.delegate mqttTransportDidOpen:self];
+    });
+}
+
+- (void)close {
+    self.state = MQTTTransportClosed;
+}
+
+- (BOOL)send:(NSData *)data {
+    if (self.refusesSend) {
+        return NO;
+    }
+
+    @synchronized (self.packets) {
+        [self.packets addObject:[data copy]];
+    }
+
+    //
+    //  The broker accepts the connection right away
+    //
+    const UInt8 *bytes = data.bytes;
+    NSData *connack = self.connack;
+    if (data.length && (bytes[0] >> 4) == MQTTConnect && connack) {
+        [self receivePacket:connack];
+    }
+
+    return YES;
+}
+
+#pragma mark - Broker
+
+- (void)receivePacket:(NSData *)packet {
+    [self.delegate mqttTransport:self didReceiveMessage:packet];
+}
+
+- (NSArray<NSData *> *)sentPackets {
+    @synchronized (self.packets) {
+        return [self.packets copy];
+    }
+}
+
+- (void)removeAllSentPackets {
+    @synchronized (self.packets) {
+        [self.packets removeAllObjects];
+    }
+}
+
+- (NSArray<MQTTMessage *> *)sentMessagesOfType:(MQTTCommandType)type protocolLevel:(MQTTProtocolVersion)protocolLevel {
+    NSMutableArray *messages = [NSMutableArray array];
+    for (NSData *packet in self.sentPackets) {
+        MQTTMessage *message = [MQTTMessage messageFromData:packet protocolLevel:protocolLevel];
+        if (message.type == type) {
+            [messages addObject:message];
+        }
+    }
+
+    return messages;
+}
+
+#pragma mark - Packets
+
++ (NSData *)packetWithType:(MQTTCommandType)type flags:(UInt8)flags body:(NSData *)body {
+    NSMutableData *packet = [NSMutableData data];
+    [packet appendByte:(UInt8)(type << 4) | flags];
+    [packet appendVariableLength:body.length];
+    if (body.length) {
+        [packet appendData:body];
+    }
+
+    return packet;
+}
+
++ (NSData *)connack {
+    const UInt8 body[] = { 0x00, MQTTAccepted };
+
+    return [self packetWithType:MQTTConnack flags:0 body:[NSData dataWithBytes:body length:sizeof(body)]];
+}
+
++ (NSData *)connackWithReceiveMaximum:(NSNumber *)receiveMaximum topicAliasMaximum:(NSNumber *)topicAliasMaximum {
+    NSMutableData *properties = [NSMutableData data];
+    if (receiveMaximum) {
+        [properties appendByte:MQTTReceiveMaximum];
+        [properties appendUInt16BigEndian:receiveMaximum.unsignedShortValue];
+    }
+    if (topicAliasMaximum) {
+        [properties appendByte:MQTTTopicAliasMaximum];
+        [properties appendUInt16BigEndian:topicAliasMaximum.unsignedShortValue];
+    }
+
+    NSMutableData *body = [NSMutableData data];
+    [body appendByte:0x00];
+    [body appendByte:MQTTSuccess];
+    [body appendVariableLength:properties.length];
+    [body appendData:properties];
+
+    return [self packetWithType:MQTTConnack flags:0 body:body];
+}
+
++ (NSData *)pubackWithMessageId:(UInt16)messageId protocolLevel:(MQTTProtocolVersion)protocolLevel {
+    NSMutableData *body = [NSMutableData data];
+    [body appendUInt16BigEndian:messageId];
+    if (protocolLevel == MQTTProtocolVersion50) {
+        [body appendByte:MQTTSuccess];
+        [body appendVariableLength:0];
+    }
+
+    return [self packetWithType:MQTTPuback flags:0 body:body];
+}
+
++ (NSData *)publishWithTopic:(NSString *)topic payload:(NSData *)payload qos:(MQTTQosLevel)qos messageId:(UInt16)messageId {
+    NSMutableData *body = [NSMutableData data];
+    [body appendMQTTString:topic];
+    if (qos != MQTTQosLevelAtMostOnce) {
+        [body appendUInt16BigEndian:messageId];
+    }
+    [body appendData:payload];
+
+    return [self packetWithType:MQTTPublish flags:(UInt8)(qos << 1) body:body];
+}
+
++ (NSString *)topicOfPublish:(MQTTMessage *)publish {
+    const UInt8 *bytes = publish.data.bytes;
+    UInt16 topicLength = 256 * bytes[0] + bytes[1];
+
+    return [[NSString alloc] initWithBytes:bytes + 2 length:topicLength encoding:NSUTF8StringEncoding];
+}
+
++ (UInt16)messageIdOfPublish:(MQTTMessage *)publish {
+    if (publish.qos == MQTTQosLevelAtMostOnce) {
+        return 0;
+    }
+
+    const UInt8 *bytes = publish.data.bytes;
+    NSUInteger offset = 2 + 256 * bytes[0] + bytes[1];
+
+    return 256 * bytes[offset] + bytes[offset + 1];
+}
+
++ (MQTTProperties *)propertiesOfPublish:(MQTTMessage *)publish protocolLevel:(MQTTProtocolVersion)protocolLevel {
+    if (protocolLevel != MQTTProtocolVersion50) {
+        return nil;
+    }
+
+    const UInt8 *bytes = publish.data.bytes;
+    NSUInteger offset = 2 + 256 * bytes[0] + bytes[1];
+    if (publish.qos != MQTTQosLevelAtMostOnce) {
+        offset += 2;
+    }
+
+    return [[MQTTProperties alloc] initFromData:[publish.data subdataWithRange:NSMakeRange(offset, publish.data.length - offset)]];
+}
+
+@end
@@ -0,0 +1,658 @@
+//
+//  MQTTWebsocketTransportTests.m
+//  MASFoundationTests
+//
+//  Copyright (c) 2018 CA. All rights reserved.
+//
+//  This software may be modified and distributed under the terms
+//  of the MIT license. See the LICENSE file for details.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <MASFoundation/MASFoundation.h>
+
+#import "MQTTMessage.h"
+#import "MQTTWebsocketTransport.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static NSUInteger const MQTTWebsocketTransportTestsPublishLength = 16 * 1024;
+static NSUInteger const MQTTWebsocketTransportTestsMaxBufferedAmount = 64 * 1024;
+
+//
+//  Random payloads do not compress, so any saving on a repeated one comes from the previous message's window
+//
+static NSUInteger const MQTTWebsocketTransportTestsRandomPayloadLength = 1000;
+static NSUInteger const MQTTWebsocketTransportTestsFragmentLength = 100;
+
+static const UInt8 MQTTWebsocketTransportTestsDeflateTail[4] = {0x00, 0x00, 0xff, 0xff};
+
+
+#pragma mark - MQTTWebsocketEchoFrame
+
+//
+//  A message received by the echo broker, as it arrived on the wire and after inflating
+//
+@interface MQTTWebsocketEchoFrame : NSObject
+
+@property (nonatomic, assign) BOOL compressed;
+@property (nonatomic, assign) NSUInteger wireLength;
+@property (nonatomic, strong) NSData *payload;
+
+@end
+
+
+@implementation MQTTWebsocketEchoFrame
+
+@end
+
+
+#pragma mark - MQTTWebsocketEchoBroker
+
+//
+//  A websocket server on the loopback address which answers the upgrade request and echoes every frame it receives.
+//  While paused, it stops reading after the upgrade, so the socket buffers fill up and the client has to buffer.
+//  With extensions, it answers a permessage-deflate offer with them, inflates compressed messages and echoes them
+//  compressed, split into frames of fragmentLength bytes when set.
+//
+@interface MQTTWebsocketEchoBroker : NSObject
+
+@property (nonatomic, assign, readonly) UInt32 port;
+@property (nonatomic, assign) NSUInteger fragmentLength;
+@property (nonatomic, copy, readonly) NSString *offeredExtensions;
+@property (nonatomic, copy, readonly) NSArray<MQTTWebsocketEchoFrame *> *receivedFrames;
+
+- (instancetype)initPaused:(BOOL)paused;
+- (instancetype)initPaused:(BOOL)paused extensions:(NSString *)extensions;
+- (void)resume;
+- (void)stop;
+
+@end
+
+
+@implementation MQTTWebsocketEchoBroker {
+    int _listenFd;
+    int _connectionFd;
+    dispatch_semaphore_t _resumeSemaphore;
+    NSString *_extensions;
+    BOOL _compressionNegotiated;
+    BOOL _clientNoContextTakeover;
+    BOOL _serverNoContextTakeover;
+    z_stream _deflater;
+    z_stream _inflater;
+    NSMutableArray<MQTTWebsocketEchoFrame *> *_receivedFrames;
+}
+
+- (instancetype)initPaused:(BOOL)paused {
+    return [self initPaused:paused extensions:nil];
+}
+
+- (instancetype)initPaused:(BOOL)paused extensions:(NSString *)extensions {
+    self = [super init];
+    if (self) {
+        _connectionFd = -1;
+        _resumeSemaphore = dispatch_semaphore_create(paused ? 0 : 1);
+        _extensions = [extensions copy];
+        _clientNoContextTakeover = [extensions containsString:@"client_no_context_takeover"];
+        _serverNoContextTakeover = [extensions containsString:@"server_no_context_takeover"];
+        _receivedFrames = [NSMutableArray array];
+        deflateInit2(&_deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        inflateInit2(&_inflater, -MAX_WBITS);
+
+        _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int receiveBufferSize = 4096;
+        setsockopt(_listenFd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+
+        struct sockaddr_in address = {0};
+        address.sin_len = sizeof(address);
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t addressLength = sizeof(address);
+        if (bind(_listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+            listen(_listenFd, 1) != 0 ||
+            getsockname(_listenFd, (struct sockaddr *)&address, &addressLength) != 0) {
+            return nil;
+        }
+        _port = ntohs(address.sin_port);
+
+        [NSThread detachNewThreadSelector:@selector(serve) toTarget:self withObject:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    deflateEnd(&_deflater);
+    inflateEnd(&_inflater);
+}
+
+- (NSArray<MQTTWebsocketEchoFrame *> *)receivedFrames {
+    @synchronized (self) {
+        return [_receivedFrames copy];
+    }
+}
+
+- (void)resume {
+    dispatch_semaphore_signal(_resumeSemaphore);
+}
+
+- (void)stop {
+    shutdown(_listenFd, SHUT_RDWR);
+    close(_listenFd);
+    if (_connectionFd >= 0) {
+        shutdown(_connectionFd, SHUT_RDWR);
+    }
+    [self resume];
+}
+
+- (void)serve {
+    int fd = accept(_listenFd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    _connectionFd = fd;
+
+    if ([self upgradeConnection:fd]) {
+        dispatch_semaphore_wait(_resumeSemaphore, DISPATCH_TIME_FOREVER);
+        while ([self echoFrame:fd]) {
+        }
+    }
+    close(fd);
+}
+
+- (BOOL)upgradeConnection:(int)fd {
+    NSMutableData *request = [NSMutableData data];
+    NSData *end = [NSData dataWithBytes:"\r\n\r\n" length:4];
+    while ([request rangeOfData:end options:0 range:NSMakeRange(0, request.length)].location == NSNotFound) {
+        UInt8 byte;
+        if (read(fd, &byte, 1) != 1) {
+            return NO;
+        }
+        [request appendBytes:&byte length:1];
+    }
+
+    NSString *key = nil;
+    for (NSString *line in [[[NSString alloc] initWithData:request encoding:NSUTF8StringEncoding] componentsSeparatedByString:@"\r\n"]) {
+        if ([line.lowercaseString hasPrefix:@"sec-websocket-key:"]) {
+            key = [[line substringFromIndex:@"sec-websocket-key:".length] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        } else if ([line.lowercaseString hasPrefix:@"sec-websocket-extensions:"]) {
+            @synchronized (self) {
+                _offeredExtensions = [[line substringFromIndex:@"sec-websocket-extensions:".length] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+            }
+        }
+    }
+    _compressionNegotiated = _extensions && [_offeredExtensions hasPrefix:@"permessage-deflate"];
+    NSData *input = [[key stringByAppendingString:@"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"] dataUsingEncoding:NSUTF8StringEncoding];
+    UInt8 digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(input.bytes, (CC_LONG)input.length, digest);
+    NSString *accept = [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+
+    NSMutableString *response = [NSMutableString stringWithFormat:@"HTTP/1.1 101 Switching Protocols\r\n"
+                                 "Upgrade: websocket\r\n"
+                                 "Connection: Upgrade\r\n"
+                                 "Sec-WebSocket-Accept: %@\r\n"
+                                 "Sec-WebSocket-Protocol: mqtt\r\n", accept];
+    if (_compressionNegotiated) {
+        [response appendFormat:@"Sec-WebSocket-Extensions: %@\r\n", _extensions];
+    }
+    [response appendString:@"\r\n"];
+    return [self writeData:[response dataUsingEncoding:NSUTF8StringEncoding] toFile:fd];
+}
+
+- (BOOL)echoFrame:(int)fd {
+    UInt8 header[2];
+    if (![self readBytes:header length:sizeof(header) fromFile:fd]) {
+        return NO;
+    }
+    UInt8 opcode = header[0] & 0x0f;
+    BOOL compressed = (header[0] & 0x40) != 0;
+    UInt64 length = header[1] & 0x7f;
+    if (length >= 126) {
+        UInt8 extendedLength[8];
+        NSUInteger extendedLengthLength = length == 126 ? 2 : 8;
+        if (![self readBytes:extendedLength length:extendedLengthLength fromFile:fd]) {
+            return NO;
+        }
+        length = 0;
+        for (NSUInteger i = 0; i < extendedLengthLength; i++) {
+            length = (length << 8) | extendedLength[i];
+        }
+    }
+    UInt8 mask[4] = {0};
+    if ((header[1] & 0x80) && ![self readBytes:mask length:sizeof(mask) fromFile:fd]) {
+        return NO;
+    }
+    NSMutableData *payload = [NSMutableData dataWithLength:(NSUInteger)length];
+    if (![self readBytes:payload.mutableBytes length:payload.length fromFile:fd]) {
+        return NO;
+    }
+    UInt8 *bytes = payload.mutableBytes;
+    for (NSUInteger i = 0; i < payload.length; i++) {
+        bytes[i] ^= mask[i & 3];
+    }
+
+    MQTTWebsocketEchoFrame *received = [[MQTTWebsocketEchoFrame alloc] init];
+    received.compressed = compressed;
+    received.wireLength = payload.length;
+    received.payload = compressed ? [self inflate:payload] : payload;
+    @synchronized (self) {
+        [_receivedFrames addObject:received];
+    }
+    if (!received.payload) {
+        return NO;
+    }
+
+    NSData *echo = compressed ? [self deflate:received.payload] : received.payload;
+    NSUInteger fragmentLength = self.fragmentLength && opcode < 0x8 ? self.fragmentLength : MAX(echo.length, 1);
+    for (NSUInteger offset = 0; offset == 0 || offset < echo.length; offset += fragmentLength) {
+        NSUInteger frameLength = MIN(fragmentLength, echo.length - offset);
+        BOOL final = offset + frameLength == echo.length;
+        UInt8 first = (final ? 0x80 : 0x00) | (offset == 0 ? opcode | (compressed ? 0x40 : 0x00) : 0x0);
+        if (![self writeFrameWithFirstByte:first payload:[echo subdataWithRange:NSMakeRange(offset, frameLength)] toFile:fd]) {
+            return NO;
+        }
+    }
+    return opcode != 0x8;
+}
+
+//
+//  Server frames are not masked
+//
+- (BOOL)writeFrameWithFirstByte:(UInt8)first payload:(NSData *)payload toFile:(int)fd {
+    NSMutableData *frame = [NSMutableData data];
+    NSUInteger length = payload.length;
+    [frame appendBytes:&first length:1];
+    if (length < 126) {
+        UInt8 second = (UInt8)length;
+        [frame appendBytes:&second length:1];
+    } else if (length <= 0xffff) {
+        UInt8 second[3] = {126, (UInt8)(length >> 8), (UInt8)length};
+        [frame appendBytes:second length:sizeof(second)];
+    } else {
+        UInt8 second = 127;
+        [frame appendBytes:&second length:1];
+        for (int i = 0; i < 8; i++) {
+            UInt8 byte = (UInt8)((UInt64)length >> (56 - 8 * i));
+            [frame appendBytes:&byte length:1];
+        }
+    }
+    [frame appendData:payload];
+
+    return [self writeData:frame toFile:fd];
+}
+
+- (NSData *)inflate:(NSData *)payload {
+    NSMutableData *input = [NSMutableData dataWithData:payload];
+    [input appendBytes:MQTTWebsocketTransportTestsDeflateTail length:sizeof(MQTTWebsocketTransportTestsDeflateTail)];
+    NSMutableData *output = [NSMutableData data];
+
+    _inflater.next_in = (Bytef *)input.bytes;
+    _inflater.avail_in = (uInt)input.length;
+    do {
+        NSUInteger used = output.length;
+        [output increaseLengthBy:4096];
+        _inflater.next_out = (Bytef *)output.mutableBytes + used;
+        _inflater.avail_out = 4096;
+        int status = inflate(&_inflater, Z_SYNC_FLUSH);
+        output.length -= _inflater.avail_out;
+        if (status != Z_OK && status != Z_BUF_ERROR) {
+            return nil;
+        } else if (status == Z_BUF_ERROR) {
+            break;
+        }
+    } while (_inflater.avail_in > 0 || _inflater.avail_out == 0);
+
+    if (_clientNoContextTakeover) {
+        inflateReset(&_inflater);
+    }
+    return output;
+}
+
+- (NSData *)deflate:(NSData *)payload {
+    NSMutableData *output = [NSMutableData dataWithLength:deflateBound(&_deflater, payload.length) + 16];
+    _deflater.next_in = (Bytef *)payload.bytes;
+    _deflater.avail_in = (uInt)payload.length;
+    _deflater.next_out = output.mutableBytes;
+    _deflater.avail_out = (uInt)output.length;
+    deflate(&_deflater, Z_SYNC_FLUSH);
+    output.length -= _deflater.avail_out + sizeof(MQTTWebsocketTransportTestsDeflateTail);
+
+    if (_serverNoContextTakeover) {
+        deflateReset(&_deflater);
+    }
+    return output;
+}
+
+- (BOOL)readBytes:(void *)bytes length:(NSUInteger)length fromFile:(int)fd {
+    NSUInteger received = 0;
+    while (received < length) {
+        ssize_t result = read(fd, (UInt8 *)bytes + received, length - received);
+        if (result <= 0) {
+            return NO;
+        }
+        received += result;
+    }
+    return YES;
+}
+
+- (BOOL)writeData:(NSData *)data toFile:(int)fd {
+    NSUInteger written = 0;
+    while (written < data.length) {
+        ssize_t result = write(fd, (const UInt8 *)data.bytes + written, data.length - written);
+        if (result <= 0) {
+            return NO;
+        }
+        written += result;
+    }
+    return YES;
+}
+
+@end
+
+
+#pragma mark - MQTTWebsocketTransportTests
+
+@interface MQTTWebsocketTransportTests : XCTestCase <MQTTTransportDelegate>
+
+@property (nonatomic, strong) MQTTWebsocketEchoBroker *broker;
+@property (nonatomic, strong) MQTTWebsocketTransport *transport;
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) NSMutableData *receivedData;
+@property (nonatomic, assign) NSUInteger expectedLength;
+@property (nonatomic, strong) XCTestExpectation *openExpectation;
+@property (nonatomic, strong) XCTestExpectation *receiveExpectation;
+
+@end
+
+
+@implementation MQTTWebsocketTransportTests
+
+- (void)tearDown {
+    if (self.queue) {
+        dispatch_sync(self.queue, ^{
+            [self.transport close];
+        });
+    }
+    [self.broker stop];
+    self.transport = nil;
+    self.broker = nil;
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (void)openTransportWithBrokerPaused:(BOOL)paused {
+    [self openTransportWithBroker:[[MQTTWebsocketEchoBroker alloc] initPaused:paused] compression:NO];
+}
+
+- (void)openTransportWithBroker:(MQTTWebsocketEchoBroker *)broker compression:(BOOL)compression {
+    self.broker = broker;
+    XCTAssertNotNil(self.broker);
+
+    self.queue = dispatch_queue_create("com.ca.MASFoundationTests.websocket", DISPATCH_QUEUE_SERIAL);
+    self.receivedData = [NSMutableData data];
+
+    self.transport = [[MQTTWebsocketTransport alloc] init];
+    self.transport.host = @"127.0.0.1";
+    self.transport.port = self.broker.port;
+    self.transport.tls = NO;
+    self.transport.compression = compression;
+    self.transport.maxBufferedAmount = MQTTWebsocketTransportTestsMaxBufferedAmount;
+    self.transport.queue = self.queue;
+    self.transport.delegate = self;
+
+    self.openExpectation = [self expectationWithDescription:@"websocket open"];
+    dispatch_sync(self.queue, ^{
+        [self.transport open];
+    });
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (NSData *)publishFixedHeaderWithRemainingLength:(NSUInteger)remainingLength {
+    NSMutableData *fixedHeader = [NSMutableData data];
+    UInt8 type = MQTTPublish << 4;
+    [fixedHeader appendBytes:&type length:1];
+    do {
+        UInt8 digit = remainingLength % 128;
+        remainingLength /= 128;
+        if (remainingLength > 0) {
+            digit |= 0x80;
+        }
+        [fixedHeader appendBytes:&digit length:1];
+    } while (remainingLength > 0);
+    return fixedHeader;
+}
+
+- (NSData *)randomDataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+//
+//  Sends the packet count times and waits until every copy was echoed back
+//
+- (NSData *)echoPublishWithPayload:(NSData *)payload count:(NSUInteger)count {
+    NSData *fixedHeader = [self publishFixedHeaderWithRemainingLength:payload.length];
+    NSMutableData *expected = [NSMutableData data];
+    for (NSUInteger i = 0; i < count; i++) {
+        [expected appendData:fixedHeader];
+        [expected appendData:payload];
+    }
+
+    self.receiveExpectation = [self expectationWithDescription:@"publish echoed"];
+    dispatch_sync(self.queue, ^{
+        self.receivedData.length = 0;
+        self.expectedLength = expected.length;
+    });
+    for (NSUInteger i = 0; i < count; i++) {
+        XCTAssertTrue([self sendFixedHeader:fixedHeader data:payload]);
+    }
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    dispatch_sync(self.queue, ^{
+        XCTAssertEqualObjects(self.receivedData, expected);
+    });
+
+    NSMutableData *packet = [NSMutableData dataWithData:fixedHeader];
+    [packet appendData:payload];
+    return packet;
+}
+
+- (BOOL)sendFixedHeader:(NSData *)fixedHeader data:(NSData *)data {
+    __block BOOL sent = NO;
+    dispatch_sync(self.queue, ^{
+        sent = [self.transport sendFixedHeader:fixedHeader.bytes length:fixedHeader.length data:data];
+    });
+    return sent;
+}
+
+#pragma mark - MQTTTransportDelegate
+
+- (void)mqttTransportDidOpen:(id<MQTTTransport>)mqttTransport {
+    [self.openExpectation fulfill];
+}
+
+- (void)mqttTransport:(id<MQTTTransport>)mqttTransport didReceiveMessage:(NSData *)message {
+    [self.receivedData appendData:message];
+    if (self.expectedLength && self.receivedData.length >= self.expectedLength) {
+        self.expectedLength = 0;
+        [self.receiveExpectation fulfill];
+    }
+}
+
+- (void)mqttTransport:(id<MQTTTransport>)mqttTransport didFailWithError:(NSError *)error {
+    XCTFail(@"transport failed %@", error);
+}
+
+- (void)mqttTransportDidClose:(id<MQTTTransport>)mqttTransport {
+}
+
+#pragma mark - Echo
+
+- (void)testPacketsAreEchoed {
+    [self openTransportWithBrokerPaused:NO];
+
+    NSData *payload = [NSMutableData dataWithLength:1000];
+    NSData *fixedHeader = [self publishFixedHeaderWithRemainingLength:payload.length];
+    NSMutableData *expected = [NSMutableData dataWithData:fixedHeader];
+    [expected appendData:payload];
+
+    self.receiveExpectation = [self expectationWithDescription:@"publish echoed"];
+    dispatch_sync(self.queue, ^{
+        self.expectedLength = expected.length;
+    });
+    XCTAssertTrue([self sendFixedHeader:fixedHeader data:payload]);
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    dispatch_sync(self.queue, ^{
+        XCTAssertEqualObjects(self.receivedData, expected);
+    });
+}
+
+#pragma mark - Compression
+
+- (void)testCompressedPacketsAreEchoedWithContextTakeover {
+    [self openTransportWithBroker:[[MQTTWebsocketEchoBroker alloc] initPaused:NO extensions:@"permessage-deflate"] compression:YES];
+    XCTAssertEqualObjects(self.broker.offeredExtensions, @"permessage-deflate");
+    XCTAssertTrue(self.transport.compressionNegotiated);
+
+    NSData *payload = [self randomDataWithLength:MQTTWebsocketTransportTestsRandomPayloadLength];
+    NSData *packet = [self echoPublishWithPayload:payload count:3];
+
+    //
+    //  The fixed header and data are deflated into a single message
+    //
+    NSArray<MQTTWebsocketEchoFrame *> *frames = self.broker.receivedFrames;
+    XCTAssertEqual(frames.count, 3);
+    for (MQTTWebsocketEchoFrame *frame in frames) {
+        XCTAssertTrue(frame.compressed);
+        XCTAssertEqualObjects(frame.payload, packet);
+    }
+
+    //
+    //  Later copies refer back to the first one instead of repeating its incompressible bytes
+    //
+    XCTAssertGreaterThanOrEqual(frames[0].wireLength, payload.length);
+    XCTAssertLessThan(frames[1].wireLength, payload.length / 10);
+    XCTAssertLessThan(frames[2].wireLength, payload.length / 10);
+}
+
+- (void)testCompressedPacketsAreEchoedWithoutContextTakeover {
+    NSString *extensions = @"permessage-deflate; client_no_context_takeover; server_no_context_takeover";
+    [self openTransportWithBroker:[[MQTTWebsocketEchoBroker alloc] initPaused:NO extensions:extensions] compression:YES];
+    XCTAssertTrue(self.transport.compressionNegotiated);
+
+    NSData *payload = [self randomDataWithLength:MQTTWebsocketTransportTestsRandomPayloadLength];
+    NSData *packet = [self echoPublishWithPayload:payload count:3];
+
+    //
+    //  Every message is compressed on its own, so the broker inflates each one with a fresh context
+    //
+    NSArray<MQTTWebsocketEchoFrame *> *frames = self.broker.receivedFrames;
+    XCTAssertEqual(frames.count, 3);
+    for (MQTTWebsocketEchoFrame *frame in frames) {
+        XCTAssertTrue(frame.compressed);
+        XCTAssertEqualObjects(frame.payload, packet);
+        XCTAssertEqual(frame.wireLength, frames[0].wireLength);
+    }
+}
+
+- (void)testCompressedMessageIsInflatedAcrossFrames {
+    MQTTWebsocketEchoBroker *broker = [[MQTTWebsocketEchoBroker alloc] initPaused:NO extensions:@"permessage-deflate"];
+    broker.fragmentLength = MQTTWebsocketTransportTestsFragmentLength;
+    [self openTransportWithBroker:broker compression:YES];
+
+    //
+    //  A compressible packet followed by an incompressible one split into many continuation frames
+    //
+    NSData *text = [[@"" stringByPaddingToLength:4000 withString:@"{\"temperature\":21.5}" startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    [self echoPublishWithPayload:text count:1];
+    [self echoPublishWithPayload:[self randomDataWithLength:4 * MQTTWebsocketTransportTestsRandomPayloadLength] count:2];
+}
+
+- (void)testShortPacketsAreSentUncompressed {
+    [self openTransportWithBroker:[[MQTTWebsocketEchoBroker alloc] initPaused:NO extensions:@"permessage-deflate"] compression:YES];
+
+    const UInt8 pingreq[2] = {MQTTPingreq << 4, 0x00};
+    NSData *packet = [NSData dataWithBytes:pingreq length:sizeof(pingreq)];
+
+    self.receiveExpectation = [self expectationWithDescription:@"pingreq echoed"];
+    dispatch_sync(self.queue, ^{
+        self.expectedLength = packet.length;
+    });
+    XCTAssertTrue([self sendFixedHeader:packet data:nil]);
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertFalse(self.broker.receivedFrames[0].compressed);
+    XCTAssertEqualObjects(self.broker.receivedFrames[0].payload, packet);
+    dispatch_sync(self.queue, ^{
+        XCTAssertEqualObjects(self.receivedData, packet);
+    });
+}
+
+- (void)testCompressionDeclinedByBroker {
+    [self openTransportWithBroker:[[MQTTWebsocketEchoBroker alloc] initPaused:NO] compression:YES];
+    XCTAssertEqualObjects(self.broker.offeredExtensions, @"permessage-deflate");
+    XCTAssertFalse(self.transport.compressionNegotiated);
+
+    NSData *packet = [self echoPublishWithPayload:[self randomDataWithLength:MQTTWebsocketTransportTestsRandomPayloadLength] count:1];
+    XCTAssertFalse(self.broker.receivedFrames[0].compressed);
+    XCTAssertEqualObjects(self.broker.receivedFrames[0].payload, packet);
+}
+
+#pragma mark - Backpressure
+
+- (void)testOnlyPublishIsRefusedWhileBuffered {
+    [self openTransportWithBrokerPaused:YES];
+
+    NSData *payload = [NSMutableData dataWithLength:MQTTWebsocketTransportTestsPublishLength];
+    NSData *publishHeader = [self publishFixedHeaderWithRemainingLength:payload.length];
+
+    //
+    //  The broker does not read, so the socket buffers fill up and the transport starts buffering
+    //
+    NSUInteger sentLength = 0;
+    BOOL refused = NO;
+    for (NSUInteger i = 0; i < 10000 && !refused; i++) {
+        if ([self sendFixedHeader:publishHeader data:payload]) {
+            sentLength += publishHeader.length + payload.length;
+        } else {
+            refused = YES;
+        }
+    }
+    XCTAssertTrue(refused, @"PUBLISH is refused once maxBufferedAmount is reached");
+    XCTAssertGreaterThan(self.transport.bufferedAmount, 0);
+
+    //
+    //  Control and acknowledgement packets are still sent
+    //
+    const UInt8 pingreq[2] = {MQTTPingreq << 4, 0x00};
+    const UInt8 puback[4] = {MQTTPuback << 4, 0x02, 0x00, 0x01};
+    XCTAssertTrue([self sendFixedHeader:[NSData dataWithBytes:pingreq length:sizeof(pingreq)] data:nil]);
+    XCTAssertTrue([self sendFixedHeader:[NSData dataWithBytes:puback length:sizeof(puback)] data:nil]);
+    sentLength += sizeof(pingreq) + sizeof(puback);
+
+    self.receiveExpectation = [self expectationWithDescription:@"buffered packets echoed"];
+    dispatch_sync(self.queue, ^{
+        self.expectedLength = sentLength;
+    });
+    [self.broker resume];
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+
+    dispatch_sync(self.queue, ^{
+        XCTAssertEqual(self.receivedData.length, sentLength);
+        NSData *tail = [self.receivedData subdataWithRange:NSMakeRange(sentLength - 6, 6)];
+        const UInt8 expectedTail[6] = {MQTTPingreq << 4, 0x00, MQTTPuback << 4, 0x02, 0x00, 0x01};
+        XCTAssertEqualObjects(tail, [NSData dataWithBytes:expectedTail length:sizeof(expectedTail)]);
+    });
+}
+
+@end